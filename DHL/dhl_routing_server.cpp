@@ -0,0 +1,449 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <queue>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <memory>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "dhl_routing_service.h"
+
+using namespace std;
+
+// Long-lived DHL routing server: loads graph, index, contraction hierarchy and
+// coordinate mapper once, then answers newline-delimited JSON route requests
+// read from stdin (responses on stdout) or from clients of a local Unix socket.
+//
+// Request:  {"id": 7, "start_lat": 14.65, "start_lng": 121.03, "dest_lat": 14.70, "dest_lng": 121.08, "use_disruptions": false}
+// Optional: "op" ("route" (default), "ping", "stats"), "threshold_meters",
+//           "snap_to_segments" (route from positions on the nearest roads instead of the nearest intersections)
+// Response: one JSON object per line, same layout as dhl_routing_json_api plus the echoed "id".
+// Requests are served concurrently, so responses may arrive out of order - match them by "id".
+
+// Function to escape JSON strings
+string escapeJsonString(const string& input) {
+    stringstream escaped;
+    for (char c : input) {
+        switch (c) {
+            case '"': escaped << "\\\""; break;
+            case '\\': escaped << "\\\\"; break;
+            case '\n': escaped << "\\n"; break;
+            case '\r': escaped << "\\r"; break;
+            case '\t': escaped << "\\t"; break;
+            default: escaped << c; break;
+        }
+    }
+    return escaped.str();
+}
+
+// Function to convert vector to JSON array
+template<typename T>
+string vectorToJson(const vector<T>& vec) {
+    stringstream json;
+    json << "[";
+    for (size_t i = 0; i < vec.size(); i++) {
+        json << vec[i];
+        if (i < vec.size() - 1) json << ", ";
+    }
+    json << "]";
+    return json.str();
+}
+
+// Function to convert string vector to JSON array
+string stringVectorToJson(const vector<string>& vec) {
+    stringstream json;
+    json << "[";
+    for (size_t i = 0; i < vec.size(); i++) {
+        json << "\"" << escapeJsonString(vec[i]) << "\"";
+        if (i < vec.size() - 1) json << ", ";
+    }
+    json << "]";
+    return json.str();
+}
+
+// Extract the raw value of a top-level field from a flat JSON object;
+// string values are returned without quotes, other values as written
+bool getJsonField(const string& json, const string& key, string& value) {
+    string pattern = "\"" + key + "\"";
+    size_t pos = json.find(pattern);
+    while (pos != string::npos) {
+        size_t colon = json.find_first_not_of(" \t", pos + pattern.size());
+        if (colon != string::npos && json[colon] == ':') {
+            size_t start = json.find_first_not_of(" \t", colon + 1);
+            if (start == string::npos) return false;
+            if (json[start] == '"') {
+                value.clear();
+                for (size_t i = start + 1; i < json.size(); i++) {
+                    if (json[i] == '\\' && i + 1 < json.size()) {
+                        value += json[++i];
+                    } else if (json[i] == '"') {
+                        return true;
+                    } else {
+                        value += json[i];
+                    }
+                }
+                return false;
+            }
+            size_t end = json.find_first_of(",}", start);
+            value = json.substr(start, end == string::npos ? string::npos : end - start);
+            while (!value.empty() && isspace(static_cast<unsigned char>(value.back()))) value.pop_back();
+            return !value.empty();
+        }
+        pos = json.find(pattern, pos + pattern.size());
+    }
+    return false;
+}
+
+// Raw JSON token for the request id, so numeric and string ids are echoed unchanged
+string getRequestId(const string& json) {
+    string pattern = "\"id\"";
+    size_t pos = json.find(pattern);
+    if (pos == string::npos) return "null";
+    size_t start = json.find_first_not_of(" \t:", pos + pattern.size());
+    if (start == string::npos) return "null";
+    if (json[start] == '"') {
+        size_t end = start + 1;
+        while (end < json.size() && json[end] != '"') {
+            if (json[end] == '\\') end++;
+            end++;
+        }
+        return json.substr(start, end - start + 1);
+    }
+    size_t end = json.find_first_of(",} \t", start);
+    return json.substr(start, end == string::npos ? string::npos : end - start);
+}
+
+bool getJsonDouble(const string& json, const string& key, double& value) {
+    string raw;
+    if (!getJsonField(json, key, raw)) return false;
+    value = stod(raw);
+    return true;
+}
+
+bool getJsonBool(const string& json, const string& key, bool default_value) {
+    string raw;
+    if (!getJsonField(json, key, raw)) return default_value;
+    return raw == "true" || raw == "1";
+}
+
+// Destination for responses; writes are serialized so concurrent workers never interleave lines
+class ResponseSink {
+    int fd;
+    bool owns_fd;
+    mutex write_mutex;
+public:
+    ResponseSink(int fd, bool owns_fd) : fd(fd), owns_fd(owns_fd) {}
+    ~ResponseSink() {
+        if (owns_fd) close(fd);
+    }
+
+    void writeLine(const string& line) {
+        lock_guard<mutex> lock(write_mutex);
+        string data = line + "\n";
+        size_t written = 0;
+        while (written < data.size()) {
+            ssize_t n = write(fd, data.data() + written, data.size() - written);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                return; // client went away
+            }
+            written += n;
+        }
+    }
+};
+
+struct RouteRequest {
+    string line;
+    shared_ptr<ResponseSink> sink;
+};
+
+// Blocking queue feeding the worker pool
+class RequestQueue {
+    queue<RouteRequest> requests;
+    mutex queue_mutex;
+    condition_variable available;
+    bool closed = false;
+public:
+    void push(RouteRequest request) {
+        {
+            lock_guard<mutex> lock(queue_mutex);
+            requests.push(move(request));
+        }
+        available.notify_one();
+    }
+
+    // Blocks until a request is available; returns false once closed and drained
+    bool pop(RouteRequest& request) {
+        unique_lock<mutex> lock(queue_mutex);
+        available.wait(lock, [this] { return closed || !requests.empty(); });
+        if (requests.empty()) return false;
+        request = move(requests.front());
+        requests.pop();
+        return true;
+    }
+
+    void close() {
+        {
+            lock_guard<mutex> lock(queue_mutex);
+            closed = true;
+        }
+        available.notify_all();
+    }
+};
+
+string errorResponse(const string& id, const string& message) {
+    return "{\"id\": " + id + ", \"success\": false, \"error\": \"" + escapeJsonString(message) + "\"}";
+}
+
+string routeResponse(const string& id, DHLRoutingService& dhl_service, const string& request) {
+    double start_lat, start_lng, dest_lat, dest_lng;
+    if (!getJsonDouble(request, "start_lat", start_lat) || !getJsonDouble(request, "start_lng", start_lng)
+        || !getJsonDouble(request, "dest_lat", dest_lat) || !getJsonDouble(request, "dest_lng", dest_lng)) {
+        return errorResponse(id, "Request requires start_lat, start_lng, dest_lat and dest_lng");
+    }
+    bool use_disruptions = getJsonBool(request, "use_disruptions", false);
+    double threshold_meters = 1000.0;
+    getJsonDouble(request, "threshold_meters", threshold_meters);
+    bool snap_to_segments = getJsonBool(request, "snap_to_segments", false);
+
+    // Compute route
+    auto result = dhl_service.findRoute(start_lat, start_lng, dest_lat, dest_lng, use_disruptions, threshold_meters, snap_to_segments);
+
+    if (!result.success) {
+        return errorResponse(id, result.error_message);
+    }
+
+    // Build JSON response
+    stringstream json_response;
+    json_response << fixed << setprecision(6);
+
+    json_response << "{";
+    json_response << "\"id\": " << id << ",";
+    json_response << "\"success\": true,";
+    json_response << "\"algorithm\": \"DHL (Dual-Hierarchy Labelling)\",";
+
+    // Performance metrics
+    json_response << "\"metrics\": {";
+    json_response << "\"query_time_microseconds\": " << result.query_time_microseconds << ",";
+    json_response << "\"query_time_ms\": " << (result.query_time_microseconds / 1000.0) << ",";
+    json_response << "\"labeling_time_ms\": " << result.labeling_time_ms << ",";
+    json_response << "\"labeling_size_bytes\": " << result.labeling_size_bytes << ",";
+    json_response << "\"total_distance_units\": " << result.total_distance << ",";
+    json_response << "\"path_length\": " << result.path_length << ",";
+    json_response << "\"hoplinks_examined\": " << result.hoplinks_examined << ",";
+    json_response << "\"routing_mode\": \"" << result.routing_mode << "\",";
+    json_response << "\"uses_disruptions\": " << (result.uses_disruptions ? "true" : "false");
+    json_response << "},";
+
+    // Index statistics
+    json_response << "\"index_stats\": {";
+    json_response << "\"index_height\": " << result.index_height << ",";
+    json_response << "\"avg_cut_size\": " << result.avg_cut_size << ",";
+    json_response << "\"total_labels\": " << result.total_labels << ",";
+    json_response << "\"graph_nodes\": " << dhl_service.getNodeCount() << ",";
+    json_response << "\"graph_edges\": " << dhl_service.getEdgeCount();
+    json_response << "},";
+
+    // GPS to Node mapping
+    json_response << "\"gps_mapping\": {";
+    json_response << "\"start_node\": " << result.start_node << ",";
+    json_response << "\"dest_node\": " << result.dest_node << ",";
+    json_response << "\"gps_to_node_info\": \"" << escapeJsonString(result.gps_to_node_info) << "\"";
+    json_response << "},";
+
+    // Route data
+    json_response << "\"route\": {";
+    json_response << "\"complete_trace\": \"" << escapeJsonString(result.complete_route_trace) << "\",";
+    json_response << "\"path_nodes\": " << vectorToJson(result.path) << ",";
+    json_response << "\"coordinates\": [";
+    json_response << "{\"type\": \"start\", \"lat\": " << start_lat << ", \"lng\": " << start_lng << ", \"node_id\": " << result.start_node << "},";
+    json_response << "{\"type\": \"destination\", \"lat\": " << dest_lat << ", \"lng\": " << dest_lng << ", \"node_id\": " << result.dest_node << "}";
+    json_response << "]";
+    json_response << "},";
+
+    // Disruption information
+    json_response << "\"disruptions\": {";
+    json_response << "\"enabled\": " << (result.uses_disruptions ? "true" : "false") << ",";
+    json_response << "\"blocked_edges\": " << stringVectorToJson(result.blocked_edges) << ",";
+    json_response << "\"blocked_nodes\": " << vectorToJson(result.blocked_nodes);
+    json_response << "},";
+
+    // Data sources
+    json_response << "\"data_sources\": {";
+    json_response << "\"graph_file\": \"" << escapeJsonString(result.data_sources.graph_file) << "\",";
+    json_response << "\"coordinates_file\": \"" << escapeJsonString(result.data_sources.coordinates_file) << "\",";
+    json_response << "\"disruptions_file\": \"" << escapeJsonString(result.data_sources.disruptions_file) << "\"";
+    json_response << "},";
+
+    // Input parameters
+    json_response << "\"input\": {";
+    json_response << "\"start_lat\": " << start_lat << ",";
+    json_response << "\"start_lng\": " << start_lng << ",";
+    json_response << "\"dest_lat\": " << dest_lat << ",";
+    json_response << "\"dest_lng\": " << dest_lng << ",";
+    json_response << "\"use_disruptions\": " << (use_disruptions ? "true" : "false");
+    json_response << "}";
+
+    json_response << "}";
+    return json_response.str();
+}
+
+string statsResponse(const string& id, DHLRoutingService& dhl_service) {
+    stringstream json_response;
+    json_response << fixed << setprecision(6);
+    json_response << "{";
+    json_response << "\"id\": " << id << ",";
+    json_response << "\"success\": true,";
+    json_response << "\"index_stats\": {";
+    json_response << "\"index_size_bytes\": " << dhl_service.getIndexSize() << ",";
+    json_response << "\"index_loaded_from_file\": " << (dhl_service.isIndexLoadedFromFile() ? "true" : "false") << ",";
+    json_response << "\"index_height\": " << dhl_service.getIndexHeight() << ",";
+    json_response << "\"avg_cut_size\": " << dhl_service.getAvgCutSize() << ",";
+    json_response << "\"total_labels\": " << dhl_service.getTotalLabels() << ",";
+    json_response << "\"graph_nodes\": " << dhl_service.getNodeCount() << ",";
+    json_response << "\"graph_edges\": " << dhl_service.getEdgeCount();
+    json_response << "}";
+    json_response << "}";
+    return json_response.str();
+}
+
+string handleRequest(DHLRoutingService& dhl_service, const string& request) {
+    string id = getRequestId(request);
+    try {
+        string op = "route";
+        getJsonField(request, "op", op);
+        if (op == "route") return routeResponse(id, dhl_service, request);
+        if (op == "ping") return "{\"id\": " + id + ", \"success\": true}";
+        if (op == "stats") return statsResponse(id, dhl_service);
+        return errorResponse(id, "Unknown op: " + op);
+    } catch (const exception& e) {
+        return errorResponse(id, string("Exception: ") + e.what());
+    }
+}
+
+void workerLoop(DHLRoutingService& dhl_service, RequestQueue& requests) {
+    RouteRequest request;
+    while (requests.pop(request)) {
+        request.sink->writeLine(handleRequest(dhl_service, request.line));
+        request.sink.reset();
+    }
+}
+
+// Read newline-delimited requests from fd and queue them; returns on EOF or error
+void readRequests(int fd, shared_ptr<ResponseSink> sink, RequestQueue& requests) {
+    char buffer[65536];
+    string pending;
+    while (true) {
+        ssize_t n = read(fd, buffer, sizeof(buffer));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        pending.append(buffer, n);
+        size_t start = 0, end;
+        while ((end = pending.find('\n', start)) != string::npos) {
+            string line = pending.substr(start, end - start);
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            if (line.find_first_not_of(" \t") != string::npos) {
+                requests.push({line, sink});
+            }
+            start = end + 1;
+        }
+        pending.erase(0, start);
+    }
+    if (pending.find_first_not_of(" \t\r") != string::npos) {
+        requests.push({pending, sink});
+    }
+}
+
+int serveSocket(const string& socket_path, RequestQueue& requests) {
+    int server_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server_fd < 0) {
+        cerr << "Error: Cannot create socket: " << strerror(errno) << endl;
+        return 1;
+    }
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(addr.sun_path)) {
+        cerr << "Error: Socket path too long: " << socket_path << endl;
+        close(server_fd);
+        return 1;
+    }
+    strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+    unlink(socket_path.c_str());
+    if (bind(server_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(server_fd, 64) < 0) {
+        cerr << "Error: Cannot listen on " << socket_path << ": " << strerror(errno) << endl;
+        close(server_fd);
+        return 1;
+    }
+    cerr << "DHL routing server listening on " << socket_path << endl;
+
+    while (true) {
+        int client_fd = accept(server_fd, nullptr, nullptr);
+        if (client_fd < 0) {
+            if (errno == EINTR) continue;
+            cerr << "Error: accept failed: " << strerror(errno) << endl;
+            break;
+        }
+        // one reader per connection; the sink closes the socket once the last response is written
+        thread([client_fd, &requests]() {
+            readRequests(client_fd, make_shared<ResponseSink>(client_fd, true), requests);
+        }).detach();
+    }
+    close(server_fd);
+    unlink(socket_path.c_str());
+    return 1;
+}
+
+int main(int argc, char* argv[]) {
+    string socket_path, graph_file, coord_file, disruption_file, index_prefix;
+    size_t thread_count = max(1u, thread::hardware_concurrency());
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (i + 1 < argc && arg == "--socket") socket_path = argv[++i];
+        else if (i + 1 < argc && arg == "--threads") thread_count = max(1, stoi(argv[++i]));
+        else if (i + 1 < argc && arg == "--graph") graph_file = argv[++i];
+        else if (i + 1 < argc && arg == "--coords") coord_file = argv[++i];
+        else if (i + 1 < argc && arg == "--disruptions") disruption_file = argv[++i];
+        else if (i + 1 < argc && arg == "--index") index_prefix = argv[++i];
+        else {
+            cerr << "Usage: " << argv[0] << " [--socket <path>] [--threads <n>] [--graph <file>] [--coords <file>] [--disruptions <file>] [--index <prefix>]" << endl;
+            return 1;
+        }
+    }
+
+    // Initialize DHL routing service once; all requests share the resident index
+    DHLRoutingService dhl_service;
+    if (!dhl_service.initialize(graph_file, coord_file, disruption_file, index_prefix)) {
+        cerr << "Error: Failed to initialize DHL routing service" << endl;
+        return 1;
+    }
+    cerr << "Serving with " << thread_count << " worker threads" << endl;
+
+    RequestQueue requests;
+    vector<thread> workers;
+    for (size_t i = 0; i < thread_count; i++) {
+        workers.emplace_back(workerLoop, ref(dhl_service), ref(requests));
+    }
+
+    int status = 0;
+    if (socket_path.empty()) {
+        // serve stdin until EOF, then drain outstanding requests
+        readRequests(STDIN_FILENO, make_shared<ResponseSink>(STDOUT_FILENO, false), requests);
+    } else {
+        status = serveSocket(socket_path, requests);
+    }
+
+    requests.close();
+    for (thread& worker : workers) {
+        worker.join();
+    }
+    return status;
+}
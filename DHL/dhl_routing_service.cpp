@@ -1,4 +1,5 @@
 #include "dhl_routing_service.h"
+#include "util.h"
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -90,16 +91,15 @@ bool DHLRoutingService::find_data_files(string& graph_file, string& coord_file,
 }
 
 bool DHLRoutingService::load_graph(const string& graph_file) {
-    ifstream ifs(graph_file);
-    if (!ifs.is_open()) {
-        cerr << "Error: Cannot open graph file: " << graph_file << endl;
+    graph = make_unique<Graph>();
+    try {
+        read_graph(*graph, graph_file);
+    } catch (const exception& e) {
+        cerr << "Error: " << e.what() << endl;
+        graph.reset();
         return false;
     }
     
-    graph = make_unique<Graph>();
-    read_graph(*graph, ifs);
-    ifs.close();
-    
     return true;
 }
 
@@ -125,10 +125,96 @@ bool DHLRoutingService::build_index() {
     auto end_time = chrono::high_resolution_clock::now();
     last_labeling_time_ms = chrono::duration<double, milli>(end_time - start_time).count();
     last_labeling_size_bytes = con_index->size();
+    index_loaded_from_file = false;
+    
+    return true;
+}
+
+bool DHLRoutingService::load_index(const string& index_prefix, uint64_t graph_hash) {
+    if (!graph) return false;
+    
+    // Index files must have been built from this exact graph file
+    ifstream hash_ifs(index_prefix + "_hash");
+    uint64_t stored_hash = 0;
+    if (!hash_ifs.is_open() || !(hash_ifs >> stored_hash)) {
+        return false;
+    }
+    if (stored_hash != graph_hash) {
+        cerr << "Persisted index " << index_prefix << " was built from a different graph, rebuilding" << endl;
+        return false;
+    }
+    
+    auto start_time = chrono::high_resolution_clock::now();
+    
+    ifstream ch_ifs(index_prefix + "_ch", ios::binary);
+    if (!ch_ifs.is_open()) {
+        return false;
+    }
+    
+    // Prefer the memory-mapped container, labels are then used in place
+    unique_ptr<ContractionIndex> loaded_index;
+    string mapped_file = index_prefix + "_mmap";
+    if (file_exists(mapped_file)) {
+        try {
+            loaded_index = make_unique<ContractionIndex>(mapped_file, true);
+            if (loaded_index->get_graph_checksum() != graph_hash) {
+                loaded_index.reset();
+            }
+        } catch (const exception& e) {
+            cerr << "Ignoring mapped index: " << e.what() << endl;
+        }
+    }
+    if (!loaded_index) {
+        ifstream dhl_ifs(index_prefix + "_dhl", ios::binary);
+        if (!dhl_ifs.is_open()) {
+            return false;
+        }
+        loaded_index = make_unique<ContractionIndex>(dhl_ifs);
+        if (!dhl_ifs) {
+            cerr << "Persisted index " << index_prefix << " is truncated, rebuilding" << endl;
+            return false;
+        }
+    }
+    
+    auto loaded_ch = make_unique<ContractionHierarchy>(ch_ifs);
+    if (!ch_ifs) {
+        cerr << "Persisted contraction hierarchy " << index_prefix << " is truncated, rebuilding" << endl;
+        return false;
+    }
+    
+    con_index = move(loaded_index);
+    ch = move(loaded_ch);
+    
+    auto end_time = chrono::high_resolution_clock::now();
+    last_labeling_time_ms = chrono::duration<double, milli>(end_time - start_time).count();
+    last_labeling_size_bytes = con_index->size();
+    index_loaded_from_file = true;
     
     return true;
 }
 
+bool DHLRoutingService::save_index(const string& index_prefix, uint64_t graph_hash) {
+    if (!con_index || !ch) return false;
+    
+    ofstream dhl_ofs(index_prefix + "_dhl", ios::binary);
+    ofstream mapped_ofs(index_prefix + "_mmap", ios::binary);
+    ofstream ch_ofs(index_prefix + "_ch", ios::binary);
+    if (!dhl_ofs.is_open() || !mapped_ofs.is_open() || !ch_ofs.is_open()) {
+        return false;
+    }
+    con_index->write(dhl_ofs);
+    con_index->write_mapped(mapped_ofs, graph_hash);
+    ch->write(ch_ofs);
+    dhl_ofs.close();
+    mapped_ofs.close();
+    ch_ofs.close();
+    
+    // Hash is written last so an interrupted save is never mistaken for a valid index
+    ofstream hash_ofs(index_prefix + "_hash");
+    hash_ofs << graph_hash << endl;
+    return dhl_ofs && mapped_ofs && ch_ofs && hash_ofs;
+}
+
 NodeID DHLRoutingService::find_nearest_node(double lat, double lng, double threshold_meters) const {
     if (!coordinate_mapping_initialized) {
         return 0;
@@ -163,8 +249,8 @@ vector<NodeID> DHLRoutingService::reconstruct_path(NodeID start, NodeID dest) {
     }
     
     try {
-        // Run custom Dijkstra with parent tracking for path reconstruction
-        path = dijkstra_with_path_reconstruction(start, dest);
+        // Bidirectional search that stops once both frontiers meet
+        path = shortest_path(start, dest).second;
         
         // If path reconstruction failed, fall back to simple start->dest
         if (path.empty()) {
@@ -182,85 +268,18 @@ vector<NodeID> DHLRoutingService::reconstruct_path(NodeID start, NodeID dest) {
     return path;
 }
 
-vector<NodeID> DHLRoutingService::dijkstra_with_path_reconstruction(NodeID start, NodeID dest) {
-    if (!graph || start == dest) {
-        vector<NodeID> path;
-        if (start != 0) path.push_back(start);
-        return path;
+pair<distance_t, vector<NodeID>> DHLRoutingService::shortest_path(NodeID start, NodeID dest) const {
+    if (!graph) {
+        return {infinity, {}};
     }
     
-    // Custom Dijkstra implementation with path reconstruction
-    map<NodeID, distance_t> distances;
-    map<NodeID, NodeID> parents;
-    set<NodeID> visited;
-    priority_queue<pair<distance_t, NodeID>, vector<pair<distance_t, NodeID>>, greater<pair<distance_t, NodeID>>> pq;
-    
-    // Initialize
-    distances[start] = 0;
-    pq.push({0, start});
-    
-    while (!pq.empty()) {
-        auto [current_dist, current_node] = pq.top();
-        pq.pop();
-        
-        if (visited.count(current_node)) continue;
-        visited.insert(current_node);
-        
-        // If we reached the destination, reconstruct path
-        if (current_node == dest) {
-            vector<NodeID> path;
-            NodeID node = dest;
-            while (node != start) {
-                path.push_back(node);
-                if (parents.find(node) == parents.end()) {
-                    // Path reconstruction failed
-                    return {};
-                }
-                node = parents[node];
-            }
-            path.push_back(start);
-            reverse(path.begin(), path.end());
-            return path;
-        }
-        
-        // Explore neighbors using the new get_neighbors method
-        try {
-            const auto& neighbors = graph->get_neighbors(current_node);
-            for (const auto& neighbor : neighbors) {
-                NodeID neighbor_id = neighbor.node;
-                distance_t edge_weight = neighbor.distance;
-                
-                if (visited.count(neighbor_id)) continue;
-                
-                // Check if this edge is disrupted when disruptions are enabled
-                if (!disrupted_edges.empty()) {
-                    string edge_key = to_string(min(current_node, neighbor_id)) + "_" + to_string(max(current_node, neighbor_id));
-                    if (disrupted_edges.find(edge_key) != disrupted_edges.end()) {
-                        continue; // Skip this edge - it's disrupted
-                    }
-                }
-                
-                // Check if the neighbor node is blocked
-                if (isNodeBlocked(neighbor_id)) {
-                    continue; // Skip this neighbor - it's blocked
-                }
-                
-                distance_t new_dist = current_dist + edge_weight;
-                
-                if (distances.find(neighbor_id) == distances.end() || new_dist < distances[neighbor_id]) {
-                    distances[neighbor_id] = new_dist;
-                    parents[neighbor_id] = current_node;
-                    pq.push({new_dist, neighbor_id});
-                }
-            }
-        } catch (const exception& e) {
-            cerr << "Error accessing neighbors for node " << current_node << ": " << e.what() << endl;
-            break;
-        }
+    // Only pay for filtering when something is actually blocked
+    if (disrupted_edges.empty() && blocked_nodes.empty()) {
+        return graph->get_shortest_path(start, dest);
     }
-    
-    // If we couldn't find a path, return empty
-    return {};
+    return graph->get_shortest_path(start, dest, [this](NodeID from, NodeID to) {
+        return !isNodeBlocked(to) && disrupted_edges.find({min(from, to), max(from, to)}) == disrupted_edges.end();
+    });
 }
 
 string DHLRoutingService::create_route_trace(const vector<NodeID>& path) const {
@@ -283,7 +302,7 @@ string DHLRoutingService::create_route_trace(const vector<NodeID>& path) const {
     return trace.str();
 }
 
-bool DHLRoutingService::initialize(const string& graph_file, const string& coord_file, const string& disruption_file) {
+bool DHLRoutingService::initialize(const string& graph_file, const string& coord_file, const string& disruption_file, const string& index_prefix) {
     try {
         // Use provided files or detect automatically
         string final_graph_file = graph_file;
@@ -311,16 +330,35 @@ bool DHLRoutingService::initialize(const string& graph_file, const string& coord
         current_coord_file = final_coord_file;
         coordinate_mapping_initialized = true;
         
+        // Index the graph's road segments for snapping GPS positions between intersections
+        vector<Edge> edges;
+        graph->get_edges(edges);
+        vector<pair<NodeID, NodeID>> segments;
+        segments.reserve(edges.size());
+        for (const Edge& e : edges) {
+            segments.push_back({e.a, e.b});
+        }
+        cerr << "Indexed " << coordinate_mapper.buildSegmentIndex(segments) << " road segments." << endl;
+        
         // Load disruptions (optional) using coordinate mapper
         if (!final_disruption_file.empty()) {
             coordinate_mapper.loadRoadSegments(final_disruption_file);
             current_disruption_file = final_disruption_file;
         }
         
-        // Build DHL index
-        if (!build_index()) {
-            return false;
+        // Load persisted DHL index, or build it and persist it for the next start
+        current_index_prefix = index_prefix.empty() ? current_graph_file : index_prefix;
+        uint64_t graph_hash = util::file_hash(current_graph_file);
+        if (!load_index(current_index_prefix, graph_hash)) {
+            if (!build_index()) {
+                return false;
+            }
+            if (!save_index(current_index_prefix, graph_hash)) {
+                cerr << "Warning: Could not save index to " << current_index_prefix << endl;
+            }
         }
+        // from here on the graph only serves fallback searches and weight updates
+        graph->freeze();
         
         cerr << "DHL routing service initialized successfully!" << endl;
         cerr << "Graph: " << current_graph_file << endl;
@@ -328,6 +366,8 @@ bool DHLRoutingService::initialize(const string& graph_file, const string& coord
         if (!current_disruption_file.empty()) {
             cerr << "Disruptions: " << current_disruption_file << endl;
         }
+        cerr << "Index: " << current_index_prefix << (index_loaded_from_file ? " (loaded)" : " (built)")
+             << " in " << last_labeling_time_ms << " ms" << endl;
         
         return true;
         
@@ -339,7 +379,8 @@ bool DHLRoutingService::initialize(const string& graph_file, const string& coord
 
 DHLRoutingResult DHLRoutingService::findRoute(double start_lat, double start_lng, 
                                              double dest_lat, double dest_lng,
-                                             bool use_disruptions, double threshold_meters) {
+                                             bool use_disruptions, double threshold_meters,
+                                             bool snap_to_segments) {
     DHLRoutingResult result;
     
     if (!isInitialized()) {
@@ -355,6 +396,10 @@ DHLRoutingResult DHLRoutingService::findRoute(double start_lat, double start_lng
     result.uses_disruptions = use_disruptions;
     result.coordinate_threshold_meters = threshold_meters;
     
+    if (snap_to_segments && coordinate_mapper.hasSegmentIndex()) {
+        return find_segment_route(result, threshold_meters);
+    }
+    
     // Find nearest nodes
     NodeID start_node = find_nearest_node(start_lat, start_lng, threshold_meters);
     NodeID dest_node = find_nearest_node(dest_lat, dest_lng, threshold_meters);
@@ -369,9 +414,15 @@ DHLRoutingResult DHLRoutingService::findRoute(double start_lat, double start_lng
         return result;
     }
     
+    // Coordinate files may list nodes the graph does not have; the index must never see them
+    if (start_node > Graph::super_node_count() || dest_node > Graph::super_node_count()) {
+        result.error_message = "Nearest node " + to_string(max(start_node, dest_node)) + " is not part of the loaded graph";
+        return result;
+    }
+
     result.start_node = start_node;
     result.dest_node = dest_node;
-    
+
     // Create GPS mapping info
     double start_coord_lat, start_coord_lng;
     double dest_coord_lat, dest_coord_lng;
@@ -409,32 +460,10 @@ DHLRoutingResult DHLRoutingService::findRoute(double start_lat, double start_lng
     if (use_disruptions && !disrupted_edges.empty()) {
         // When disruptions are present, use Dijkstra for accurate distance calculation
         // that respects blocked edges
-        result.path = dijkstra_with_path_reconstruction(start_node, dest_node);
-        if (result.path.empty()) {
-            distance = infinity;
-            hoplinks = 0;
-        } else {
-            // Calculate distance from path
-            distance = 0;
-            for (size_t i = 0; i < result.path.size() - 1; i++) {
-                NodeID from = result.path[i];
-                NodeID to = result.path[i + 1];
-                // Find edge weight
-                try {
-                    const auto& neighbors = graph->get_neighbors(from);
-                    for (const auto& neighbor : neighbors) {
-                        if (neighbor.node == to) {
-                            distance += neighbor.distance;
-                            break;
-                        }
-                    }
-                } catch (const exception& e) {
-                    // If we can't find the edge weight, estimate
-                    distance += 1;
-                }
-            }
-            hoplinks = result.path.size() - 1; // Number of edges traversed
-        }
+        auto route = shortest_path(start_node, dest_node);
+        distance = route.first;
+        result.path = route.second;
+        hoplinks = result.path.empty() ? 0 : result.path.size() - 1; // Number of edges traversed
     } else {
         // Use precomputed DHL index when no disruptions
         distance = con_index->get_distance(start_node, dest_node);
@@ -454,6 +483,11 @@ DHLRoutingResult DHLRoutingService::findRoute(double start_lat, double start_lng
     result.success = true;
     result.total_distance = distance;
     result.hoplinks_examined = hoplinks;
+    fill_route_details(result);
+    return result;
+}
+
+void DHLRoutingService::fill_route_details(DHLRoutingResult& result, bool reconstruct) {
     result.labeling_time_ms = last_labeling_time_ms;
     result.labeling_size_bytes = last_labeling_size_bytes;
     
@@ -468,8 +502,8 @@ DHLRoutingResult DHLRoutingService::findRoute(double start_lat, double start_lng
     result.total_labels = con_index->label_count();
     
     // Reconstruct path if not already done
-    if (result.path.empty()) {
-        result.path = reconstruct_path(start_node, dest_node);
+    if (reconstruct && result.path.empty()) {
+        result.path = reconstruct_path(result.start_node, result.dest_node);
     }
     result.path_length = result.path.size();
     
@@ -477,15 +511,113 @@ DHLRoutingResult DHLRoutingService::findRoute(double start_lat, double start_lng
     result.complete_route_trace = create_route_trace(result.path);
     
     // Disruption information
-    if (use_disruptions) {
+    if (result.uses_disruptions) {
         for (const auto& edge : disrupted_edges) {
-            result.blocked_edges.push_back(edge.first);
+            result.blocked_edges.push_back(to_string(edge.first) + "_" + to_string(edge.second));
         }
         for (NodeID node : blocked_nodes) {
             result.blocked_nodes.push_back(node);
         }
     }
+}
+
+distance_t DHLRoutingService::edge_weight(NodeID v, NodeID w) const {
+    distance_t d = infinity;
+    for (const Neighbor& n : graph->get_neighbors(v)) {
+        if (n.node == w) d = min(d, n.distance);
+    }
+    return d;
+}
+
+DHLRoutingResult DHLRoutingService::find_segment_route(DHLRoutingResult& result, double threshold_meters) {
+    // Disrupted segments cannot be travelled, and segments with both endpoints blocked cannot be left,
+    // so positions snap onto the nearest open segment instead
+    function<bool(NodeID, NodeID)> open_segment = nullptr;
+    if (result.uses_disruptions && !(disrupted_edges.empty() && blocked_nodes.empty())) {
+        open_segment = [this](NodeID a, NodeID b) {
+            return disrupted_edges.find({min(a, b), max(a, b)}) == disrupted_edges.end() && !(isNodeBlocked(a) && isNodeBlocked(b));
+        };
+    }
+    dhl::DHLSegmentSnap from, to;
+    if (!coordinate_mapper.snapToSegment(result.start_lat, result.start_lng, from, open_segment) || from.distance_m > threshold_meters) {
+        result.error_message = "No start road segment found within " + to_string(threshold_meters) + "m threshold";
+        return result;
+    }
+    if (!coordinate_mapper.snapToSegment(result.dest_lat, result.dest_lng, to, open_segment) || to.distance_m > threshold_meters) {
+        result.error_message = "No destination road segment found within " + to_string(threshold_meters) + "m threshold";
+        return result;
+    }
+    
+    stringstream gps_info;
+    gps_info << "Start: (" << result.start_lat << ", " << result.start_lng << ") -> Segment " << from.source_id << "-" << from.target_id
+             << " at (" << from.latitude << ", " << from.longitude << "), " << from.distance_m << "m away";
+    gps_info << "; Dest: (" << result.dest_lat << ", " << result.dest_lng << ") -> Segment " << to.source_id << "-" << to.target_id
+             << " at (" << to.latitude << ", " << to.longitude << "), " << to.distance_m << "m away";
+    result.gps_to_node_info = gps_info.str();
+    
+    auto query_start = chrono::high_resolution_clock::now();
+    
+    // Leave the start segment through either endpoint and enter the destination segment through either
+    // endpoint, paying the partial edge weights up to the snapped positions
+    const bool use_graph = result.uses_disruptions && !disrupted_edges.empty();
+    const double from_weight = edge_weight(from.source_id, from.target_id), to_weight = edge_weight(to.source_id, to.target_id);
+    const pair<NodeID, double> exits[2] = { {from.source_id, from.fraction * from_weight}, {from.target_id, (1 - from.fraction) * from_weight} };
+    const pair<NodeID, double> entries[2] = { {to.source_id, to.fraction * to_weight}, {to.target_id, (1 - to.fraction) * to_weight} };
+    double best = infinity;
+    NodeID start_node = 0, dest_node = 0;
+    vector<NodeID> best_path; // only filled by graph searches, so the winning one need not be repeated
+    for (const auto& [exit_node, exit_offset] : exits) {
+        if (result.uses_disruptions && isNodeBlocked(exit_node)) continue;
+        for (const auto& [entry_node, entry_offset] : entries) {
+            if (result.uses_disruptions && isNodeBlocked(entry_node)) continue;
+            pair<distance_t, vector<NodeID>> route;
+            if (use_graph) {
+                route = shortest_path(exit_node, entry_node);
+            } else {
+                route.first = con_index->get_distance(exit_node, entry_node);
+            }
+            if (route.first < infinity && exit_offset + route.first + entry_offset < best) {
+                best = exit_offset + route.first + entry_offset;
+                start_node = exit_node;
+                dest_node = entry_node;
+                best_path = move(route.second);
+            }
+        }
+    }
+    // Both positions on the same segment: travel along it directly
+    bool direct = false;
+    if (from.source_id == to.source_id && from.target_id == to.target_id) {
+        double along = fabs(from.fraction - to.fraction) * from_weight;
+        if (along <= best) {
+            best = along;
+            direct = true;
+            start_node = from.fraction <= to.fraction ? from.source_id : from.target_id;
+            dest_node = from.fraction <= to.fraction ? from.target_id : from.source_id;
+        }
+    }
     
+    auto query_end = chrono::high_resolution_clock::now();
+    result.query_time_microseconds = chrono::duration<double, micro>(query_end - query_start).count();
+    
+    if (best >= infinity) {
+        result.error_message = "No path exists between road segments " + to_string(from.source_id) + "-" + to_string(from.target_id)
+                             + " and " + to_string(to.source_id) + "-" + to_string(to.target_id);
+        return result;
+    }
+    
+    result.success = true;
+    result.start_node = start_node;
+    result.dest_node = dest_node;
+    result.total_distance = static_cast<distance_t>(llround(best));
+    if (direct) {
+        // The sub-route stays strictly within the segment and passes no node
+        fill_route_details(result, false);
+        result.complete_route_trace = "DHL Route (along segment " + to_string(start_node) + " -> " + to_string(dest_node) + ")";
+        return result;
+    }
+    result.path = move(best_path);
+    result.hoplinks_examined = use_graph ? 0 : con_index->get_hoplinks(start_node, dest_node);
+    fill_route_details(result);
     return result;
 }
 
@@ -503,4 +635,12 @@ void DHLRoutingService::clearBlockedNodes() {
 
 bool DHLRoutingService::isNodeBlocked(NodeID node) const {
     return blocked_nodes.find(node) != blocked_nodes.end();
+}
+
+void DHLRoutingService::addDisruptedEdge(NodeID a, NodeID b) {
+    disrupted_edges.insert({min(a, b), max(a, b)});
+}
+
+void DHLRoutingService::clearDisruptedEdges() {
+    disrupted_edges.clear();
 }
\ No newline at end of file
@@ -67,7 +67,7 @@ private:
     bool coordinate_mapping_initialized;
     
     // Disruption handling
-    map<string, bool> disrupted_edges;
+    set<pair<NodeID, NodeID>> disrupted_edges; // (min, max) node pairs
     set<NodeID> blocked_nodes;
     
     // Performance tracking
@@ -78,34 +78,53 @@ private:
     bool load_graph(const string& graph_file);
     bool build_index();
     
+    // Persisted index (<prefix>_dhl, <prefix>_mmap, <prefix>_ch, <prefix>_hash as written by the index tool)
+    bool load_index(const string& index_prefix, uint64_t graph_hash);
+    bool save_index(const string& index_prefix, uint64_t graph_hash);
+    bool index_loaded_from_file = false;
+    
     // File path detection
     bool find_data_files(string& graph_file, string& coord_file, string& disruption_file) const;
     bool file_exists(const string& filepath) const;
     
     NodeID find_nearest_node(double lat, double lng, double threshold_meters = 1000.0) const;
     vector<NodeID> reconstruct_path(NodeID start, NodeID dest);
-    vector<NodeID> dijkstra_with_path_reconstruction(NodeID start, NodeID dest);
+    // Bidirectional shortest path on the graph, skipping blocked nodes and disrupted edges
+    pair<distance_t, vector<NodeID>> shortest_path(NodeID start, NodeID dest) const;
     string create_route_trace(const vector<NodeID>& path) const;
+    // Fill statistics, path, route trace and disruption details of a successful route; an empty path is
+    // reconstructed between start and destination node unless reconstruct is false
+    void fill_route_details(DHLRoutingResult& result, bool reconstruct = true);
+    // Weight of the edge between v and w, infinity if there is none
+    distance_t edge_weight(NodeID v, NodeID w) const;
+    // Route between GPS positions of result snapped onto road segments, as the best combination of
+    // segment endpoints plus partial edge weights
+    DHLRoutingResult find_segment_route(DHLRoutingResult& result, double threshold_meters);
     
     // Data source tracking
     string current_graph_file = "";
     string current_coord_file = "";
     string current_disruption_file = "";
+    string current_index_prefix = "";
     
 public:
     DHLRoutingService();
     ~DHLRoutingService();
     
-    // Main initialization
+    // Main initialization; index_prefix defaults to the graph file path,
+    // a matching persisted index is loaded, otherwise it is rebuilt and saved
     bool initialize(const string& graph_file = "",
                    const string& coord_file = "",
-                   const string& disruption_file = "");
+                   const string& disruption_file = "",
+                   const string& index_prefix = "");
     
-    // Main routing function
+    // Main routing function; snap_to_segments routes from and to the snapped positions on the
+    // nearest road segments instead of the nearest intersections
     DHLRoutingResult findRoute(double start_lat, double start_lng, 
                               double dest_lat, double dest_lng,
                               bool use_disruptions = false,
-                              double threshold_meters = 1000.0);
+                              double threshold_meters = 1000.0,
+                              bool snap_to_segments = false);
     
     // Utility functions
     bool isInitialized() const { return graph != nullptr && con_index != nullptr; }
@@ -117,10 +136,14 @@ public:
     size_t getIndexHeight() const { return con_index ? con_index->height() : 0; }
     double getAvgCutSize() const { return con_index ? con_index->avg_cut_size() : 0.0; }
     size_t getTotalLabels() const { return con_index ? con_index->label_count() : 0; }
+    bool isIndexLoadedFromFile() const { return index_loaded_from_file; }
     
     // Configuration
     void addBlockedNode(NodeID node);
     void removeBlockedNode(NodeID node);
     void clearBlockedNodes();
     bool isNodeBlocked(NodeID node) const;
+    // Disrupted edges are avoided by disruption-aware routes, and never snapped onto
+    void addDisruptedEdge(NodeID a, NodeID b);
+    void clearDisruptedEdges();
 };
\ No newline at end of file
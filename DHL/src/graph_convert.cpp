@@ -0,0 +1,80 @@
+#include "road_network.h"
+#include "util.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cmath>
+#include <stdexcept>
+
+using namespace std;
+using namespace road_network;
+
+// read CSV with header line and rows "node_id,value[,value...]" into columns of per-node vectors; rows for unknown nodes are skipped
+static size_t read_node_csv(const string &filename, vector<vector<double>*> columns, vector<uint64_t> *ids)
+{
+    ifstream in(filename);
+    if (!in)
+        throw runtime_error("cannot open " + filename);
+    const size_t n = Graph::super_node_count();
+    string line, field;
+    getline(in, line); // skip header
+    size_t rows = 0;
+    while (getline(in, line))
+    {
+        istringstream fields(line);
+        if (!getline(fields, field, ',') || field.empty())
+            continue;
+        NodeID v = stoul(field);
+        if (v == 0 || v > n)
+            continue;
+        for (vector<double> *column : columns)
+        {
+            getline(fields, field, ',');
+            (*column)[v] = stod(field);
+        }
+        if (ids)
+        {
+            getline(fields, field, ',');
+            (*ids)[v] = stoull(field);
+        }
+        rows++;
+    }
+    return rows;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3)
+    {
+        cerr << "usage: " << argv[0] << " <graph.gr> <snapshot> [nodes.csv [node_id_mapping.csv]]" << endl;
+        return 1;
+    }
+    try {
+        util::start_timer();
+        Graph g;
+        read_graph(g, string(argv[1]));
+        const size_t n = Graph::super_node_count();
+
+        NodeAttributes attributes;
+        if (argc > 3)
+        {
+            attributes.latitudes.assign(n + 1, NAN);
+            attributes.longitudes.assign(n + 1, NAN);
+            size_t rows = read_node_csv(argv[3], { &attributes.latitudes, &attributes.longitudes }, nullptr);
+            cout << "read coordinates of " << rows << " nodes" << endl;
+        }
+        if (argc > 4)
+        {
+            attributes.osm_ids.assign(n + 1, 0);
+            size_t rows = read_node_csv(argv[4], {}, &attributes.osm_ids);
+            cout << "read OSM ids of " << rows << " nodes" << endl;
+        }
+        write_graph_snapshot(argv[2], g, attributes);
+        cout << "wrote snapshot of " << n << " nodes and " << g.edge_count() << " edges in " << util::stop_timer() << "s" << endl;
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -1,4 +1,5 @@
 #include "road_network.h"
+#include "util.h"
 
 #include <iostream>
 #include <fstream>
@@ -8,12 +9,20 @@ using namespace road_network;
 
 int main(int argc, char** argv)
 {
+    if (argc != 3 && !(argc == 5 && string(argv[3]) == "--road-classes"))
+    {
+        cerr << "usage: " << argv[0] << " <graph.gr> <index prefix> [--road-classes <edges.csv>]" << endl;
+        return 1;
+    }
 
     // read graph
-    ifstream ifs(argv[1]);
     Graph g;
-    read_graph(g, ifs);
-    ifs.close();
+    read_graph(g, string(argv[1]));
+
+    // road classes from the highway column let cuts prefer arterial roads
+    NodeAttributes attributes;
+    if (argc == 5)
+        cout << "read road classes of " << read_road_classes(argv[4], attributes) << " edges" << endl;
 
     // degree 1 node contraction
     vector<Neighbor> closest;
@@ -21,7 +30,7 @@ int main(int argc, char** argv)
 
     // construct index
     vector<CutIndex> ci;
-    g.create_cut_index(ci, 0.2);
+    g.create_cut_index(ci, 0.2, 0, attributes.road_classes.empty() ? nullptr : &attributes);
     g.reset();
     
     ContractionHierarchy ch;
@@ -35,6 +44,15 @@ int main(int argc, char** argv)
     ofs.open(string(argv[2]) + string("_ch"));
     ch.write(ofs);
     ofs.close();
+    // graph hash allows loaders to detect stale index files
+    uint64_t graph_hash = util::file_hash(argv[1]);
+    ofs.open(string(argv[2]) + string("_hash"));
+    ofs << graph_hash << endl;
+    ofs.close();
+    // memory-mappable copy of the index for fast startup
+    ofs.open(string(argv[2]) + string("_mmap"), ios::binary);
+    con_index.write_mapped(ofs, graph_hash);
+    ofs.close();
 
     return 0;
 }
@@ -10,9 +10,14 @@ using namespace road_network;
 int main(int argc, char** argv)
 {
 
-    // read index
-    ifstream ifs(string(argv[1]) + string("_dhl"));
-    ContractionIndex con_index(ifs);
+    // read index, mapping it directly when a mapped container is available
+    string mapped_file = string(argv[1]) + string("_mmap");
+    ifstream ifs(mapped_file);
+    bool mapped = ifs.is_open();
+    ifs.close();
+    if (!mapped)
+        ifs.open(string(argv[1]) + string("_dhl"));
+    ContractionIndex con_index = mapped ? ContractionIndex(mapped_file, true) : ContractionIndex(ifs);
     ifs.close();
 
     vector<pair<NodeID, NodeID> > queries; NodeID a, b;
@@ -3,6 +3,7 @@
 
 #include <vector>
 #include <queue>
+#include <deque>
 #include <cassert>
 #include <algorithm>
 #include <iostream>
@@ -13,6 +14,20 @@
 #include <atomic>
 #include <cstring>
 #include <random>
+#include <functional>
+#include <bit>
+
+#if defined(__x86_64__) || defined(__i386__)
+    #include <immintrin.h>
+    #define MIN_PLUS_SIMD // vectorized label scans, dispatched at runtime
+#endif
+#include <fstream>
+#include <stdexcept>
+#include <type_traits>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 using namespace std;
 
@@ -29,6 +44,10 @@ namespace road_network {
 static const NodeID NO_NODE = 0; // null value equivalent for integers identifying nodes
 static const SubgraphID NO_SUBGRAPH = 0; // used to indicate that node does not belong to any active subgraph
 static const uint16_t MAX_CUT_LEVEL = 58; // maximum height of decomposition tree; 58 bits to store binary path, plus 6 bits to store path length = 64 bit integer
+static const size_t GRAPH_CHUNK_SIZE = 1 << 20; // minimum number of bytes per thread when parsing graph files
+static const pair<double,double> INERTIAL_DIRECTIONS[] = { {1, 0}, {0, 1}, {1, 1}, {1, -1} }; // projection directions for inertial-flow partitioning
+static const double INERTIAL_FRACTION = 0.25; // maximum fraction of nodes used as sources or sinks for inertial-flow partitioning
+static const uint8_t MAX_ROAD_CLASS = 7; // road class of motorways, see road_class_rank
 
 // profiling
 #ifndef NPROFILE
@@ -42,6 +61,7 @@ static const uint16_t MAX_CUT_LEVEL = 58; // maximum height of decomposition tre
 
 // progress of 0 resets counter
 static bool log_progress_on = false;
+static FlowEngine flow_engine = FlowEngine::dinitz;
 void log_progress(size_t p, ostream &os = cout)
 {
     static const size_t P_DIFF = 1000000L;
@@ -234,6 +254,103 @@ bool is_ancestor(uint64_t bv_ancestor, uint64_t bv_descendant)
 
 }
 
+//--------------------------- Min-plus kernels ----------------------
+
+// label data is followed by this many readable bytes, so vectorized scans can end on a full-width load
+static const size_t LABEL_TAIL_PADDING = 64;
+
+// computes min(a[i] + b[i]) for i < n; labels are at most infinity, so sums cannot overflow
+typedef distance_t (*MinPlusKernel)(const distance_t *a, const distance_t *b, size_t n);
+
+static distance_t min_plus_scalar(const distance_t *a, const distance_t *b, size_t n)
+{
+    distance_t min_dist = infinity;
+    for (size_t i = 0; i < n; i++)
+    {
+        distance_t dist = a[i] + b[i];
+        if (dist < min_dist)
+            min_dist = dist;
+    }
+    return min_dist;
+}
+
+#ifdef MIN_PLUS_SIMD
+// partial last vectors read into tail padding, with lanes beyond n masked to infinity
+__attribute__((target("sse4.1")))
+static distance_t min_plus_sse41(const distance_t *a, const distance_t *b, size_t n)
+{
+    const __m128i inf = _mm_set1_epi32(infinity);
+    __m128i acc = inf;
+    for (size_t i = 0; i < n; i += 4)
+    {
+        __m128i dist = _mm_add_epi32(_mm_loadu_si128((const __m128i*)(a + i)), _mm_loadu_si128((const __m128i*)(b + i)));
+        if (i + 4 > n)
+        {
+            __m128i valid = _mm_cmplt_epi32(_mm_setr_epi32(0, 1, 2, 3), _mm_set1_epi32(n - i));
+            dist = _mm_blendv_epi8(inf, dist, valid);
+        }
+        acc = _mm_min_epu32(acc, dist);
+    }
+    acc = _mm_min_epu32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+    acc = _mm_min_epu32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(acc);
+}
+
+__attribute__((target("avx2")))
+static distance_t min_plus_avx2(const distance_t *a, const distance_t *b, size_t n)
+{
+    const __m256i inf = _mm256_set1_epi32(infinity);
+    __m256i acc = inf;
+    for (size_t i = 0; i < n; i += 8)
+    {
+        __m256i dist = _mm256_add_epi32(_mm256_loadu_si256((const __m256i*)(a + i)), _mm256_loadu_si256((const __m256i*)(b + i)));
+        if (i + 8 > n)
+        {
+            __m256i valid = _mm256_cmpgt_epi32(_mm256_set1_epi32(n - i), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+            dist = _mm256_blendv_epi8(inf, dist, valid);
+        }
+        acc = _mm256_min_epu32(acc, dist);
+    }
+    __m128i acc4 = _mm_min_epu32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    acc4 = _mm_min_epu32(acc4, _mm_shuffle_epi32(acc4, _MM_SHUFFLE(1, 0, 3, 2)));
+    acc4 = _mm_min_epu32(acc4, _mm_shuffle_epi32(acc4, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(acc4);
+}
+
+// masked loads suppress faults, so no padding is needed here
+__attribute__((target("avx512f")))
+static distance_t min_plus_avx512(const distance_t *a, const distance_t *b, size_t n)
+{
+    __m512i acc = _mm512_set1_epi32(infinity);
+    for (size_t i = 0; i < n; i += 16)
+    {
+        __mmask16 valid = i + 16 > n ? (__mmask16)((1u << (n - i)) - 1) : (__mmask16)0xFFFF;
+        __m512i dist = _mm512_add_epi32(_mm512_maskz_loadu_epi32(valid, a + i), _mm512_maskz_loadu_epi32(valid, b + i));
+        acc = _mm512_mask_min_epu32(acc, valid, acc, dist);
+    }
+    alignas(64) distance_t lanes[16];
+    _mm512_store_si512(lanes, acc);
+    return *min_element(lanes, lanes + 16);
+}
+#endif
+
+static MinPlusKernel select_min_plus_kernel()
+{
+#ifdef MIN_PLUS_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        return min_plus_avx512;
+    if (__builtin_cpu_supports("avx2"))
+        return min_plus_avx2;
+    if (__builtin_cpu_supports("sse4.1"))
+        return min_plus_sse41;
+#endif
+    return min_plus_scalar;
+}
+
+// selected once at startup, based on CPU features
+static const MinPlusKernel min_plus = select_min_plus_kernel();
+
 //--------------------------- FlatCutIndex --------------------------
 
 // helper function for memory alignment
@@ -247,61 +364,42 @@ size_t aligned<uint32_t>(size_t size)
     return mod ? size + (4 - mod) : size;
 }
 
-FlatCutIndex::FlatCutIndex() : data(nullptr)
+FlatCutIndex::FlatCutIndex() : bitvector(nullptr), dist_index_data(nullptr), distance_data(nullptr)
 {
 }
 
-FlatCutIndex::FlatCutIndex(const CutIndex &ci)
+size_t FlatCutIndex::data_size(const CutIndex &ci)
 {
-    assert(ci.is_consistent());
-    // allocate memory for partition bitvector, dist_index and distances
-    size_t data_size = sizeof(uint64_t) + aligned<distance_t>(ci.dist_index.size() * sizeof(uint16_t)) + ci.distances.size() * sizeof(distance_t);
-    data = (char*)calloc(data_size, 1);
-    // copy partition bitvector, dist_index and distances into data
-    *partition_bitvector() = PBV::from(ci.partition, ci.cut_level);
-    memcpy(dist_index(), &ci.dist_index[0], ci.dist_index.size() * sizeof(uint16_t));
-    memcpy(distances(), &ci.distances[0], ci.distances.size() * sizeof(distance_t));
+    return ci.distances.size() * sizeof(distance_t);
 }
 
 bool FlatCutIndex::operator==(FlatCutIndex other) const
 {
-    return data == other.data;
-}
-
-uint64_t* FlatCutIndex::partition_bitvector()
-{
-    assert(!empty());
-    return (uint64_t*)data;
+    return distance_data == other.distance_data;
 }
 
 const uint64_t* FlatCutIndex::partition_bitvector() const
 {
     assert(!empty());
-    return (uint64_t*)data;
-}
-
-uint16_t* FlatCutIndex::dist_index()
-{
-    assert(!empty());
-    return (uint16_t*)(data + sizeof(uint64_t));
+    return bitvector;
 }
 
 const uint16_t* FlatCutIndex::dist_index() const
 {
     assert(!empty());
-    return (uint16_t*)(data + sizeof(uint64_t));
+    return dist_index_data;
 }
 
 distance_t* FlatCutIndex::distances()
 {
     assert(!empty());
-    return (distance_t*)(data + sizeof(uint64_t) + aligned<distance_t>((cut_level() + 1) * sizeof(uint16_t)));
+    return distance_data;
 }
 
 const distance_t* FlatCutIndex::distances() const
 {
     assert(!empty());
-    return (distance_t*)(data + sizeof(uint64_t) + aligned<distance_t>((cut_level() + 1) * sizeof(uint16_t)));
+    return distance_data;
 }
 
 uint64_t FlatCutIndex::partition() const
@@ -339,7 +437,7 @@ size_t FlatCutIndex::bottom_cut_size() const
 
 bool FlatCutIndex::empty() const
 {
-    return data == nullptr;
+    return distance_data == nullptr;
 }
 
 const distance_t* FlatCutIndex::cl_begin(size_t cl) const
@@ -367,17 +465,13 @@ vector<vector<distance_t>> FlatCutIndex::unflatten() const
 
 //--------------------------- ContractionLabel ----------------------
 
-ContractionLabel::ContractionLabel() : distance_offset(0), parent(NO_NODE)
+ContractionLabel::ContractionLabel() : label_offset(NO_LABELS), distance_offset(0), parent(NO_NODE)
 {
 }
 
-size_t ContractionLabel::size() const
+bool ContractionLabel::empty() const
 {
-    size_t total = sizeof(ContractionLabel);
-    // only count index data if owned
-    if (distance_offset == 0)
-        total += cut_index.size();
-    return total;
+    return label_offset == NO_LABELS;
 }
 
 //--------------------------- ContractionIndex ----------------------
@@ -389,18 +483,95 @@ static void clear_and_shrink(vector<T> &v)
     v.shrink_to_fit();
 }
 
-ContractionIndex::ContractionIndex(vector<CutIndex> &ci, vector<Neighbor> &closest)
+// orders partition bitvectors by DFS (pre-order) traversal of the partition tree
+static bool dfs_order(uint64_t bv1, uint64_t bv2)
+{
+    uint16_t cl1 = PBV::cut_level(bv1), cl2 = PBV::cut_level(bv2);
+    uint64_t diff = PBV::partition(bv1) ^ PBV::partition(bv2);
+    uint16_t common_level = min(cl1, cl2);
+    if (common_level > 0 && (diff << (64 - common_level)) != 0)
+    {
+        // first level where paths through the partition tree split
+        uint16_t split_level = __builtin_ctzll(diff);
+        return ((PBV::partition(bv1) >> split_level) & 1) == 0;
+    }
+    // ancestors come first
+    return cl1 < cl2;
+}
+
+// cache-line aligned block with zeroed tail padding, so label scans may read past the last label
+static char* allocate_label_block(size_t size)
+{
+    // size must be a multiple of alignment
+    size_t alloc_size = (size + LABEL_TAIL_PADDING + 63) & ~63ul;
+    char *block = (char*)aligned_alloc(64, alloc_size);
+    if (block == nullptr)
+        throw bad_alloc();
+    memset(block + size, 0, alloc_size - size);
+    return block;
+}
+
+void ContractionIndex::allocate_arena(vector<NodeID> &owners, const vector<size_t> &data_sizes)
+{
+    stable_sort(owners.begin(), owners.end(), [this](NodeID a, NodeID b) { return dfs_order(partition_bitvectors[a], partition_bitvectors[b]); });
+    // labels start at 8-byte boundaries
+    arena_size = 0;
+    for (NodeID node : owners)
+    {
+        assert(arena_size / 8 < ContractionLabel::NO_LABELS);
+        labels[node].label_offset = arena_size / 8;
+        arena_size += (data_sizes[node] + 7) & ~7ul;
+    }
+    arena = allocate_label_block(arena_size);
+}
+
+void ContractionIndex::add_dist_index(NodeID node, const uint16_t *dist_index, size_t size)
+{
+    assert(dist_indices.size() + size <= UINT32_MAX);
+    dist_index_offsets[node] = dist_indices.size();
+    dist_indices.insert(dist_indices.end(), dist_index, dist_index + size);
+}
+
+void ContractionIndex::link_contracted_labels()
+{
+    for (NodeID node = 1; node < labels.size(); node++)
+    {
+        ContractionLabel &cl = labels[node];
+        if (cl.distance_offset != 0)
+        {
+            NodeID root = cl.parent;
+            while (labels[root].distance_offset != 0)
+                root = labels[root].parent;
+            cl.label_offset = labels[root].label_offset;
+            partition_bitvectors[node] = partition_bitvectors[root];
+            dist_index_offsets[node] = dist_index_offsets[root];
+        }
+    }
+}
+
+ContractionIndex::ContractionIndex(vector<CutIndex> &ci, vector<Neighbor> &closest) : arena(nullptr), arena_size(0), mapped_region(nullptr), mapped_size(0), graph_checksum(0)
 {
     assert(ci.size() == closest.size());
     labels.resize(ci.size());
+    partition_bitvectors.resize(ci.size(), 0);
+    dist_index_offsets.resize(ci.size(), 0);
     // handle core nodes
+    vector<NodeID> owners;
+    vector<size_t> data_sizes(ci.size(), 0);
     for (NodeID node = 1; node < closest.size(); node++)
-    {
         if (closest[node].node == node)
         {
             assert(closest[node].distance == 0);
-            labels[node].cut_index = FlatCutIndex(ci[node]);
+            owners.push_back(node);
+            partition_bitvectors[node] = PBV::from(ci[node].partition, ci[node].cut_level);
+            data_sizes[node] = FlatCutIndex::data_size(ci[node]);
         }
+    allocate_arena(owners, data_sizes);
+    for (NodeID node : owners)
+    {
+        assert(ci[node].is_consistent());
+        add_dist_index(node, ci[node].dist_index.data(), ci[node].dist_index.size());
+        memcpy(get_cut_index(node).distances(), ci[node].distances.data(), data_sizes[node]);
         // conserve memory
         clear_and_shrink(ci[node].dist_index);
         clear_and_shrink(ci[node].distances);
@@ -421,44 +592,60 @@ ContractionIndex::ContractionIndex(vector<CutIndex> &ci, vector<Neighbor> &close
                 root_dist += closest[root].distance;
                 root = closest[root].node;
             }
-            // copy index
-            assert(!labels[root].cut_index.empty());
-            labels[node].cut_index = labels[root].cut_index;
+            // share index
+            assert(!labels[root].empty());
+            labels[node].label_offset = labels[root].label_offset;
             labels[node].distance_offset = root_dist;
             labels[node].parent = n.node;
+            partition_bitvectors[node] = partition_bitvectors[root];
+            dist_index_offsets[node] = dist_index_offsets[root];
         }
     }
     clear_and_shrink(ci);
     clear_and_shrink(closest);
 }
 
-ContractionIndex::ContractionIndex(std::vector<CutIndex> &ci)
+ContractionIndex::ContractionIndex(std::vector<CutIndex> &ci) : arena(nullptr), arena_size(0), mapped_region(nullptr), mapped_size(0), graph_checksum(0)
 {
     labels.resize(ci.size());
+    partition_bitvectors.resize(ci.size(), 0);
+    dist_index_offsets.resize(ci.size(), 0);
+    vector<NodeID> owners;
+    vector<size_t> data_sizes(ci.size(), 0);
     for (NodeID node = 1; node < ci.size(); node++)
         if (!ci[node].empty())
         {
-            labels[node].cut_index = FlatCutIndex(ci[node]);
-            // conserve memory
-            clear_and_shrink(ci[node].dist_index);
-            clear_and_shrink(ci[node].distances);
+            owners.push_back(node);
+            partition_bitvectors[node] = PBV::from(ci[node].partition, ci[node].cut_level);
+            data_sizes[node] = FlatCutIndex::data_size(ci[node]);
         }
+    allocate_arena(owners, data_sizes);
+    for (NodeID node : owners)
+    {
+        assert(ci[node].is_consistent());
+        add_dist_index(node, ci[node].dist_index.data(), ci[node].dist_index.size());
+        memcpy(get_cut_index(node).distances(), ci[node].distances.data(), data_sizes[node]);
+        // conserve memory
+        clear_and_shrink(ci[node].dist_index);
+        clear_and_shrink(ci[node].distances);
+    }
     clear_and_shrink(ci);
 }
 
 ContractionIndex::~ContractionIndex()
 {
-    for (NodeID node = 1; node < labels.size(); node++)
-        // not all labels own their cut index data
-        if (!labels[node].cut_index.empty() && labels[node].distance_offset == 0)
-            free(labels[node].cut_index.data);
+    // label data is released as a whole
+    if (mapped_region != nullptr)
+        munmap(mapped_region, mapped_size);
+    else
+        free(arena);
 }
 
 distance_t ContractionIndex::get_distance(NodeID v, NodeID w) const
 {
     ContractionLabel cv = labels[v], cw = labels[w];
-    assert(!cv.cut_index.empty() && !cw.cut_index.empty());
-    if (cv.cut_index == cw.cut_index)
+    assert(!cv.empty() && !cw.empty());
+    if (cv.label_offset == cw.label_offset)
     {
         if (v == w)
             return 0;
@@ -495,12 +682,14 @@ distance_t ContractionIndex::get_distance(NodeID v, NodeID w) const
         }
         return cv.distance_offset + cw.distance_offset - 2 * cv_anc.distance_offset;
     }
-    return cv.distance_offset + cw.distance_offset + get_distance(cv.cut_index, cw.cut_index);
+    // lca level comes from compact bitvector array, so only the needed label data gets loaded
+    size_t lca_level = PBV::lca_level(partition_bitvectors[v], partition_bitvectors[w]);
+    return cv.distance_offset + cw.distance_offset + get_distance(get_cut_index(v), get_cut_index(w), lca_level);
 }
 
 size_t ContractionIndex::get_hoplinks(NodeID v, NodeID w) const
 {
-    FlatCutIndex cv = labels[v].cut_index, cw = labels[w].cut_index;
+    FlatCutIndex cv = get_cut_index(v), cw = get_cut_index(w);
     if (cv == cw)
         return 0;
     return get_hoplinks(cv, cw);
@@ -516,22 +705,12 @@ double ContractionIndex::avg_hoplinks(const std::vector<std::pair<NodeID,NodeID>
 
 distance_t ContractionIndex::get_cut_level_distance(FlatCutIndex a, FlatCutIndex b, size_t cut_level)
 {
-    distance_t min_dist = infinity;
     uint16_t a_offset = get_offset(a.dist_index(), cut_level);
     uint16_t b_offset = get_offset(b.dist_index(), cut_level);
     const distance_t* a_ptr = a.distances() + a_offset;
     const distance_t* b_ptr = b.distances() + b_offset;
-    const distance_t* a_end = a_ptr + min(a.dist_index()[cut_level] - a_offset, b.dist_index()[cut_level] - b_offset);
     // find min 2-hop distance within partition
-    while (a_ptr != a_end)
-    {
-        distance_t dist = *a_ptr + *b_ptr;
-        if (dist < min_dist)
-            min_dist = dist;
-        a_ptr++;
-        b_ptr++;
-    }
-    return min_dist;
+    return min_plus(a_ptr, b_ptr, min(a.dist_index()[cut_level] - a_offset, b.dist_index()[cut_level] - b_offset));
 }
 
 size_t ContractionIndex::get_cut_level_hoplinks(FlatCutIndex a, FlatCutIndex b, size_t cut_level)
@@ -542,7 +721,11 @@ size_t ContractionIndex::get_cut_level_hoplinks(FlatCutIndex a, FlatCutIndex b,
 distance_t ContractionIndex::get_distance(FlatCutIndex a, FlatCutIndex b)
 {
     // find lowest level at which partitions differ
-    size_t cut_level = PBV::lca_level(*a.partition_bitvector(), *b.partition_bitvector());
+    return get_distance(a, b, PBV::lca_level(*a.partition_bitvector(), *b.partition_bitvector()));
+}
+
+distance_t ContractionIndex::get_distance(FlatCutIndex a, FlatCutIndex b, size_t cut_level)
+{
 #ifdef NO_SHORTCUTS
     distance_t min_dist = infinity;
 #ifdef PRUNING
@@ -550,17 +733,7 @@ distance_t ContractionIndex::get_distance(FlatCutIndex a, FlatCutIndex b)
         min_dist = min(min_dist, get_cut_level_distance(a, b, cl));
 #else
     // no pruning means we have a continuous block to check
-    const distance_t* a_ptr = a.distances();
-    const distance_t* b_ptr = b.distances();
-    const distance_t* a_end = a_ptr + min(a.dist_index()[cut_level], b.dist_index()[cut_level]);
-    while (a_ptr != a_end)
-    {
-        distance_t dist = *a_ptr + *b_ptr;
-        if (dist < min_dist)
-            min_dist = dist;
-        a_ptr++;
-        b_ptr++;
-    }
+    min_dist = min_plus(a.distances(), b.distances(), min(a.dist_index()[cut_level], b.dist_index()[cut_level]));
 #endif
     return min_dist;
 #else
@@ -584,12 +757,12 @@ size_t ContractionIndex::uncontracted_count() const
 
 bool ContractionIndex::in_partition_subgraph(NodeID node, uint64_t partition_bitvector) const
 {
-    return !is_contracted(node) && PBV::is_ancestor(partition_bitvector, *labels[node].cut_index.partition_bitvector());
+    return !is_contracted(node) && PBV::is_ancestor(partition_bitvector, partition_bitvectors[node]);
 }
 
 uint16_t ContractionIndex::dist_index(NodeID node) const
 {
-    FlatCutIndex const& ci = labels[node].cut_index;
+    FlatCutIndex ci = get_cut_index(node);
     uint16_t index = get_offset(ci.dist_index(), ci.cut_level());
     while (ci.distances()[index] != 0)
         index++;
@@ -601,6 +774,18 @@ ContractionLabel ContractionIndex::get_contraction_label(NodeID v) const
     return labels[v];
 }
 
+FlatCutIndex ContractionIndex::get_cut_index(NodeID v) const
+{
+    FlatCutIndex fci;
+    if (!labels[v].empty())
+    {
+        fci.bitvector = &partition_bitvectors[v];
+        fci.dist_index_data = &dist_indices[dist_index_offsets[v]];
+        fci.distance_data = (distance_t*)(arena + 8 * (size_t)labels[v].label_offset);
+    }
+    return fci;
+}
+
 void ContractionIndex::update_distance_offset(NodeID n, distance_t d)
 {
     labels[n].distance_offset = d;
@@ -629,26 +814,21 @@ size_t ContractionIndex::get_hoplinks(FlatCutIndex a, FlatCutIndex b)
 
 size_t ContractionIndex::size() const
 {
-    size_t total = 0;
-    for (NodeID node = 1; node < labels.size(); node++)
-    {
-        // skip isolated nodes (subgraph)
-        if (!labels[node].cut_index.empty())
-            total += labels[node].size();
-    }
-    return total;
+    return labels.size() * sizeof(ContractionLabel) + partition_bitvectors.size() * sizeof(uint64_t)
+        + dist_index_offsets.size() * sizeof(uint32_t) + dist_indices.size() * sizeof(uint16_t) + arena_size;
 }
 
 double ContractionIndex::avg_cut_size() const
 {
     double cut_sum = 0, label_count = 0;
     for (NodeID node = 1; node < labels.size(); node++)
-        if (!labels[node].cut_index.empty())
+        if (!labels[node].empty())
         {
-            cut_sum += labels[node].cut_index.cut_level() + 1;
-            label_count += labels[node].cut_index.label_count();
+            FlatCutIndex ci = get_cut_index(node);
+            cut_sum += ci.cut_level() + 1;
+            label_count += ci.label_count();
             // adjust for label pruning
-            label_count += labels[node].cut_index.bottom_cut_size() + 1;
+            label_count += ci.bottom_cut_size() + 1;
         }
     return label_count / max(1.0, cut_sum);
 }
@@ -657,8 +837,8 @@ size_t ContractionIndex::max_cut_size() const
 {
     size_t max_cut = 0;
     for (NodeID node = 1; node < labels.size(); node++)
-        if (!labels[node].cut_index.empty())
-            max_cut = max(max_cut, 1 + labels[node].cut_index.bottom_cut_size());
+        if (!labels[node].empty())
+            max_cut = max(max_cut, 1 + get_cut_index(node).bottom_cut_size());
     return max_cut;
 }
 
@@ -666,8 +846,8 @@ size_t ContractionIndex::height() const
 {
     uint16_t max_cut_level = 0;
     for (NodeID node = 1; node < labels.size(); node++)
-        if (!labels[node].cut_index.empty())
-            max_cut_level = max(max_cut_level, labels[node].cut_index.cut_level());
+        if (!labels[node].empty())
+            max_cut_level = max(max_cut_level, PBV::cut_level(partition_bitvectors[node]));
     return max_cut_level;
 }
 
@@ -675,8 +855,8 @@ size_t ContractionIndex::label_count() const
 {
     size_t total = 0;
     for (NodeID node = 1; node < labels.size(); node++)
-        if (!labels[node].cut_index.empty() && labels[node].distance_offset == 0)
-            total += labels[node].cut_index.label_count();
+        if (!labels[node].empty() && labels[node].distance_offset == 0)
+            total += get_cut_index(node).label_count();
     return total;
 }
 
@@ -688,7 +868,7 @@ size_t ContractionIndex::non_empty_cuts() const
         if (is_contracted(node))
             continue;
         // count nodes that come first within their cut
-        FlatCutIndex const& ci = labels[node].cut_index;
+        FlatCutIndex ci = get_cut_index(node);
         if (ci.distances()[get_offset(ci.dist_index(), ci.cut_level())] == 0)
             total++;
     }
@@ -702,8 +882,8 @@ bool ContractionIndex::check_query(std::pair<NodeID,NodeID> query, Graph &g) con
     if (d_index != d_dijkstra)
     {
         cerr << "BUG: d_index=" << d_index << ", d_dijkstra=" << d_dijkstra << endl;
-        cerr << "index[" << query.first << "]=" << labels[query.first] << endl;
-        cerr << "index[" << query.second << "]=" << labels[query.second] << endl;
+        cerr << "index[" << query.first << "]=" << labels[query.first] << " " << get_cut_index(query.first) << endl;
+        cerr << "index[" << query.second << "]=" << labels[query.second] << " " << get_cut_index(query.second) << endl;
     }
     return d_index == d_dijkstra;
 }
@@ -727,9 +907,18 @@ void ContractionIndex::write(ostream& os) const
         os.write((char*)&cl.distance_offset, sizeof(distance_t));
         if (cl.distance_offset == 0)
         {
-            size_t data_size = cl.cut_index.size();
+            FlatCutIndex ci = get_cut_index(node);
+            size_t data_size = ci.empty() ? 0 : ci.size();
             os.write((char*)&data_size, sizeof(size_t));
-            os.write(cl.cut_index.data, data_size);
+            if (data_size == 0)
+                continue;
+            // partition bitvector, padded dist_index and distances in a single block
+            static const char zeros[sizeof(distance_t)] = {};
+            size_t dist_index_size = (ci.cut_level() + 1) * sizeof(uint16_t);
+            os.write((const char*)ci.partition_bitvector(), sizeof(uint64_t));
+            os.write((const char*)ci.dist_index(), dist_index_size);
+            os.write(zeros, aligned<distance_t>(dist_index_size) - dist_index_size);
+            os.write((const char*)ci.distances(), ci.label_count() * sizeof(distance_t));
         }
         else
             os.write((char*)&cl.parent, sizeof(NodeID));
@@ -747,7 +936,7 @@ void ContractionIndex::write_json(std::ostream& os) const
         os << node << ":";
         ContractionLabel cl = labels[node];
         if (cl.distance_offset == 0)
-            os << cl.cut_index.unflatten();
+            os << get_cut_index(node).unflatten();
 	else
             os << "{\"p\":" << cl.parent << ",\"d\":" << cl.distance_offset << "}";
         os << (node == labels.size() - 1 ? "" : ",") << endl;
@@ -757,12 +946,17 @@ void ContractionIndex::write_json(std::ostream& os) const
     set_list_format(lf);
 }
 
-ContractionIndex::ContractionIndex(istream& is)
+ContractionIndex::ContractionIndex(istream& is) : arena(nullptr), arena_size(0), mapped_region(nullptr), mapped_size(0), graph_checksum(0)
 {
-    // read index data
+    // read index data into staging buffer (file is in node order)
     size_t node_count = 0;
     is.read((char*)&node_count, sizeof(size_t));
     labels.resize(node_count + 1);
+    partition_bitvectors.resize(node_count + 1, 0);
+    dist_index_offsets.resize(node_count + 1, 0);
+    vector<char> staging;
+    vector<size_t> staging_offsets(node_count + 1, 0), data_sizes(node_count + 1, 0);
+    vector<NodeID> owners;
     for (NodeID node = 1; node < labels.size(); node++)
     {
         ContractionLabel &cl = labels[node];
@@ -771,22 +965,440 @@ ContractionIndex::ContractionIndex(istream& is)
         {
             size_t data_size = 0;
             is.read((char*)&data_size, sizeof(size_t));
-            cl.cut_index.data = (char*)malloc(data_size);
-            is.read(cl.cut_index.data, data_size);
+            if (!is || data_size == 0)
+                continue;
+            staging_offsets[node] = staging.size();
+            staging.resize(staging.size() + data_size);
+            is.read(staging.data() + staging_offsets[node], data_size);
+            memcpy(&partition_bitvectors[node], staging.data() + staging_offsets[node], sizeof(uint64_t));
+            // only distances go into arena
+            data_sizes[node] = data_size - sizeof(uint64_t) - aligned<distance_t>((PBV::cut_level(partition_bitvectors[node]) + 1) * sizeof(uint16_t));
+            owners.push_back(node);
         }
         else
             is.read((char*)&cl.parent, sizeof(NodeID));
     }
-    // fix data references
+    // split into dist_index array and arena, re-ordered by partition tree
+    allocate_arena(owners, data_sizes);
+    for (NodeID node : owners)
+    {
+        const char *data = staging.data() + staging_offsets[node];
+        size_t dist_index_size = PBV::cut_level(partition_bitvectors[node]) + 1;
+        vector<uint16_t> dist_index(dist_index_size);
+        memcpy(dist_index.data(), data + sizeof(uint64_t), dist_index_size * sizeof(uint16_t));
+        add_dist_index(node, dist_index.data(), dist_index_size);
+        memcpy(get_cut_index(node).distances(), data + sizeof(uint64_t) + aligned<distance_t>(dist_index_size * sizeof(uint16_t)), data_sizes[node]);
+    }
+    link_contracted_labels();
+}
+
+// layout of memory-mappable index container
+static const char MAPPED_MAGIC[8] = { 'D', 'H', 'L', 'I', 'N', 'D', 'E', 'X' };
+static const uint32_t MAPPED_VERSION = 4; // version 4 stores node table as ContractionLabel array
+static const uint64_t MAPPED_ALIGNMENT = 64; // sections start on cache line boundaries
+
+enum MappedSectionID : uint32_t { NODE_TABLE = 1, LABEL_BLOB = 2, PARTITION_BITVECTORS = 3, DIST_INDEX_OFFSETS = 4, DIST_INDICES = 5 };
+static const uint32_t MAPPED_SECTION_COUNT = 5;
+
+struct MappedHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t variant; // compile-time algorithm config the index was built with
+    uint64_t node_count;
+    uint64_t graph_checksum;
+    uint32_t section_count;
+    uint32_t reserved;
+};
+
+struct MappedSection
+{
+    uint32_t id;
+    uint32_t reserved;
+    uint64_t offset;
+    uint64_t size;
+};
+
+// node table is the ContractionLabel array, with label offsets in 8-byte units of the label blob
+static_assert(is_trivially_copyable<ContractionLabel>::value && sizeof(ContractionLabel) == 12, "node table layout");
+
+static uint32_t index_variant()
+{
+    uint32_t variant = 0;
+#ifdef NO_SHORTCUTS
+    variant |= 1;
+#endif
+#ifdef PRUNING
+    variant |= 2;
+#endif
+#ifdef CONTRACT2D
+    variant |= 4;
+#endif
+    return variant;
+}
+
+static uint64_t align_offset(uint64_t offset)
+{
+    return (offset + MAPPED_ALIGNMENT - 1) & ~(MAPPED_ALIGNMENT - 1);
+}
+
+void ContractionIndex::write_mapped(ostream& os, uint64_t graph_checksum) const
+{
+    // header and section table
+    MappedHeader header = {};
+    memcpy(header.magic, MAPPED_MAGIC, sizeof(MAPPED_MAGIC));
+    header.version = MAPPED_VERSION;
+    header.variant = index_variant();
+    header.node_count = labels.size() - 1;
+    header.graph_checksum = graph_checksum;
+    header.section_count = MAPPED_SECTION_COUNT;
+    // label blob comes last, followed by tail padding
+    const char *section_data[MAPPED_SECTION_COUNT] = { (const char*)labels.data(), (const char*)partition_bitvectors.data(),
+        (const char*)dist_index_offsets.data(), (const char*)dist_indices.data(), arena };
+    MappedSection sections[MAPPED_SECTION_COUNT] = {
+        { NODE_TABLE, 0, 0, labels.size() * sizeof(ContractionLabel) },
+        { PARTITION_BITVECTORS, 0, 0, partition_bitvectors.size() * sizeof(uint64_t) },
+        { DIST_INDEX_OFFSETS, 0, 0, dist_index_offsets.size() * sizeof(uint32_t) },
+        { DIST_INDICES, 0, 0, dist_indices.size() * sizeof(uint16_t) },
+        { LABEL_BLOB, 0, 0, arena_size }
+    };
+    uint64_t offset = sizeof(MappedHeader) + sizeof(sections);
+    for (MappedSection &section : sections)
+    {
+        section.offset = align_offset(offset);
+        offset = section.offset + section.size;
+    }
+    // write, padding sections to their offsets
+    static const char zeros[MAPPED_ALIGNMENT] = {};
+    os.write((char*)&header, sizeof(MappedHeader));
+    os.write((char*)sections, sizeof(sections));
+    offset = sizeof(MappedHeader) + sizeof(sections);
+    for (uint32_t i = 0; i < MAPPED_SECTION_COUNT; i++)
+    {
+        os.write(zeros, sections[i].offset - offset);
+        os.write(section_data[i], sections[i].size);
+        offset = sections[i].offset + sections[i].size;
+    }
+    os.write(zeros, LABEL_TAIL_PADDING);
+}
+
+ContractionIndex::ContractionIndex(const string& mapped_file, bool prefault) : arena(nullptr), arena_size(0), mapped_region(nullptr), mapped_size(0), graph_checksum(0)
+{
+    int fd = open(mapped_file.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw runtime_error("cannot open index file " + mapped_file);
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) < 0 || file_stat.st_size < (off_t)sizeof(MappedHeader))
+    {
+        close(fd);
+        throw runtime_error("index file too small: " + mapped_file);
+    }
+    // read-only, updates copy the label blob to the heap first (see make_writable)
+    int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+    if (prefault)
+        flags |= MAP_POPULATE;
+#endif
+    void *region = mmap(nullptr, file_stat.st_size, PROT_READ, flags, fd, 0);
+    close(fd);
+    if (region == MAP_FAILED)
+        throw runtime_error("cannot map index file " + mapped_file);
+    mapped_region = (char*)region;
+    mapped_size = file_stat.st_size;
+    // validate header and locate sections
+    auto fail = [this, &mapped_file](const string &reason) {
+        munmap(mapped_region, mapped_size);
+        mapped_region = nullptr;
+        throw runtime_error(reason + ": " + mapped_file);
+    };
+    const MappedHeader &header = *(const MappedHeader*)mapped_region;
+    if (memcmp(header.magic, MAPPED_MAGIC, sizeof(MAPPED_MAGIC)) != 0)
+        fail("not a mapped index file");
+    if (header.version != MAPPED_VERSION)
+        fail("unsupported index format version " + to_string(header.version));
+    if (header.variant != index_variant())
+        fail("index built with different algorithm config");
+    if (sizeof(MappedHeader) + header.section_count * sizeof(MappedSection) > mapped_size)
+        fail("truncated section table");
+    const MappedSection *section_table = (const MappedSection*)(mapped_region + sizeof(MappedHeader));
+    const MappedSection *found[MAPPED_SECTION_COUNT + 1] = {};
+    for (uint32_t i = 0; i < header.section_count; i++)
+    {
+        const MappedSection &section = section_table[i];
+        if (section.offset > mapped_size || section.size > mapped_size - section.offset)
+            fail("truncated section");
+        if (section.id >= 1 && section.id <= MAPPED_SECTION_COUNT)
+            found[section.id] = &section;
+    }
+    for (uint32_t id = 1; id <= MAPPED_SECTION_COUNT; id++)
+        if (found[id] == nullptr)
+            fail("missing section " + to_string(id));
+    size_t entries = header.node_count + 1;
+    const MappedSection *node_table = found[NODE_TABLE], *label_blob = found[LABEL_BLOB];
+    if (node_table->size != entries * sizeof(ContractionLabel) || found[PARTITION_BITVECTORS]->size != entries * sizeof(uint64_t)
+        || found[DIST_INDEX_OFFSETS]->size != entries * sizeof(uint32_t) || found[DIST_INDICES]->size % sizeof(uint16_t) != 0)
+        fail("malformed sections");
+    if (label_blob->offset + label_blob->size + LABEL_TAIL_PADDING > mapped_size)
+        fail("missing label blob padding");
+    graph_checksum = header.graph_checksum;
+    // per-node arrays are copied, label blob serves as arena
+    const ContractionLabel *table = (const ContractionLabel*)(mapped_region + node_table->offset);
+    const uint64_t *bitvectors = (const uint64_t*)(mapped_region + found[PARTITION_BITVECTORS]->offset);
+    const uint32_t *offsets = (const uint32_t*)(mapped_region + found[DIST_INDEX_OFFSETS]->offset);
+    const uint16_t *indices = (const uint16_t*)(mapped_region + found[DIST_INDICES]->offset);
+    labels.assign(table, table + entries);
+    partition_bitvectors.assign(bitvectors, bitvectors + entries);
+    dist_index_offsets.assign(offsets, offsets + entries);
+    dist_indices.assign(indices, indices + found[DIST_INDICES]->size / sizeof(uint16_t));
+    arena = mapped_region + label_blob->offset;
+    arena_size = label_blob->size;
+    // label ranges are checked via dist_index, without touching the blob
     for (NodeID node = 1; node < labels.size(); node++)
+        if (!labels[node].empty())
+        {
+            uint16_t cut_level = PBV::cut_level(partition_bitvectors[node]);
+            if ((uint64_t)dist_index_offsets[node] + cut_level + 1 > dist_indices.size()
+                || 8 * (uint64_t)labels[node].label_offset + dist_indices[dist_index_offsets[node] + cut_level] * sizeof(distance_t) > arena_size)
+                fail("label offset out of range");
+        }
+}
+
+void ContractionIndex::make_writable()
+{
+    if (mapped_region == nullptr)
+        return;
+    char *heap_arena = allocate_label_block(arena_size);
+    memcpy(heap_arena, arena, arena_size);
+    munmap(mapped_region, mapped_size);
+    mapped_region = nullptr;
+    mapped_size = 0;
+    arena = heap_arena;
+}
+
+uint64_t ContractionIndex::get_graph_checksum() const
+{
+    return graph_checksum;
+}
+
+//--------------------------- Push-relabel --------------------------
+
+// compact flow network over local vertex ids, with arcs stored in adjacency arrays
+// and each arc paired with its reverse residual arc
+class FlowNetwork
+{
+    struct Arc
     {
-        ContractionLabel &cl = labels[node];
-        if (cl.distance_offset != 0)
+        uint32_t from, to;
+        int32_t capacity;
+    };
+    uint32_t vertex_count = 0;
+    vector<Arc> added; // arcs in order of add_arc calls, until finalize
+    vector<uint32_t> first_arc, head, rev, position, fill_pos;
+    vector<int32_t> residual;
+    // push-relabel state
+    vector<uint32_t> height, current;
+    vector<int64_t> excess;
+    vector<uint8_t> active;
+    deque<uint32_t> fifo;
+    vector<uint32_t> bfs_queue;
+
+    void global_relabel(uint32_t root);
+    void push(uint32_t v, uint32_t arc, int64_t amount);
+    void relabel(uint32_t v);
+    // discharges active vertices towards root until none are left that can reach it
+    void discharge_all(uint32_t root, uint32_t other);
+public:
+    static const int32_t UNBOUNDED = INT32_MAX / 2;
+
+    // clears network, keeping allocated memory for reuse
+    void reset(uint32_t vertex_count);
+    // adds arc together with reverse residual arc of capacity 0; returns id for querying flow
+    uint32_t add_arc(uint32_t from, uint32_t to, int32_t capacity);
+    // converts arcs into adjacency arrays; no arcs may be added afterwards
+    void finalize();
+    // computes maximum s-t flow using two-phase FIFO push-relabel with global relabeling; returns flow value
+    int64_t max_flow(uint32_t s, uint32_t t);
+    // flow along arc with given id
+    int32_t flow(uint32_t arc_id) const;
+    // marks vertices reachable from root in residual network, or from which root is reachable if backward
+    void residual_reachable(uint32_t root, bool backward, vector<uint8_t> &reached);
+};
+
+// number of relabel scans per vertex and arc between global relabels
+static const size_t GLOBAL_RELABEL_FREQUENCY = 6;
+
+void FlowNetwork::reset(uint32_t vertex_count)
+{
+    this->vertex_count = vertex_count;
+    added.clear();
+}
+
+uint32_t FlowNetwork::add_arc(uint32_t from, uint32_t to, int32_t capacity)
+{
+    assert(from < vertex_count && to < vertex_count && capacity > 0);
+    added.push_back({ from, to, capacity });
+    return added.size() - 1;
+}
+
+void FlowNetwork::finalize()
+{
+    // count sort arcs and their reverses by tail
+    first_arc.assign(vertex_count + 1, 0);
+    for (const Arc &a : added)
+    {
+        first_arc[a.from + 1]++;
+        first_arc[a.to + 1]++;
+    }
+    for (uint32_t v = 0; v < vertex_count; v++)
+        first_arc[v + 1] += first_arc[v];
+    const size_t arc_count = 2 * added.size();
+    head.resize(arc_count);
+    rev.resize(arc_count);
+    residual.resize(arc_count);
+    position.resize(added.size());
+    fill_pos.assign(first_arc.begin(), first_arc.end() - 1);
+    for (size_t i = 0; i < added.size(); i++)
+    {
+        const Arc &a = added[i];
+        uint32_t forward = fill_pos[a.from]++, backward = fill_pos[a.to]++;
+        head[forward] = a.to;
+        head[backward] = a.from;
+        rev[forward] = backward;
+        rev[backward] = forward;
+        residual[forward] = a.capacity;
+        residual[backward] = 0;
+        position[i] = forward;
+    }
+    added.clear();
+}
+
+void FlowNetwork::global_relabel(uint32_t root)
+{
+    // exact residual distances to root; vertices cut off from root get vertex_count, which makes them inactive
+    height.assign(vertex_count, vertex_count);
+    height[root] = 0;
+    bfs_queue.assign(1, root);
+    for (size_t i = 0; i < bfs_queue.size(); i++)
+    {
+        uint32_t w = bfs_queue[i];
+        for (uint32_t a = first_arc[w]; a < first_arc[w + 1]; a++)
         {
-            NodeID root = cl.parent;
-            while (labels[root].distance_offset != 0)
-                root = labels[root].parent;
-            cl.cut_index = labels[root].cut_index;
+            uint32_t u = head[a];
+            if (height[u] == vertex_count && residual[rev[a]] > 0)
+            {
+                height[u] = height[w] + 1;
+                bfs_queue.push_back(u);
+            }
+        }
+    }
+    for (uint32_t v = 0; v < vertex_count; v++)
+        current[v] = first_arc[v];
+}
+
+void FlowNetwork::push(uint32_t v, uint32_t arc, int64_t amount)
+{
+    uint32_t w = head[arc];
+    residual[arc] -= amount;
+    residual[rev[arc]] += amount;
+    excess[v] -= amount;
+    excess[w] += amount;
+    if (!active[w])
+    {
+        active[w] = true;
+        fifo.push_back(w);
+    }
+}
+
+void FlowNetwork::relabel(uint32_t v)
+{
+    uint32_t min_height = vertex_count;
+    for (uint32_t a = first_arc[v]; a < first_arc[v + 1]; a++)
+        if (residual[a] > 0)
+            min_height = min(min_height, height[head[a]] + 1);
+    height[v] = min_height;
+    current[v] = first_arc[v];
+}
+
+void FlowNetwork::discharge_all(uint32_t root, uint32_t other)
+{
+    global_relabel(root);
+    height[other] = vertex_count;
+    const size_t relabel_budget = GLOBAL_RELABEL_FREQUENCY * vertex_count + head.size();
+    size_t relabel_work = 0;
+    while (!fifo.empty())
+    {
+        uint32_t v = fifo.front();
+        fifo.pop_front();
+        active[v] = false;
+        while (excess[v] > 0 && height[v] < vertex_count)
+        {
+            if (current[v] == first_arc[v + 1])
+            {
+                relabel(v);
+                relabel_work += first_arc[v + 1] - first_arc[v];
+                continue;
+            }
+            uint32_t a = current[v];
+            if (residual[a] > 0 && height[v] == height[head[a]] + 1)
+                push(v, a, min<int64_t>(excess[v], residual[a]));
+            else
+                current[v]++;
+        }
+        if (relabel_work > relabel_budget)
+        {
+            global_relabel(root);
+            height[other] = vertex_count;
+            relabel_work = 0;
+        }
+    }
+}
+
+int64_t FlowNetwork::max_flow(uint32_t s, uint32_t t)
+{
+    assert(added.empty());
+    excess.assign(vertex_count, 0);
+    current.resize(vertex_count);
+    active.assign(vertex_count, false);
+    fifo.clear();
+    // s and t never become active
+    active[s] = active[t] = true;
+    for (uint32_t a = first_arc[s]; a < first_arc[s + 1]; a++)
+        if (residual[a] > 0)
+            push(s, a, residual[a]);
+    // phase one finds a maximum preflow, moving excess towards t only
+    discharge_all(t, s);
+    // phase two returns remaining excess to s, turning the preflow into a flow
+    for (uint32_t v = 0; v < vertex_count; v++)
+        if (excess[v] > 0 && !active[v])
+        {
+            active[v] = true;
+            fifo.push_back(v);
+        }
+    discharge_all(s, t);
+    return excess[t];
+}
+
+int32_t FlowNetwork::flow(uint32_t arc_id) const
+{
+    return residual[rev[position[arc_id]]];
+}
+
+void FlowNetwork::residual_reachable(uint32_t root, bool backward, vector<uint8_t> &reached)
+{
+    reached.assign(vertex_count, false);
+    reached[root] = true;
+    bfs_queue.assign(1, root);
+    for (size_t i = 0; i < bfs_queue.size(); i++)
+    {
+        uint32_t v = bfs_queue[i];
+        for (uint32_t a = first_arc[v]; a < first_arc[v + 1]; a++)
+        {
+            uint32_t w = head[a];
+            if (!reached[w] && residual[backward ? rev[a] : a] > 0)
+            {
+                reached[w] = true;
+                bfs_queue.push_back(w);
+            }
         }
     }
 }
@@ -812,33 +1424,37 @@ bool Neighbor::operator<(const Neighbor &other) const
 
 Node::Node(SubgraphID subgraph_id) : subgraph_id(subgraph_id)
 {
-    distance = outcopy_distance = 0;
-    inflow = outflow = NO_NODE;
-    landmark_level = 0;
 }
 
-Node& MultiThreadNodeData::operator[](size_type pos)
+FlowData::FlowData() : outcopy_distance(0), inflow(NO_NODE), outflow(NO_NODE)
+{
+}
+
+template<typename T>
+T& MultiThreadNodeData<T>::operator[](size_t pos)
 {
     if (pos == Graph::s)
         return s_data;
     if (pos == Graph::t)
         return t_data;
-    return vector::operator[](pos);
+    return vector<T>::operator[](pos);
 }
 
-const Node& MultiThreadNodeData::operator[](size_type pos) const
+template<typename T>
+const T& MultiThreadNodeData<T>::operator[](size_t pos) const
 {
     if (pos == Graph::s)
         return s_data;
     if (pos == Graph::t)
         return t_data;
-    return vector::operator[](pos);
+    return vector<T>::operator[](pos);
 }
 
-void MultiThreadNodeData::normalize()
+template<typename T>
+void MultiThreadNodeData<T>::normalize()
 {
-    vector::operator[](Graph::s) = s_data;
-    vector::operator[](Graph::t) = t_data;
+    vector<T>::operator[](Graph::s) = s_data;
+    vector<T>::operator[](Graph::t) = t_data;
 }
 
 double Partition::rating() const
@@ -878,20 +1494,59 @@ bool DiffData::cmp_diff(DiffData x, DiffData y)
 }
 
 // definition of static members
-thread_local Node MultiThreadNodeData::s_data(NO_SUBGRAPH), MultiThreadNodeData::t_data(NO_SUBGRAPH);
+template<> thread_local Node MultiThreadNodeData<Node>::s_data(NO_SUBGRAPH);
+template<> thread_local Node MultiThreadNodeData<Node>::t_data(NO_SUBGRAPH);
+template<> thread_local distance_t MultiThreadNodeData<distance_t>::s_data = 0;
+template<> thread_local distance_t MultiThreadNodeData<distance_t>::t_data = 0;
+template<> thread_local FlowData MultiThreadNodeData<FlowData>::s_data = FlowData();
+template<> thread_local FlowData MultiThreadNodeData<FlowData>::t_data = FlowData();
+template<> thread_local uint16_t MultiThreadNodeData<uint16_t>::s_data = 0;
+template<> thread_local uint16_t MultiThreadNodeData<uint16_t>::t_data = 0;
+template class MultiThreadNodeData<Node>;
+template class MultiThreadNodeData<distance_t>;
+template class MultiThreadNodeData<FlowData>;
+template class MultiThreadNodeData<uint16_t>;
 #ifdef MULTI_THREAD
-MultiThreadNodeData Graph::node_data;
 size_t Graph::thread_threshold;
-#else
-vector<Node> Graph::node_data;
+#endif
+Graph::NodeArray<Node> Graph::node_data;
+vector<uint32_t> Graph::adj_offsets;
+vector<Neighbor> Graph::adj_edges;
+Graph::NodeArray<distance_t> Graph::node_distance;
+Graph::NodeArray<FlowData> Graph::flow_data;
+Graph::NodeArray<uint16_t> Graph::landmark_level;
+#ifdef MULTI_THREAD_DISTANCES
+vector<array<distance_t, MULTI_THREAD_DISTANCES>> Graph::par_distances;
 #endif
 NodeID Graph::s, Graph::t;
+// planar node coordinates for inertial-flow partitioning; only set during create_cut_index, NaN for nodes without coordinates
+static vector<double> partition_x, partition_y;
+// road class priors for cut vertices; only set during create_cut_index, 0 for nodes without road class
+static vector<uint8_t> node_road_class;
+
+#ifdef MULTI_THREAD
+// pool running subgraph recursion and label searches during index construction, and label repairs during
+// updates; sized by create_cut_index
+static unique_ptr<util::TaskPool> shared_tasks;
+
+static util::TaskPool& task_pool()
+{
+    if (!shared_tasks)
+        shared_tasks = make_unique<util::TaskPool>();
+    return *shared_tasks;
+}
+#endif
 
 void Graph::show_progress(bool state)
 {
     log_progress_on = state;
 }
 
+void Graph::set_flow_engine(FlowEngine engine)
+{
+    flow_engine = engine;
+}
+
 bool Graph::contains(NodeID node) const
 {
     return node_data[node].subgraph_id == subgraph_id;
@@ -916,6 +1571,9 @@ void Graph::resize(size_t node_count)
     assert(nodes.empty());
     // node numbering starts from 1, and we reserve two additional nodes for s & t
     node_data.clear();
+    adj_offsets.clear();
+    adj_edges.clear();
+    release_scratch();
     node_data.resize(node_count + 3, Node(subgraph_id));
     s = node_count + 1;
     t = node_count + 2;
@@ -930,12 +1588,13 @@ void Graph::resize(size_t node_count)
 
 void Graph::add_edge(NodeID v, NodeID w, distance_t distance, bool add_reverse)
 {
+    assert(!is_frozen());
     assert(v < node_data.size());
     assert(w < node_data.size());
     assert(distance > 0);
     // check for existing edge
     bool exists = false;
-    for (Neighbor &n : node_data[v].neighbors)
+    for (Neighbor &n : neighbors(v))
         if (n.node == w)
         {
             exists = true;
@@ -948,8 +1607,60 @@ void Graph::add_edge(NodeID v, NodeID w, distance_t distance, bool add_reverse)
         add_edge(w, v, distance, false);
 }
 
+void Graph::add_edges(const vector<Edge> &edges)
+{
+    assert(!is_frozen());
+    // counting sort of both arc directions by tail, keeping input order within each adjacency list
+    vector<uint32_t> offsets(node_data.size() + 1, 0);
+    for (const Edge &e : edges)
+    {
+        assert(e.a < node_data.size() && e.b < node_data.size());
+        assert(e.d > 0);
+        offsets[e.a + 1]++;
+        offsets[e.b + 1]++;
+    }
+    for (size_t i = 1; i < offsets.size(); i++)
+        offsets[i] += offsets[i - 1];
+    vector<Neighbor> arcs(offsets.back(), Neighbor(NO_NODE, 0));
+    vector<uint32_t> next(offsets.begin(), offsets.end() - 1);
+    for (const Edge &e : edges)
+    {
+        arcs[next[e.a]++] = Neighbor(e.b, e.d);
+        arcs[next[e.b]++] = Neighbor(e.a, e.d);
+    }
+    // merge parallel edges like add_edge does: first position, minimal distance
+    vector<NodeID> last_tail(node_data.size(), node_data.size());
+    vector<uint32_t> position(node_data.size());
+    for (NodeID v = 0; v < node_data.size(); v++)
+    {
+        vector<Neighbor> &neighbors = node_data[v].neighbors;
+        assert(neighbors.empty());
+        neighbors.reserve(offsets[v + 1] - offsets[v]);
+        for (uint32_t i = offsets[v]; i < offsets[v + 1]; i++)
+        {
+            Neighbor n = arcs[i];
+            if (last_tail[n.node] == v)
+                neighbors[position[n.node]].distance = min(neighbors[position[n.node]].distance, n.distance);
+            else
+            {
+                last_tail[n.node] = v;
+                position[n.node] = neighbors.size();
+                neighbors.push_back(n);
+            }
+        }
+    }
+}
+
+void Graph::set_neighbors(NodeID v, span<const Neighbor> neighbors)
+{
+    assert(!is_frozen());
+    assert(v < node_data.size());
+    node_data[v].neighbors.assign(neighbors.begin(), neighbors.end());
+}
+
 void Graph::remove_edge(NodeID v, NodeID w)
 {
+    assert(!is_frozen());
     auto& v_neighbors = node_data[v].neighbors;
     auto it_v = std::remove_if(v_neighbors.begin(), v_neighbors.end(), [w](const Neighbor &n) { return n.node == w; });
     v_neighbors.erase(it_v, v_neighbors.end());
@@ -962,14 +1673,15 @@ void Graph::remove_edge(NodeID v, NodeID w)
 pair<distance_t, pair<NodeID, NodeID> > Graph::random_update()
 {
         NodeID a = random_node();
-        NodeID b = rand() % node_data[a].neighbors.size();
+        span<const Neighbor> a_neighbors = neighbors(a);
+        NodeID b = rand() % a_neighbors.size();
 
-        return make_pair(node_data[a].neighbors[b].distance, make_pair(a, node_data[a].neighbors[b].node));
+        return make_pair(a_neighbors[b].distance, make_pair(a, a_neighbors[b].node));
 }
 
 void Graph::update_edge(NodeID v, NodeID w, distance_t d)
 {
-        for (Neighbor &n : node_data[v].neighbors)
+        for (Neighbor &n : neighbors(v))
                 if (n.node == w) {
                         n.distance = d;
                         break;
@@ -994,7 +1706,7 @@ void Graph::reset()
     nodes.clear();
     for (NodeID node = 1; node < node_data.size() - 2; node++)
     {
-        if (!node_data[node].neighbors.empty())
+        if (!neighbors(node).empty())
         {
             nodes.push_back(node);
             node_data[node].subgraph_id = subgraph_id;
@@ -1004,6 +1716,28 @@ void Graph::reset()
     node_data[t].subgraph_id = NO_SUBGRAPH;
 }
 
+void Graph::freeze()
+{
+    if (is_frozen())
+        return;
+    adj_offsets.reserve(node_data.size() + 1);
+    adj_offsets.push_back(0);
+    for (NodeID node = 0; node < node_data.size(); node++)
+        adj_offsets.push_back(adj_offsets.back() + node_data[node].neighbors.size());
+    adj_edges.reserve(adj_offsets.back());
+    for (NodeID node = 0; node < node_data.size(); node++)
+    {
+        adj_edges.insert(adj_edges.end(), node_data[node].neighbors.begin(), node_data[node].neighbors.end());
+        vector<Neighbor>().swap(node_data[node].neighbors);
+    }
+    release_scratch();
+}
+
+bool Graph::is_frozen() const
+{
+    return !adj_offsets.empty();
+}
+
 void Graph::add_node(NodeID v)
 {
     assert(v < node_data.size());
@@ -1027,7 +1761,7 @@ size_t Graph::edge_count() const
 {
     size_t ecount = 0;
     for (NodeID node : nodes)
-        for (Neighbor n : node_data[node].neighbors)
+        for (Neighbor n : neighbors(node))
             if (contains(n.node))
                 ecount++;
     return ecount / 2;
@@ -1037,7 +1771,7 @@ size_t Graph::degree(NodeID v) const
 {
     assert(contains(v));
     size_t deg = 0;
-    for (Neighbor n : node_data[v].neighbors)
+    for (Neighbor n : neighbors(v))
         if (contains(n.node))
             deg++;
     return deg;
@@ -1047,7 +1781,7 @@ Neighbor Graph::single_neighbor(NodeID v) const
 {
     assert(contains(v));
     Neighbor neighbor(NO_NODE, 0);
-    for (Neighbor n : node_data[v].neighbors)
+    for (Neighbor n : neighbors(v))
         if (contains(n.node))
         {
             if (neighbor.node == NO_NODE)
@@ -1058,6 +1792,42 @@ Neighbor Graph::single_neighbor(NodeID v) const
     return neighbor;
 }
 
+span<Neighbor> Graph::neighbors(NodeID v)
+{
+    if (adj_offsets.empty())
+        return node_data[v].neighbors;
+    return span<Neighbor>(adj_edges.data() + adj_offsets[v], adj_offsets[v + 1] - adj_offsets[v]);
+}
+
+span<const Neighbor> Graph::neighbors(NodeID v) const
+{
+    if (adj_offsets.empty())
+        return node_data[v].neighbors;
+    return span<const Neighbor>(adj_edges.data() + adj_offsets[v], adj_offsets[v + 1] - adj_offsets[v]);
+}
+
+void Graph::reserve_scratch()
+{
+    if (node_distance.size() == node_data.size())
+        return;
+    node_distance.assign(node_data.size(), 0);
+    flow_data.assign(node_data.size(), FlowData());
+    landmark_level.assign(node_data.size(), 0);
+#ifdef MULTI_THREAD_DISTANCES
+    par_distances.resize(node_data.size());
+#endif
+}
+
+void Graph::release_scratch()
+{
+    NodeArray<distance_t>().swap(node_distance);
+    NodeArray<FlowData>().swap(flow_data);
+    NodeArray<uint16_t>().swap(landmark_level);
+#ifdef MULTI_THREAD_DISTANCES
+    vector<array<distance_t, MULTI_THREAD_DISTANCES>>().swap(par_distances);
+#endif
+}
+
 size_t Graph::super_node_count()
 {
     return node_data.size() - 3;
@@ -1072,7 +1842,7 @@ void Graph::get_edges(vector<Edge> &edges) const
 {
     edges.clear();
     for (NodeID a : nodes)
-        for (const Neighbor &n : node_data[a].neighbors)
+        for (const Neighbor &n : neighbors(a))
             if (n.node > a && contains(n.node))
                 edges.push_back(Edge(a, n.node, n.distance));
 }
@@ -1124,8 +1894,8 @@ void Graph::run_dijkstra(NodeID v)
     assert(contains(v));
     // init distances
     for (NodeID node : nodes)
-        node_data[node].distance = infinity;
-    node_data[v].distance = 0;
+        node_distance[node] = infinity;
+    node_distance[v] = 0;
     // init queue
     priority_queue<SearchNode> q;
     q.push(SearchNode(0, v));
@@ -1135,16 +1905,16 @@ void Graph::run_dijkstra(NodeID v)
         SearchNode next = q.top();
         q.pop();
 
-        for (Neighbor n : node_data[next.node].neighbors)
+        for (Neighbor n : neighbors(next.node))
         {
             // filter neighbors nodes not belonging to subgraph
             if (!contains(n.node))
                 continue;
             // update distance and enque
             distance_t new_dist = next.distance + n.distance;
-            if (new_dist < node_data[n.node].distance)
+            if (new_dist < node_distance[n.node])
             {
-                node_data[n.node].distance = new_dist;
+                node_distance[n.node] = new_dist;
                 q.push(SearchNode(new_dist, n.node));
             }
         }
@@ -1155,11 +1925,11 @@ void Graph::run_dijkstra_llsub(NodeID v)
 {
     CHECK_CONSISTENT;
     assert(contains(v));
-    const uint16_t pruning_level = node_data[v].landmark_level;
+    const uint16_t pruning_level = landmark_level[v];
     // init distances
     for (NodeID node : nodes)
-        node_data[node].distance = infinity;
-    node_data[v].distance = 0;
+        node_distance[node] = infinity;
+    node_distance[v] = 0;
     // init queue
     priority_queue<SearchNode> q;
     q.push(SearchNode(0, v));
@@ -1169,17 +1939,16 @@ void Graph::run_dijkstra_llsub(NodeID v)
         SearchNode next = q.top();
         q.pop();
 
-        for (Neighbor n : node_data[next.node].neighbors)
+        for (Neighbor n : neighbors(next.node))
         {
-            Node &n_data = node_data[n.node];
             // filter neighbors nodes not belonging to subgraph or having higher landmark level
-            if (!contains(n.node) || n_data.landmark_level >= pruning_level)
+            if (!contains(n.node) || landmark_level[n.node] >= pruning_level)
                 continue;
             // update distance and enque
             distance_t new_dist = next.distance + n.distance;
-            if (new_dist < n_data.distance)
+            if (new_dist < node_distance[n.node])
             {
-                n_data.distance = new_dist;
+                node_distance[n.node] = new_dist;
                 q.push(SearchNode(new_dist, n.node));
             }
         }
@@ -1191,17 +1960,17 @@ void Graph::run_dijkstra_ll(NodeID v)
 {
     CHECK_CONSISTENT;
     assert(contains(v));
-    const uint16_t pruning_level = node_data[v].landmark_level;
+    const uint16_t pruning_level = landmark_level[v];
     // init distances
     for (NodeID node : nodes)
-        node_data[node].distance = infinity;
-    node_data[v].distance = 1;
+        node_distance[node] = infinity;
+    node_distance[v] = 1;
     // init queue
     priority_queue<SearchNode> q;
-    for (Neighbor n : node_data[v].neighbors)
+    for (Neighbor n : neighbors(v))
     {
         distance_t n_dist = (n.distance << 1) | 1;
-        node_data[n.node].distance = n_dist;
+        node_distance[n.node] = n_dist;
         q.push(SearchNode(n_dist, n.node));
     }
     // dijkstra
@@ -1210,18 +1979,17 @@ void Graph::run_dijkstra_ll(NodeID v)
         SearchNode next = q.top();
         q.pop();
 
-        const Node &next_data = node_data[next.node];
-        distance_t current_dist = next_data.landmark_level >= pruning_level ? next.distance & ~static_cast<distance_t>(1) : next.distance;
-        for (Neighbor n : next_data.neighbors)
+        distance_t current_dist = landmark_level[next.node] >= pruning_level ? next.distance & ~static_cast<distance_t>(1) : next.distance;
+        for (Neighbor n : neighbors(next.node))
         {
             // filter neighbors nodes not belonging to subgraph
             if (!contains(n.node))
                 continue;
             // update distance and enque
             distance_t new_dist = current_dist + (n.distance << 1);
-            if (new_dist < node_data[n.node].distance)
+            if (new_dist < node_distance[n.node])
             {
-                node_data[n.node].distance = new_dist;
+                node_distance[n.node] = new_dist;
                 q.push(SearchNode(new_dist, n.node));
             }
         }
@@ -1233,14 +2001,13 @@ void Graph::run_dijkstra_ll(NodeID v)
 void Graph::run_dijkstra_par(const vector<NodeID> &vertices)
 {
     CHECK_CONSISTENT;
-    vector<thread> threads;
     auto dijkstra = [this](NodeID v, size_t distance_id) {
         assert(contains(v));
         assert(distance_id < MULTI_THREAD_DISTANCES);
         // init distances
         for (NodeID node : nodes)
-            node_data[node].distances[distance_id] = infinity;
-        node_data[v].distances[distance_id] = 0;
+            par_distances[node][distance_id] = infinity;
+        par_distances[v][distance_id] = 0;
         // init queue
         priority_queue<SearchNode> q;
         q.push(SearchNode(0, v));
@@ -1250,39 +2017,38 @@ void Graph::run_dijkstra_par(const vector<NodeID> &vertices)
             SearchNode next = q.top();
             q.pop();
 
-            for (Neighbor n : node_data[next.node].neighbors)
+            for (Neighbor n : neighbors(next.node))
             {
                 // filter neighbors nodes not belonging to subgraph
                 if (!contains(n.node))
                     continue;
                 // update distance and enque
                 distance_t new_dist = next.distance + n.distance;
-                if (new_dist < node_data[n.node].distances[distance_id])
+                if (new_dist < par_distances[n.node][distance_id])
                 {
-                    node_data[n.node].distances[distance_id] = new_dist;
+                    par_distances[n.node][distance_id] = new_dist;
                     q.push(SearchNode(new_dist, n.node));
                 }
             }
         }
     };
+    util::TaskPool::TaskGroup group(task_pool());
     for (size_t i = 0; i < vertices.size(); i++)
-        threads.push_back(thread(dijkstra, vertices[i], i));
-    for (size_t i = 0; i < vertices.size(); i++)
-        threads[i].join();
+        group.spawn([&dijkstra, &vertices, i] { dijkstra(vertices[i], i); });
+    group.wait();
 }
 
 void Graph::run_dijkstra_llsub_par(const std::vector<NodeID> &vertices)
 {
     CHECK_CONSISTENT;
-    vector<thread> threads;
     auto dijkstra = [this](NodeID v, size_t distance_id) {
         assert(contains(v));
         assert(distance_id < MULTI_THREAD_DISTANCES);
-        const uint16_t pruning_level = node_data[v].landmark_level;
+        const uint16_t pruning_level = landmark_level[v];
         // init distances
         for (NodeID node : nodes)
-            node_data[node].distances[distance_id] = infinity;
-        node_data[v].distances[distance_id] = 0;
+            par_distances[node][distance_id] = infinity;
+        par_distances[v][distance_id] = 0;
         // init queue
         priority_queue<SearchNode> q;
         q.push(SearchNode(0, v));
@@ -1292,47 +2058,45 @@ void Graph::run_dijkstra_llsub_par(const std::vector<NodeID> &vertices)
             SearchNode next = q.top();
             q.pop();
 
-            for (Neighbor n : node_data[next.node].neighbors)
+            for (Neighbor n : neighbors(next.node))
             {
-                Node &n_data = node_data[n.node];
                 // filter neighbors nodes not belonging to subgraph or having higher landmark level
-                if (!contains(n.node) || n_data.landmark_level >= pruning_level)
+                if (!contains(n.node) || landmark_level[n.node] >= pruning_level)
                     continue;
                 // update distance and enque
                 distance_t new_dist = next.distance + n.distance;
-                if (new_dist < n_data.distances[distance_id])
+                if (new_dist < par_distances[n.node][distance_id])
                 {
-                    n_data.distances[distance_id] = new_dist;
+                    par_distances[n.node][distance_id] = new_dist;
                     q.push(SearchNode(new_dist, n.node));
                 }
             }
         }
     };
+    util::TaskPool::TaskGroup group(task_pool());
     for (size_t i = 0; i < vertices.size(); i++)
-        threads.push_back(thread(dijkstra, vertices[i], i));
-    for (size_t i = 0; i < vertices.size(); i++)
-        threads[i].join();
+        group.spawn([&dijkstra, &vertices, i] { dijkstra(vertices[i], i); });
+    group.wait();
 }
 
 #ifdef PRUNING
 void Graph::run_dijkstra_ll_par(const vector<NodeID> &vertices)
 {
     CHECK_CONSISTENT;
-    vector<thread> threads;
     auto dijkstra = [this](NodeID v, size_t distance_id) {
         assert(contains(v));
         assert(distance_id < MULTI_THREAD_DISTANCES);
-        const uint16_t pruning_level = node_data[v].landmark_level;
+        const uint16_t pruning_level = landmark_level[v];
         // init distances
         for (NodeID node : nodes)
-            node_data[node].distances[distance_id] = infinity;
-        node_data[v].distances[distance_id] = 1;
+            par_distances[node][distance_id] = infinity;
+        par_distances[v][distance_id] = 1;
         // init queue
         priority_queue<SearchNode> q;
-        for (Neighbor n : node_data[v].neighbors)
+        for (Neighbor n : neighbors(v))
         {
             distance_t n_dist = (n.distance << 1) | 1;
-            node_data[n.node].distances[distance_id] = n_dist;
+            par_distances[n.node][distance_id] = n_dist;
             q.push(SearchNode(n_dist, n.node));
         }
         // dijkstra
@@ -1341,27 +2105,26 @@ void Graph::run_dijkstra_ll_par(const vector<NodeID> &vertices)
             SearchNode next = q.top();
             q.pop();
 
-            const Node &next_data = node_data[next.node];
-            distance_t current_dist = next_data.landmark_level >= pruning_level ? next.distance & ~static_cast<distance_t>(1) : next.distance;
-            for (Neighbor n : next_data.neighbors)
+            distance_t current_dist = landmark_level[next.node] >= pruning_level ? next.distance & ~static_cast<distance_t>(1) : next.distance;
+            for (Neighbor n : neighbors(next.node))
             {
                 // filter neighbors nodes not belonging to subgraph
                 if (!contains(n.node))
                     continue;
                 // update distance and enque
                 distance_t new_dist = current_dist + (n.distance << 1);
-                if (new_dist < node_data[n.node].distances[distance_id])
+                if (new_dist < par_distances[n.node][distance_id])
                 {
-                    node_data[n.node].distances[distance_id] = new_dist;
+                    par_distances[n.node][distance_id] = new_dist;
                     q.push(SearchNode(new_dist, n.node));
                 }
             }
         }
     };
+    util::TaskPool::TaskGroup group(task_pool());
     for (size_t i = 0; i < vertices.size(); i++)
-        threads.push_back(thread(dijkstra, vertices[i], i));
-    for (size_t i = 0; i < vertices.size(); i++)
-        threads[i].join();
+        group.spawn([&dijkstra, &vertices, i] { dijkstra(vertices[i], i); });
+    group.wait();
 }
 #endif
 #endif
@@ -1372,8 +2135,8 @@ void Graph::run_bfs(NodeID v)
     assert(contains(v));
     // init distances
     for (NodeID node : nodes)
-        node_data[node].distance = infinity;
-    node_data[v].distance = 0;
+        node_distance[node] = infinity;
+    node_distance[v] = 0;
     // init queue
     queue<NodeID> q;
     q.push(v);
@@ -1383,14 +2146,14 @@ void Graph::run_bfs(NodeID v)
         NodeID next = q.front();
         q.pop();
 
-        distance_t new_dist = node_data[next].distance + 1;
-        for (Neighbor n : node_data[next].neighbors)
+        distance_t new_dist = node_distance[next] + 1;
+        for (Neighbor n : neighbors(next))
         {
             // filter neighbors nodes not belonging to subgraph or already visited
-            if (contains(n.node) && node_data[n.node].distance == infinity)
+            if (contains(n.node) && node_distance[n.node] == infinity)
             {
                 // update distance and enque
-                node_data[n.node].distance = new_dist;
+                node_distance[n.node] = new_dist;
                 q.push(n.node);
             }
         }
@@ -1426,16 +2189,16 @@ void Graph::run_flow_bfs_from_s()
     assert(contains(s) && contains(t));
     // init distances
     for (NodeID node : nodes)
-        node_data[node].distance = node_data[node].outcopy_distance = infinity;
-    node_data[t].distance = node_data[t].outcopy_distance = 0;
+        node_distance[node] = flow_data[node].outcopy_distance = infinity;
+    node_distance[t] = flow_data[t].outcopy_distance = 0;
     // init queue - start with neighbors of s as s requires special flow handling
     queue<FlowNode> q;
-    for (Neighbor n : node_data[s].neighbors)
-        if (contains(n.node) && node_data[n.node].inflow != s)
+    for (Neighbor n : neighbors(s))
+        if (contains(n.node) && flow_data[n.node].inflow != s)
         {
-            assert(node_data[n.node].inflow == NO_NODE);
-            node_data[n.node].distance = 1;
-            node_data[n.node].outcopy_distance = 1; // treat inner-node edges as length 0
+            assert(flow_data[n.node].inflow == NO_NODE);
+            node_distance[n.node] = 1;
+            flow_data[n.node].outcopy_distance = 1; // treat inner-node edges as length 0
             q.push(FlowNode(n.node, false));
         }
     // BFS
@@ -1444,17 +2207,17 @@ void Graph::run_flow_bfs_from_s()
         FlowNode fn = q.front();
         q.pop();
 
-        distance_t fn_dist = fn.outcopy ? node_data[fn.node].outcopy_distance : node_data[fn.node].distance;
-        NodeID inflow = node_data[fn.node].inflow;
+        distance_t fn_dist = fn.outcopy ? flow_data[fn.node].outcopy_distance : node_distance[fn.node];
+        NodeID inflow = flow_data[fn.node].inflow;
         // special treatment is needed for node with flow through it
         if (inflow != NO_NODE && !fn.outcopy)
         {
             // inflow is only valid neighbor
-            if (update_distance(node_data[inflow].outcopy_distance, fn_dist + 1))
+            if (update_distance(flow_data[inflow].outcopy_distance, fn_dist + 1))
             {
                 // need to set distance for 0-distance nodes immediately
                 // otherwise a longer path may set wrong distance value first
-                update_distance(node_data[inflow].distance, fn_dist + 1);
+                update_distance(node_distance[inflow], fn_dist + 1);
                 q.push(FlowNode(inflow, true));
             }
         }
@@ -1462,7 +2225,7 @@ void Graph::run_flow_bfs_from_s()
         {
             // when arriving at the outgoing copy of flow node, all neighbors except outflow are valid
             // outflow must have been already visited in this case, so checking all neighbors is fine
-            for (Neighbor n : node_data[fn.node].neighbors)
+            for (Neighbor n : neighbors(fn.node))
             {
                 // filter neighbors nodes not belonging to subgraph
                 if (!contains(n.node))
@@ -1470,20 +2233,20 @@ void Graph::run_flow_bfs_from_s()
                 // following inflow by inverting flow requires special handling
                 if (n.node == inflow)
                 {
-                    if (update_distance(node_data[n.node].outcopy_distance, fn_dist + 1))
+                    if (update_distance(flow_data[n.node].outcopy_distance, fn_dist + 1))
                     {
                         // neighbor must be a flow node
-                        update_distance(node_data[n.node].distance, fn_dist + 1);
+                        update_distance(node_distance[n.node], fn_dist + 1);
                         q.push(FlowNode(n.node, true));
                     }
                 }
                 else
                 {
-                    if (update_distance(node_data[n.node].distance, fn_dist + 1))
+                    if (update_distance(node_distance[n.node], fn_dist + 1))
                     {
                         // neighbor may be a flow node
-                        if (node_data[n.node].inflow == NO_NODE)
-                            update_distance(node_data[n.node].outcopy_distance, fn_dist + 1);
+                        if (flow_data[n.node].inflow == NO_NODE)
+                            update_distance(flow_data[n.node].outcopy_distance, fn_dist + 1);
                         q.push(FlowNode(n.node, false));
                     }
                 }
@@ -1498,16 +2261,16 @@ void Graph::run_flow_bfs_from_t()
     assert(contains(s) && contains(t));
     // init distances
     for (NodeID node : nodes)
-        node_data[node].distance = node_data[node].outcopy_distance = infinity;
-    node_data[t].distance = node_data[t].outcopy_distance = 0;
+        node_distance[node] = flow_data[node].outcopy_distance = infinity;
+    node_distance[t] = flow_data[t].outcopy_distance = 0;
     // init queue - start with neighbors of t as t requires special flow handling
     queue<FlowNode> q;
-    for (Neighbor n : node_data[t].neighbors)
-        if (contains(n.node) && node_data[n.node].outflow != t)
+    for (Neighbor n : neighbors(t))
+        if (contains(n.node) && flow_data[n.node].outflow != t)
         {
-            assert(node_data[n.node].outflow == NO_NODE);
-            node_data[n.node].outcopy_distance = 1;
-            node_data[n.node].distance = 1; // treat inner-node edges as length 0
+            assert(flow_data[n.node].outflow == NO_NODE);
+            flow_data[n.node].outcopy_distance = 1;
+            node_distance[n.node] = 1; // treat inner-node edges as length 0
             q.push(FlowNode(n.node, true));
         }
     // BFS
@@ -1516,17 +2279,17 @@ void Graph::run_flow_bfs_from_t()
         FlowNode fn = q.front();
         q.pop();
 
-        distance_t fn_dist = fn.outcopy ? node_data[fn.node].outcopy_distance : node_data[fn.node].distance;
-        NodeID outflow = node_data[fn.node].outflow;
+        distance_t fn_dist = fn.outcopy ? flow_data[fn.node].outcopy_distance : node_distance[fn.node];
+        NodeID outflow = flow_data[fn.node].outflow;
         // special treatment is needed for node with flow through it
         if (outflow != NO_NODE && fn.outcopy)
         {
             // outflow is only valid neighbor
-            if (update_distance(node_data[outflow].distance, fn_dist + 1))
+            if (update_distance(node_distance[outflow], fn_dist + 1))
             {
                 // need to set distance for 0-distance nodes immediately
                 // otherwise a longer path may set wrong distance value first
-                update_distance(node_data[outflow].outcopy_distance, fn_dist + 1);
+                update_distance(flow_data[outflow].outcopy_distance, fn_dist + 1);
                 q.push(FlowNode(outflow, false));
             }
         }
@@ -1534,7 +2297,7 @@ void Graph::run_flow_bfs_from_t()
         {
             // when arriving at the incoming copy of flow node, all neighbors except inflow are valid
             // inflow must have been already visited in this case, so checking all neighbors is fine
-            for (Neighbor n : node_data[fn.node].neighbors)
+            for (Neighbor n : neighbors(fn.node))
             {
                 // filter neighbors nodes not belonging to subgraph
                 if (!contains(n.node))
@@ -1542,20 +2305,20 @@ void Graph::run_flow_bfs_from_t()
                 // following outflow by inverting flow requires special handling
                 if (n.node == outflow)
                 {
-                    if (update_distance(node_data[n.node].distance, fn_dist + 1))
+                    if (update_distance(node_distance[n.node], fn_dist + 1))
                     {
                         // neighbor must be a flow node
-                        update_distance(node_data[n.node].outcopy_distance, fn_dist + 1);
+                        update_distance(flow_data[n.node].outcopy_distance, fn_dist + 1);
                         q.push(FlowNode(n.node, false));
                     }
                 }
                 else
                 {
-                    if (update_distance(node_data[n.node].outcopy_distance, fn_dist + 1))
+                    if (update_distance(flow_data[n.node].outcopy_distance, fn_dist + 1))
                     {
                         // neighbor may be a flow node
-                        if (node_data[n.node].outflow == NO_NODE)
-                            update_distance(node_data[n.node].distance, fn_dist + 1);
+                        if (flow_data[n.node].outflow == NO_NODE)
+                            update_distance(node_distance[n.node], fn_dist + 1);
                         q.push(FlowNode(n.node, true));
                     }
                 }
@@ -1567,8 +2330,121 @@ void Graph::run_flow_bfs_from_t()
 distance_t Graph::get_distance(NodeID v, NodeID w, bool weighted)
 {
     assert(contains(v) && contains(w));
+    reserve_scratch();
     weighted ? run_dijkstra(v) : run_bfs(v);
-    return node_data[w].distance;
+    return node_distance[w];
+}
+
+// per-thread state for shortest path searches, indexed by node; entries only count if stamped by the current search
+struct PathSearchWorkspace
+{
+    // state of a node on one side of the search, kept together since relaxing an edge reads all of it
+    struct Entry
+    {
+        uint32_t stamp;
+        distance_t distance;
+        NodeID parent;
+    };
+    vector<Entry> entries[2];
+    uint32_t current_stamp = 0;
+
+    void start(size_t node_count)
+    {
+        for (int side = 0; side < 2; side++)
+            if (entries[side].size() < node_count)
+                entries[side].resize(node_count, Entry{0, infinity, NO_NODE});
+        // after wrap-around, stale stamps could match again
+        if (++current_stamp == 0)
+        {
+            for (int side = 0; side < 2; side++)
+                for (Entry &e : entries[side])
+                    e.stamp = 0;
+            current_stamp = 1;
+        }
+    }
+    bool reached(int side, NodeID node) const
+    {
+        return entries[side][node].stamp == current_stamp;
+    }
+    distance_t distance(int side, NodeID node) const
+    {
+        return entries[side][node].distance;
+    }
+    NodeID parent(int side, NodeID node) const
+    {
+        return entries[side][node].parent;
+    }
+    void reach(int side, NodeID node, distance_t dist, NodeID parent_node)
+    {
+        entries[side][node] = Entry{current_stamp, dist, parent_node};
+    }
+};
+
+static thread_local PathSearchWorkspace path_workspace;
+
+pair<distance_t, vector<NodeID>> Graph::get_shortest_path(NodeID v, NodeID w, const function<bool(NodeID,NodeID)> &edge_filter) const
+{
+    assert(contains(v) && contains(w));
+    if (v == w)
+        return make_pair(0, vector<NodeID>(1, v));
+    PathSearchWorkspace &ws = path_workspace;
+    ws.start(node_data.size());
+    // side 0 searches forward from v, side 1 backward from w
+    typedef pair<distance_t,NodeID> QueueEntry;
+    priority_queue<QueueEntry, vector<QueueEntry>, greater<QueueEntry>> q[2];
+    const NodeID root[2] = { v, w };
+    for (int side = 0; side < 2; side++)
+    {
+        ws.reach(side, root[side], 0, NO_NODE);
+        q[side].push(QueueEntry(0, root[side]));
+    }
+    // shortest connection found so far, via edge from meet_forward to meet_backward
+    distance_t best = infinity;
+    NodeID meet_forward = NO_NODE, meet_backward = NO_NODE;
+    while (!q[0].empty() && !q[1].empty())
+    {
+        // frontiers have met once no shorter connection is possible
+        if (q[0].top().first + q[1].top().first >= best)
+            break;
+        const int side = q[0].top().first <= q[1].top().first ? 0 : 1;
+        const QueueEntry next = q[side].top();
+        q[side].pop();
+        // skip outdated queue entries
+        if (next.first > ws.distance(side, next.second))
+            continue;
+        for (const Neighbor &n : neighbors(next.second))
+        {
+            // filter closed edges and neighbors not belonging to subgraph
+            if (n.distance >= infinity || !contains(n.node))
+                continue;
+            if (edge_filter && !(side == 0 ? edge_filter(next.second, n.node) : edge_filter(n.node, next.second)))
+                continue;
+            const distance_t new_dist = next.first + n.distance;
+            if (new_dist >= best)
+                continue;
+            if (!ws.reached(side, n.node) || new_dist < ws.distance(side, n.node))
+            {
+                ws.reach(side, n.node, new_dist, next.second);
+                q[side].push(QueueEntry(new_dist, n.node));
+            }
+            if (ws.reached(1 - side, n.node) && new_dist + ws.distance(1 - side, n.node) < best)
+            {
+                best = new_dist + ws.distance(1 - side, n.node);
+                meet_forward = side == 0 ? next.second : n.node;
+                meet_backward = side == 0 ? n.node : next.second;
+            }
+        }
+    }
+    if (best >= infinity)
+        return make_pair(infinity, vector<NodeID>());
+    // join forward and backward search trees at meeting edge
+    vector<NodeID> path;
+    for (NodeID node = meet_forward; node != NO_NODE; node = ws.parent(0, node))
+        path.push_back(node);
+    reverse(path.begin(), path.end());
+    for (NodeID node = meet_backward; node != NO_NODE; node = ws.parent(1, node))
+        path.push_back(node);
+    return make_pair(best, path);
 }
 
 pair<NodeID,distance_t> Graph::get_furthest(NodeID v, bool weighted)
@@ -1577,9 +2453,9 @@ pair<NodeID,distance_t> Graph::get_furthest(NodeID v, bool weighted)
 
     weighted ? run_dijkstra(v) : run_bfs(v);
     for (NodeID node : nodes)
-        if (node_data[node].distance > node_data[furthest].distance)
+        if (node_distance[node] > node_distance[furthest])
             furthest = node;
-    return make_pair(furthest, node_data[furthest].distance);
+    return make_pair(furthest, node_distance[furthest]);
 }
 
 Edge Graph::get_furthest_pair(bool weighted)
@@ -1601,6 +2477,7 @@ distance_t Graph::diameter(bool weighted)
 {
     if (nodes.size() < 2)
         return 0;
+    reserve_scratch();
     return get_furthest_pair(weighted).d;
 }
 
@@ -1608,17 +2485,17 @@ void Graph::get_diff_data(std::vector<DiffData> &diff, NodeID a, NodeID b, bool
 {
     CHECK_CONSISTENT;
     assert(diff.empty());
-    assert(!pre_computed || node_data[a].distance == 0);
+    assert(!pre_computed || node_distance[a] == 0);
     diff.reserve(nodes.size());
     // init with distances to a
     if (!pre_computed)
         weighted ? run_dijkstra(a) : run_bfs(a);
     for (NodeID node : nodes)
-        diff.push_back(DiffData(node, node_data[node].distance, 0));
+        diff.push_back(DiffData(node, node_distance[node], 0));
     // add distances to b
     weighted ? run_dijkstra(b) : run_bfs(b);
     for (DiffData &dd : diff)
-        dd.dist_b = node_data[dd.node].distance;
+        dd.dist_b = node_distance[dd.node];
 }
 
 // helper function for sorting connected components by size
@@ -1639,6 +2516,7 @@ bool Graph::get_rough_partition(Partition &p, double balance, bool disconnected)
     DEBUG("get_rough_partition, p=" << p << ", disconnected=" << disconnected << " on " << *this);
     CHECK_CONSISTENT;
     assert(p.left.empty() && p.cut.empty() && p.right.empty());
+    reserve_scratch();
     if (disconnected)
     {
         vector<vector<NodeID>> cc;
@@ -1737,6 +2615,80 @@ bool Graph::get_rough_partition(Partition &p, double balance, bool disconnected)
     return false;
 }
 
+// sum of road classes over given nodes
+static size_t road_class_sum(const vector<NodeID> &nodes)
+{
+    size_t sum = 0;
+    if (!node_road_class.empty())
+        for (NodeID node : nodes)
+            sum += node_road_class[node];
+    return sum;
+}
+
+bool Graph::get_inertial_partition(Partition &p, double balance)
+{
+    DEBUG("get_inertial_partition on " << *this);
+    CHECK_CONSISTENT;
+    assert(p.left.empty() && p.cut.empty() && p.right.empty());
+    for (NodeID node : nodes)
+        if (node >= partition_x.size() || isnan(partition_x[node]) || isnan(partition_y[node]))
+            return false;
+    // get partition bounds as for rough partition, but keep enough nodes in between for flow to choose from
+    size_t max_left = min(nodes.size() / 2, static_cast<size_t>(ceil(nodes.size() * min(balance, INERTIAL_FRACTION))));
+    size_t min_right = nodes.size() - max_left;
+    // for each direction, use extreme nodes on either side as sources and sinks
+    vector<vector<NodeID>> candidates;
+    vector<pair<double,NodeID>> projection(nodes.size());
+    for (pair<double,double> direction : INERTIAL_DIRECTIONS)
+    {
+        for (size_t i = 0; i < nodes.size(); i++)
+        {
+            NodeID node = nodes[i];
+            projection[i] = make_pair(direction.first * partition_x[node] + direction.second * partition_y[node], node);
+        }
+        nth_element(projection.begin(), projection.begin() + max_left, projection.end());
+        nth_element(projection.begin() + max_left, projection.begin() + min_right, projection.end());
+        Partition rough;
+        for (size_t i = 0; i < projection.size(); i++)
+        {
+            if (i < max_left)
+                rough.left.push_back(projection[i].second);
+            else if (i < min_right)
+                rough.cut.push_back(projection[i].second);
+            else
+                rough.right.push_back(projection[i].second);
+        }
+        vector<vector<NodeID>> cuts;
+        rough_partition_to_cuts(cuts, rough);
+        for (vector<NodeID> &cut : cuts)
+            candidates.push_back(std::move(cut));
+    }
+    DEBUG("inertial cuts=" << candidates);
+    // tiny graphs may yield no cuts at all, leave those to the rough partition
+    if (candidates.empty())
+        return false;
+    // completing a partition requires a full traversal, so only do so for the smallest cuts,
+    // preferring those through arterial roads
+    size_t min_cut_size = candidates[0].size(), max_cut_class = 0;
+    for (const vector<NodeID> &cut : candidates)
+        min_cut_size = min(min_cut_size, cut.size());
+    for (const vector<NodeID> &cut : candidates)
+        if (cut.size() == min_cut_size)
+            max_cut_class = max(max_cut_class, road_class_sum(cut));
+    bool found = false;
+    for (vector<NodeID> &cut : candidates)
+        if (cut.size() == min_cut_size && road_class_sum(cut) == max_cut_class)
+        {
+            Partition p_alt;
+            p_alt.cut = std::move(cut);
+            complete_partition(p_alt);
+            if (!found || p.rating() < p_alt.rating())
+                p = p_alt;
+            found = true;
+        }
+    return found;
+}
+
 void Graph::min_vertex_cuts(vector<vector<NodeID>> &cuts)
 {
     DEBUG("min_vertex_cut over " << *this);
@@ -1744,7 +2696,7 @@ void Graph::min_vertex_cuts(vector<vector<NodeID>> &cuts)
     assert(contains(s) && contains(t));
     // set flow to empty
     for (NodeID node : nodes)
-        node_data[node].inflow = node_data[node].outflow = NO_NODE;
+        flow_data[node].inflow = flow_data[node].outflow = NO_NODE;
 #ifndef NDEBUG
     size_t last_s_distance = 1; // min s_distance is 2
 #endif
@@ -1754,7 +2706,7 @@ void Graph::min_vertex_cuts(vector<vector<NodeID>> &cuts)
         // construct BFS tree from t
         run_flow_bfs_from_t();
         DEBUG("BFS-tree: " << distances());
-        const distance_t s_distance = node_data[s].outcopy_distance;
+        const distance_t s_distance = flow_data[s].outcopy_distance;
         if (s_distance == infinity)
             break;
         assert(s_distance > last_s_distance && (last_s_distance = s_distance));
@@ -1762,14 +2714,14 @@ void Graph::min_vertex_cuts(vector<vector<NodeID>> &cuts)
         vector<NodeID> path;
         vector<FlowNode> stack;
         // iterating over neighbors of s directly simplifies stack cleanup after new s-t path is found
-        for (Neighbor sn : node_data[s].neighbors)
+        for (Neighbor sn : neighbors(s))
         {
-            if (!contains(sn.node) || node_data[sn.node].distance != s_distance - 1)
+            if (!contains(sn.node) || node_distance[sn.node] != s_distance - 1)
                 continue;
             // ensure edge from s to neighbor exists in residual graph
-            if (node_data[sn.node].inflow != NO_NODE)
+            if (flow_data[sn.node].inflow != NO_NODE)
             {
-                assert(node_data[sn.node].inflow == s);
+                assert(flow_data[sn.node].inflow == s);
                 continue;
             }
             stack.push_back(FlowNode(sn.node, false));
@@ -1779,7 +2731,7 @@ void Graph::min_vertex_cuts(vector<vector<NodeID>> &cuts)
                 stack.pop_back();
                 DEBUG("fn=" << fn);
                 // clean up path (back tracking)
-                distance_t fn_dist = fn.outcopy ? node_data[fn.node].outcopy_distance : node_data[fn.node].distance;
+                distance_t fn_dist = fn.outcopy ? flow_data[fn.node].outcopy_distance : node_distance[fn.node];
                 // safeguard against re-visiting node during DFS (may have been enqueued before first visit)
                 if (fn_dist == infinity)
                     continue;
@@ -1789,28 +2741,28 @@ void Graph::min_vertex_cuts(vector<vector<NodeID>> &cuts)
                 if (fn.node == t)
                 {
                     DEBUG("flow path=" << path);
-                    assert(node_data[path.front()].inflow == NO_NODE);
-                    node_data[path.front()].inflow = s;
+                    assert(flow_data[path.front()].inflow == NO_NODE);
+                    flow_data[path.front()].inflow = s;
                     for (size_t path_pos = 1; path_pos < path.size(); path_pos++)
                     {
                         NodeID from = path[path_pos - 1];
                         NodeID to = path[path_pos];
                         // we might be reverting existing flow
                         // from.inflow may have been changed already => check outflow
-                        if (node_data[to].outflow == from)
+                        if (flow_data[to].outflow == from)
                         {
-                            node_data[to].outflow = NO_NODE;
-                            if (node_data[from].inflow == to)
-                                node_data[from].inflow = NO_NODE;
+                            flow_data[to].outflow = NO_NODE;
+                            if (flow_data[from].inflow == to)
+                                flow_data[from].inflow = NO_NODE;
                         }
                         else
                         {
-                            node_data[from].outflow = to;
-                            node_data[to].inflow = from;
+                            flow_data[from].outflow = to;
+                            flow_data[to].inflow = from;
                         }
                     }
-                    assert(node_data[path.back()].outflow == NO_NODE);
-                    node_data[path.back()].outflow = t;
+                    assert(flow_data[path.back()].outflow == NO_NODE);
+                    flow_data[path.back()].outflow = t;
                     // skip to next neighbor of s
                     stack.clear();
                     path.clear();
@@ -1819,36 +2771,36 @@ void Graph::min_vertex_cuts(vector<vector<NodeID>> &cuts)
                 }
                 // ensure vertex is not re-visited during current DFS iteration
                 if (fn.outcopy)
-                    node_data[fn.node].outcopy_distance = infinity;
+                    flow_data[fn.node].outcopy_distance = infinity;
                 else
-                    node_data[fn.node].distance = infinity;
+                    node_distance[fn.node] = infinity;
                 // continue DFS from node
                 path.push_back(fn.node);
                 distance_t next_distance = fn_dist - 1;
                 // when arriving at outgoing copy of a node with flow through it,
                 // we are inverting outflow, so all neighbors are valid (except outflow)
                 // otherwise inverting the inflow is the only possible option
-                NodeID inflow = node_data[fn.node].inflow;
+                NodeID inflow = flow_data[fn.node].inflow;
                 if (inflow != NO_NODE && !fn.outcopy)
                 {
-                    if (node_data[inflow].outcopy_distance == next_distance)
+                    if (flow_data[inflow].outcopy_distance == next_distance)
                         stack.push_back(FlowNode(inflow, true));
                 }
                 else
                 {
-                    for (Neighbor n : node_data[fn.node].neighbors)
+                    for (Neighbor n : neighbors(fn.node))
                     {
                         if (!contains(n.node))
                             continue;
                         // inflow inversion requires special handling
                         if (n.node == inflow)
                         {
-                            if (node_data[inflow].outcopy_distance == next_distance)
+                            if (flow_data[inflow].outcopy_distance == next_distance)
                                 stack.push_back(FlowNode(inflow, true));
                         }
                         else
                         {
-                            if (node_data[n.node].distance == next_distance)
+                            if (node_distance[n.node] == next_distance)
                                 stack.push_back(FlowNode(n.node, false));
                         }
                     }
@@ -1864,15 +2816,15 @@ void Graph::min_vertex_cuts(vector<vector<NodeID>> &cuts)
     // in that case, starting point must become the cut vertex
     for (NodeID node : nodes)
     {
-        NodeID outflow = node_data[node].outflow;
+        NodeID outflow = flow_data[node].outflow;
         // distance already stores distance from t in inverse residual graph
         if (outflow != NO_NODE)
         {
-            assert(node_data[node].inflow != NO_NODE);
-            if (node_data[node].outcopy_distance < infinity)
+            assert(flow_data[node].inflow != NO_NODE);
+            if (flow_data[node].outcopy_distance < infinity)
             {
                 // check inner edge
-                if (node_data[node].distance == infinity)
+                if (node_distance[node] == infinity)
                     cuts[0].push_back(node);
             }
             else
@@ -1884,29 +2836,99 @@ void Graph::min_vertex_cuts(vector<vector<NodeID>> &cuts)
         }
     }
 #ifdef MULTI_CUT
-    // same thing but w.r.t. reachability from s in residual graph
-    run_flow_bfs_from_s();
+    // same thing but w.r.t. reachability from s in residual graph
+    run_flow_bfs_from_s();
+    cuts.resize(2);
+    // distance now stores distance from s in residual graph
+    for (NodeID node : nodes)
+    {
+        NodeID inflow = flow_data[node].inflow;
+        if (inflow != NO_NODE)
+        {
+            assert(flow_data[node].outflow != NO_NODE);
+            if (node_distance[node] < infinity)
+            {
+                // check inner edge
+                if (flow_data[node].outcopy_distance == infinity)
+                    cuts[1].push_back(node);
+            }
+            else
+            {
+                // check outer edge
+                if (inflow == s)
+                    cuts[1].push_back(node);
+            }
+        }
+    }
+    // eliminate potential duplicate
+    if (cuts[0] == cuts[1])
+        cuts.resize(1);
+#endif
+    DEBUG("cuts=" << cuts);
+}
+
+void Graph::min_vertex_cuts_push_relabel(vector<vector<NodeID>> &cuts)
+{
+    DEBUG("min_vertex_cuts_push_relabel over " << *this);
+    CHECK_CONSISTENT;
+    assert(contains(s) && contains(t));
+    static const uint32_t NO_ARC = UINT32_MAX;
+    // local copy of flow graph: node i is split into incoming copy 2i and outgoing copy 2i+1, followed by s and t;
+    // local ids are kept in node_distance, which Dinitz' algorithm uses for BFS
+    vector<NodeID> local_nodes;
+    for (NodeID node : nodes)
+        if (node != s && node != t)
+        {
+            node_distance[node] = local_nodes.size();
+            local_nodes.push_back(node);
+        }
+    const uint32_t local_s = 2 * local_nodes.size(), local_t = local_s + 1;
+    // with road classes, cutting a node costs a large base minus its class: any smaller cut is still cheaper,
+    // but among cuts of equal size those through arterial roads win
+    const int32_t base_capacity = node_road_class.empty() ? 1 : MAX_ROAD_CLASS * local_nodes.size() + 1;
+    assert(base_capacity < FlowNetwork::UNBOUNDED);
+    static thread_local FlowNetwork network;
+    network.reset(local_t + 1);
+    vector<uint32_t> inner_arc(local_nodes.size()), s_arc(local_nodes.size(), NO_ARC), t_arc(local_nodes.size(), NO_ARC);
+    for (uint32_t i = 0; i < local_nodes.size(); i++)
+    {
+        const int32_t capacity = base_capacity - (node_road_class.empty() ? 0 : node_road_class[local_nodes[i]]);
+        inner_arc[i] = network.add_arc(2 * i, 2 * i + 1, capacity);
+        for (Neighbor n : neighbors(local_nodes[i]))
+        {
+            if (n.node == s)
+                s_arc[i] = network.add_arc(local_s, 2 * i, capacity);
+            else if (n.node == t)
+                t_arc[i] = network.add_arc(2 * i + 1, local_t, capacity);
+            else if (contains(n.node))
+                network.add_arc(2 * i + 1, 2 * node_distance[n.node], FlowNetwork::UNBOUNDED);
+        }
+    }
+    network.finalize();
+    network.max_flow(local_s, local_t);
+    // the min cuts closest to t and to s are the same for every max flow, so without road classes these match the cuts found by Dinitz' algorithm
+    assert(cuts.empty());
+    cuts.resize(1);
+    vector<uint8_t> reached;
+    network.residual_reachable(local_t, true, reached);
+    for (uint32_t i = 0; i < local_nodes.size(); i++)
+    {
+        if (network.flow(inner_arc[i]) == 0)
+            continue;
+        // cut inner edge, or edge to t if outgoing copy cannot reach t
+        if (reached[2 * i + 1] ? !reached[2 * i] : t_arc[i] != NO_ARC && network.flow(t_arc[i]) > 0)
+            cuts[0].push_back(local_nodes[i]);
+    }
+#ifdef MULTI_CUT
     cuts.resize(2);
-    // distance now stores distance from s in residual graph
-    for (NodeID node : nodes)
+    network.residual_reachable(local_s, false, reached);
+    for (uint32_t i = 0; i < local_nodes.size(); i++)
     {
-        NodeID inflow = node_data[node].inflow;
-        if (inflow != NO_NODE)
-        {
-            assert(node_data[node].outflow != NO_NODE);
-            if (node_data[node].distance < infinity)
-            {
-                // check inner edge
-                if (node_data[node].outcopy_distance == infinity)
-                    cuts[1].push_back(node);
-            }
-            else
-            {
-                // check outer edge
-                if (inflow == s)
-                    cuts[1].push_back(node);
-            }
-        }
+        if (network.flow(inner_arc[i]) == 0)
+            continue;
+        // cut inner edge, or edge from s if incoming copy is unreachable from s
+        if (reached[2 * i] ? !reached[2 * i + 1] : s_arc[i] != NO_ARC && network.flow(s_arc[i]) > 0)
+            cuts[1].push_back(local_nodes[i]);
     }
     // eliminate potential duplicate
     if (cuts[0] == cuts[1])
@@ -1935,7 +2957,7 @@ void Graph::get_connected_components(vector<vector<NodeID>> &components)
             NodeID node = stack.back();
             stack.pop_back();
             cc.push_back(node);
-            for (Neighbor n : node_data[node].neighbors)
+            for (Neighbor n : neighbors(node))
                 if (contains(n.node))
                 {
                     node_data[n.node].subgraph_id = NO_SUBGRAPH;
@@ -1962,7 +2984,7 @@ void Graph::rough_partition_to_cuts(vector<vector<NodeID>> &cuts, const Partitio
     // do this first as it can eliminate other s/t neighbors
     vector<NodeID> s_neighbors, t_neighbors;
     for (NodeID node : left.nodes)
-        for (Neighbor n : node_data[node].neighbors)
+        for (Neighbor n : neighbors(node))
             if (right.contains(n.node))
             {
                 s_neighbors.push_back(node);
@@ -1981,11 +3003,11 @@ void Graph::rough_partition_to_cuts(vector<vector<NodeID>> &cuts, const Partitio
     DEBUG("pre-partition=" << left.nodes << "|" << center.nodes << "|" << right.nodes);
     // identify additional neighbors of s and t
     for (NodeID node : left.nodes)
-        for (Neighbor n : node_data[node].neighbors)
+        for (Neighbor n : neighbors(node))
             if (center.contains(n.node))
                 s_neighbors.push_back(n.node);
     for (NodeID node : right.nodes)
-        for (Neighbor n : node_data[node].neighbors)
+        for (Neighbor n : neighbors(node))
             if (center.contains(n.node))
                 t_neighbors.push_back(n.node);
     util::make_set(s_neighbors);
@@ -1995,8 +3017,11 @@ void Graph::rough_partition_to_cuts(vector<vector<NodeID>> &cuts, const Partitio
         center.add_edge(s, node, 1, true);
     for (NodeID node : t_neighbors)
         center.add_edge(t, node, 1, true);
-    // find minimum cut
-    center.min_vertex_cuts(cuts);
+    // find minimum cut; our implementation of Dinitz' algorithm is limited to unit capacities, so road classes require push-relabel
+    if (flow_engine == FlowEngine::push_relabel || !node_road_class.empty())
+        center.min_vertex_cuts_push_relabel(cuts);
+    else
+        center.min_vertex_cuts(cuts);
     // revert s-t addition
     for (NodeID node : t_neighbors)
     {
@@ -2037,6 +3062,13 @@ void Graph::create_partition(Partition &p, double balance)
     CHECK_CONSISTENT;
     assert(nodes.size() > 1);
     DEBUG("create_partition, p=" << p << " on " << *this);
+    reserve_scratch();
+    // use node coordinates if available
+    if (!partition_x.empty() && get_inertial_partition(p, balance))
+    {
+        DEBUG("get_inertial_partition found partition=" << p);
+        return;
+    }
     // find initial rough partition
 #ifdef NO_SHORTCUTS
     bool is_fine = get_rough_partition(p, balance, true);
@@ -2073,7 +3105,7 @@ void Graph::add_shortcuts(const vector<NodeID> &cut, const vector<CutIndex> &ci)
     // compute border nodes
     vector<NodeID> border;
     for (NodeID cut_node : cut)
-        for (Neighbor n : node_data[cut_node].neighbors)
+        for (Neighbor n : neighbors(cut_node))
             if (contains(n.node))
                 border.push_back(n.node);
     util::make_set(border);
@@ -2097,7 +3129,7 @@ void Graph::add_shortcuts(const vector<NodeID> &cut, const vector<CutIndex> &ci)
                 for (size_t j = 0; j < distance_id + offset; j++)
                 {
                     NodeID n_j = border[j];
-                    distance_t d_ij = node_data[n_j].distances[distance_id];
+                    distance_t d_ij = par_distances[n_j][distance_id];
                     d_partition.push_back(d_ij);
                     distance_t d_cut = get_cut_level_distance(ci[n_i], ci[n_j], cut_level);
                     d_graph.push_back(min(d_ij, d_cut));
@@ -2115,7 +3147,7 @@ void Graph::add_shortcuts(const vector<NodeID> &cut, const vector<CutIndex> &ci)
         {
             assert(d_partition.size() == hmi(i, j));
             NodeID n_j = border[j];
-            distance_t d_ij = node_data[n_j].distance;
+            distance_t d_ij = node_distance[n_j];
             d_partition.push_back(d_ij);
             distance_t d_cut = get_cut_level_distance(ci[n_i], ci[n_j], cut_level);
             d_graph.push_back(min(d_ij, d_cut));
@@ -2164,7 +3196,7 @@ void Graph::sort_cut_for_pruning(vector<NodeID> &cut, [[maybe_unused]] vector<Cu
 #ifdef PRUNING
     // mimics code in extend_on_partition
     for (size_t c = 0; c < cut.size(); c++)
-        node_data[cut[c]].landmark_level = 1;
+        landmark_level[cut[c]] = 1;
     #ifdef MULTI_THREAD_DISTANCES
     if (nodes.size() > thread_threshold)
     {
@@ -2177,7 +3209,7 @@ void Graph::sort_cut_for_pruning(vector<NodeID> &cut, [[maybe_unused]] vector<Cu
             for (size_t distance_id = 0; distance_id < partial_cut.size(); distance_id++)
                 for (NodeID node : nodes)
                 {
-                    distance_t dist_and_flag = node_data[node].distances[distance_id];
+                    distance_t dist_and_flag = par_distances[node][distance_id];
                     if ((dist_and_flag & 1) == 0)
                     {
                         pruning_potential[offset + distance_id].first++;
@@ -2193,7 +3225,7 @@ void Graph::sort_cut_for_pruning(vector<NodeID> &cut, [[maybe_unused]] vector<Cu
         run_dijkstra_ll(cut[c]);
         for (NodeID node : nodes)
         {
-            distance_t dist_and_flag = node_data[node].distance;
+            distance_t dist_and_flag = node_distance[node];
             if ((dist_and_flag & 1) == 0)
             {
                 pruning_potential[c].first++;
@@ -2266,17 +3298,20 @@ void Graph::extend_cut_index(vector<CutIndex> &ci, double balance, uint8_t cut_l
     else
         p.cut = nodes;
 
+    // put arterial roads first, giving them the highest landmark levels
+    if (!node_road_class.empty())
+        stable_sort(p.cut.begin(), p.cut.end(), [](NodeID a, NodeID b) { return node_road_class[a] > node_road_class[b]; });
     for (size_t c = 0; c < p.cut.size(); c++)
-        node_data[p.cut[c]].landmark_level = p.cut.size() - c;
+        landmark_level[p.cut[c]] = p.cut.size() - c;
 
     // update dist_index
     for (NodeID node : nodes)
     {
         assert(ci[node].dist_index.size() == cut_level);
-        if(node_data[node].landmark_level == 0)
+        if(landmark_level[node] == 0)
             ci[node].dist_index.push_back(ci[node].dist_index[cut_level - 1] + p.cut.size());
 	else
-	    ci[node].dist_index.push_back(ci[node].dist_index[cut_level - 1] + (p.cut.size() - node_data[node].landmark_level + 1));
+	    ci[node].dist_index.push_back(ci[node].dist_index[cut_level - 1] + (p.cut.size() - landmark_level[node] + 1));
     }
 
     // set cut_level
@@ -2292,16 +3327,18 @@ void Graph::extend_cut_index(vector<CutIndex> &ci, double balance, uint8_t cut_l
 
     // reset landmark flags
     for (NodeID c : p.cut)
-        node_data[c].landmark_level = 0;
+        landmark_level[c] = 0;
     STOP_TIMER(t_label);
 
     // add shortcuts and recurse
 #ifdef MULTI_THREAD
     if (nodes.size() > thread_threshold)
     {
-        std::thread t_left(extend_on_partition, std::ref(ci), balance, cut_level, std::cref(p.left), std::cref(p.cut));
+        // idle workers may steal the left side while this thread recurses on the right
+        util::TaskPool::TaskGroup group(task_pool());
+        group.spawn([&ci, balance, cut_level, &p] { extend_on_partition(ci, balance, cut_level, p.left, p.cut); });
         extend_on_partition(ci, balance, cut_level, p.right, p.cut);
-        t_left.join();
+        group.wait();
     }
     else
 #endif
@@ -2311,8 +3348,18 @@ void Graph::extend_cut_index(vector<CutIndex> &ci, double balance, uint8_t cut_l
     }
 }
 
-size_t Graph::create_cut_index(std::vector<CutIndex> &ci, double balance)
+size_t Graph::create_cut_index(std::vector<CutIndex> &ci, double balance, size_t thread_count, const NodeAttributes *attributes)
 {
+#ifdef MULTI_THREAD
+    if (thread_count == 0)
+        thread_count = max(thread::hardware_concurrency(), 1u);
+    if (!shared_tasks || shared_tasks->size() != thread_count)
+        shared_tasks = make_unique<util::TaskPool>(thread_count);
+#else
+    (void)thread_count;
+#endif
+    assert(!is_frozen());
+    reserve_scratch();
 #ifndef NPROFILE
     t_partition = t_label = t_shortcut = 0;
 #endif
@@ -2335,8 +3382,39 @@ size_t Graph::create_cut_index(std::vector<CutIndex> &ci, double balance)
     {
         ci[node].dist_index.reserve(32);
     }
+    // project coordinates onto plane, scaling longitudes by mean latitude
+    if (attributes && !attributes->latitudes.empty())
+    {
+        double latitude_sum = 0;
+        size_t latitude_count = 0;
+        for (double latitude : attributes->latitudes)
+            if (!isnan(latitude))
+            {
+                latitude_sum += latitude;
+                latitude_count++;
+            }
+        const double longitude_scale = cos(latitude_sum / max<size_t>(latitude_count, 1) * M_PI / 180);
+        partition_x.assign(node_data.size(), NAN);
+        partition_y.assign(node_data.size(), NAN);
+        for (NodeID node : nodes)
+            if (node < attributes->latitudes.size() && node < attributes->longitudes.size())
+            {
+                partition_x[node] = attributes->longitudes[node] * longitude_scale;
+                partition_y[node] = attributes->latitudes[node];
+            }
+    }
+    if (attributes && !attributes->road_classes.empty())
+    {
+        node_road_class.assign(node_data.size(), 0);
+        for (NodeID node : nodes)
+            if (node < attributes->road_classes.size())
+                node_road_class[node] = min(attributes->road_classes[node], MAX_ROAD_CLASS);
+    }
     extend_cut_index(ci, balance, 0);
     log_progress(0);
+    partition_x.clear();
+    partition_y.clear();
+    node_road_class.clear();
     // reset nodes (top-level cut vertices got removed)
     nodes = original_nodes;
     // remove shortcuts
@@ -2364,19 +3442,20 @@ void Graph::get_redundant_edges(std::vector<Edge> &edges)
 {
     CHECK_CONSISTENT;
     assert(edges.empty());
+    reserve_scratch();
     // reset distances for all nodes
     for (NodeID node : nodes)
-        node_data[node].distance = infinity;
+        node_distance[node] = infinity;
     // run localized Dijkstra from each node
     vector<NodeID> visited;
     priority_queue<SearchNode> q;
     for (NodeID v : nodes)
     {
-        node_data[v].distance = 0;
+        node_distance[v] = 0;
         visited.push_back(v);
         distance_t max_dist = 0;
         // init queue - starting from neighbors ensures that only paths of length 2+ are considered
-        for (Neighbor n : node_data[v].neighbors)
+        for (Neighbor n : neighbors(v))
             if (contains(n.node))
             {
                 q.push(SearchNode(n.distance, n.node));
@@ -2389,35 +3468,36 @@ void Graph::get_redundant_edges(std::vector<Edge> &edges)
             SearchNode next = q.top();
             q.pop();
 
-            for (Neighbor n : node_data[next.node].neighbors)
+            for (Neighbor n : neighbors(next.node))
             {
                 // filter neighbors nodes not belonging to subgraph
                 if (!contains(n.node))
                     continue;
                 // update distance and enque
                 distance_t new_dist = next.distance + n.distance;
-                if (new_dist <= max_dist && new_dist < node_data[n.node].distance)
+                if (new_dist <= max_dist && new_dist < node_distance[n.node])
                 {
-                    node_data[n.node].distance = new_dist;
+                    node_distance[n.node] = new_dist;
                     q.push(SearchNode(new_dist, n.node));
                     visited.push_back(n.node);
                 }
             }
         }
         // identify redundant edges
-        for (Neighbor n : node_data[v].neighbors)
+        for (Neighbor n : neighbors(v))
             // only add redundant edges once
-            if (v < n.node && contains(n.node) && node_data[n.node].distance <= n.distance)
+            if (v < n.node && contains(n.node) && node_distance[n.node] <= n.distance)
                 edges.push_back(Edge(v, n.node, n.distance));
         // cleanup
         for (NodeID w : visited)
-            node_data[w].distance = infinity;
+            node_distance[w] = infinity;
         visited.clear();
     }
 }
 
 void Graph::contract(vector<Neighbor> &closest)
 {
+    assert(!is_frozen());
     closest.resize(node_data.size() - 2, Neighbor(NO_NODE, 0));
     for (NodeID node : nodes)
         closest[node] = Neighbor(node, 0);
@@ -2454,80 +3534,178 @@ void Graph::contract(vector<Neighbor> &closest)
 
 //--------------------------- ContractionHierarchy ------------------
 
+static const char CH_FORMAT[8] = { 'D', 'H', 'L', 'C', 'S', 'R', '0', '1' };
+
+template<typename T>
+static void write_block(ostream &os, const vector<T> &v)
+{
+    uint64_t count = v.size();
+    os.write((const char*)&count, sizeof(uint64_t));
+    os.write((const char*)v.data(), count * sizeof(T));
+}
+
+template<typename T>
+static void read_block(istream &is, vector<T> &v, T fill = T())
+{
+    uint64_t count = 0;
+    if (!is.read((char*)&count, sizeof(uint64_t)))
+        return;
+    v.assign(count, fill);
+    is.read((char*)v.data(), count * sizeof(T));
+}
+
 ContractionHierarchy::ContractionHierarchy() {
 
 }
 
-ContractionHierarchy::ContractionHierarchy(istream &is) {
+ContractionHierarchy::ContractionHierarchy(const vector<uint16_t> &dist_indices, const vector<vector<Neighbor>> &up_neighbors) : dist_indices(dist_indices) {
 
-    size_t count, node_count;
-    is.read((char*)&node_count, sizeof(size_t));
-    nodes.resize(node_count);
-    for(NodeID i = 1; i < node_count; i++) {
-        is.read((char*)&nodes[i].dist_index, sizeof(uint16_t));
-        if(nodes[i].dist_index == 65535)
-            continue;
-        is.read((char*)&count, sizeof(size_t));
-        nodes[i].up_neighbors.reserve(count);
-        for(size_t j = 0; j < count; j++) {
-            Neighbor n(NO_NODE, 0);
-            is.read((char*)&n.node, sizeof(NodeID));
-            is.read((char*)&n.distance, sizeof(distance_t));
-            nodes[i].up_neighbors.push_back(n);
+    size_t node_count = dist_indices.size();
+    auto di_order = [&dist_indices](Neighbor a, Neighbor b) { return dist_indices[a.node] < dist_indices[b.node]; };
+    up_offsets.assign(node_count + 1, 0);
+    down_offsets.assign(node_count + 1, 0);
+    for (NodeID v = 0; v < node_count; v++) {
+        up_offsets[v + 1] = up_offsets[v] + up_neighbors[v].size();
+        for (Neighbor n : up_neighbors[v])
+            down_offsets[n.node + 1]++;
+    }
+    up_edges.reserve(up_offsets.back());
+    for (NodeID v = 0; v < node_count; v++) {
+        size_t begin = up_edges.size();
+        up_edges.insert(up_edges.end(), up_neighbors[v].begin(), up_neighbors[v].end());
+        sort(up_edges.begin() + begin, up_edges.end(), di_order);
+    }
+
+    // fill downward edges with tails in dist_index order
+    for (NodeID v = 0; v < node_count; v++)
+        down_offsets[v + 1] += down_offsets[v];
+    vector<NodeID> tails;
+    for (NodeID v = 0; v < node_count; v++)
+        if (up_offsets[v + 1] > up_offsets[v])
+            tails.push_back(v);
+    stable_sort(tails.begin(), tails.end(), [&dist_indices](NodeID a, NodeID b) { return dist_indices[a] < dist_indices[b]; });
+    vector<uint32_t> next_down(down_offsets.begin(), down_offsets.end() - 1);
+    down_nodes.resize(up_edges.size());
+    down_up_edges.resize(up_edges.size());
+    for (NodeID v : tails)
+        for (uint32_t e = up_offsets[v]; e < up_offsets[v + 1]; e++) {
+            uint32_t slot = next_down[up_edges[e].node]++;
+            down_nodes[slot] = v;
+            down_up_edges[slot] = e;
+        }
+
+    // bitmaps cover dist_index range of ancestors
+    bitmap_offsets.assign(node_count + 1, 0);
+    for (NodeID v = 0; v < node_count; v++)
+        bitmap_offsets[v + 1] = bitmap_offsets[v] + (dist_indices[v] == NOT_IN_HIERARCHY ? 0 : (dist_indices[v] + 63) / 64);
+    edge_bits.assign(bitmap_offsets.back(), 0);
+    edge_ranks.assign(bitmap_offsets.back(), 0);
+    for (NodeID v = 0; v < node_count; v++) {
+        for (uint32_t e = up_offsets[v]; e < up_offsets[v + 1]; e++) {
+            uint16_t di = dist_indices[up_edges[e].node];
+            edge_bits[bitmap_offsets[v] + di / 64] |= 1ull << (di % 64);
         }
-        is.read((char*)&count, sizeof(size_t));
-        nodes[i].down_neighbors.reserve(count);
-        for(size_t j = 0; j < count; j++) {
-            NodeID n;
-            is.read((char*)&n, sizeof(NodeID));
-            nodes[i].down_neighbors.push_back(n);
+        uint16_t rank = 0;
+        for (uint32_t word = bitmap_offsets[v]; word < bitmap_offsets[v + 1]; word++) {
+            edge_ranks[word] = rank;
+            rank += popcount(edge_bits[word]);
         }
     }
-
 }
 
-void ContractionHierarchy::write(ostream &os) {
+ContractionHierarchy::ContractionHierarchy(istream &is) {
 
-    size_t count = nodes.size();
-    os.write((char*)&count, sizeof(size_t));
-    for(NodeID i = 1; i < nodes.size() ; i++) {
-        os.write((char*)&nodes[i].dist_index, sizeof(uint16_t));
-        if(nodes[i].dist_index == 65535)
-            continue;
-        count = nodes[i].up_neighbors.size();
-        os.write((char*)&count, sizeof(size_t));
-        for(Neighbor n: nodes[i].up_neighbors) {
-            os.write((char*)&n.node, sizeof(NodeID));
-            os.write((char*)&n.distance, sizeof(distance_t));
-        }
-        count = nodes[i].down_neighbors.size();
-        os.write((char*)&count, sizeof(size_t));
-        for(NodeID n: nodes[i].down_neighbors) {
-            os.write((char*)&n, sizeof(NodeID));
-        }
+    char format[sizeof(CH_FORMAT)];
+    if (!is.read(format, sizeof(CH_FORMAT)) || memcmp(format, CH_FORMAT, sizeof(CH_FORMAT)) != 0) {
+        is.setstate(ios::failbit);
+        return;
     }
+    read_block(is, dist_indices);
+    read_block(is, up_offsets);
+    read_block(is, up_edges, Neighbor(NO_NODE, 0));
+    read_block(is, down_offsets);
+    read_block(is, down_nodes);
+    read_block(is, down_up_edges);
+    read_block(is, bitmap_offsets);
+    read_block(is, edge_bits);
+    read_block(is, edge_ranks);
+}
+
+void ContractionHierarchy::write(ostream &os) const {
+
+    os.write(CH_FORMAT, sizeof(CH_FORMAT));
+    write_block(os, dist_indices);
+    write_block(os, up_offsets);
+    write_block(os, up_edges);
+    write_block(os, down_offsets);
+    write_block(os, down_nodes);
+    write_block(os, down_up_edges);
+    write_block(os, bitmap_offsets);
+    write_block(os, edge_bits);
+    write_block(os, edge_ranks);
 }
 
 size_t ContractionHierarchy::size() const
 {
-    size_t total = 0;
-    for(NodeID i = 1; i < nodes.size() ; i++) {
-	if(nodes[i].dist_index == 65535)
-            continue;
-        total += sizeof(uint64_t);
-	total += nodes[i].up_neighbors.size() * sizeof(NodeID);
-	total += nodes[i].up_neighbors.size() * sizeof(distance_t);
-	total += nodes[i].down_neighbors.size() * sizeof(NodeID);
-    }
-    return total;
+    return dist_indices.size() * sizeof(uint16_t)
+        + (up_offsets.size() + down_offsets.size() + bitmap_offsets.size()) * sizeof(uint32_t)
+        + up_edges.size() * sizeof(Neighbor)
+        + down_nodes.size() * sizeof(NodeID) + down_up_edges.size() * sizeof(uint32_t)
+        + edge_bits.size() * sizeof(uint64_t) + edge_ranks.size() * sizeof(uint16_t);
 }
 
 size_t ContractionHierarchy::edge_count() const
 {
-    size_t total = 0;
-    for (CHNode const& node : nodes)
-        total += node.up_neighbors.size();
-    return total;
+    return up_edges.size();
+}
+
+uint16_t ContractionHierarchy::dist_index(NodeID v) const
+{
+    return dist_indices[v];
+}
+
+span<Neighbor> ContractionHierarchy::up_neighbors(NodeID v)
+{
+    return span<Neighbor>(up_edges.data() + up_offsets[v], up_offsets[v + 1] - up_offsets[v]);
+}
+
+span<const Neighbor> ContractionHierarchy::up_neighbors(NodeID v) const
+{
+    return span<const Neighbor>(up_edges.data() + up_offsets[v], up_offsets[v + 1] - up_offsets[v]);
+}
+
+span<const NodeID> ContractionHierarchy::down_neighbors(NodeID v) const
+{
+    return span<const NodeID>(down_nodes.data() + down_offsets[v], down_offsets[v + 1] - down_offsets[v]);
+}
+
+span<const uint32_t> ContractionHierarchy::down_edges(NodeID v) const
+{
+    return span<const uint32_t>(down_up_edges.data() + down_offsets[v], down_offsets[v + 1] - down_offsets[v]);
+}
+
+uint32_t ContractionHierarchy::find_edge(NodeID v, NodeID w) const
+{
+    uint16_t di = dist_indices[w];
+    uint32_t word = bitmap_offsets[v] + di / 64;
+    if (di == NOT_IN_HIERARCHY || word >= bitmap_offsets[v + 1])
+        return NO_EDGE;
+    uint64_t bit = 1ull << (di % 64);
+    if (!(edge_bits[word] & bit))
+        return NO_EDGE;
+    // dist_index is only unique among ancestors of v, so confirm the head
+    uint32_t e = up_offsets[v] + edge_ranks[word] + popcount(edge_bits[word] & (bit - 1));
+    return up_edges[e].node == w ? e : NO_EDGE;
+}
+
+Neighbor& ContractionHierarchy::edge(uint32_t e)
+{
+    return up_edges[e];
+}
+
+const Neighbor& ContractionHierarchy::edge(uint32_t e) const
+{
+    return up_edges[e];
 }
 
 void Graph::create_contraction_hierarchy(ContractionHierarchy &ch, vector<CutIndex> &ci) const
@@ -2535,32 +3713,33 @@ void Graph::create_contraction_hierarchy(ContractionHierarchy &ch, vector<CutInd
     vector<NodeID> bottom_up_nodes;
     bottom_up_nodes.reserve(nodes.size() + 1);
     // initialize distance index to determine edge direction
-    ch.nodes.resize(nodes.size() + 1);
+    vector<uint16_t> dist_index(nodes.size() + 1, ContractionHierarchy::NOT_IN_HIERARCHY);
+    vector<vector<Neighbor>> up_neighbors(nodes.size() + 1);
     for (NodeID node : nodes) {
-        ch.nodes[node].dist_index = ci[node].dist_index[ci[node].cut_level] - 1;
-	ci[node].distances.resize(ch.nodes[node].dist_index, infinity);
+        dist_index[node] = ci[node].dist_index[ci[node].cut_level] - 1;
+	ci[node].distances.resize(dist_index[node], infinity);
     }
 
     // initialize with upwards graph edges
     for (NodeID node : nodes)
     {
         bottom_up_nodes.push_back(node);
-        for (Neighbor &n : node_data[node].neighbors)
-	    if (ch.nodes[n.node].dist_index < ch.nodes[node].dist_index) {
-                ch.nodes[node].up_neighbors.push_back(Neighbor(n.node, n.distance));
-		ci[node].distances[ch.nodes[n.node].dist_index] = n.distance;
+        for (const Neighbor &n : neighbors(node))
+	    if (dist_index[n.node] < dist_index[node]) {
+                up_neighbors[node].push_back(Neighbor(n.node, n.distance));
+		ci[node].distances[dist_index[n.node]] = n.distance;
 	    }
     };
 
     // add shortcuts bottom-up
-    auto di_order = [&ch](NodeID a, NodeID b) -> bool
+    auto di_order = [&dist_index](NodeID a, NodeID b) -> bool
     {
-        return ch.nodes[a].dist_index > ch.nodes[b].dist_index;
+        return dist_index[a] > dist_index[b];
     };
-    auto di_order1 = [&ch](Neighbor a, Neighbor b) -> bool
+    auto di_order1 = [&dist_index](Neighbor a, Neighbor b) -> bool
     {
-        if(ch.nodes[a.node].dist_index > ch.nodes[b.node].dist_index) return true;
-	if(ch.nodes[a.node].dist_index == ch.nodes[b.node].dist_index && a.distance < b.distance) return true;
+        if(dist_index[a.node] > dist_index[b.node]) return true;
+	if(dist_index[a.node] == dist_index[b.node] && a.distance < b.distance) return true;
 	return false;
     };
 
@@ -2568,32 +3747,29 @@ void Graph::create_contraction_hierarchy(ContractionHierarchy &ch, vector<CutInd
 
     for (NodeID node : bottom_up_nodes)
     {
-        vector<Neighbor> &up = ch.nodes[node].up_neighbors;
+        vector<Neighbor> &up = up_neighbors[node];
         util::make_set(up, di_order1);
 
         for (size_t i = 0; i + 1 < up.size(); i++) {
             for (size_t j = i + 1; j < up.size(); j++) {
 		distance_t weight = up[i].distance + up[j].distance;
-		if(weight < ci[up[i].node].distances[ch.nodes[up[j].node].dist_index]) {
-                    ch.nodes[up[i].node].up_neighbors.push_back(Neighbor(up[j].node, weight));
-		    ci[up[i].node].distances[ch.nodes[up[j].node].dist_index] = weight;
+		if(weight < ci[up[i].node].distances[dist_index[up[j].node]]) {
+                    up_neighbors[up[i].node].push_back(Neighbor(up[j].node, weight));
+		    ci[up[i].node].distances[dist_index[up[j].node]] = weight;
 		}
 	    }
 	}
-
-        // create downward neighbors from upward ones
-        for (Neighbor upn: up)
-            ch.nodes[upn.node].down_neighbors.push_back(node);
     }
 
     // compute DHL distances
     for(auto it = bottom_up_nodes.rbegin(); it != bottom_up_nodes.rend(); it++) {
-    	for(Neighbor n: ch.nodes[*it].up_neighbors) {
-		for(size_t anc = 0; anc < ch.nodes[n.node].dist_index; anc++)
+    	for(Neighbor n: up_neighbors[*it]) {
+		for(size_t anc = 0; anc < dist_index[n.node]; anc++)
 			ci[*it].distances[anc] = min(ci[*it].distances[anc], n.distance + ci[n.node].distances[anc]);
 	}
 	ci[*it].distances.push_back(0);
     }
+    ch = ContractionHierarchy(dist_index, up_neighbors);
 }
 
 void Graph::create_contraction_hierarchy(ContractionHierarchy &ch, vector<CutIndex> &ci, vector<Neighbor> &closest) const
@@ -2601,68 +3777,65 @@ void Graph::create_contraction_hierarchy(ContractionHierarchy &ch, vector<CutInd
     vector<NodeID> bottom_up_nodes;
     bottom_up_nodes.reserve(nodes.size() + 1);
     // initialize distance index to determine edge direction
-    ch.nodes.resize(nodes.size() + 1);
+    vector<uint16_t> dist_index(nodes.size() + 1, ContractionHierarchy::NOT_IN_HIERARCHY);
+    vector<vector<Neighbor>> up_neighbors(nodes.size() + 1);
     for (NodeID node : nodes) {
         if(closest[node].node == node) {
 
             bottom_up_nodes.push_back(node);
-            ch.nodes[node].dist_index = ci[node].dist_index[ci[node].cut_level] - 1;
-            ci[node].distances.resize(ch.nodes[node].dist_index, infinity);
-        } else
-            ch.nodes[node].dist_index = 65535;
+            dist_index[node] = ci[node].dist_index[ci[node].cut_level] - 1;
+            ci[node].distances.resize(dist_index[node], infinity);
+        }
     }
 
     // initialize with upwards graph edges
     for (NodeID node : bottom_up_nodes)
     {
-        for (Neighbor &n : node_data[node].neighbors)
-            if (closest[n.node].node == n.node && ch.nodes[n.node].dist_index < ch.nodes[node].dist_index) {
-                ch.nodes[node].up_neighbors.push_back(Neighbor(n.node, n.distance));
-                ci[node].distances[ch.nodes[n.node].dist_index] = n.distance;
+        for (const Neighbor &n : neighbors(node))
+            if (closest[n.node].node == n.node && dist_index[n.node] < dist_index[node]) {
+                up_neighbors[node].push_back(Neighbor(n.node, n.distance));
+                ci[node].distances[dist_index[n.node]] = n.distance;
             }
     }
 
     // add shortcuts bottom-up
-    auto di_order = [&ch](NodeID a, NodeID b) -> bool
+    auto di_order = [&dist_index](NodeID a, NodeID b) -> bool
     {
-        return ch.nodes[a].dist_index > ch.nodes[b].dist_index;
+        return dist_index[a] > dist_index[b];
     };
-    auto di_order1 = [&ch](Neighbor a, Neighbor b) -> bool
+    auto di_order1 = [&dist_index](Neighbor a, Neighbor b) -> bool
     {
-        if(ch.nodes[a.node].dist_index > ch.nodes[b.node].dist_index) return true;
-        if(ch.nodes[a.node].dist_index == ch.nodes[b.node].dist_index && a.distance < b.distance) return true;
+        if(dist_index[a.node] > dist_index[b.node]) return true;
+        if(dist_index[a.node] == dist_index[b.node] && a.distance < b.distance) return true;
         return false;
     };
 
     std::sort(bottom_up_nodes.begin(), bottom_up_nodes.end(), di_order);
     for (NodeID node : bottom_up_nodes)
     {
-        vector<Neighbor> &up = ch.nodes[node].up_neighbors;
+        vector<Neighbor> &up = up_neighbors[node];
         util::make_set(up, di_order1);
 
         for (size_t i = 0; i + 1 < up.size(); i++) {
             for (size_t j = i + 1; j < up.size(); j++) {
                 distance_t weight = up[i].distance + up[j].distance;
-                if(weight < ci[up[i].node].distances[ch.nodes[up[j].node].dist_index]) {
-                    ch.nodes[up[i].node].up_neighbors.push_back(Neighbor(up[j].node, weight));
-                    ci[up[i].node].distances[ch.nodes[up[j].node].dist_index] = weight;
+                if(weight < ci[up[i].node].distances[dist_index[up[j].node]]) {
+                    up_neighbors[up[i].node].push_back(Neighbor(up[j].node, weight));
+                    ci[up[i].node].distances[dist_index[up[j].node]] = weight;
                 }
             }
         }
-
-        // create downward neighbors from upward ones
-        for (Neighbor upn: up)
-            ch.nodes[upn.node].down_neighbors.push_back(node);
     }
 
     // compute DHL distances
     for(auto it = bottom_up_nodes.rbegin(); it != bottom_up_nodes.rend(); it++) {
-        for(Neighbor n: ch.nodes[*it].up_neighbors) {
-                for(size_t anc = 0; anc < ch.nodes[n.node].dist_index; anc++)
+        for(Neighbor n: up_neighbors[*it]) {
+                for(size_t anc = 0; anc < dist_index[n.node]; anc++)
                         ci[*it].distances[anc] = min(ci[*it].distances[anc], n.distance + ci[n.node].distances[anc]);
         }
         ci[*it].distances.push_back(0);
     }
+    ch = ContractionHierarchy(dist_index, up_neighbors);
 }
 
 struct DCHSearchNode
@@ -2688,62 +3861,55 @@ void Graph::DecCH(ContractionHierarchy &ch, vector<pair<pair<distance_t, distanc
     for(pair<pair<distance_t, distance_t>, pair<NodeID, NodeID> > iter: updates) {
 
 	a = iter.second.first, b = iter.second.second;
-	if(ch.nodes[a].dist_index < ch.nodes[b].dist_index) swap(a, b);
+	if(ch.dist_index(a) < ch.dist_index(b)) swap(a, b);
 
-	Neighbor &x = UpNeighbor(ch, a, b);
+	uint32_t e = ch.find_edge(a, b);
+	if(e == ContractionHierarchy::NO_EDGE)
+	    continue;
+	Neighbor &x = ch.edge(e);
 	if(x.distance > iter.first.second) {
 	    x.distance = iter.first.second;
 	    C.push_back(make_pair(x.distance, make_pair(a, b)));
-	    q.push(DCHSearchNode(ch.nodes[a].dist_index, a, b, x.distance));
+	    q.push(DCHSearchNode(ch.dist_index(a), a, b, x.distance));
 	}
     }
 
     while(!q.empty()) {
         DCHSearchNode next = q.top(); q.pop();
 
-	for(Neighbor n: ch.nodes[next.v].up_neighbors) {
+	for(Neighbor n: ch.up_neighbors(next.v)) {
 	    if(n.node != next.w) {
                 distance_t new_dist = next.distance + n.distance;
 
+		// upward neighbors of a node are pairwise connected, so the edge always exists
 		a = next.w, b = n.node;
-		if(ch.nodes[a].dist_index < ch.nodes[b].dist_index) swap(a, b);
-		Neighbor &x = UpNeighbor(ch, a, b);
+		if(ch.dist_index(a) < ch.dist_index(b)) swap(a, b);
+		Neighbor &x = ch.edge(ch.find_edge(a, b));
                 if(x.distance > new_dist) {
                     x.distance = new_dist;
 		    C.push_back(make_pair(x.distance, make_pair(a, b)));
-                    q.push(DCHSearchNode(ch.nodes[a].dist_index, a, b, x.distance));
+                    q.push(DCHSearchNode(ch.dist_index(a), a, b, x.distance));
             	}
 	    }
 	}
     }
 }
 
-Neighbor& Graph::UpNeighbor(ContractionHierarchy &ch, NodeID v, NodeID w) {
-
-    for(Neighbor &n: ch.nodes[v].up_neighbors) {
-        if(n.node == w) {
-	    return n;
-        }
-    }
-    
-    // If neighbor doesn't exist, add it with infinity distance
-    // This handles the case where the edge is being processed for the first time
-    ch.nodes[v].up_neighbors.push_back(Neighbor(w, infinity));
-    return ch.nodes[v].up_neighbors.back();
-}
-
 void Graph::IncCH(ContractionHierarchy &ch, vector<pair<pair<distance_t, distance_t>, pair<NodeID, NodeID> > >& updates, vector<pair<distance_t, pair<NodeID, NodeID> > > &C) {
 
     priority_queue<DCHSearchNode> q; NodeID a, b; 
     for(pair<pair<distance_t, distance_t>, pair<NodeID, NodeID> > iter: updates) {
 
         a = iter.second.first, b = iter.second.second;
-        if(ch.nodes[a].dist_index < ch.nodes[b].dist_index) swap(a, b);
+        if(ch.dist_index(a) < ch.dist_index(b)) swap(a, b);
 
-        Neighbor& x = UpNeighbor(ch, a, b);
+        uint32_t e = ch.find_edge(a, b);
+        if(e == ContractionHierarchy::NO_EDGE)
+            continue;
+        Neighbor& x = ch.edge(e);
         if(x.distance == iter.first.first) {
             C.push_back(make_pair(x.distance, make_pair(a, b)));
-            q.push(DCHSearchNode(ch.nodes[a].dist_index, a, b, x.distance));
+            q.push(DCHSearchNode(ch.dist_index(a), a, b, x.distance));
         }
     }
 
@@ -2752,39 +3918,38 @@ void Graph::IncCH(ContractionHierarchy &ch, vector<pair<pair<distance_t, distanc
 
         // recompute shortcut distance
         distance_t new_dist = infinity;
-        for (Neighbor &n : node_data[next.v].neighbors) {
+        for (Neighbor &n : neighbors(next.v)) {
             if (n.node == next.w) {
                 new_dist = n.distance;
                 break;
             }
         }
 
-        size_t i = 0, j = 0;
-        std::sort(ch.nodes[next.v].down_neighbors.begin(), ch.nodes[next.v].down_neighbors.end());
-        std::sort(ch.nodes[next.w].down_neighbors.begin(), ch.nodes[next.w].down_neighbors.end());
-        while (i < ch.nodes[next.v].down_neighbors.size() && j < ch.nodes[next.w].down_neighbors.size()) {
-            a = ch.nodes[next.v].down_neighbors[i]; b = ch.nodes[next.w].down_neighbors[j];
-            if (a < b) i++;
-            else if (b < a) j++;
-            else {
-                new_dist = min(new_dist, UpNeighbor(ch, a, next.v).distance + UpNeighbor(ch, a, next.w).distance);
-                i++; j++;
-            }
+        // shortcuts through common downward neighbors, looked up from the shorter list
+        NodeID v = next.v, w = next.w;
+        if (ch.down_neighbors(v).size() > ch.down_neighbors(w).size())
+            swap(v, w);
+        span<const NodeID> down = ch.down_neighbors(v);
+        span<const uint32_t> down_edges = ch.down_edges(v);
+        for (size_t i = 0; i < down.size(); i++) {
+            uint32_t e = ch.find_edge(down[i], w);
+            if (e != ContractionHierarchy::NO_EDGE)
+                new_dist = min(new_dist, ch.edge(down_edges[i]).distance + ch.edge(e).distance);
         }
 
-        Neighbor& x = UpNeighbor(ch, next.v, next.w);
+        Neighbor& x = ch.edge(ch.find_edge(next.v, next.w));
         if(new_dist != x.distance) {
 
-            for(Neighbor &n: ch.nodes[next.v].up_neighbors) {
+            for(Neighbor &n: ch.up_neighbors(next.v)) {
                 if(n.node != next.w) {
                     distance_t new_dist = next.distance + n.distance;
 
                     a = next.w, b = n.node;
-                    if(ch.nodes[a].dist_index < ch.nodes[b].dist_index) swap(a, b);
-                    Neighbor& y = UpNeighbor(ch, a, b);
+                    if(ch.dist_index(a) < ch.dist_index(b)) swap(a, b);
+                    Neighbor& y = ch.edge(ch.find_edge(a, b));
                     if(y.distance == new_dist) {
                         C.push_back(make_pair(y.distance, make_pair(a, b)));
-                        q.push(DCHSearchNode(ch.nodes[a].dist_index, a, b, y.distance));
+                        q.push(DCHSearchNode(ch.dist_index(a), a, b, y.distance));
                     }
                 }
             }
@@ -2795,20 +3960,22 @@ void Graph::IncCH(ContractionHierarchy &ch, vector<pair<pair<distance_t, distanc
 
 void Graph::DhlDec(ContractionHierarchy &ch, ContractionIndex &ci, vector<pair<pair<distance_t, distance_t>, pair<NodeID, NodeID> > >& updates) {
 
+    ci.make_writable();
+
     vector<pair<distance_t, pair<NodeID, NodeID> > > C;
     DecCH(ch, updates, C);
 
     //update distances involving ancestors
     util::min_bucket_queue<ICHSearchNode> q;
     for(pair<distance_t, pair<NodeID, NodeID> > iter: C) {
-	FlatCutIndex a = ci.get_contraction_label(iter.second.first).cut_index;
-	if(iter.first < a.distances()[ch.nodes[iter.second.second].dist_index]) {
+	FlatCutIndex a = ci.get_cut_index(iter.second.first);
+	if(iter.first < a.distances()[ch.dist_index(iter.second.second)]) {
 
-	    FlatCutIndex b = ci.get_contraction_label(iter.second.second).cut_index;
-            for(size_t anc = 0; anc <= ch.nodes[iter.second.second].dist_index; anc++) {
+	    FlatCutIndex b = ci.get_cut_index(iter.second.second);
+            for(size_t anc = 0; anc <= ch.dist_index(iter.second.second); anc++) {
                 if(iter.first + b.distances()[anc] < a.distances()[anc]) {
                     a.distances()[anc] = iter.first + b.distances()[anc];
-                    q.push(ICHSearchNode(iter.second.first, anc), ch.nodes[iter.second.first].dist_index);
+                    q.push(ICHSearchNode(iter.second.first, anc), ch.dist_index(iter.second.first));
                 }
             }
         }
@@ -2818,13 +3985,13 @@ void Graph::DhlDec(ContractionHierarchy &ch, ContractionIndex &ci, vector<pair<p
     while(!q.empty()) {
         ICHSearchNode next = q.pop();
 
-	distance_t d = ci.get_contraction_label(next.v).cut_index.distances()[next.w];
-        for(NodeID node: ch.nodes[next.v].down_neighbors) {
-	    FlatCutIndex nn = ci.get_contraction_label(node).cut_index;
-            distance_t new_dist = nn.distances()[ch.nodes[next.v].dist_index] + d;
+	distance_t d = ci.get_cut_index(next.v).distances()[next.w];
+        for(NodeID node: ch.down_neighbors(next.v)) {
+	    FlatCutIndex nn = ci.get_cut_index(node);
+            distance_t new_dist = nn.distances()[ch.dist_index(next.v)] + d;
             if(new_dist < nn.distances()[next.w]) {
                 nn.distances()[next.w] = new_dist;
-                q.push(ICHSearchNode(node, next.w), ch.nodes[node].dist_index);
+                q.push(ICHSearchNode(node, next.w), ch.dist_index(node));
 	    }
         }
     }
@@ -2832,19 +3999,21 @@ void Graph::DhlDec(ContractionHierarchy &ch, ContractionIndex &ci, vector<pair<p
 
 void Graph::DhlInc(ContractionHierarchy &ch, ContractionIndex &ci, vector<pair<pair<distance_t, distance_t>, pair<NodeID, NodeID> > >& updates) {
 
+    ci.make_writable();
+
     vector<pair<distance_t, pair<NodeID, NodeID> > > C;
     IncCH(ch, updates, C);
 
     //update distances involving ancestors
     util::min_bucket_queue<ICHSearchNode> q;
     for(pair<distance_t, pair<NodeID, NodeID> > iter: C) {
-	FlatCutIndex a = ci.get_contraction_label(iter.second.first).cut_index;
-	if(iter.first == a.distances()[ch.nodes[iter.second.second].dist_index]) {
+	FlatCutIndex a = ci.get_cut_index(iter.second.first);
+	if(iter.first == a.distances()[ch.dist_index(iter.second.second)]) {
 
-            FlatCutIndex b = ci.get_contraction_label(iter.second.second).cut_index;
-            for(size_t anc = 0; anc <= ch.nodes[iter.second.second].dist_index; anc++) {
+            FlatCutIndex b = ci.get_cut_index(iter.second.second);
+            for(size_t anc = 0; anc <= ch.dist_index(iter.second.second); anc++) {
                 if(iter.first + b.distances()[anc] == a.distances()[anc]) {
-	            q.push(ICHSearchNode(iter.second.first, anc), ch.nodes[iter.second.first].dist_index);
+	            q.push(ICHSearchNode(iter.second.first, anc), ch.dist_index(iter.second.first));
 		}
             }
         }
@@ -2855,18 +4024,18 @@ void Graph::DhlInc(ContractionHierarchy &ch, ContractionIndex &ci, vector<pair<p
         ICHSearchNode next = q.pop();
 
 	distance_t new_dist = infinity; // new distance from v to anc
-        for(Neighbor &n: ch.nodes[next.v].up_neighbors) {
-            if(ch.nodes[n.node].dist_index >= next.w)
-                new_dist = min(new_dist, n.distance + ci.get_contraction_label(n.node).cut_index.distances()[next.w]);
+        for(Neighbor &n: ch.up_neighbors(next.v)) {
+            if(ch.dist_index(n.node) >= next.w)
+                new_dist = min(new_dist, n.distance + ci.get_cut_index(n.node).distances()[next.w]);
 	}
 
 	// distance may not have changed after all
-	FlatCutIndex cv = ci.get_contraction_label(next.v).cut_index;
+	FlatCutIndex cv = ci.get_cut_index(next.v);
 	if(new_dist > cv.distances()[next.w]) {
-	    for(NodeID node: ch.nodes[next.v].down_neighbors) {
-		FlatCutIndex nn = ci.get_contraction_label(node).cut_index;
-                if(nn.distances()[ch.nodes[next.v].dist_index] + cv.distances()[next.w] == nn.distances()[next.w]) {
-		    q.push(ICHSearchNode(node, next.w), ch.nodes[node].dist_index);
+	    for(NodeID node: ch.down_neighbors(next.v)) {
+		FlatCutIndex nn = ci.get_cut_index(node);
+                if(nn.distances()[ch.dist_index(next.v)] + cv.distances()[next.w] == nn.distances()[next.w]) {
+		    q.push(ICHSearchNode(node, next.w), ch.dist_index(node));
 		}
             }
 	    cv.distances()[next.w] = new_dist;
@@ -2874,149 +4043,231 @@ void Graph::DhlInc(ContractionHierarchy &ch, ContractionIndex &ci, vector<pair<p
     }
 }
 
-void Graph::contract_seq(ContractionIndex &ci, vector<pair<pair<distance_t,distance_t>, NodeID> >& contracted_updates) {
+void Graph::contract_seq(ContractionIndex &ci, vector<pair<distance_t, NodeID> >& contracted_updates) {
 
-    // we start searches in order of original distance and cancel searches for nodes already updated
+    // process children in order of original distance, so that ancestors come first and their offsets are final;
+    // new offsets are always derived from the parent's current offset, as other updates may have shifted it
     sort(contracted_updates.begin(), contracted_updates.end());
+    unordered_set<NodeID> visited;
     // search from each update using DFS
-    vector<SearchNode> stack;
+    vector<NodeID> stack;
     for (auto& it: contracted_updates) {
-        // if already processed, distance offset has (probably) changed
-        if (it.first.first != ci.get_contraction_label(it.second).distance_offset)
+        // skip subtrees already updated from an ancestor
+        if (!visited.insert(it.second).second)
             continue;
-        stack.push_back(SearchNode(it.first.second, it.second));
+        stack.push_back(it.second);
         while (!stack.empty()) {
-            SearchNode next = stack.back(); stack.pop_back();
+            NodeID node = stack.back(); stack.pop_back();
+            visited.insert(node);
 
             // update label
-            ci.update_distance_offset(next.node, next.distance);
-            // enqueue neighbors
-            for (Neighbor n : node_data[next.node].neighbors) {
-                if (ci.get_contraction_label(n.node).parent == next.node)
-                    stack.push_back(SearchNode(next.distance + n.distance, n.node));
+            NodeID parent = ci.get_contraction_label(node).parent;
+            distance_t parent_offset = ci.get_contraction_label(parent).distance_offset;
+            for (Neighbor n : neighbors(node))
+                if (n.node == parent) {
+                    ci.update_distance_offset(node, parent_offset + n.distance);
+                    break;
+                }
+            // enqueue children
+            for (Neighbor n : neighbors(node)) {
+                if (ci.get_contraction_label(n.node).parent == node)
+                    stack.push_back(n.node);
+            }
+        }
+    }
+}
+
+size_t Graph::update_edges(ContractionHierarchy &ch, ContractionIndex &ci, const vector<Edge> &updates) {
+
+    // group updates by undirected edge, keeping arrival order within each group
+    vector<Edge> batch(updates);
+    for (Edge &e : batch)
+        if (e.a > e.b)
+            swap(e.a, e.b);
+    stable_sort(batch.begin(), batch.end(), [](const Edge &x, const Edge &y) { return x.a < y.a || (x.a == y.a && x.b < y.b); });
+
+    vector<pair<pair<distance_t, distance_t>, pair<NodeID, NodeID> > > decreases, increases;
+    vector<pair<distance_t, NodeID> > contracted_updates;
+    for (size_t i = 0; i < batch.size(); i++) {
+        // only the last update of each edge matters
+        if (i + 1 < batch.size() && batch[i + 1].a == batch[i].a && batch[i + 1].b == batch[i].b)
+            continue;
+        NodeID a = batch[i].a, b = batch[i].b;
+        distance_t new_weight = batch[i].d, old_weight = infinity;
+        for (const Neighbor &n : neighbors(a))
+            if (n.node == b) {
+                old_weight = n.distance;
+                break;
             }
+        if (old_weight == infinity || old_weight == new_weight)
+            continue;
+        update_edge(a, b, new_weight);
+        update_edge(b, a, new_weight);
+
+        if (ci.is_contracted(a) || ci.is_contracted(b)) {
+            // edges of contracted trees only shift distance offsets of the child's subtree
+            ContractionLabel x = ci.get_contraction_label(a), y = ci.get_contraction_label(b);
+            if (x.parent == b)
+                contracted_updates.push_back(make_pair(x.distance_offset, a));
+            else if (y.parent == a)
+                contracted_updates.push_back(make_pair(y.distance_offset, b));
+            continue;
         }
+        (new_weight < old_weight ? decreases : increases).push_back(make_pair(make_pair(old_weight, new_weight), make_pair(a, b)));
+    }
+
+    // decreases first, as IncCH recomputes shortcuts from graph weights which already include them
+    if (!decreases.empty()) {
+#ifdef MULTI_THREAD_UPDATES
+        if (decreases.size() >= MULTI_THREAD_UPDATES && thread::hardware_concurrency() > 1)
+            DhlDec_Par(ch, ci, decreases);
+        else
+#endif
+            DhlDec(ch, ci, decreases);
+    }
+    if (!increases.empty()) {
+#ifdef MULTI_THREAD_UPDATES
+        if (increases.size() >= MULTI_THREAD_UPDATES && thread::hardware_concurrency() > 1)
+            DhlInc_Par(ch, ci, increases);
+        else
+#endif
+            DhlInc(ch, ci, increases);
     }
+    if (!contracted_updates.empty())
+        contract_seq(ci, contracted_updates);
+    return decreases.size() + increases.size() + contracted_updates.size();
 }
 
 #ifdef MULTI_THREAD_DISTANCES
+// non-empty buckets of grouping, largest first; the spawning thread works from the back of its deque,
+// so idle workers steal the expensive ones from the front
+static vector<uint16_t> label_tasks(const vector<vector<NodeID>> &grouping)
+{
+    vector<uint16_t> tasks;
+    for (size_t label_index = 0; label_index < grouping.size(); label_index++)
+        if (!grouping[label_index].empty())
+            tasks.push_back(label_index);
+    stable_sort(tasks.begin(), tasks.end(), [&grouping](uint16_t a, uint16_t b) { return grouping[a].size() > grouping[b].size(); });
+    return tasks;
+}
+
 void Graph::DhlDec_Par(ContractionHierarchy &ch, ContractionIndex &ci, vector<pair<pair<distance_t, distance_t>, pair<NodeID, NodeID> > >& updates) {
 
-    vector<thread> threads;
-    auto dhcldec = [this](ContractionHierarchy &ch, ContractionIndex& ci, util::TSBucketQueue<NodeID>& que) {
+    ci.make_writable();
 
-        util::min_bucket_queue<NodeID> bq;
-        vector<NodeID> bucket; size_t label_index;
-        while (que.next_bucket(bucket, label_index))
-        {
-            for (NodeID node : bucket)
-                bq.push(node, label_index);
+    vector<pair<distance_t, pair<NodeID, NodeID> > > C;
+    DecCH(ch, updates, C);
+
+    //update distances involving ancestors, grouping nodes to continue from by label index
+    vector<vector<NodeID> > grouping;
+    for(pair<distance_t, pair<NodeID, NodeID> > iter: C) {
+        FlatCutIndex a = ci.get_cut_index(iter.second.first);
+        if(iter.first < a.distances()[ch.dist_index(iter.second.second)]) {
+
+            FlatCutIndex b = ci.get_cut_index(iter.second.second);
+            for(uint16_t anc = 0; anc <= ch.dist_index(iter.second.second); anc++) {
+                distance_t new_dist = iter.first + b.distances()[anc];
+                if(new_dist < a.distances()[anc]) {
+                    a.distances()[anc] = new_dist;
+                    if (grouping.size() <= anc)
+                        grouping.resize(anc + 1);
+                    grouping[anc].push_back(iter.second.first);
+                }
+            }
+        }
+    }
+
+    // label indices are independent, so each is repaired as one task
+    util::TaskPool::TaskGroup group(task_pool());
+    for (uint16_t label_index : label_tasks(grouping))
+        group.spawn([&, label_index] {
+            util::min_bucket_queue<NodeID> bq;
+            for (NodeID node : grouping[label_index])
+                bq.push(node, ch.dist_index(node));
 
             // update distances involving descendants
             while(!bq.empty()) {
                 NodeID next = bq.pop();
 
-                distance_t d = ci.get_contraction_label(next).cut_index.distances()[label_index];
-                for(NodeID node: ch.nodes[next].down_neighbors) {
-                    FlatCutIndex nn = ci.get_contraction_label(node).cut_index;
-                    distance_t new_dist = UpNeighbor(ch, node, next).distance + d;
+                distance_t d = ci.get_cut_index(next).distances()[label_index];
+                span<const NodeID> down = ch.down_neighbors(next);
+                span<const uint32_t> down_edges = ch.down_edges(next);
+                for(size_t i = 0; i < down.size(); i++) {
+                    NodeID node = down[i];
+                    FlatCutIndex nn = ci.get_cut_index(node);
+                    distance_t new_dist = ch.edge(down_edges[i]).distance + d;
 
                     if(new_dist < nn.distances()[label_index]) {
                         nn.distances()[label_index] = new_dist;
-                        bq.push(node, label_index);
+                        bq.push(node, ch.dist_index(node));
                     }
                 }
             }
-        }
-    };
+        });
+    group.wait();
+}
+
+void Graph::DhlInc_Par(ContractionHierarchy &ch, ContractionIndex &ci, vector<pair<pair<distance_t, distance_t>, pair<NodeID, NodeID> > >& updates) {
+
+    ci.make_writable();
 
     vector<pair<distance_t, pair<NodeID, NodeID> > > C;
-    DecCH(ch, updates, C);
+    IncCH(ch, updates, C);
 
-    //update distances involving ancestors
-    util::TSBucketQueue<NodeID> grouping;
+    //update distances involving ancestors, grouping nodes to continue from by label index
+    vector<vector<NodeID> > grouping;
     for(pair<distance_t, pair<NodeID, NodeID> > iter: C) {
-        FlatCutIndex a = ci.get_contraction_label(iter.second.first).cut_index;
-        if(iter.first < a.distances()[ch.nodes[iter.second.second].dist_index]) {
+        FlatCutIndex a = ci.get_cut_index(iter.second.first);
+        if(iter.first == a.distances()[ch.dist_index(iter.second.second)]) {
 
-            FlatCutIndex b = ci.get_contraction_label(iter.second.second).cut_index;
-            for(uint16_t anc = 0; anc <= ch.nodes[iter.second.second].dist_index; anc++) {
-                distance_t new_dist = iter.first + b.distances()[anc];
-                if(new_dist < a.distances()[anc]) {
-                    a.distances()[anc] = new_dist;
-                    grouping.push(iter.second.first, anc);
+            FlatCutIndex b = ci.get_cut_index(iter.second.second);
+            for(uint16_t anc = 0; anc <= ch.dist_index(iter.second.second); anc++) {
+                distance_t dist = iter.first + b.distances()[anc];
+                if(dist == a.distances()[anc]) {
+                    if (grouping.size() <= anc)
+                        grouping.resize(anc + 1);
+                    grouping[anc].push_back(iter.second.first);
                 }
             }
         }
     }
 
-    for (size_t i = 0; i < MULTI_THREAD_DISTANCES; i++)
-        threads.push_back(thread(dhcldec, std::ref(ch), std::ref(ci), std::ref(grouping)));
-    for (size_t i = 0; i < MULTI_THREAD_DISTANCES; i++)
-        threads[i].join();
-}
-
-void Graph::DhlInc_Par(ContractionHierarchy &ch, ContractionIndex &ci, vector<pair<pair<distance_t, distance_t>, pair<NodeID, NodeID> > >& updates) {
-
-    vector<thread> threads;
-    auto dhclinc = [this](ContractionHierarchy &ch, ContractionIndex& ci, util::TSBucketQueue<NodeID>& que) {
-
-        util::min_bucket_queue<NodeID> bq;
-        vector<NodeID> bucket; size_t label_index;
-        while (que.next_bucket(bucket, label_index))
-        {
-            // move items to bucket queue
-            for (NodeID node: bucket)
-                bq.push(node, label_index);
+    // label indices are independent, so each is repaired as one task
+    util::TaskPool::TaskGroup group(task_pool());
+    for (uint16_t label_index : label_tasks(grouping))
+        group.spawn([&, label_index] {
+            util::min_bucket_queue<NodeID> bq;
+            for (NodeID node : grouping[label_index])
+                bq.push(node, ch.dist_index(node));
 
             // identify distances to descendants for update
             while(!bq.empty()) {
                 NodeID next = bq.pop();
 
                 distance_t new_dist = infinity; // new distance from v to anc
-                for(Neighbor &n: ch.nodes[next].up_neighbors) {
-                    if(ch.nodes[n.node].dist_index >= label_index)
-                        new_dist = min(new_dist, n.distance + ci.get_contraction_label(n.node).cut_index.distances()[label_index]);
+                for(Neighbor &n: ch.up_neighbors(next)) {
+                    if(ch.dist_index(n.node) >= label_index)
+                        new_dist = min(new_dist, n.distance + ci.get_cut_index(n.node).distances()[label_index]);
                 }
 
                 // distance may not have changed after all
-                FlatCutIndex cv = ci.get_contraction_label(next).cut_index;
+                FlatCutIndex cv = ci.get_cut_index(next);
                 if(new_dist > cv.distances()[label_index]) {
-                    for(NodeID node: ch.nodes[next].down_neighbors) {
-                        FlatCutIndex nn = ci.get_contraction_label(node).cut_index;
-                        distance_t dist = UpNeighbor(ch, node, next).distance + cv.distances()[label_index];
+                    span<const NodeID> down = ch.down_neighbors(next);
+                    span<const uint32_t> down_edges = ch.down_edges(next);
+                    for(size_t i = 0; i < down.size(); i++) {
+                        NodeID node = down[i];
+                        FlatCutIndex nn = ci.get_cut_index(node);
+                        distance_t dist = ch.edge(down_edges[i]).distance + cv.distances()[label_index];
 
                         if(dist == nn.distances()[label_index])
-                            bq.push(node, label_index);
+                            bq.push(node, ch.dist_index(node));
                     }
                     cv.distances()[label_index] = new_dist;
                 }
             }
-        }
-    };
-
-    vector<pair<distance_t, pair<NodeID, NodeID> > > C;
-    IncCH(ch, updates, C);
-
-    //update distances involving ancestors
-    util::TSBucketQueue<NodeID> grouping;
-    for(pair<distance_t, pair<NodeID, NodeID> > iter: C) {
-        FlatCutIndex a = ci.get_contraction_label(iter.second.first).cut_index;
-        if(iter.first == a.distances()[ch.nodes[iter.second.second].dist_index]) {
-
-            FlatCutIndex b = ci.get_contraction_label(iter.second.second).cut_index;
-            for(uint16_t anc = 0; anc <= ch.nodes[iter.second.second].dist_index; anc++) {
-                distance_t dist = iter.first + b.distances()[anc];
-                if(dist == a.distances()[anc])
-                    grouping.push(iter.second.first, anc);
-            }
-        }
-    }
-
-    for (size_t i = 0; i < MULTI_THREAD_DISTANCES; i++)
-        threads.push_back(thread(dhclinc, std::ref(ch), std::ref(ci), std::ref(grouping)));
-    for (size_t i = 0; i < MULTI_THREAD_DISTANCES; i++)
-        threads[i].join();
+        });
+    group.wait();
 }
 #endif
 
@@ -3047,10 +4298,10 @@ bool Graph::is_consistent() const
 bool Graph::is_undirected() const
 {
     for (NodeID node : nodes)
-        for (Neighbor n : node_data[node].neighbors)
+        for (Neighbor n : neighbors(node))
         {
             bool found = false;
-            for (Neighbor nn : node_data[n.node].neighbors)
+            for (Neighbor nn : neighbors(n.node))
                 if (nn.node == node && nn.distance == n.distance)
                 {
                     found = true;
@@ -3065,16 +4316,16 @@ bool Graph::is_undirected() const
 vector<pair<distance_t,distance_t>> Graph::distances() const
 {
     vector<pair<distance_t,distance_t>> d;
-    for (const Node &n : node_data)
-        d.push_back(pair(n.distance, n.outcopy_distance));
+    for (NodeID node = 0; node < node_distance.size(); node++)
+        d.push_back(pair(node_distance[node], flow_data[node].outcopy_distance));
     return d;
 }
 
 vector<pair<NodeID,NodeID>> Graph::flow() const
 {
     vector<pair<NodeID,NodeID>> f;
-    for (const Node &n : node_data)
-        f.push_back(pair(n.inflow, n.outflow));
+    for (NodeID node = 0; node < flow_data.size(); node++)
+        f.push_back(pair(flow_data[node].inflow, flow_data[node].outflow));
     return f;
 }
 
@@ -3094,7 +4345,8 @@ pair<NodeID,NodeID> Graph::random_pair(size_t steps) const
         NodeID n = NO_NODE;
         do
         {
-            n = util::random(node_data[stop].neighbors).node;
+            span<const Neighbor> stop_neighbors = neighbors(stop);
+            n = stop_neighbors[rand() % stop_neighbors.size()].node;
         } while (!contains(n));
         stop = n;
     }
@@ -3137,6 +4389,7 @@ void Graph::random_pairs(vector<vector<pair<NodeID,NodeID>>> &buckets, distance_
 
 void Graph::randomize()
 {
+    assert(!is_frozen());
     shuffle(nodes.begin(), nodes.end(), default_random_engine());
     for (NodeID node : nodes)
         shuffle(node_data[node].neighbors.begin(), node_data[node].neighbors.end(), default_random_engine());
@@ -3177,6 +4430,360 @@ void read_graph(Graph &g, istream &in)
     g.remove_isolated();
 }
 
+// parse unsigned decimal at p, skipping leading blanks; leaves p behind the last digit
+static uint32_t parse_uint(const char *&p, const char *end)
+{
+    while (p < end && (*p == ' ' || *p == '\t'))
+        p++;
+    uint32_t value = 0;
+    while (p < end && *p >= '0' && *p <= '9')
+        value = value * 10 + (*p++ - '0');
+    return value;
+}
+
+// parse DIMACS lines in [p, end), which must start at a line boundary; node_count is set by a problem line
+static void parse_dimacs_chunk(const char *p, const char *end, vector<Edge> &edges, size_t &node_count)
+{
+    while (p < end)
+    {
+        // like stream extraction, skip blank space before line identifier
+        while (p < end && isspace(static_cast<unsigned char>(*p)))
+            p++;
+        if (p == end)
+            break;
+        char line_id = *p++;
+        if (line_id == 'a')
+        {
+            NodeID v = parse_uint(p, end);
+            NodeID w = parse_uint(p, end);
+            distance_t d = parse_uint(p, end);
+            edges.push_back(Edge(v, w, d));
+        }
+        else if (line_id == 'p')
+        {
+            // skip problem type
+            while (p < end && *p != '\n' && !isdigit(static_cast<unsigned char>(*p)))
+                p++;
+            node_count = parse_uint(p, end);
+        }
+        p = static_cast<const char*>(memchr(p, '\n', end - p));
+        if (p == nullptr)
+            break;
+    }
+}
+
+//--------------------------- snapshot ------------------------------
+
+// binary graph snapshot layout, all sections aligned to MAPPED_ALIGNMENT:
+// header, offsets[node_count + 2], arcs[arc_count], then latitudes, longitudes and osm_ids[node_count + 1] if flagged
+static const char SNAPSHOT_MAGIC[8] = { 'H', 'C', '2', 'L', 'G', 'R', 'P', 'H' };
+static const uint32_t SNAPSHOT_VERSION = 1;
+static const uint32_t SNAPSHOT_COORDINATES = 1;
+static const uint32_t SNAPSHOT_OSM_IDS = 2;
+
+struct SnapshotHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint64_t node_count;
+    uint64_t arc_count;
+};
+
+// section offsets of snapshot with given header, plus total file size
+struct SnapshotLayout
+{
+    uint64_t offsets, arcs, latitudes, longitudes, osm_ids, size;
+    SnapshotLayout(const SnapshotHeader &header);
+};
+
+SnapshotLayout::SnapshotLayout(const SnapshotHeader &header)
+{
+    const uint64_t attribute_size = (header.node_count + 1) * 8;
+    offsets = align_offset(sizeof(SnapshotHeader));
+    arcs = align_offset(offsets + (header.node_count + 2) * sizeof(uint32_t));
+    latitudes = align_offset(arcs + header.arc_count * sizeof(Neighbor));
+    longitudes = latitudes + (header.flags & SNAPSHOT_COORDINATES ? attribute_size : 0);
+    osm_ids = longitudes + (header.flags & SNAPSHOT_COORDINATES ? attribute_size : 0);
+    size = osm_ids + (header.flags & SNAPSHOT_OSM_IDS ? attribute_size : 0);
+}
+
+// load snapshot from memory region holding the whole file
+static void load_snapshot(const char *data, size_t size, Graph *g, NodeAttributes *attributes, const string &filename)
+{
+    SnapshotHeader header;
+    if (size < sizeof(header))
+        throw runtime_error("truncated graph snapshot " + filename);
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0)
+        throw runtime_error("not a graph snapshot: " + filename);
+    if (header.version != SNAPSHOT_VERSION)
+        throw runtime_error("unsupported graph snapshot version " + to_string(header.version) + " in " + filename);
+    if (header.node_count >= UINT32_MAX || header.arc_count > UINT32_MAX)
+        throw runtime_error("corrupt graph snapshot " + filename);
+    SnapshotLayout layout(header);
+    if (layout.size != size)
+        throw runtime_error("corrupt graph snapshot " + filename);
+    const size_t n = header.node_count;
+    if (g)
+    {
+        const uint32_t *offsets = reinterpret_cast<const uint32_t*>(data + layout.offsets);
+        const Neighbor *arcs = reinterpret_cast<const Neighbor*>(data + layout.arcs);
+        if (offsets[0] != 0 || offsets[n + 1] != header.arc_count)
+            throw runtime_error("corrupt graph snapshot " + filename);
+        for (size_t v = 0; v <= n; v++)
+            if (offsets[v] > offsets[v + 1])
+                throw runtime_error("corrupt graph snapshot " + filename);
+        for (size_t i = 0; i < header.arc_count; i++)
+            if (arcs[i].node > n)
+                throw runtime_error("corrupt graph snapshot " + filename);
+        g->resize(n);
+        for (NodeID v = 0; v <= n; v++)
+            g->set_neighbors(v, span<const Neighbor>(arcs + offsets[v], arcs + offsets[v + 1]));
+        g->remove_isolated();
+    }
+    if (attributes)
+    {
+        const double *latitudes = reinterpret_cast<const double*>(data + layout.latitudes);
+        const double *longitudes = reinterpret_cast<const double*>(data + layout.longitudes);
+        const uint64_t *osm_ids = reinterpret_cast<const uint64_t*>(data + layout.osm_ids);
+        attributes->latitudes.clear();
+        attributes->longitudes.clear();
+        attributes->osm_ids.clear();
+        if (header.flags & SNAPSHOT_COORDINATES)
+        {
+            attributes->latitudes.assign(latitudes, latitudes + n + 1);
+            attributes->longitudes.assign(longitudes, longitudes + n + 1);
+        }
+        if (header.flags & SNAPSHOT_OSM_IDS)
+            attributes->osm_ids.assign(osm_ids, osm_ids + n + 1);
+    }
+}
+
+uint8_t road_class_rank(const string &highway)
+{
+    static const pair<const char*,uint8_t> ranks[] = {
+        { "motorway", 7 }, { "trunk", 6 }, { "primary", 5 }, { "secondary", 4 }, { "tertiary", 3 },
+        { "unclassified", 2 }, { "residential", 2 }, { "living_street", 1 }, { "service", 1 }
+    };
+    // tags may list several classes, and link roads share the class of the road they connect to
+    uint8_t rank = 0;
+    size_t begin = 0;
+    while (begin < highway.size())
+    {
+        size_t end = highway.find_first_not_of("abcdefghijklmnopqrstuvwxyz_", begin);
+        if (end == string::npos)
+            end = highway.size();
+        string tag = highway.substr(begin, end - begin);
+        if (tag.size() > 5 && tag.compare(tag.size() - 5, 5, "_link") == 0)
+            tag.resize(tag.size() - 5);
+        for (const pair<const char*,uint8_t> &r : ranks)
+            if (tag == r.first)
+                rank = max(rank, r.second);
+        begin = end + 1;
+    }
+    return rank;
+}
+
+// split CSV line into fields, keeping separators within double quotes
+static void split_csv_line(const string &line, vector<string> &fields)
+{
+    fields.assign(1, string());
+    bool quoted = false;
+    for (char c : line)
+    {
+        if (c == '"')
+            quoted = !quoted;
+        else if (c == ',' && !quoted)
+            fields.emplace_back();
+        else if (c != '\r')
+            fields.back().push_back(c);
+    }
+}
+
+size_t read_road_classes(const string &filename, NodeAttributes &attributes)
+{
+    ifstream in(filename);
+    if (!in)
+        throw runtime_error("cannot open " + filename);
+    string line;
+    vector<string> fields;
+    getline(in, line);
+    split_csv_line(line, fields);
+    const size_t source_column = find(fields.begin(), fields.end(), "source") - fields.begin();
+    const size_t target_column = find(fields.begin(), fields.end(), "target") - fields.begin();
+    const size_t highway_column = find(fields.begin(), fields.end(), "highway") - fields.begin();
+    if (max({ source_column, target_column, highway_column }) >= fields.size())
+        throw runtime_error("missing source, target or highway column in " + filename);
+    const size_t n = Graph::super_node_count();
+    attributes.road_classes.assign(n + 1, 0);
+    size_t rows = 0;
+    while (getline(in, line))
+    {
+        split_csv_line(line, fields);
+        if (max({ source_column, target_column, highway_column }) >= fields.size())
+            continue;
+        const uint8_t rank = road_class_rank(fields[highway_column]);
+        for (size_t column : { source_column, target_column })
+        {
+            NodeID node = stoul(fields[column]);
+            if (node > 0 && node <= n)
+                attributes.road_classes[node] = max(attributes.road_classes[node], rank);
+        }
+        rows++;
+    }
+    return rows;
+}
+
+bool is_graph_snapshot(const string &filename)
+{
+    ifstream in(filename, ios::binary);
+    char magic[sizeof(SNAPSHOT_MAGIC)];
+    return in.read(magic, sizeof(magic)) && memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic)) == 0;
+}
+
+void write_graph_snapshot(const string &filename, const Graph &g, const NodeAttributes &attributes)
+{
+    const size_t n = Graph::super_node_count();
+    const bool coordinates = !attributes.latitudes.empty();
+    const bool osm_ids = !attributes.osm_ids.empty();
+    if ((coordinates && (attributes.latitudes.size() != n + 1 || attributes.longitudes.size() != n + 1))
+        || (!coordinates && !attributes.longitudes.empty()) || (osm_ids && attributes.osm_ids.size() != n + 1))
+        throw invalid_argument("node attributes do not match graph size");
+    vector<uint32_t> offsets(n + 2, 0);
+    vector<Neighbor> arcs;
+    for (NodeID v = 0; v <= n; v++)
+    {
+        span<const Neighbor> neighbors = g.get_neighbors(v);
+        arcs.insert(arcs.end(), neighbors.begin(), neighbors.end());
+        offsets[v + 1] = arcs.size();
+    }
+    SnapshotHeader header = {};
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    header.version = SNAPSHOT_VERSION;
+    header.flags = (coordinates ? SNAPSHOT_COORDINATES : 0) | (osm_ids ? SNAPSHOT_OSM_IDS : 0);
+    header.node_count = n;
+    header.arc_count = arcs.size();
+    SnapshotLayout layout(header);
+
+    ofstream os(filename, ios::binary);
+    if (!os)
+        throw runtime_error("cannot write graph snapshot " + filename);
+    const char zeros[MAPPED_ALIGNMENT] = {};
+    auto write_section = [&os, &zeros](uint64_t offset, const void *data, size_t bytes) {
+        os.write(zeros, offset - os.tellp());
+        os.write(static_cast<const char*>(data), bytes);
+    };
+    os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    write_section(layout.offsets, offsets.data(), offsets.size() * sizeof(uint32_t));
+    write_section(layout.arcs, arcs.data(), arcs.size() * sizeof(Neighbor));
+    write_section(layout.latitudes, nullptr, 0);
+    if (coordinates)
+    {
+        write_section(layout.latitudes, attributes.latitudes.data(), (n + 1) * sizeof(double));
+        write_section(layout.longitudes, attributes.longitudes.data(), (n + 1) * sizeof(double));
+    }
+    if (osm_ids)
+        write_section(layout.osm_ids, attributes.osm_ids.data(), (n + 1) * sizeof(uint64_t));
+    if (!os)
+        throw runtime_error("cannot write graph snapshot " + filename);
+}
+
+void read_graph_snapshot(const string &filename, Graph *g, NodeAttributes *attributes)
+{
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw runtime_error("cannot open graph snapshot " + filename);
+    struct stat file_stat;
+    void *region = MAP_FAILED;
+    if (fstat(fd, &file_stat) == 0 && file_stat.st_size > 0)
+        region = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (region == MAP_FAILED)
+        throw runtime_error("cannot map graph snapshot " + filename);
+    try {
+        load_snapshot(static_cast<const char*>(region), file_stat.st_size, g, attributes, filename);
+    } catch (...) {
+        munmap(region, file_stat.st_size);
+        throw;
+    }
+    munmap(region, file_stat.st_size);
+}
+
+void read_graph(Graph &g, const string &filename)
+{
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw runtime_error("cannot open graph file " + filename);
+    struct stat file_stat;
+    void *region = MAP_FAILED;
+    if (fstat(fd, &file_stat) == 0 && S_ISREG(file_stat.st_mode) && file_stat.st_size > 0)
+        region = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    // pipes, empty files and failed mappings go through the stream parser
+    if (region == MAP_FAILED)
+    {
+        ifstream in(filename);
+        if (!in)
+            throw runtime_error("cannot read graph file " + filename);
+        read_graph(g, in);
+        return;
+    }
+    const size_t size = file_stat.st_size;
+    const char *begin = static_cast<const char*>(region), *end = begin + size;
+    madvise(region, size, MADV_SEQUENTIAL);
+    if (size >= sizeof(SNAPSHOT_MAGIC) && memcmp(begin, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) == 0)
+    {
+        try {
+            load_snapshot(begin, size, &g, nullptr, filename);
+        } catch (...) {
+            munmap(region, size);
+            throw;
+        }
+        munmap(region, size);
+        return;
+    }
+    // split at line boundaries into chunks of at least GRAPH_CHUNK_SIZE bytes, parsed in parallel
+    const size_t chunk_count = max<size_t>(1, min<size_t>(size / GRAPH_CHUNK_SIZE, thread::hardware_concurrency()));
+    vector<const char*> bounds(1, begin);
+    for (size_t i = 1; i < chunk_count; i++)
+    {
+        const char *bound = max(begin + size * i / chunk_count, bounds.back());
+        const char *line_end = static_cast<const char*>(memchr(bound, '\n', end - bound));
+        bounds.push_back(line_end ? line_end + 1 : end);
+    }
+    bounds.push_back(end);
+    vector<vector<Edge>> chunk_edges(chunk_count);
+    vector<size_t> node_counts(chunk_count, 0);
+    vector<thread> threads;
+    for (size_t i = 1; i < chunk_count; i++)
+        threads.push_back(thread(parse_dimacs_chunk, bounds[i], bounds[i + 1], ref(chunk_edges[i]), ref(node_counts[i])));
+    parse_dimacs_chunk(bounds[0], bounds[1], chunk_edges[0], node_counts[0]);
+    for (thread &t : threads)
+        t.join();
+    munmap(region, size);
+    // concatenate chunks in file order, so adjacency lists match those built by the stream parser
+    size_t node_count = 0, edge_count = 0;
+    for (size_t i = 0; i < chunk_count; i++)
+    {
+        if (node_count == 0)
+            node_count = node_counts[i];
+        edge_count += chunk_edges[i].size();
+    }
+    if (node_count == 0)
+        throw runtime_error("missing problem line in graph file " + filename);
+    vector<Edge> edges;
+    edges.reserve(edge_count);
+    for (vector<Edge> &chunk : chunk_edges)
+    {
+        edges.insert(edges.end(), chunk.begin(), chunk.end());
+        vector<Edge>().swap(chunk);
+    }
+    g.resize(node_count);
+    g.add_edges(edges);
+    g.remove_isolated();
+}
+
 //--------------------------- ostream -------------------------------
 
 // for easy distance printing
@@ -3229,7 +4836,7 @@ ostream& operator<<(ostream& os, const FlatCutIndex &ci)
 
 ostream& operator<<(ostream& os, const ContractionLabel &cl)
 {
-    return os << "CL(" << cl.cut_index << ",d=" << cl.distance_offset << ",p=" << cl.parent << ")";
+    return os << "CL(@" << cl.label_offset << ",d=" << cl.distance_offset << ",p=" << cl.parent << ")";
 }
 
 ostream& operator<<(ostream& os, const Neighbor &n)
@@ -3263,9 +4870,9 @@ ostream& operator<<(ostream& os, const Graph &g)
     return os << "G(" << g.subgraph_id << "#" << g.nodes << " over " << g.node_data << ")";
 }
 
-const std::vector<Neighbor>& Graph::get_neighbors(NodeID v) const
+span<const Neighbor> Graph::get_neighbors(NodeID v) const
 {
-    return node_data[v].neighbors;
+    return neighbors(v);
 }
 
 } // road_network
@@ -11,11 +11,13 @@
 #define MULTI_THREAD 32 // determines threshold for multi-threading
 #ifdef MULTI_THREAD
     #define MULTI_THREAD_DISTANCES 4 // number of parallel threads for label & shortcut computation
+    #define MULTI_THREAD_UPDATES 64 // minimum number of edge updates in a batch for parallel label repair
 #endif
 
 #include <cstdint>
 #include <climits>
 #include <vector>
+#include <functional>
 #include <ostream>
 #include <cassert>
 #include <boost/functional/hash.hpp>
@@ -26,6 +28,9 @@
 #include <map>
 #include <set>
 #include <fstream>
+#include <string>
+#include <span>
+#include <array>
 
 namespace road_network {
 
@@ -37,6 +42,7 @@ const distance_t infinity = UINT32_MAX >> 1;
 
 struct Neighbor;
 class Graph;
+struct NodeAttributes;
 
 //--------------------------- CutIndex ------------------------------
 
@@ -76,19 +82,23 @@ namespace PBV
     bool is_ancestor(uint64_t bv_ancestor, uint64_t bv_descendant);
 }
 
+// view of the labels of a node; partition bitvector and dist_index are kept in per-node arrays of the
+// ContractionIndex, so only distances are read from the arena
 class FlatCutIndex
 {
-    char* data; // stores partition bitvector, dist_index and distances
+    const uint64_t* bitvector;
+    const uint16_t* dist_index_data;
+    distance_t* distance_data;
 public:
     FlatCutIndex();
-    FlatCutIndex(const CutIndex &ci);
+
+    // number of arena bytes required to store distances of ci
+    static size_t data_size(const CutIndex &ci);
 
     bool operator==(FlatCutIndex other) const;
 
     // return pointers to partition bitvector, dist_index and distances array
-    uint64_t* partition_bitvector();
     const uint64_t* partition_bitvector() const;
-    uint16_t* dist_index();
     const uint16_t* dist_index() const;
     distance_t* distances();
     const distance_t* distances() const;
@@ -96,7 +106,7 @@ public:
     uint64_t partition() const;
     uint16_t cut_level() const;
 
-    // number of bytes allocated for index data
+    // number of bytes of label data in binary format written by ContractionIndex::write
     size_t size() const;
     // number of labels
     size_t label_count() const;
@@ -122,13 +132,14 @@ std::ostream& operator<<(std::ostream& os, const FlatCutIndex &ci);
 
 struct ContractionLabel
 {
-    FlatCutIndex cut_index;
+    static const uint32_t NO_LABELS = UINT32_MAX;
+
+    uint32_t label_offset; // position of labels in arena, in 8-byte units (shared with label-owning node)
     distance_t distance_offset; // distance to node owning the labels
     NodeID parent; // parent in tree rooted at label-owning node
 
     ContractionLabel();
-    // index size in bytes
-    size_t size() const;
+    bool empty() const;
 };
 
 std::ostream& operator<<(std::ostream& os, const ContractionLabel &ci);
@@ -136,9 +147,29 @@ std::ostream& operator<<(std::ostream& os, const ContractionLabel &ci);
 class ContractionIndex
 {
     std::vector<ContractionLabel> labels;
+    // partition bitvectors and dist_index positions by node, kept apart from distances so lca levels and
+    // label ranges are found without touching the arena (contracted nodes share those of their root)
+    std::vector<uint64_t> partition_bitvectors;
+    std::vector<uint32_t> dist_index_offsets;
+    std::vector<uint16_t> dist_indices;
+    // distances of all label-owning nodes in a single block, laid out in DFS order of the partition tree
+    char* arena;
+    size_t arena_size;
+    // memory-mapped index file backing the arena (nullptr if arena is heap-allocated)
+    char* mapped_region;
+    size_t mapped_size;
+    uint64_t graph_checksum;
+
+    // sort owners into DFS order of the partition tree, assign arena offsets and allocate arena
+    void allocate_arena(std::vector<NodeID> &owners, const std::vector<size_t> &data_sizes);
+    // append dist_index of node to dist_indices
+    void add_dist_index(NodeID node, const uint16_t *dist_index, size_t size);
+    // let contracted nodes share labels of their root
+    void link_contracted_labels();
 
     static distance_t get_cut_level_distance(FlatCutIndex a, FlatCutIndex b, size_t cut_level);
     static distance_t get_distance(FlatCutIndex a, FlatCutIndex b);
+    static distance_t get_distance(FlatCutIndex a, FlatCutIndex b, size_t lca_level);
     static size_t get_cut_level_hoplinks(FlatCutIndex a, FlatCutIndex b, size_t cut_level);
     static size_t get_hoplinks(FlatCutIndex a, FlatCutIndex b);
 public:
@@ -146,6 +177,8 @@ public:
     ContractionIndex(std::vector<CutIndex> &ci, std::vector<Neighbor> &closest);
     // populate from binary source
     ContractionIndex(std::istream& is);
+    // map index container written by write_mapped read-only; distances are used in place, optionally prefaulted
+    explicit ContractionIndex(const std::string& mapped_file, bool prefault = false);
     // wrapper when not contracting
     explicit ContractionIndex(std::vector<CutIndex> &ci);
     ~ContractionIndex();
@@ -177,12 +210,20 @@ public:
     size_t non_empty_cuts() const;
 
     ContractionLabel get_contraction_label(NodeID v) const;
+    // view of labels used by v (owned by v or by the root v got contracted into)
+    FlatCutIndex get_cut_index(NodeID v) const;
     void update_distance_offset(NodeID n, distance_t d);
+    // copy mapped distances to the heap so updates can modify them (no-op unless mapped)
+    void make_writable();
 
     // generate random query
     std::pair<NodeID,NodeID> random_query() const;
     // write index in binary format
     void write(std::ostream& os) const;
+    // write index as memory-mappable container (header, section table, per-node arrays, contiguous label blob)
+    void write_mapped(std::ostream& os, uint64_t graph_checksum = 0) const;
+    // checksum of graph the index was built from, as stored in mapped container (0 if unknown)
+    uint64_t get_graph_checksum() const;
     // write index in json format
     void write_json(std::ostream& os) const;
 };
@@ -209,24 +250,47 @@ public:
 
 //--------------------------- ContractionHierarchy ------------------
 
-struct CHNode
-{
-    uint16_t dist_index;
-    std::vector<Neighbor> up_neighbors;
-    //std::vector<NodeID> up_neighbors;
-    std::vector<NodeID> down_neighbors;
-};
-
+// contraction hierarchy induced by the cut index, frozen in CSR layout; upward edges lead to ancestors in the
+// partition tree, whose dist_index is unique along the path to the root, so edges are located via per-node
+// bitmaps over dist_index
 class ContractionHierarchy
 {
 public:
-    std::vector<CHNode> nodes;
-
+    static constexpr uint16_t NOT_IN_HIERARCHY = UINT16_MAX;
+    static constexpr uint32_t NO_EDGE = UINT32_MAX;
+private:
+    std::vector<uint16_t> dist_indices;
+    // upward edges by node, ordered by dist_index of head
+    std::vector<uint32_t> up_offsets;
+    std::vector<Neighbor> up_edges;
+    // downward edges by node, ordered by dist_index of tail, with index of the matching upward edge
+    std::vector<uint32_t> down_offsets;
+    std::vector<NodeID> down_nodes;
+    std::vector<uint32_t> down_up_edges;
+    // bit i in bitmap of node is set if it has an upward edge to dist_index i; ranks count bits in preceding words
+    std::vector<uint32_t> bitmap_offsets;
+    std::vector<uint64_t> edge_bits;
+    std::vector<uint16_t> edge_ranks;
+public:
     ContractionHierarchy();
+    // freeze upward adjacency lists of nodes with given dist_index (NOT_IN_HIERARCHY for contracted nodes)
+    ContractionHierarchy(const std::vector<uint16_t> &dist_indices, const std::vector<std::vector<Neighbor>> &up_neighbors);
+    // populate from binary source written by write; sets failbit on format mismatch
     ContractionHierarchy(std::istream &is);
-    void write(std::ostream &os);
+    void write(std::ostream &os) const;
     size_t edge_count() const;
     size_t size() const;
+
+    uint16_t dist_index(NodeID v) const;
+    std::span<Neighbor> up_neighbors(NodeID v);
+    std::span<const Neighbor> up_neighbors(NodeID v) const;
+    std::span<const NodeID> down_neighbors(NodeID v) const;
+    // indices of upward edges from down_neighbors(v) to v
+    std::span<const uint32_t> down_edges(NodeID v) const;
+    // index of upward edge from v to w, NO_EDGE if w is not an up-neighbor of v
+    uint32_t find_edge(NodeID v, NodeID w) const;
+    Neighbor& edge(uint32_t e);
+    const Neighbor& edge(uint32_t e) const;
 };
 
 //--------------------------- Graph ---------------------------------
@@ -243,33 +307,33 @@ struct Neighbor
 
 std::ostream& operator<<(std::ostream& os, const Neighbor &n);
 
+// adjacency and subgraph membership, the only per-node data touched by every traversal
 struct Node
 {
     std::vector<Neighbor> neighbors;
     // subgraph identifier
     SubgraphID subgraph_id;
     Node(SubgraphID subgraph_id);
-private:
-    // temporary data used by algorithms
-    distance_t distance, outcopy_distance;
-#ifdef MULTI_THREAD_DISTANCES
-    distance_t distances[MULTI_THREAD_DISTANCES];
-#endif
-    NodeID inflow, outflow;
-    uint16_t landmark_level;
-
-    friend class Graph;
 };
 
 std::ostream& operator<<(std::ostream& os, const Node &n);
 
+// temporary data used by max-flow computation
+struct FlowData
+{
+    distance_t outcopy_distance;
+    NodeID inflow, outflow;
+    FlowData();
+};
+
 // multi-threading requires thread-local data for s & t nodes
-class MultiThreadNodeData : public std::vector<Node>
+template<typename T>
+class MultiThreadNodeData : public std::vector<T>
 {
-    thread_local static Node s_data, t_data;
+    thread_local static T s_data, t_data;
 public:
-    Node& operator[](size_type pos);
-    const Node& operator[](size_type pos) const;
+    T& operator[](size_t pos);
+    const T& operator[](size_t pos) const;
     void normalize();
 };
 
@@ -305,6 +369,9 @@ struct DiffData
     friend std::ostream& operator<<(std::ostream& os, const DiffData &dd);
 };
 
+// max-flow algorithm used to find minimum vertex cuts during partitioning
+enum class FlowEngine { dinitz, push_relabel };
+
 /**
  * full graph information (edges and weights) is only stored once, as static data; graph instances describe induced subgraphs, storing only a list of nodes;
  * this approach speeds up creation of subgraphs, and saves memory, but complicates usage;
@@ -314,12 +381,24 @@ struct DiffData
  */
 class Graph
 {
-    // global graph
 #ifdef MULTI_THREAD
-    static MultiThreadNodeData node_data;
+    template<typename T> using NodeArray = MultiThreadNodeData<T>;
     static size_t thread_threshold; // minimum subgraph size for which processing will be split across multiple threads
 #else
-    static std::vector<Node> node_data;
+    template<typename T> using NodeArray = std::vector<T>;
+#endif
+    // global graph
+    static NodeArray<Node> node_data;
+    // adjacency of frozen global graph in CSR layout, empty unless frozen
+    static std::vector<uint32_t> adj_offsets;
+    static std::vector<Neighbor> adj_edges;
+    // temporary data used by algorithms, one array per algorithm so searches only pull in what they use;
+    // allocated on first use, so graphs that are only queried never hold them
+    static NodeArray<distance_t> node_distance;
+    static NodeArray<FlowData> flow_data;
+    static NodeArray<uint16_t> landmark_level;
+#ifdef MULTI_THREAD_DISTANCES
+    static std::vector<std::array<distance_t, MULTI_THREAD_DISTANCES>> par_distances;
 #endif
     static NodeID s,t; // virtual nodes for max-flow
     // subgraph info
@@ -345,8 +424,14 @@ class Graph
     void remove_nodes(const std::vector<NodeID> &node_set);
     // return single neighbor of degree one node, or NO_NODE otherwise
     Neighbor single_neighbor(NodeID v) const;
-
-    // run dijkstra from node v, storing distance results in node_data
+    // neighbors of v in global graph, from CSR arrays if frozen
+    std::span<Neighbor> neighbors(NodeID v);
+    std::span<const Neighbor> neighbors(NodeID v) const;
+    // allocate algorithm scratch data for global graph unless already present; not thread-safe
+    static void reserve_scratch();
+    static void release_scratch();
+
+    // run dijkstra from node v, storing distance results in node_distance
     void run_dijkstra(NodeID v);
     // run dijkstra from node v, in subgraph excluding lower-level landmarks
     void run_dijkstra_llsub(NodeID v);
@@ -359,13 +444,10 @@ class Graph
     void run_dijkstra_llsub_par(const std::vector<NodeID> &vertices);
     // stores whether all shortest paths bypass other landmarks in lowest distance bit
     void run_dijkstra_ll_par(const std::vector<NodeID> &vertices);
-
-    void DhlInc_Par(ContractionHierarchy &ch, ContractionIndex &ci, std::vector<std::pair<std::pair<distance_t, distance_t>, std::pair<NodeID, NodeID> > >& updates);
-    void DhlDec_Par(ContractionHierarchy &ch, ContractionIndex &ci, std::vector<std::pair<std::pair<distance_t, distance_t>, std::pair<NodeID, NodeID> > >& updates);
 #endif
-    // run BFS from node v, storing distance results in node_data
+    // run BFS from node v, storing distance results in node_distance
     void run_bfs(NodeID v);
-    // run BFS from s (forward) or t (backward) on the residual graph, storing distance results in node_data
+    // run BFS from s (forward) or t (backward) on the residual graph, storing distance results in node_distance
     void run_flow_bfs_from_s();
     void run_flow_bfs_from_t();
 
@@ -373,10 +455,13 @@ class Graph
     std::pair<NodeID,distance_t> get_furthest(NodeID v, bool weighted);
     // find pair of nodes with maximal distance
     Edge get_furthest_pair(bool weighted);
-    // get distances of nodes to a and b; pre-computed indicates that node_data already holds distances to a
+    // get distances of nodes to a and b; pre-computed indicates that node_distance already holds distances to a
     void get_diff_data(std::vector<DiffData> &diff, NodeID a, NodeID b, bool weighted, bool pre_computed = false);
     // find one or more minimal s-t vertex cut sets
     void min_vertex_cuts(std::vector<std::vector<NodeID>> &cuts);
+    // same cuts as min_vertex_cuts, computed by push-relabel on a compact copy of the flow graph;
+    // during create_cut_index with road classes, picks the min cut through the most important roads
+    void min_vertex_cuts_push_relabel(std::vector<std::vector<NodeID>> &cuts);
     // find cut from given rough partition
     void rough_partition_to_cuts(std::vector<std::vector<NodeID>> &cuts, const Partition &p);
     // compute left/right partitions based on given cut
@@ -401,6 +486,8 @@ class Graph
 public:
     // turn progress tracking on/off
     static void show_progress(bool state);
+    // select max-flow algorithm used for partitioning
+    static void set_flow_engine(FlowEngine engine);
     // number of nodes in the top-level graph
     static size_t super_node_count();
 
@@ -411,6 +498,10 @@ public:
     void resize(size_t node_count);
     // insert edge from v to w into global graph
     void add_edge(NodeID v, NodeID w, distance_t distance, bool add_reverse);
+    // insert batch of undirected edges into global graph without edges; parallel edges are merged as in add_edge
+    void add_edges(const std::vector<Edge> &edges);
+    // replace adjacency list of v in global graph; reverse arcs must be set separately
+    void set_neighbors(NodeID v, std::span<const Neighbor> neighbors);
     // remove edge between v and w from global graph
     void remove_edge(NodeID v, NodeID w);
     // change the weight of the edge between v and w in global graph
@@ -420,6 +511,10 @@ public:
     void remove_isolated();
     // reset graph to contain all nodes in global graph
     void reset();
+    // convert global adjacency lists into CSR layout and release scratch data; afterwards only edge weights
+    // may change, and construction algorithms (contraction, cut index, randomize) must not be run
+    void freeze();
+    bool is_frozen() const;
 
     size_t node_count() const;
     size_t edge_count() const;
@@ -433,14 +528,21 @@ public:
 
     // returns distance between u and v in subgraph
     distance_t get_distance(NodeID v, NodeID w, bool weighted);
+    // returns shortest path between v and w in subgraph using bidirectional dijkstra, with per-thread workspaces;
+    // edges (x,y) for which edge_filter returns false are skipped; distance is infinity and path empty if unreachable
+    std::pair<distance_t, std::vector<NodeID>> get_shortest_path(NodeID v, NodeID w, const std::function<bool(NodeID,NodeID)> &edge_filter = nullptr) const;
     // decompose graph into connected components
     void get_connected_components(std::vector<std::vector<NodeID>> &cc);
     // computed rough partition with wide separator, returned in p; returns if rough partition is already a partition
     bool get_rough_partition(Partition &p, double balance, bool disconnected);
+    // compute partition by projecting node coordinates onto several directions and separating extreme nodes (inertial flow);
+    // only available during create_cut_index with coordinates given, returns false if nodes lack coordinates
+    bool get_inertial_partition(Partition &p, double balance);
     // partition graph into balanced subgraphs using minimal cut
     void create_partition(Partition &p, double balance);
-    // decompose graph and construct cut index; returns number of shortcuts used
-    size_t create_cut_index(std::vector<CutIndex> &ci, double balance);
+    // decompose graph and construct cut index using up to thread_count threads (0 = all cores); returns number of shortcuts used;
+    // if node attributes are given, partitions are found by inertial flow where coordinates allow, and cuts prefer arterial roads
+    size_t create_cut_index(std::vector<CutIndex> &ci, double balance, size_t thread_count = 0, const NodeAttributes *attributes = nullptr);
     // returns edges that don't affect distances between nodes
     void get_redundant_edges(std::vector<Edge> &edges);
     // repeatedly remove nodes of degree 1, populating closest[removed] with next node on path to closest unremoved node
@@ -458,24 +560,56 @@ public:
     // randomize order of nodes and neighbors
     void randomize();
 
-    Neighbor& UpNeighbor(ContractionHierarchy &ch, NodeID v, NodeID w);
     void DecCH(ContractionHierarchy &ch, std::vector<std::pair<std::pair<distance_t, distance_t>, std::pair<NodeID, NodeID> > >& updates, std::vector<std::pair<distance_t, std::pair<NodeID, NodeID> > > &C);
     void IncCH(ContractionHierarchy &ch, std::vector<std::pair<std::pair<distance_t, distance_t>, std::pair<NodeID, NodeID> > >& updates, std::vector<std::pair<distance_t, std::pair<NodeID, NodeID> > > &C);
     void DhlDec(ContractionHierarchy &ch, ContractionIndex &ci, std::vector<std::pair<std::pair<distance_t, distance_t>, std::pair<NodeID, NodeID> > >& updates);
     void DhlInc(ContractionHierarchy &ch, ContractionIndex &ci, std::vector<std::pair<std::pair<distance_t, distance_t>, std::pair<NodeID, NodeID> > >& updates);
+#ifdef MULTI_THREAD_DISTANCES
+    // as DhlInc/DhlDec, but repairs each label index as a separate task on the shared task pool
+    void DhlInc_Par(ContractionHierarchy &ch, ContractionIndex &ci, std::vector<std::pair<std::pair<distance_t, distance_t>, std::pair<NodeID, NodeID> > >& updates);
+    void DhlDec_Par(ContractionHierarchy &ch, ContractionIndex &ci, std::vector<std::pair<std::pair<distance_t, distance_t>, std::pair<NodeID, NodeID> > >& updates);
+#endif
 
-    void contract_seq(ContractionIndex &ci, std::vector<std::pair<std::pair<distance_t,distance_t>, NodeID> >& contracted_updates);
+    // recompute distance offsets in contracted subtrees of given children (paired with their old offsets) from current graph weights
+    void contract_seq(ContractionIndex &ci, std::vector<std::pair<distance_t, NodeID> >& contracted_updates);
+    // apply batch of edge weight changes (a, b, new weight) in arrival order to graph, hierarchy and index;
+    // repeated updates to an edge collapse to their net change; returns number of edges whose weight changed
+    size_t update_edges(ContractionHierarchy &ch, ContractionIndex &ci, const std::vector<Edge> &updates);
 
     // Helper method for path reconstruction - get neighbors of a node
-    const std::vector<Neighbor>& get_neighbors(NodeID v) const;
+    std::span<const Neighbor> get_neighbors(NodeID v) const;
 
     friend std::ostream& operator<<(std::ostream& os, const Graph &g);
-    friend MultiThreadNodeData;
+    template<typename T> friend class MultiThreadNodeData;
 };
 
 // print graph in DIMACS format
 void print_graph(const Graph &g, std::ostream &os);
 // read graph in DIMACS format
 void read_graph(Graph &g, std::istream &in);
+// read graph in DIMACS format or binary snapshot from memory-mapped file, parsing DIMACS chunks in parallel;
+// throws if file cannot be read
+void read_graph(Graph &g, const std::string &filename);
+
+// per-node data, mostly stored in binary graph snapshots, indexed by node id (entry 0 unused); empty if not available
+struct NodeAttributes
+{
+    std::vector<double> latitudes, longitudes; // NaN for nodes without coordinates
+    std::vector<uint64_t> osm_ids; // 0 for nodes without OSM id
+    std::vector<uint8_t> road_classes; // highest road_class_rank of incident roads, 0 if unknown; not stored in snapshots
+};
+
+// rank of OpenStreetMap highway tag (or list of tags), from 7 for motorways down to 1 for service roads; 0 if unknown
+uint8_t road_class_rank(const std::string &highway);
+// read highest road_class_rank of incident edges from CSV with source, target and highway columns (e.g. quezon_city_edges.csv)
+// into attributes.road_classes, sized for the global graph; returns number of edges read, throws if file cannot be read
+size_t read_road_classes(const std::string &filename, NodeAttributes &attributes);
+
+// returns whether file is a binary graph snapshot (of any version)
+bool is_graph_snapshot(const std::string &filename);
+// write global graph as binary snapshot with CSR adjacency; attributes must be empty or have super_node_count() + 1 entries
+void write_graph_snapshot(const std::string &filename, const Graph &g, const NodeAttributes &attributes);
+// read binary snapshot into g and attributes, either of which may be null; throws if file is invalid or of another version
+void read_graph_snapshot(const std::string &filename, Graph *g, NodeAttributes *attributes);
 
 } // road_network
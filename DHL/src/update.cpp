@@ -14,14 +14,14 @@ int main(int argc, char** argv)
 {
 
     // read graph
-    fstream ifs(argv[1]);
     Graph g;
-    read_graph(g, ifs);
-    ifs.close();
+    read_graph(g, string(argv[1]));
+    // updates only change edge weights
+    g.freeze();
 
     // read index
     util::start_timer();
-    ifs.open(string(argv[2]) + string("_dhl"));
+    fstream ifs(string(argv[2]) + string("_dhl"));
     ContractionIndex con_index(ifs);
     ifs.close();
     ifs.open(string(argv[2]) + string("_ch"));
@@ -30,46 +30,23 @@ int main(int argc, char** argv)
     double read_index_time = util::stop_timer();
     cout << "read index in " << read_index_time << "s (" << con_index.size() / MB << " MB)" << " " << ch.size() / MB << " MB)" << endl;
 
-    vector<pair<pair<distance_t,distance_t>, NodeID> > contracted_updates;
-    vector<pair<pair<distance_t, distance_t>, pair<NodeID, NodeID> > > updates;
+    // d/i scale listed weights down/up, m reads new weights from a live feed (mixed directions, repeated edges)
+    vector<Edge> updates;
     ifs.open(argv[3]); NodeID a, b; distance_t weight;
     while(ifs >> a >> b >> weight) {
 
-        distance_t new_weight;
+        distance_t new_weight = weight;
         if(argv[4][0] == 'd')
             new_weight = weight * 0.5;
         else if(argv[4][0] == 'i')
             new_weight = weight * 1.5;
-
-        g.update_edge(a, b, new_weight);
-        g.update_edge(b, a, new_weight);
-
-        ContractionLabel x = con_index.get_contraction_label(a), y = con_index.get_contraction_label(b);
-        if (con_index.is_contracted(a) || con_index.is_contracted(b)) {
-            if (x.distance_offset > y.distance_offset)
-                contracted_updates.push_back(make_pair(make_pair(x.distance_offset, y.distance_offset + new_weight), a));
-            else if(x.distance_offset < y.distance_offset)
-                contracted_updates.push_back(make_pair(make_pair(y.distance_offset, x.distance_offset + new_weight), b));
-            continue;
-        }
-        updates.push_back(make_pair(make_pair(weight, new_weight), make_pair(a, b)));
+        updates.push_back(Edge(a, b, new_weight));
     }
     ifs.close();
 
     util::start_timer();
-    if(argv[4][0] == 'd') {
-      //sequential
-      g.DhlDec(ch, con_index, updates);
-      //parallel
-      //g.DhlDec_Par(ch, con_index, updates);
-    } else if(argv[4][0] == 'i') {
-      //sequential
-      g.DhlInc(ch, con_index, updates);
-      //parallel
-      //g.DhlInc_Par(ch, con_index, updates);
-    }
-    g.contract_seq(con_index, contracted_updates);
+    size_t changed = g.update_edges(ch, con_index, updates);
     double random_update_time = util::stop_timer();
-    cout << "ran " << updates.size() << " random updates in " << random_update_time << endl;
+    cout << "ran " << updates.size() << " random updates (" << changed << " edge changes) in " << random_update_time << endl;
     return 0;
 }
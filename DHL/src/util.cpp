@@ -1,6 +1,8 @@
 #include "util.h"
 
 #include <chrono>
+#include <fstream>
+#include <utility>
 
 using namespace std;
 
@@ -22,11 +24,187 @@ double stop_timer()
     return diff_nano / 1.e9;
 }
 
+uint64_t file_hash(const string &path)
+{
+    ifstream ifs(path, ios::binary);
+    if (!ifs.is_open())
+        return 0;
+    uint64_t hash = 14695981039346656037ull;
+    vector<char> buffer(1 << 16);
+    while (ifs.read(buffer.data(), buffer.size()) || ifs.gcount() > 0)
+    {
+        for (streamsize i = 0; i < ifs.gcount(); i++)
+        {
+            hash ^= static_cast<unsigned char>(buffer[i]);
+            hash *= 1099511628211ull;
+        }
+    }
+    return hash;
+}
+
 Summary Summary::operator*(double x) const
 {
     return { min * x, max * x, avg * x  };
 }
 
+// pool and deque index of the current thread if it is a TaskPool worker
+thread_local static const TaskPool *worker_pool = nullptr;
+thread_local static size_t worker_index = 0;
+
+TaskPool::TaskGroup::TaskGroup(TaskPool &pool) : pool(pool), pending(0)
+{
+}
+
+TaskPool::TaskGroup::~TaskGroup()
+{
+    join();
+}
+
+void TaskPool::TaskGroup::spawn(function<void()> task)
+{
+    pending++;
+    pool.push(Task{ move(task), this });
+}
+
+void TaskPool::TaskGroup::wait()
+{
+    join();
+    if (error)
+        rethrow_exception(exchange(error, nullptr));
+}
+
+void TaskPool::TaskGroup::join()
+{
+    const size_t worker = pool.current_worker();
+    Task task;
+    while (pending > 0)
+    {
+        if (pool.next_task(worker, task))
+        {
+            pool.execute(task);
+            continue;
+        }
+        unique_lock<mutex> lock(pool.m_mutex);
+        pool.changed.wait(lock, [this] { return pending == 0 || pool.queued > 0; });
+    }
+}
+
+TaskPool::TaskPool(size_t thread_count) : queued(0), stopping(false)
+{
+    for (size_t i = 0; i < thread_count; i++)
+        queues.push_back(make_unique<TaskQueue>());
+    for (size_t i = 1; i < thread_count; i++)
+        workers.push_back(thread(&TaskPool::worker_loop, this, i));
+}
+
+TaskPool::~TaskPool()
+{
+    {
+        lock_guard<mutex> lock(m_mutex);
+        stopping = true;
+    }
+    changed.notify_all();
+    for (thread &t : workers)
+        t.join();
+}
+
+size_t TaskPool::size() const
+{
+    return queues.size();
+}
+
+size_t TaskPool::current_worker() const
+{
+    return worker_pool == this ? worker_index : 0;
+}
+
+void TaskPool::push(Task &&task)
+{
+    // count before queueing, so queued never drops below the number of tasks present
+    queued++;
+    {
+        TaskQueue &q = *queues[current_worker()];
+        lock_guard<mutex> lock(q.m_mutex);
+        q.tasks.push_back(move(task));
+    }
+    lock_guard<mutex> lock(m_mutex);
+    changed.notify_all();
+}
+
+bool TaskPool::next_task(size_t worker, Task &task)
+{
+    // own tasks from the back, stolen ones from the front
+    for (size_t i = 0; i < queues.size(); i++)
+    {
+        TaskQueue &q = *queues[(worker + i) % queues.size()];
+        lock_guard<mutex> lock(q.m_mutex);
+        if (q.tasks.empty())
+            continue;
+        if (i == 0)
+        {
+            task = move(q.tasks.back());
+            q.tasks.pop_back();
+        }
+        else
+        {
+            task = move(q.tasks.front());
+            q.tasks.pop_front();
+        }
+        queued--;
+        return true;
+    }
+    return false;
+}
+
+void TaskPool::execute(Task &task)
+{
+    // completion is signalled even if the task throws, so its group never waits forever
+    struct Completion
+    {
+        TaskPool &pool;
+        Task &task;
+        ~Completion()
+        {
+            task.run = nullptr;
+            // group may be destroyed by its waiter as soon as pending drops to zero
+            if (task.group->pending.fetch_sub(1) == 1)
+            {
+                lock_guard<mutex> lock(pool.m_mutex);
+                pool.changed.notify_all();
+            }
+        }
+    } completion{ *this, task };
+    try
+    {
+        task.run();
+    }
+    catch (...)
+    {
+        lock_guard<mutex> lock(m_mutex);
+        if (!task.group->error)
+            task.group->error = current_exception();
+    }
+}
+
+void TaskPool::worker_loop(size_t worker)
+{
+    worker_pool = this;
+    worker_index = worker;
+    Task task;
+    while (true)
+    {
+        if (next_task(worker, task))
+        {
+            execute(task);
+            continue;
+        }
+        unique_lock<mutex> lock(m_mutex);
+        changed.wait(lock, [this] { return stopping || queued > 0; });
+        if (stopping)
+            return;
+    }
+}
+
 }
 
 namespace std {
@@ -3,6 +3,15 @@
 #include <vector>
 #include <algorithm>
 #include <ostream>
+#include <string>
+#include <deque>
+#include <mutex>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <functional>
+#include <condition_variable>
+#include <exception>
 #include "road_network.h"
 
 namespace util {
@@ -12,6 +21,9 @@ void start_timer();
 // returns time in seconds since last unconsumed start_timer call and consumes it
 double stop_timer();
 
+// 64-bit FNV-1a hash of file contents, used to tie persisted indices to their graph; 0 if unreadable
+uint64_t file_hash(const std::string &path);
+
 // sort vector and remove duplicate elements
 template<typename T>
 void make_set(std::vector<T> &v)
@@ -146,50 +158,59 @@ public:
     }
 };
 
-// thread-safe queue of buckets
-template <typename T>
-class TSBucketQueue {
-private:
-    // underlying data structure
-    std::vector<std::vector<T> > buckets;
-    // minimum non-empty bucket
-    size_t min_bucket;
-    // mutex for thread synchronization
-    std::mutex m_mutex;
-
-    bool empty() const
-    {
-        return min_bucket >= buckets.size();
-    }
+// persistent pool of worker threads for nested fork/join parallelism; spawned tasks go to the deque of the
+// spawning worker and idle workers steal from the front of other deques, while threads waiting on a group
+// run pending tasks themselves, so tasks may spawn and wait on groups of their own
+class TaskPool {
 public:
-    // pushes an element to a given bucket in the queue (NOT thread-safe)
-    void push(T item, size_t bucket)
+    class TaskGroup;
+private:
+    struct Task
     {
-        //std::lock_guard<std::mutex> lock(m_mutex);
-        if (empty() || min_bucket > bucket)
-            min_bucket = bucket;
-        if (buckets.size() <= bucket)
-            buckets.resize(bucket + 1);
-        buckets[bucket].push_back(item);
-    }
-    // pops next non-empty bucket off the queue, along with its bucket number; returns whether successful (thread-safe)
-    bool next_bucket(std::vector<T>& items, size_t &bucket)
+        std::function<void()> run;
+        TaskGroup *group;
+    };
+    struct TaskQueue
     {
-        // restrict mutex lock to critical block (delay copy)
-        {
-            std::lock_guard<std::mutex> lock(m_mutex);
-            if (empty())
-                return false;
-            bucket = min_bucket++;
-            // skip empty buckets
-            while (min_bucket < buckets.size() && buckets[min_bucket].empty())
-                min_bucket++;
-        }
-        // copy bucket content
-        items = buckets[bucket];
-        buckets[bucket].clear();
-        return true;
-    }
+        std::mutex m_mutex;
+        std::deque<Task> tasks;
+    };
+    std::vector<std::unique_ptr<TaskQueue>> queues;
+    std::vector<std::thread> workers;
+    // number of tasks waiting in queues
+    std::atomic<size_t> queued;
+    bool stopping;
+    std::mutex m_mutex;
+    // signalled when tasks get queued or a group completes
+    std::condition_variable changed;
+
+    size_t current_worker() const;
+    void push(Task &&task);
+    bool next_task(size_t worker, Task &task);
+    void execute(Task &task);
+    void worker_loop(size_t worker);
+public:
+    // tasks spawned together and awaited as a unit
+    class TaskGroup {
+        friend TaskPool;
+        TaskPool &pool;
+        std::atomic<size_t> pending;
+        // first exception thrown by a task, rethrown by wait
+        std::exception_ptr error;
+
+        void join();
+    public:
+        explicit TaskGroup(TaskPool &pool);
+        // waits for tasks not yet completed
+        ~TaskGroup();
+        void spawn(std::function<void()> task);
+        // returns once all spawned tasks completed, running queued tasks meanwhile; rethrows task exceptions
+        void wait();
+    };
+    // threads outside the pool share deque 0 and only work while waiting, so thread_count - 1 threads are started
+    explicit TaskPool(size_t thread_count = std::max(1u, std::thread::hardware_concurrency()));
+    ~TaskPool();
+    size_t size() const;
 };
 
 } // util
@@ -1,5 +1,6 @@
 #include "src/road_network.h"
 #include "src/util.h"
+#include "dhl_routing_service.h"
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -8,6 +9,9 @@
 #include <map>
 #include <set>
 #include <cmath>
+#include <random>
+#include <algorithm>
+#include <memory>
 
 using namespace std;
 using namespace road_network;
@@ -327,6 +331,276 @@ void testDHLFunctionality() {
     }
 }
 
+// Checks a mixed batch that shortens a contracted tree edge and lengthens the edge below it against Dijkstra
+bool testContractedMixedBatch() {
+    cout << "\n=== Testing Mixed Update Batch on Contracted Tree ===" << endl;
+    // cycle 1-2-3-4 with chain 1-5-6-7 hanging off node 1, which gets contracted
+    Graph g(7);
+    g.add_edge(1, 2, 10, true);
+    g.add_edge(2, 3, 10, true);
+    g.add_edge(3, 4, 10, true);
+    g.add_edge(4, 1, 10, true);
+    g.add_edge(1, 5, 10, true);
+    g.add_edge(5, 6, 3, true);
+    g.add_edge(6, 7, 4, true);
+    vector<Neighbor> closest;
+    g.contract(closest);
+    vector<CutIndex> ci;
+    g.create_cut_index(ci, 0.2);
+    g.reset();
+    ContractionHierarchy ch;
+    g.create_contraction_hierarchy(ch, ci, closest);
+    ContractionIndex conIndex(ci, closest);
+
+    // offset of 6 drops by 5 through its parent and rises by 5 through its own edge, so it ends up unchanged
+    vector<Edge> batch = { Edge(1, 5, 5), Edge(5, 6, 8), Edge(2, 3, 14) };
+    g.update_edges(ch, conIndex, batch);
+
+    size_t mismatches = 0;
+    for (NodeID v = 1; v <= 7; v++)
+        for (NodeID w = 1; w <= 7; w++)
+            if (conIndex.get_distance(v, w) != g.get_distance(v, w, true)) {
+                cout << "Mismatch " << v << " -> " << w << ": index " << conIndex.get_distance(v, w)
+                     << ", Dijkstra " << g.get_distance(v, w, true) << endl;
+                mismatches++;
+            }
+    cout << (mismatches == 0 ? "PASSED" : "FAILED") << ": " << mismatches << " mismatches after mixed batch" << endl;
+    return mismatches == 0;
+}
+
+#ifdef MULTI_THREAD_UPDATES
+// Checks parallel label repair (DhlDec_Par/DhlInc_Par) on a batch of the size update_edges hands to it,
+// against sequential repair (DhlDec/DhlInc) of a second index and against Dijkstra
+bool testParallelMixedBatch() {
+    cout << "\n=== Testing Parallel Repair of Mixed Update Batch ===" << endl;
+    // 16x16 grid with random weights
+    const NodeID side = 16, nodeCount = side * side;
+    mt19937 rng(42);
+    uniform_int_distribution<distance_t> weights(10, 100);
+    Graph g(nodeCount);
+    vector<Edge> edges;
+    for (NodeID r = 0; r < side; r++)
+        for (NodeID c = 0; c < side; c++) {
+            NodeID v = r * side + c + 1;
+            if (c + 1 < side)
+                edges.push_back(Edge(v, v + 1, weights(rng)));
+            if (r + 1 < side)
+                edges.push_back(Edge(v, v + side, weights(rng)));
+        }
+    for (const Edge &e : edges)
+        g.add_edge(e.a, e.b, e.d, true);
+    // one index per repair variant
+    ContractionHierarchy parCH, seqCH;
+    auto buildIndex = [&g](ContractionHierarchy &ch) {
+        vector<Neighbor> closest;
+        g.contract(closest);
+        vector<CutIndex> ci;
+        // sizes the shared task pool, so repair runs on several threads even on single-core machines
+        g.create_cut_index(ci, 0.2, 4);
+        g.reset();
+        g.create_contraction_hierarchy(ch, ci, closest);
+        return make_unique<ContractionIndex>(ci, closest);
+    };
+    unique_ptr<ContractionIndex> parIndex = buildIndex(parCH), seqIndex = buildIndex(seqCH);
+
+    // decreases and increases on distinct edges, each at least the parallel threshold
+    const size_t perDirection = MULTI_THREAD_UPDATES + 16;
+    shuffle(edges.begin(), edges.end(), rng);
+    vector<pair<pair<distance_t, distance_t>, pair<NodeID, NodeID>>> decreases, increases;
+    for (size_t i = 0; i < 2 * perDirection; i++) {
+        const Edge &e = edges[i];
+        distance_t newWeight = i < perDirection ? max<distance_t>(1, e.d / 3) : e.d * 3;
+        g.update_edge(e.a, e.b, newWeight);
+        g.update_edge(e.b, e.a, newWeight);
+        (i < perDirection ? decreases : increases).push_back({{e.d, newWeight}, {e.a, e.b}});
+    }
+    // decreases go first, as in update_edges
+    g.DhlDec_Par(parCH, *parIndex, decreases);
+    g.DhlInc_Par(parCH, *parIndex, increases);
+    g.DhlDec(seqCH, *seqIndex, decreases);
+    g.DhlInc(seqCH, *seqIndex, increases);
+
+    size_t mismatches = 0, checked = 0;
+    for (NodeID v = 1; v <= nodeCount; v += 3)
+        for (NodeID w = 1; w <= nodeCount; w += 5) {
+            checked++;
+            distance_t par = parIndex->get_distance(v, w), seq = seqIndex->get_distance(v, w);
+            distance_t dijkstra = g.get_distance(v, w, true);
+            if (par != seq || par != dijkstra) {
+                if (mismatches < 5)
+                    cout << "Mismatch " << v << " -> " << w << ": parallel " << par << ", sequential " << seq
+                         << ", Dijkstra " << dijkstra << endl;
+                mismatches++;
+            }
+        }
+    cout << (mismatches == 0 ? "PASSED" : "FAILED") << ": " << mismatches << " mismatches in " << checked
+         << " queries after " << decreases.size() << " decreases and " << increases.size() << " increases" << endl;
+    return mismatches == 0;
+}
+#endif
+
+// side x side grid with pseudo-random weights, seeded by side so repeated builds are identical
+static void makeWeightedGrid(Graph &g, NodeID side) {
+    g.resize(side * side);
+    mt19937 rng(side);
+    for (NodeID r = 0; r < side; r++)
+        for (NodeID c = 0; c < side; c++) {
+            NodeID v = r * side + c + 1;
+            if (c + 1 < side)
+                g.add_edge(v, v + 1, 50 + rng() % 100, true);
+            if (r + 1 < side)
+                g.add_edge(v, v + side, 50 + rng() % 100, true);
+        }
+}
+
+// builds labels single-threaded on a fresh grid from a fixed seed, so runs differ only in the given options;
+// cuts come from create_cut_index, distances from the contraction hierarchy
+static void buildGridLabels(NodeID side, FlowEngine engine, const NodeAttributes *attributes, vector<CutIndex> &ci, vector<Neighbor> &closest) {
+    Graph g;
+    makeWeightedGrid(g, side);
+    g.contract(closest);
+    Graph::set_flow_engine(engine);
+    srand(1);
+    g.create_cut_index(ci, 0.2, 1, attributes);
+    Graph::set_flow_engine(FlowEngine::dinitz);
+    g.reset();
+    ContractionHierarchy ch;
+    g.create_contraction_hierarchy(ch, ci, closest);
+}
+
+// counts random pairs whose index distance differs from Dijkstra on the same grid
+static size_t gridDistanceMismatches(NodeID side, const ContractionIndex &conIndex) {
+    Graph g;
+    makeWeightedGrid(g, side);
+    mt19937 pairs(7);
+    size_t mismatches = 0;
+    for (int i = 0; i < 200; i++) {
+        NodeID v = 1 + pairs() % (side * side), w = 1 + pairs() % (side * side);
+        if (conIndex.get_distance(v, w) != g.get_distance(v, w, true))
+            mismatches++;
+    }
+    return mismatches;
+}
+
+// Checks that the push-relabel engine finds the same cuts as Dinitz, giving identical labels
+bool testPushRelabelMatchesDinitz() {
+    cout << "\n=== Testing Push-Relabel Flow Engine ===" << endl;
+    const NodeID side = 40;
+    vector<CutIndex> dinitzCI, pushRelabelCI;
+    vector<Neighbor> closest;
+    buildGridLabels(side, FlowEngine::dinitz, nullptr, dinitzCI, closest);
+    buildGridLabels(side, FlowEngine::push_relabel, nullptr, pushRelabelCI, closest);
+    size_t differing = 0;
+    for (NodeID v = 1; v <= side * side; v++)
+        if (dinitzCI[v].partition != pushRelabelCI[v].partition || dinitzCI[v].dist_index != pushRelabelCI[v].dist_index
+            || dinitzCI[v].distances != pushRelabelCI[v].distances)
+            differing++;
+    bool passed = dinitzCI.size() == pushRelabelCI.size() && differing == 0;
+    cout << (passed ? "PASSED" : "FAILED") << ": " << differing << " nodes with differing labels" << endl;
+    return passed;
+}
+
+// Checks that inertial-flow partitions from grid coordinates give smaller cuts and exact distances
+bool testInertialFlowPartition() {
+    cout << "\n=== Testing Inertial Flow Partitioning ===" << endl;
+    const NodeID side = 60;
+    // grid laid out in 100m steps
+    NodeAttributes coordinates;
+    coordinates.latitudes.assign(side * side + 1, NAN);
+    coordinates.longitudes.assign(side * side + 1, NAN);
+    for (NodeID r = 0; r < side; r++)
+        for (NodeID c = 0; c < side; c++) {
+            coordinates.latitudes[r * side + c + 1] = 14.6 + r * 1e-3;
+            coordinates.longitudes[r * side + c + 1] = 121.0 + c * 1e-3;
+        }
+    vector<CutIndex> roughCI, inertialCI;
+    vector<Neighbor> roughClosest, inertialClosest;
+    buildGridLabels(side, FlowEngine::dinitz, nullptr, roughCI, roughClosest);
+    buildGridLabels(side, FlowEngine::dinitz, &coordinates, inertialCI, inertialClosest);
+    ContractionIndex roughIndex(roughCI, roughClosest), inertialIndex(inertialCI, inertialClosest);
+    double roughCutSize = roughIndex.avg_cut_size(), inertialCutSize = inertialIndex.avg_cut_size();
+    size_t mismatches = gridDistanceMismatches(side, inertialIndex);
+    bool passed = inertialCutSize < roughCutSize && mismatches == 0;
+    cout << (passed ? "PASSED" : "FAILED") << ": avg cut size " << inertialCutSize << " (inertial flow) vs "
+         << roughCutSize << " (rough partition), " << mismatches << " mismatches" << endl;
+    return passed;
+}
+
+// Checks road class parsing and that cuts preferring arterial roads keep distances exact
+bool testRoadClassCuts() {
+    cout << "\n=== Testing Road Class Cut Priors ===" << endl;
+    bool ranks = road_class_rank("motorway") == 7 && road_class_rank("primary_link") == 5
+        && road_class_rank("['unclassified', 'tertiary']") == 3 && road_class_rank("busway") == 0;
+
+    const string path = "test_road_classes.csv";
+    ofstream(path) << "source,target,length,name,highway\n"
+                   << "1,2,22.66,\"Avenue, North\",secondary\n"
+                   << "2,3,19.49,,\"['unclassified', 'residential']\"\n";
+    // road classes are sized for the global graph
+    Graph roads(3);
+    NodeAttributes parsed;
+    bool read = read_road_classes(path, parsed) == 2 && parsed.road_classes == vector<uint8_t>{ 0, 4, 4, 2 };
+    remove(path.c_str());
+
+    // every tenth row and column is a primary road
+    const NodeID side = 40;
+    NodeAttributes attributes;
+    attributes.road_classes.assign(side * side + 1, 2);
+    for (NodeID r = 0; r < side; r++)
+        for (NodeID c = 0; c < side; c++)
+            if (r % 10 == 5 || c % 10 == 5)
+                attributes.road_classes[r * side + c + 1] = 5;
+    vector<CutIndex> ci;
+    vector<Neighbor> closest;
+    buildGridLabels(side, FlowEngine::dinitz, &attributes, ci, closest);
+    size_t mismatches = gridDistanceMismatches(side, ContractionIndex(ci, closest));
+    bool passed = ranks && read && mismatches == 0;
+    cout << (passed ? "PASSED" : "FAILED") << ": ranks " << (ranks ? "ok" : "wrong") << ", road classes "
+         << (read ? "read" : "misread") << ", " << mismatches << " mismatches with arterial cuts" << endl;
+    return passed;
+}
+
+// Checks that positions near a disrupted segment snap onto open segments instead of travelling along it
+bool testSnapAvoidsDisruptedSegment() {
+    cout << "\n=== Testing Segment Snapping Around Disrupted Edge ===" << endl;
+    // ladder with rows 1-2-3 and 4-5-6, about 111m between neighboring nodes
+    const string graphPath = "test_segment_graph.txt", nodesPath = "test_segment_nodes.csv";
+    {
+        ofstream graphFile(graphPath);
+        graphFile << "p sp 6 7" << endl;
+        for (auto [a, b] : vector<pair<int, int>>{ {1, 2}, {2, 3}, {4, 5}, {5, 6}, {1, 4}, {2, 5}, {3, 6} })
+            graphFile << "a " << a << " " << b << " 100" << endl;
+        ofstream nodesFile(nodesPath);
+        nodesFile << "node_id,latitude,longitude" << endl;
+        for (int i = 0; i < 6; i++)
+            nodesFile << i + 1 << "," << (i < 3 ? 0.0 : -0.001) << "," << (i % 3) * 0.001 << endl;
+    }
+    DHLRoutingService service;
+    if (!service.initialize(graphPath, nodesPath)) {
+        cout << "FAILED: could not initialize routing service" << endl;
+        return false;
+    }
+    service.addDisruptedEdge(1, 2);
+
+    // both positions lie on segment 1-2; without disruptions the route runs along it directly
+    DHLRoutingResult base = service.findRoute(0.00001, 0.0003, 0.00001, 0.0007, false, 1000.0, true);
+    DHLRoutingResult disrupted = service.findRoute(0.00001, 0.0003, 0.00001, 0.0007, true, 1000.0, true);
+    bool usesClosedEdge = false;
+    for (size_t i = 0; i + 1 < disrupted.path.size(); i++)
+        if (min(disrupted.path[i], disrupted.path[i + 1]) == 1 && max(disrupted.path[i], disrupted.path[i + 1]) == 2)
+            usesClosedEdge = true;
+    // the direct sub-route passes no node, and the detour keeps the graph search path between the chosen endpoints
+    bool direct = base.path.empty() && base.hoplinks_examined == 0;
+    bool detourPath = !disrupted.path.empty() && disrupted.path.front() == disrupted.start_node
+                      && disrupted.path.back() == disrupted.dest_node && disrupted.hoplinks_examined == 0;
+    // detour 1-4-5-2 plus partial rungs
+    bool passed = base.success && base.total_distance == 40 && direct && disrupted.success && !usesClosedEdge && detourPath
+                  && disrupted.total_distance >= 300 && disrupted.total_distance < infinity;
+    cout << (passed ? "PASSED" : "FAILED") << ": base route " << base.total_distance << ", disrupted route "
+         << disrupted.total_distance << " via " << disrupted.complete_route_trace << endl;
+    return passed;
+}
+
 int main() {
     cout << "DHL (Dual-Hierarchy Labelling) Test Program" << endl;
     cout << "===========================================" << endl;
@@ -334,7 +608,15 @@ int main() {
     cout << "This program tests the DHL implementation with the Quezon City dataset." << endl;
     cout << "The DHL technique provides fast shortest-path queries with support for dynamic updates." << endl;
     
+    bool passed = testContractedMixedBatch();
+    passed = testPushRelabelMatchesDinitz() && passed;
+    passed = testInertialFlowPartition() && passed;
+    passed = testRoadClassCuts() && passed;
+#ifdef MULTI_THREAD_UPDATES
+    passed = testParallelMixedBatch() && passed;
+#endif
+    passed = testSnapAvoidsDisruptedSegment() && passed;
     testDHLFunctionality();
     
-    return 0;
+    return passed ? 0 : 1;
 }
\ No newline at end of file
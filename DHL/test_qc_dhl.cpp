@@ -175,15 +175,8 @@ void testDHLWithQCData() {
         
         // Step 2: Load the graph
         cout << "\nLoading Quezon City graph from: " << graphPath << endl;
-        ifstream graphFile(graphPath);
-        if (!graphFile.is_open()) {
-            cerr << "Error: Cannot open graph file" << endl;
-            return;
-        }
-        
         Graph g;
-        read_graph(g, graphFile);
-        graphFile.close();
+        read_graph(g, graphPath);
         
         cout << "Quezon City graph loaded successfully!" << endl;
         cout << "Network Statistics:" << endl;
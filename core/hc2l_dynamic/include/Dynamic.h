@@ -6,6 +6,10 @@
 #include <utility>
 #include <functional>
 #include <chrono>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <thread>
 #include "road_network.h"
 #include "coordinate_mapper.h"
 
@@ -37,11 +41,17 @@ struct RouteInfo {
 class Dynamic {
 public:
     explicit Dynamic(road_network::Graph &baseGraph);
+    // Waits for a running background label refresh
+    ~Dynamic();
 
     // Initialize coordinate mapping system
     bool initializeCoordinateMapping(const std::string& nodes_csv_file, const std::string& scenario_csv_file);
 
     void loadDisruptions(const std::string &filename);
+    // Attach HC2L index built on the base graph; used for distances and label-based path unpacking
+    void setIndex(const road_network::ContractionIndex *contraction_index);
+    // Build labels on the base graph that can be repaired incrementally after disruptions (via contraction hierarchy)
+    void buildRepairableIndex(double balance = 0.5);
     void setMode(Mode mode);
     Mode getMode() const;
 
@@ -90,7 +100,9 @@ public:
 
 private:
     road_network::Graph &graph;
-    Mode currentMode;
+    const road_network::ContractionIndex *index;
+    // Read by lock-free queries while disruptions switch modes
+    std::atomic<Mode> currentMode;
     
     // Coordinate mapping system
     CoordinateMapper coordinate_mapper;
@@ -100,11 +112,40 @@ private:
     std::unordered_map<EdgeID, double, EdgeIDHasher> disruptedSlowdownFactorByEdge;
     std::unordered_map<EdgeID, std::string, EdgeIDHasher> disruptionSeverityByEdge;
     std::unordered_map<EdgeID, std::string, EdgeIDHasher> disruptionTypeByEdge;
+    // weight overlays built from the disruption sets above: all disruptions, and closures plus critical slowdowns only
+    road_network::WeightOverlay disruptionOverlay;
+    road_network::WeightOverlay criticalDisruptionOverlay;
+
+    // Repairable labels with the disruptionOverlay version they match, and the edge weights they describe
+    // so paths can be unpacked from them while the graph switches overlays
+    struct LabelSnapshot {
+        std::unique_ptr<road_network::ContractionIndex> index;
+        std::shared_ptr<const road_network::WeightTable> weights;
+        uint64_t version = 0;
+    };
+    // Published repairable labels; queries load them once without locking and take distance and path from
+    // the same snapshot, which is freed once the last reader drops it. Repairs work on a copy and swap it in
+    std::atomic<std::shared_ptr<LabelSnapshot>> labelSnapshot;
+    // Unrepaired labels on base weights from buildRepairableIndex, answering base mode queries; dropped when
+    // setIndex attaches other labels
+    std::atomic<std::shared_ptr<LabelSnapshot>> baseSnapshot;
+    // Hierarchy used to update labels; repairedWeights holds edge weights the published labels reflect where
+    // they differ from baseWeights
+    road_network::ContractionHierarchy repairHierarchy;
+    std::unordered_map<EdgeID, road_network::distance_t, EdgeIDHasher> repairedWeights;
+    std::shared_ptr<const road_network::WeightTable> baseWeights;
+    // Guards label repair state above and serializes repairs; taken before graph_mutex
+    std::mutex repair_mutex;
+    // Guards the graph (weights, overlays, search state) and disruption sets
+    mutable std::recursive_mutex graph_mutex;
+    // Guards refresh_requested and starting the refresh thread
+    std::mutex refresh_mutex;
+    bool refresh_requested;
+    std::thread refresh_thread;
     
     // NEW: Label staleness tracking for Lazy/Immediate modes
     std::unordered_set<road_network::NodeID> stale_nodes;
-    std::unordered_map<std::pair<road_network::NodeID, road_network::NodeID>, bool, EdgeIDHasher> precomputed_labels;
-    bool background_update_active;
+    std::atomic<bool> background_update_active;
     std::chrono::steady_clock::time_point last_update_time;
 
     // Helper method to check if a node is accessible (not completely isolated by disruptions)
@@ -113,6 +154,17 @@ private:
     // Find nearest node that is not completely cut off by disruptions
     road_network::NodeID findNearestAvailableNode(double lat, double lng, double& distance);
     
+    // Route endpoints for GPS positions snapped onto road segments: the route leaves and enters the snapped
+    // segments through the endpoints minimizing current distance plus partial edge weights
+    struct SegmentEndpoints {
+        road_network::NodeID start_node = 0, end_node = 0;
+        double start_distance = 0.0, end_distance = 0.0; // meters from GPS positions to their segments
+        road_network::distance_t distance = road_network::infinity; // including partial edge weights
+        bool direct = false; // both positions on the same segment, travelling along it
+    };
+    bool findSegmentEndpoints(const std::shared_ptr<LabelSnapshot> &labels, Mode mode, double start_lat, double start_lng,
+                              double end_lat, double end_lng, bool weighted, SegmentEndpoints& endpoints);
+    
     // Check if a specific edge is disrupted
     bool isEdgeDisrupted(road_network::NodeID u, road_network::NodeID v) const;
     
@@ -120,6 +172,29 @@ private:
     bool isRouteHeavilyDisrupted(road_network::NodeID start, road_network::NodeID end) const;
 
     static EdgeID makeEdgeId(road_network::NodeID a, road_network::NodeID b);
+
+    // Rebuild disruption overlays after the disruption sets changed
+    void rebuildDisruptionOverlays();
+    // Update labels matching repairedWeights to the weights of overlay, touching only label entries of affected
+    // ancestors and descendants; caller holds repair_mutex, the global graph is not touched
+    void repairLabels(LabelSnapshot &snapshot, const road_network::WeightOverlay &overlay);
+    // Repair a copy of the published labels to current disruptions and swap it in; caller must not hold graph_mutex
+    void publishRepairedLabels();
+    // Whether snapshot exists and matches current disruptions
+    bool labelsFresh(const std::shared_ptr<LabelSnapshot> &snapshot) const;
+    // Background worker: refreshes labels until no further refresh was requested
+    void refreshLabels();
+
+    // Labels answering a query in given mode (repaired first in lazy mode), or nullptr if the graph must be searched
+    std::shared_ptr<LabelSnapshot> queryLabels(Mode mode, bool weighted);
+    // Distance and path from labels if given, otherwise by searching the graph under graph_mutex
+    road_network::distance_t queryDistance(const std::shared_ptr<LabelSnapshot> &labels, Mode mode, road_network::NodeID v, road_network::NodeID w, bool weighted);
+    std::pair<road_network::distance_t, std::vector<road_network::NodeID>> queryPath(const std::shared_ptr<LabelSnapshot> &labels, Mode mode,
+                                                                                     road_network::NodeID source, road_network::NodeID target, bool weighted);
+    // Check if path is affected by disruptions
+    bool isPathAffectedByDisruptions(road_network::NodeID source, road_network::NodeID target);
+    // Rebuild HC2L labels with current disruptions (for immediate mode)
+    void rebuildLabelsWithDisruptions();
 };
 
 } // namespace hc2l_dynamic
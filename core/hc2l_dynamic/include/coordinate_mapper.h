@@ -1,6 +1,7 @@
 #pragma once
 
 #include <vector>
+#include <functional>
 #include <string>
 #include <unordered_map>
 #include "road_network.h"
@@ -40,9 +41,87 @@ struct PairHasher {
     }
 };
 
+// GPS position snapped onto a road segment
+struct SegmentSnap {
+    road_network::NodeID source_id = 0;
+    road_network::NodeID target_id = 0;
+    double fraction = 0.0;   // position along the segment, from 0 at source to 1 at target
+    double distance_m = 0.0; // distance from the GPS position to the snapped position
+    double latitude = 0.0, longitude = 0.0; // snapped position
+};
+
+// Uniform cell layout over a lat/lng bounding box, with cells square in an equirectangular projection.
+// Items of cell c are stored at [cell_start[c], cell_start[c + 1]) of the owning grid's packed array.
+class GridLayout {
+protected:
+    std::vector<uint32_t> cell_start;
+    size_t columns = 0, rows = 0;
+    double min_x = 0, min_y = 0, cell_size = 1;
+    double lng_scale = 1; // cosine of highest latitude, so projected x distances never exceed true distances
+    
+    // size cells to hold about two of item_count items each
+    void init(double min_lat, double max_lat, double min_lng, double max_lng, size_t item_count);
+    void project(double latitude, double longitude, double& x, double& y) const;
+    size_t column_of(double x) const;
+    size_t row_of(double y) const;
+    // lower bound in meters on the distance to items outside the cells within ring r of cell (column, row)
+    double ring_bound(double latitude, double x, double y, size_t column, size_t row, size_t r) const;
+    // visit cells at Chebyshev distance exactly r from cell (column, row)
+    template<typename F> void visit_ring(size_t column, size_t row, size_t r, F&& visit_cell) const;
+};
+
+// Packed grid over node coordinates for nearest-node queries, built at load time; queries
+// scan rings of cells around the query point until no closer node can exist.
+class SpatialGrid : private GridLayout {
+public:
+    void build(const std::vector<NodeCoordinate>& nodes);
+    bool empty() const { return points.empty(); }
+    
+    // Nearest node and its distance in meters, or 0 if the grid is empty
+    road_network::NodeID nearest(double latitude, double longitude, double& distance_m) const;
+    
+    // Up to k nearest nodes with distances in meters, closest first
+    std::vector<std::pair<road_network::NodeID, double>> k_nearest(double latitude, double longitude, size_t k) const;
+    
+    // All nodes within radius_m meters, closest first
+    std::vector<std::pair<road_network::NodeID, double>> within_radius(double latitude, double longitude, double radius_m) const;
+
+private:
+    // node position as unit vector; chord length orders nodes exactly like great-circle distance
+    struct GridPoint {
+        double x, y, z;
+        road_network::NodeID node_id;
+    };
+    
+    std::vector<GridPoint> points;
+};
+
+// Packed grid over road segments for snapping GPS positions onto roads; each segment is
+// listed in every cell its bounding box overlaps.
+class SegmentGrid : private GridLayout {
+public:
+    // segments are (source, target) pairs with coordinates of both endpoints
+    void build(const std::vector<std::pair<NodeCoordinate, NodeCoordinate>>& segments);
+    bool empty() const { return segments.empty(); }
+    size_t size() const { return segments.size(); }
+    
+    // Snap position onto the nearest segment (source, target) accepted by accept, if set; returns false if there is none
+    bool nearest(double latitude, double longitude, SegmentSnap& snap,
+                 const std::function<bool(road_network::NodeID, road_network::NodeID)>& accept = nullptr) const;
+
+private:
+    struct GridSegment {
+        double source_lat, source_lng, target_lat, target_lng;
+        road_network::NodeID source_id, target_id;
+    };
+    
+    std::vector<GridSegment> segments;
+    std::vector<uint32_t> cell_segments; // segment indices, grouped by cell
+};
+
 class CoordinateMapper {
 public:
-    // Load node coordinates from CSV file
+    // Load node coordinates from CSV file or binary graph snapshot (see graph_convert)
     bool loadNodeCoordinates(const std::string& nodes_csv_file);
     
     // Load road segments with coordinates from scenario CSV
@@ -51,9 +130,30 @@ public:
     // Find the nearest node to given GPS coordinates
     road_network::NodeID findNearestNode(double latitude, double longitude, double& distance_m) const;
     
+    // Find the k nearest nodes to given GPS coordinates, closest first, with distances in meters
+    std::vector<std::pair<road_network::NodeID, double>> findKNearestNodes(double latitude, double longitude, size_t k) const;
+    
+    // Find all nodes within radius_m meters of given GPS coordinates, closest first
+    std::vector<std::pair<road_network::NodeID, double>> findNodesWithinRadius(double latitude, double longitude, double radius_m) const;
+    
+    // Snap a batch of (latitude, longitude) points to their nearest nodes, with distances in meters
+    std::vector<road_network::NodeID> findNearestNodes(const std::vector<std::pair<double, double>>& points, std::vector<double>& distances_m) const;
+    
+    // Index road segments for snapToSegment; edges are (source, target) node pairs, those without
+    // coordinates for both endpoints are skipped. Returns the number of indexed segments.
+    size_t buildSegmentIndex(const std::vector<std::pair<road_network::NodeID, road_network::NodeID>>& edges);
+    bool hasSegmentIndex() const { return !segment_grid.empty(); }
+    
+    // Snap GPS coordinates onto the nearest indexed road segment accepted by accept, if set; returns false if there is none
+    bool snapToSegment(double latitude, double longitude, SegmentSnap& snap,
+                       const std::function<bool(road_network::NodeID, road_network::NodeID)>& accept = nullptr) const;
+    
     // Get coordinates for a specific node
     bool getNodeCoordinates(road_network::NodeID node_id, double& latitude, double& longitude) const;
     
+    // Get OSM id of a node, or 0 if unknown (only available when loaded from a graph snapshot)
+    uint64_t getOsmId(road_network::NodeID node_id) const;
+    
     // Get road name for an edge between two nodes
     std::string getRoadName(road_network::NodeID source, road_network::NodeID target) const;
     
@@ -74,7 +174,12 @@ private:
     std::vector<NodeCoordinate> node_coordinates;
     std::vector<RoadSegment> road_segments;
     std::unordered_map<road_network::NodeID, size_t> node_index_map;
+    std::vector<uint64_t> osm_ids;
+    SpatialGrid node_grid;
+    SegmentGrid segment_grid;
     std::unordered_map<std::pair<road_network::NodeID, road_network::NodeID>, size_t, PairHasher> segment_map;
+    
+    bool loadNodeSnapshot(const std::string& snapshot_file);
 };
 
 } // namespace hc2l_dynamic
\ No newline at end of file
@@ -22,6 +22,10 @@
 #include <cstdint>
 #include <climits>
 #include <vector>
+#include <string>
+#include <span>
+#include <functional>
+#include <memory>
 #include <ostream>
 #include <cassert>
 #include <limits>
@@ -37,6 +41,7 @@ const distance_t infinity = UINT32_MAX >> 1;
 
 struct Neighbor;
 class Graph;
+struct NodeAttributes;
 extern double DISRUPTION_THRESHOLD_TAU;
 
 //--------------------------- CutIndex ------------------------------
@@ -147,18 +152,30 @@ std::ostream& operator<<(std::ostream& os, const ContractionLabel &ci);
     class ContractionIndex
     {
         std::vector<ContractionLabel> labels;
+        // label data of owning nodes, shared between copies of the index until written through get_writable_cut_index
+        std::vector<std::shared_ptr<char>> blocks;
+        // contracted nodes using the labels of each owning node, so copied label data can be re-pointed; built on first use
+        std::shared_ptr<const std::vector<std::vector<NodeID>>> contracted_nodes;
+        // labels were computed by create_contraction_hierarchy (distances via upward hierarchy, as for DHL),
+        // so queries must scan all common ancestors rather than the lowest common cut only
+        bool hierarchy_labels;
 
         static distance_t get_cut_level_distance(FlatCutIndex a, FlatCutIndex b, size_t cut_level);
         static distance_t get_distance(FlatCutIndex a, FlatCutIndex b);
+        static distance_t get_hierarchy_distance(FlatCutIndex a, FlatCutIndex b);
         static size_t get_cut_level_hoplinks(FlatCutIndex a, FlatCutIndex b, size_t cut_level);
         static size_t get_hoplinks(FlatCutIndex a, FlatCutIndex b);
     public:
-        // populate from ci and closest, draining ci in the process
-        ContractionIndex(std::vector<CutIndex> &ci, std::vector<Neighbor> &closest);
+        // populate from ci and closest, draining ci in the process; hierarchy_labels must be set if ci was passed through create_contraction_hierarchy
+        ContractionIndex(std::vector<CutIndex> &ci, std::vector<Neighbor> &closest, bool hierarchy_labels = false);
         // populate from binary source
         ContractionIndex(std::istream& is);
         // wrapper when not contracting
         explicit ContractionIndex(std::vector<CutIndex> &ci);
+        // copy sharing label data with the original; labels written through get_writable_cut_index get copied first,
+        // so they can be updated without affecting readers of the original
+        ContractionIndex(const ContractionIndex &other);
+        ContractionIndex& operator=(const ContractionIndex &other) = delete;
         ~ContractionIndex();
 
         // NEW METHOD
@@ -188,6 +205,13 @@ std::ostream& operator<<(std::ostream& os, const ContractionLabel &ci);
         size_t inf_label_count() const;
         size_t non_empty_cuts() const;
 
+        ContractionLabel get_contraction_label(NodeID v) const;
+        // view of labels used by v (owned by v or by the root v got contracted into)
+        FlatCutIndex get_cut_index(NodeID v) const;
+        // view of labels used by v whose distances may be modified, copying them first if shared with another index
+        FlatCutIndex get_writable_cut_index(NodeID v);
+        void update_distance_offset(NodeID n, distance_t d);
+
         std::pair<NodeID,NodeID> random_query() const;
         void write(std::ostream& os) const;
         void write_json(std::ostream& os) const;
@@ -196,6 +220,28 @@ std::ostream& operator<<(std::ostream& os, const ContractionLabel &ci);
     };
 
 
+//--------------------------- ContractionHierarchy ------------------
+
+struct CHNode
+{
+    uint16_t dist_index; // rank in hierarchy, equal to position of own label (65535 for contracted nodes)
+    std::vector<Neighbor> up_neighbors;
+    std::vector<NodeID> down_neighbors;
+};
+
+// contraction hierarchy induced by the cut index, used to repair labels after edge weight changes
+class ContractionHierarchy
+{
+public:
+    std::vector<CHNode> nodes;
+
+    ContractionHierarchy();
+    ContractionHierarchy(std::istream &is);
+    void write(std::ostream &os);
+    size_t edge_count() const;
+    size_t size() const;
+};
+
 //--------------------------- Graph ---------------------------------
 
 SubgraphID next_subgraph_id(bool reset = false);
@@ -219,7 +265,6 @@ struct Node
 private:
     // temporary data used by algorithms
     distance_t distance, outcopy_distance;
-    NodeID parent; // parent node for path reconstruction
 #ifdef MULTI_THREAD_DISTANCES
     distance_t distances[MULTI_THREAD_DISTANCES];
 #endif
@@ -281,6 +326,27 @@ struct Edge {
     }
 };
 
+// sparse set of edge weight changes, applied on top of base weights of the global graph;
+// edges are addressed by (node, neighbor slot), so an overlay is only valid while graph topology is unchanged
+struct WeightOverlay
+{
+    struct Change
+    {
+        NodeID node;
+        uint32_t slot; // index into node's neighbor list
+        distance_t weight;
+    };
+    std::vector<Change> changes;
+    uint64_t version = 0; // bumped on every modification, so an active overlay gets re-applied
+
+    void clear();
+    bool empty() const;
+};
+
+// copy of the neighbor lists (with weights) of all nodes in the global graph, indexed by node;
+// lets labels be repaired and unpacked while the global graph switches overlays
+typedef std::vector<std::vector<Neighbor>> WeightTable;
+
 // helper structure for pre-partitioning
 struct DiffData
 {
@@ -296,6 +362,9 @@ struct DiffData
     friend std::ostream& operator<<(std::ostream& os, const DiffData &dd);
 };
 
+// max-flow algorithm used to find minimum vertex cuts during partitioning
+enum class FlowEngine { dinitz, push_relabel };
+
 /**
  * full graph information (edges and weights) is only stored once, as static data; graph instances describe induced subgraphs, storing only a list of nodes;
  * this approach speeds up creation of subgraphs, and saves memory, but complicates usage;
@@ -317,6 +386,10 @@ class Graph
 #endif
     static NodeID s,t; // virtual nodes for max-flow
     static std::vector<NodeID> node_order; // for prescribing tree decomposition
+    // weight overlay currently applied to global graph, with base weights it replaced (in order of application)
+    static const WeightOverlay *overlay;
+    static uint64_t overlay_version;
+    static std::vector<WeightOverlay::Change> overlay_base;
     // subgraph info
     std::vector<NodeID> nodes;
     SubgraphID subgraph_id;
@@ -349,19 +422,16 @@ class Graph
 
     // run dijkstra from node v, storing distance results in node_data
     void run_dijkstra(NodeID v);
-    // run dijkstra with path reconstruction, storing distance and parent results in node_data
-    void run_dijkstra_with_parents(NodeID v);
-    // reconstruct path from source to target using parent pointers
-    std::vector<NodeID> reconstruct_path(NodeID source, NodeID target);
     // run dijkstra from node v, in subgraph excluding lower-level landmarks
     void run_dijkstra_llsub(NodeID v);
     // stores whether all shortest paths bypass other landmarks in lowest distance bit
     void run_dijkstra_ll(NodeID v);
+    // run dijkstra from a group of cut vertices starting at cut[first] in a single traversal, in subgraph excluding
+    // lower-level landmarks; distances go into the last cut.size() entries of each CutIndex, which must be reserved
+    void run_dijkstra_llsub_multi(const std::vector<NodeID> &cut, size_t first, std::vector<CutIndex> &ci);
 #ifdef MULTI_THREAD_DISTANCES
     // run dijkstra from multiple nodes in parallel
     void run_dijkstra_par(const std::vector<NodeID> &vertices);
-    // run dijkstra from multiple nodes in parallel, in subgraph excluding lower-level landmarks
-    void run_dijkstra_llsub_par(const std::vector<NodeID> &vertices);
     // stores whether all shortest paths bypass other landmarks in lowest distance bit
     void run_dijkstra_ll_par(const std::vector<NodeID> &vertices);
 #endif
@@ -386,6 +456,9 @@ class Graph
     void get_diff_data(std::vector<DiffData> &diff, NodeID a, NodeID b, bool weighted, bool pre_computed = false);
     // find one or more minimal s-t vertex cut sets
     void min_vertex_cuts(std::vector<std::vector<NodeID>> &cuts);
+    // same cuts as min_vertex_cuts, computed by push-relabel on a compact copy of the flow graph;
+    // during create_cut_index with road classes, picks the min cut through the most important roads
+    void min_vertex_cuts_push_relabel(std::vector<std::vector<NodeID>> &cuts);
     // find cut from given rough partition
     void rough_partition_to_cuts(std::vector<std::vector<NodeID>> &cuts, const Partition &p);
     // compute left/right partitions based on given cut
@@ -410,6 +483,8 @@ class Graph
 public:
     // turn progress tracking on/off
     static void show_progress(bool state);
+    // select max-flow algorithm used for partitioning
+    static void set_flow_engine(FlowEngine engine);
     // number of nodes in the top-level graph
     static size_t super_node_count();
 
@@ -420,6 +495,10 @@ public:
     void resize(size_t node_count);
     // insert edge from v to w into global graph, optionally merging with existing edge
     void add_edge(NodeID v, NodeID w, distance_t distance, bool add_reverse, bool merge = false);
+    // insert batch of undirected edges into global graph without edges, merging parallel edges
+    void add_edges(const std::vector<Edge> &edges);
+    // replace adjacency list of v in global graph; reverse arcs must be set separately
+    void set_neighbors(NodeID v, std::span<const Neighbor> neighbors);
     // remove edges between v and w from global graph
     void remove_edge(NodeID v, NodeID w);
     // remove isolated nodes from subgraph
@@ -439,20 +518,31 @@ public:
 
     // returns distance between u and v in subgraph
     distance_t get_distance(NodeID v, NodeID w, bool weighted);
-    // returns path between u and v in subgraph with complete node sequence
+    // returns shortest path between v and w in subgraph using bidirectional dijkstra, with per-thread workspaces;
+    // edges (x,y) for which edge_filter returns false are skipped; distance is infinity and path empty if unreachable
+    std::pair<distance_t, std::vector<NodeID>> get_shortest_path(NodeID v, NodeID w, const std::function<bool(NodeID,NodeID)> &edge_filter = nullptr) const;
+    // returns path between u and v in subgraph with complete node sequence (via get_shortest_path)
     std::pair<distance_t, std::vector<NodeID>> get_path_dijkstra(NodeID v, NodeID w, bool weighted);
+    // returns path between v and w, unpacked hop by hop from index distances; graph must hold the edges the index was built on
+    // (without shortcuts), otherwise the returned path is empty; weights are read from given table instead of global graph if set
+    std::pair<distance_t, std::vector<NodeID>> get_path_from_index(NodeID v, NodeID w, const ContractionIndex &ci, const WeightTable *weights = nullptr) const;
     // decompose graph into connected components
     void get_connected_components(std::vector<std::vector<NodeID>> &cc);
 
     // computed rough partition with wide separator, returned in p; returns if rough partition is already a partition
     
     bool get_rough_partition(Partition &p, double balance, bool disconnected);
+    // compute partition by projecting node coordinates onto several directions and separating extreme nodes (inertial flow);
+    // only available during create_cut_index with coordinates given, returns false if nodes lack coordinates
+    
+    bool get_inertial_partition(Partition &p, double balance);
     // partition graph into balanced subgraphs using minimal cut
     
     void create_partition(Partition &p, double balance);
-    // decompose graph and construct cut index; returns number of shortcuts used
+    // decompose graph and construct cut index using up to thread_count threads (0 = all cores); returns number of shortcuts used;
+    // if node attributes are given, partitions are found by inertial flow where coordinates allow, and cuts prefer arterial roads
     
-    size_t create_cut_index(std::vector<CutIndex> &ci, double balance);
+    size_t create_cut_index(std::vector<CutIndex> &ci, double balance, size_t thread_count = 0, const NodeAttributes *attributes = nullptr);
     // returns edges that don't affect distances between nodes
     void get_redundant_edges(std::vector<Edge> &edges);
     // repeatedly remove nodes of degree 1, populating closest[removed] with next node on path to closest unremoved node
@@ -467,7 +557,29 @@ public:
     // randomize order of nodes and neighbors
     void randomize();
 
-    void applyDisruption(NodeID u, NodeID v, double slowdown, bool closed);
+    // create contraction hierarchy based on index, replacing label distances with distances via upward hierarchy
+    void create_contraction_hierarchy(ContractionHierarchy &ch, std::vector<CutIndex> &ci, std::vector<Neighbor> &closest) const;
+    void create_contraction_hierarchy(ContractionHierarchy &ch, std::vector<CutIndex> &ci) const;
+    // update hierarchy and labels after edge weights decreased / increased; updates hold ((old weight, new weight), (v, w)),
+    // global graph (or weights table, if set) must already hold the new weights; contracted nodes are handled by contract_seq instead
+    Neighbor& UpNeighbor(ContractionHierarchy &ch, NodeID v, NodeID w);
+    void DecCH(ContractionHierarchy &ch, std::vector<std::pair<std::pair<distance_t, distance_t>, std::pair<NodeID, NodeID> > >& updates, std::vector<std::pair<distance_t, std::pair<NodeID, NodeID> > > &C);
+    void IncCH(ContractionHierarchy &ch, std::vector<std::pair<std::pair<distance_t, distance_t>, std::pair<NodeID, NodeID> > >& updates, std::vector<std::pair<distance_t, std::pair<NodeID, NodeID> > > &C, const WeightTable *weights = nullptr);
+    void DhlDec(ContractionHierarchy &ch, ContractionIndex &ci, std::vector<std::pair<std::pair<distance_t, distance_t>, std::pair<NodeID, NodeID> > >& updates);
+    void DhlInc(ContractionHierarchy &ch, ContractionIndex &ci, std::vector<std::pair<std::pair<distance_t, distance_t>, std::pair<NodeID, NodeID> > >& updates, const WeightTable *weights = nullptr);
+    // recompute distance offsets in contracted subtrees of given children (paired with their old offsets) from current graph weights (or weights table, if set)
+    void contract_seq(ContractionIndex &ci, std::vector<std::pair<distance_t, NodeID> >& contracted_updates, const WeightTable *weights = nullptr);
+    // weight of edge from v to w in global graph, or in weights table if set (infinity if there is none)
+    distance_t edge_weight(NodeID v, NodeID w, const WeightTable *weights = nullptr) const;
+    // copy current neighbor lists of all nodes, with the active overlay applied
+    void get_weights(WeightTable &weights) const;
+
+    // add change of edge weight between v and w (both directions) to overlay, computed from base weight; returns false if no such edge exists
+    bool set_overlay_weight(WeightOverlay &o, NodeID v, NodeID w, const std::function<distance_t(distance_t)> &reweight) const;
+    // apply overlay to global graph, reverting the previous one; nullptr restores base weights; cost is O(#changes), no-op if already active
+    static void activate_overlay(const WeightOverlay *o);
+    // overlay currently applied to global graph (nullptr if none)
+    static const WeightOverlay* active_overlay();
 
 
     friend std::ostream& operator<<(std::ostream& os, const Graph &g);
@@ -478,5 +590,27 @@ public:
 void print_graph(const Graph &g, std::ostream &os);
 // read graph in DIMACS format
 void read_graph(Graph &g, std::istream &in);
+// read graph in DIMACS format or binary snapshot from memory-mapped file, parsing DIMACS chunks in parallel;
+// throws if file cannot be read
+void read_graph(Graph &g, const std::string &filename);
+
+// per-node data, mostly stored in binary graph snapshots, indexed by node id (entry 0 unused); empty if not available
+struct NodeAttributes
+{
+    std::vector<double> latitudes, longitudes; // NaN for nodes without coordinates
+    std::vector<uint64_t> osm_ids; // 0 for nodes without OSM id
+    std::vector<uint8_t> road_classes; // highest road_class_rank of incident roads, 0 if unknown; not stored in snapshots
+};
+
+// rank of OpenStreetMap highway tag (or list of tags), from 7 for motorways down to 1 for service roads; 0 if unknown
+uint8_t road_class_rank(const std::string &highway);
+// read highest road_class_rank of incident edges from CSV with source, target and highway columns (e.g. quezon_city_edges.csv)
+// into attributes.road_classes, sized for the global graph; returns number of edges read, throws if file cannot be read
+size_t read_road_classes(const std::string &filename, NodeAttributes &attributes);
+
+// returns whether file is a binary graph snapshot (of any version)
+bool is_graph_snapshot(const std::string &filename);
+// read binary snapshot into g and attributes, either of which may be null; throws if file is invalid or of another version
+void read_graph_snapshot(const std::string &filename, Graph *g, NodeAttributes *attributes);
 
 } // road_network
\ No newline at end of file
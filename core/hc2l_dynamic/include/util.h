@@ -6,6 +6,12 @@
 #include <barrier>
 #include <cassert>
 #include <mutex>
+#include <deque>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <functional>
+#include <condition_variable>
 
 namespace util {
 
@@ -275,6 +281,57 @@ public:
     }
 };
 
+// persistent pool of worker threads for nested fork/join parallelism; spawned tasks go to the deque of the
+// spawning worker and idle workers steal from the front of other deques, while threads waiting on a group
+// run pending tasks themselves, so tasks may spawn and wait on groups of their own
+class TaskPool {
+public:
+    class TaskGroup;
+private:
+    struct Task
+    {
+        std::function<void()> run;
+        TaskGroup *group;
+    };
+    struct TaskQueue
+    {
+        std::mutex m_mutex;
+        std::deque<Task> tasks;
+    };
+    std::vector<std::unique_ptr<TaskQueue>> queues;
+    std::vector<std::thread> workers;
+    // number of tasks waiting in queues
+    std::atomic<size_t> queued;
+    bool stopping;
+    std::mutex m_mutex;
+    // signalled when tasks get queued or a group completes
+    std::condition_variable changed;
+
+    size_t current_worker() const;
+    void push(Task &&task);
+    bool next_task(size_t worker, Task &task);
+    void execute(Task &task);
+    void worker_loop(size_t worker);
+public:
+    // tasks spawned together and awaited as a unit
+    class TaskGroup {
+        friend TaskPool;
+        TaskPool &pool;
+        std::atomic<size_t> pending;
+    public:
+        explicit TaskGroup(TaskPool &pool);
+        // waits for tasks not yet completed
+        ~TaskGroup();
+        void spawn(std::function<void()> task);
+        // returns once all spawned tasks completed, running queued tasks meanwhile
+        void wait();
+    };
+    // threads outside the pool share deque 0 and only work while waiting, so thread_count - 1 threads are started
+    explicit TaskPool(size_t thread_count = std::max(1u, std::thread::hardware_concurrency()));
+    ~TaskPool();
+    size_t size() const;
+};
+
 } // util
 
 namespace std {
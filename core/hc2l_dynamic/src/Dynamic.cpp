@@ -25,9 +25,129 @@ static inline double clampSlowdown(double x) {
     return x;
 }
 
+// Travel time on an edge whose speed dropped to the given fraction of free flow
+static inline distance_t slowedWeight(distance_t base, double slowdown) {
+    double slowed = std::ceil(static_cast<double>(base) / slowdown);
+    return slowed >= static_cast<double>(infinity) ? infinity : static_cast<distance_t>(slowed);
+}
+
+// Slowdowns below this ratio are repaired even in lazy mode
+static const double CRITICAL_SLOWDOWN = 0.5;
+
 Dynamic::Dynamic(Graph &baseGraph)
-    : graph(baseGraph), currentMode(Mode::BASE), coordinate_mapping_initialized(false), 
-      background_update_active(false), last_update_time(std::chrono::steady_clock::now()) {}
+    : graph(baseGraph), index(nullptr), currentMode(Mode::BASE), coordinate_mapping_initialized(false), 
+      refresh_requested(false), background_update_active(false), last_update_time(std::chrono::steady_clock::now()) {}
+
+Dynamic::~Dynamic() {
+    if (refresh_thread.joinable()) {
+        refresh_thread.join();
+    }
+}
+
+void Dynamic::setIndex(const ContractionIndex *contraction_index) {
+    std::lock_guard<std::recursive_mutex> lock(graph_mutex);
+    index = contraction_index;
+    // Labels from elsewhere come without weights, so base queries unpack them against the graph instead
+    std::shared_ptr<LabelSnapshot> base = baseSnapshot.load();
+    if (base && base->index.get() != contraction_index) {
+        baseSnapshot.store(nullptr);
+    }
+}
+
+void Dynamic::buildRepairableIndex(double balance) {
+    std::lock_guard<std::mutex> repair_lock(repair_mutex);
+    std::lock_guard<std::recursive_mutex> lock(graph_mutex);
+    // Labels describe base weights, so disruptions are repaired in afterwards
+    graph.activate_overlay(nullptr);
+    auto weights = std::make_shared<WeightTable>();
+    graph.get_weights(*weights);
+    baseWeights = std::move(weights);
+    std::vector<Neighbor> closest;
+    graph.contract(closest);
+    std::vector<CutIndex> ci;
+    graph.create_cut_index(ci, balance);
+    graph.reset();
+    repairHierarchy = ContractionHierarchy();
+    graph.create_contraction_hierarchy(repairHierarchy, ci, closest);
+    auto snapshot = std::make_shared<LabelSnapshot>();
+    snapshot->index = std::make_unique<ContractionIndex>(ci, closest, true);
+    snapshot->weights = baseWeights;
+    // Published labels follow disruptions, so base mode keeps a copy of the unrepaired ones
+    auto base = std::make_shared<LabelSnapshot>();
+    base->index = std::make_unique<ContractionIndex>(*snapshot->index);
+    base->weights = baseWeights;
+    baseSnapshot.store(base);
+    setIndex(base->index.get());
+    repairedWeights.clear();
+    labelSnapshot.store(std::move(snapshot));
+}
+
+bool Dynamic::labelsFresh(const std::shared_ptr<LabelSnapshot> &snapshot) const {
+    std::lock_guard<std::recursive_mutex> lock(graph_mutex);
+    return snapshot && snapshot->version == disruptionOverlay.version;
+}
+
+void Dynamic::repairLabels(LabelSnapshot &snapshot, const WeightOverlay &overlay) {
+    if (snapshot.version == overlay.version) {
+        return;
+    }
+    ContractionIndex &labels = *snapshot.index;
+    // Current weights are base weights with the overlay applied, the same way activate_overlay does on the graph;
+    // edges whose weight may differ between labels and overlay are those repaired before and those it changes
+    auto weights = std::make_shared<WeightTable>(*baseWeights);
+    std::unordered_set<EdgeID, EdgeIDHasher> edges;
+    for (const auto& [edge, weight] : repairedWeights) {
+        edges.insert(edge);
+    }
+    for (const WeightOverlay::Change& c : overlay.changes) {
+        Neighbor &n = (*weights)[c.node][c.slot];
+        n.distance = c.weight;
+        edges.insert(makeEdgeId(c.node, n.node));
+    }
+    std::vector<std::pair<std::pair<distance_t, distance_t>, std::pair<NodeID, NodeID>>> decreases, increases;
+    std::vector<std::pair<distance_t, NodeID>> contractedUpdates;
+    for (const EdgeID& edge : edges) {
+        distance_t base = graph.edge_weight(edge.first, edge.second, baseWeights.get());
+        auto it = repairedWeights.find(edge);
+        distance_t oldWeight = it != repairedWeights.end() ? it->second : base;
+        distance_t newWeight = graph.edge_weight(edge.first, edge.second, weights.get());
+        if (newWeight == base) {
+            repairedWeights.erase(edge);
+        } else {
+            repairedWeights[edge] = newWeight;
+        }
+        if (newWeight == oldWeight) {
+            continue;
+        }
+        auto [a, b] = edge;
+        if (labels.is_contracted(a) || labels.is_contracted(b)) {
+            // Edges of contracted trees only shift distance offsets of the child's subtree
+            ContractionLabel la = labels.get_contraction_label(a), lb = labels.get_contraction_label(b);
+            if (la.parent == b) {
+                contractedUpdates.push_back({la.distance_offset, a});
+            } else if (lb.parent == a) {
+                contractedUpdates.push_back({lb.distance_offset, b});
+            }
+            continue;
+        }
+        (newWeight < oldWeight ? decreases : increases).push_back({{oldWeight, newWeight}, {a, b}});
+    }
+
+    // Decreases first, so increases are repaired against a hierarchy matching all other current weights
+    auto repair_start = std::chrono::steady_clock::now();
+    if (!decreases.empty()) {
+        graph.DhlDec(repairHierarchy, labels, decreases);
+    }
+    if (!increases.empty()) {
+        graph.DhlInc(repairHierarchy, labels, increases, weights.get());
+    }
+    graph.contract_seq(labels, contractedUpdates, weights.get());
+    snapshot.weights = std::move(weights);
+    snapshot.version = overlay.version;
+    auto repair_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - repair_start);
+    std::cout << "🔧 Repaired labels for " << decreases.size() + increases.size() + contractedUpdates.size()
+              << " changed edges in " << repair_us.count() << "us\n";
+}
 
 void Dynamic::setMode(Mode mode) {
     currentMode = mode;
@@ -41,10 +161,29 @@ EdgeID Dynamic::makeEdgeId(NodeID a, NodeID b) {
     return std::minmax(a, b);
 }
 
+void Dynamic::rebuildDisruptionOverlays() {
+    disruptionOverlay.clear();
+    criticalDisruptionOverlay.clear();
+    auto closed = [](distance_t) { return infinity; };
+    for (const auto& edge : disruptedClosedEdges) {
+        graph.set_overlay_weight(disruptionOverlay, edge.first, edge.second, closed);
+        graph.set_overlay_weight(criticalDisruptionOverlay, edge.first, edge.second, closed);
+    }
+    for (const auto& [edge, slowdown] : disruptedSlowdownFactorByEdge) {
+        if (disruptedClosedEdges.count(edge))
+            continue;
+        auto slowed = [slowdown](distance_t base) { return slowedWeight(base, slowdown); };
+        graph.set_overlay_weight(disruptionOverlay, edge.first, edge.second, slowed);
+        if (slowdown < CRITICAL_SLOWDOWN)
+            graph.set_overlay_weight(criticalDisruptionOverlay, edge.first, edge.second, slowed);
+    }
+}
+
 // User-submitted disruption injection
 void Dynamic::addUserDisruption(NodeID u, NodeID v,
                                 const std::string& incidentType,
                                 const std::string& severity) {
+    std::lock_guard<std::recursive_mutex> lock(graph_mutex);
     // Validate node IDs
     if (u == 0 || v == 0 || u >= graph.super_node_count() + 1 || v >= graph.super_node_count() + 1) {
         std::cerr << "Error: Invalid node IDs for user disruption (" << u << ", " << v << ")" << std::endl;
@@ -72,6 +211,7 @@ void Dynamic::addUserDisruption(NodeID u, NodeID v,
         is_closed = true;
         disruptedClosedEdges.insert(eid);
     }
+    rebuildDisruptionOverlays();
 
     // 🔥 NEW: Calculate Impact Score and determine update mode
     double jam_factor = 10.0 - (slowdown_factor * 10.0); // Estimate jam factor from slowdown
@@ -123,6 +263,7 @@ std::vector<std::string> parseCSVLine(const std::string& line) {
 }
 
 void Dynamic::loadDisruptions(const std::string& filename) {
+    std::lock_guard<std::recursive_mutex> lock(graph_mutex);
     disruptedClosedEdges.clear();
     disruptedSlowdownFactorByEdge.clear();
     disruptionSeverityByEdge.clear();
@@ -233,6 +374,7 @@ void Dynamic::loadDisruptions(const std::string& filename) {
     }
 
     infile.close();
+    rebuildDisruptionOverlays();
     
     // 🔥 NEW: Determine overall update mode based on network impact
     if (!disruptedClosedEdges.empty() || !disruptedSlowdownFactorByEdge.empty()) {
@@ -365,6 +507,10 @@ void Dynamic::markLabelsStale(const std::vector<NodeID>& affected_nodes) {
 }
 
 bool Dynamic::areLabelsStale(NodeID u, NodeID v) const {
+    std::lock_guard<std::recursive_mutex> lock(graph_mutex);
+    if (auto snapshot = labelSnapshot.load()) {
+        return !labelsFresh(snapshot);
+    }
     return stale_nodes.count(u) > 0 || stale_nodes.count(v) > 0 || is_dirty(u, v);
 }
 
@@ -374,64 +520,90 @@ void Dynamic::repairStaleLabels(NodeID u, NodeID v) {
     }
     
     std::cout << "🔧 Repairing stale labels for query (" << u << ", " << v << ")\n";
-    
-    // Apply all current disruptions to get fresh labels
-    for (const auto& edge : disruptedClosedEdges) {
-        graph.applyDisruption(edge.first, edge.second, 1.0, true);
-    }
-    for (const auto& [edge, slowdown] : disruptedSlowdownFactorByEdge) {
-        graph.applyDisruption(edge.first, edge.second, slowdown, false);
+    if (labelSnapshot.load() == nullptr) {
+        std::cout << "Warning: No repairable labels - call buildRepairableIndex first" << std::endl;
+        return;
     }
-    
-    // Cache the repaired result
-    std::pair<NodeID, NodeID> query_pair = {u, v};
-    precomputed_labels[query_pair] = true;
-    
-    // Remove from stale set if both nodes are now fresh
-    // In a full implementation, this would be more sophisticated
-    mark_dirty(u, v); // Clear the dirty flag after repair
+    // Repaired labels answer all queries, not just this one
+    publishRepairedLabels();
 }
 
 void Dynamic::precomputeAffectedLabels() {
-    if (background_update_active) {
-        std::cout << "⚠️  Background update already in progress\n";
-        return;
-    }
-    
-    background_update_active = true;
-    std::cout << "🔄 Starting background label precomputation (IMMEDIATE UPDATE MODE)\n";
+    std::cout << "🔄 Starting label precomputation (IMMEDIATE UPDATE MODE)\n";
     
     // In IMMEDIATE mode, proactively update all affected labels
     auto start_time = std::chrono::steady_clock::now();
     
-    // Apply all disruptions immediately
-    for (const auto& edge : disruptedClosedEdges) {
-        graph.applyDisruption(edge.first, edge.second, 1.0, true);
-    }
-    for (const auto& [edge, slowdown] : disruptedSlowdownFactorByEdge) {
-        graph.applyDisruption(edge.first, edge.second, slowdown, false);
-    }
-    
-    // Clear stale nodes since we've precomputed everything
-    stale_nodes.clear();
-    clear_dirty();
+    publishRepairedLabels();
     
     auto end_time = std::chrono::steady_clock::now();
     auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
     
-    std::cout << "✅ Background precomputation completed in " << duration.count() << "ms\n";
+    std::cout << "✅ Label precomputation completed in " << duration.count() << "ms\n";
     std::cout << "🚀 All affected labels are now fresh and ready for queries\n";
+}
+
+void Dynamic::publishRepairedLabels() {
+    std::lock_guard<std::mutex> repair_lock(repair_mutex);
+    std::shared_ptr<LabelSnapshot> current;
+    WeightOverlay overlay;
+    {
+        // Only reading disruptions needs the graph lock; the repair itself runs on private copies
+        std::lock_guard<std::recursive_mutex> lock(graph_mutex);
+        current = labelSnapshot.load();
+        overlay = disruptionOverlay;
+    }
+    if (current && current->version != overlay.version) {
+        // Readers may still hold the current snapshot, so repair a copy; it shares label data and only copies the labels it changes
+        auto next = std::make_shared<LabelSnapshot>();
+        next->index = std::make_unique<ContractionIndex>(*current->index);
+        next->weights = current->weights;
+        next->version = current->version;
+        repairLabels(*next, overlay);
+        labelSnapshot.store(std::move(next));
+    }
     
-    background_update_active = false;
+    std::lock_guard<std::recursive_mutex> lock(graph_mutex);
+    // Disruptions added during the repair keep their labels marked stale
+    if (overlay.version == disruptionOverlay.version) {
+        stale_nodes.clear();
+        clear_dirty();
+    }
     last_update_time = std::chrono::steady_clock::now();
 }
 
-void Dynamic::triggerBackgroundLabelUpdate() {
-    if (currentMode == Mode::IMMEDIATE_UPDATE) {
+void Dynamic::refreshLabels() {
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(refresh_mutex);
+            if (!refresh_requested) {
+                background_update_active = false;
+                return;
+            }
+            refresh_requested = false;
+        }
+        // Disruptions added meanwhile request another pass, so a batch is covered by a single refresh
         precomputeAffectedLabels();
     }
 }
 
+void Dynamic::triggerBackgroundLabelUpdate() {
+    if (currentMode != Mode::IMMEDIATE_UPDATE) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(refresh_mutex);
+    refresh_requested = true;
+    if (background_update_active) {
+        return;
+    }
+    if (refresh_thread.joinable()) {
+        refresh_thread.join();
+    }
+    background_update_active = true;
+    std::cout << "🔄 Starting background label refresh - queries use previous labels until it completes\n";
+    refresh_thread = std::thread(&Dynamic::refreshLabels, this);
+}
+
 distance_t Dynamic::get_distance(NodeID v, NodeID w, bool weighted) {
     // Input validation
     if (v == 0 || w == 0 || v >= graph.super_node_count() + 1 || w >= graph.super_node_count() + 1) {
@@ -439,71 +611,57 @@ distance_t Dynamic::get_distance(NodeID v, NodeID w, bool weighted) {
         return std::numeric_limits<distance_t>::max();
     }
     
-    // Start query response timer
-    auto query_start = std::chrono::high_resolution_clock::now();
-    
-    // Handle different modes according to their proper definitions
-    if (currentMode == Mode::BASE) {
-        auto labeling_start = std::chrono::high_resolution_clock::now();
-        distance_t result = graph.get_distance(v, w, weighted);
-        auto labeling_end = std::chrono::high_resolution_clock::now();
-        auto query_end = std::chrono::high_resolution_clock::now();
-        
-        return result;
+    const Mode mode = currentMode;
+    return queryDistance(queryLabels(mode, weighted), mode, v, w, weighted);
+}
+
+std::shared_ptr<Dynamic::LabelSnapshot> Dynamic::queryLabels(Mode mode, bool weighted) {
+    // Labels hold weighted distances only
+    std::shared_ptr<LabelSnapshot> snapshot = labelSnapshot.load();
+    if (!weighted || !snapshot) {
+        return nullptr;
     }
     
-    // 🔥 LAZY UPDATE MODE - Labels are marked stale and only repaired when accessed
-    if (currentMode == Mode::LAZY_UPDATE) {
-        std::cout << "⏳ LAZY UPDATE: Checking if labels need repair...\n";
-        
-        // Check if labels are stale and repair only if needed
-        if (areLabelsStale(v, w)) {
-            std::cout << "🔧 Labels are stale - repairing on access (saves memory/computation)\n";
-            repairStaleLabels(v, w);
-        } else {
-            std::cout << "✅ Labels are fresh - using cached result\n";
+    // 🔥 IMMEDIATE UPDATE MODE - Labels are refreshed in the background while queries use the published snapshot
+    if (mode == Mode::IMMEDIATE_UPDATE) {
+        if (!labelsFresh(snapshot)) {
+            triggerBackgroundLabelUpdate();
         }
-        
-        auto labeling_start = std::chrono::high_resolution_clock::now();
-        distance_t result = graph.get_distance(v, w, weighted);
-        auto labeling_end = std::chrono::high_resolution_clock::now();
-        
-        return result;
+        return snapshot;
     }
     
-    // 🔥 IMMEDIATE UPDATE MODE - Labels are immediately recalculated and kept fresh
-    if (currentMode == Mode::IMMEDIATE_UPDATE) {
-        std::cout << "🚀 IMMEDIATE UPDATE: Using precomputed fresh labels\n";
-        
-        // In immediate mode, labels should already be fresh from background processing
-        if (background_update_active) {
-            std::cout << "⚡ Background update still active - waiting for completion\n";
-        } else {
-            std::cout << "✅ Using precomputed labels (proactive background updates)\n";
+    // 🔥 LAZY UPDATE MODE - Labels are marked stale and only repaired when accessed
+    if (mode == Mode::LAZY_UPDATE) {
+        if (labelsFresh(snapshot)) {
+            return snapshot;
         }
-        
-        auto labeling_start = std::chrono::high_resolution_clock::now();
-        distance_t result = graph.get_distance(v, w, weighted);
-        auto labeling_end = std::chrono::high_resolution_clock::now();
-        
-        return result;
+        publishRepairedLabels();
+        return labelSnapshot.load();
     }
     
-    // Standard DISRUPTED mode and other modes
-    if (currentMode == Mode::DISRUPTED) {
-        // Apply all disruptions immediately (legacy behavior)
-        for (const auto& edge : disruptedClosedEdges) {
-            graph.applyDisruption(edge.first, edge.second, 1.0, true);
-        }
-        for (const auto& [edge, slowdown] : disruptedSlowdownFactorByEdge) {
-            graph.applyDisruption(edge.first, edge.second, slowdown, false);
-        }
-        
-        distance_t result = graph.get_distance(v, w, weighted);
-        return result;
+    // Base mode uses the unrepaired labels, disrupted mode only labels a refresh already brought up to date
+    if (mode == Mode::BASE) {
+        return baseSnapshot.load();
+    }
+    if (mode == Mode::DISRUPTED && labelsFresh(snapshot)) {
+        return snapshot;
+    }
+    return nullptr;
+}
+
+distance_t Dynamic::queryDistance(const std::shared_ptr<LabelSnapshot> &labels, Mode mode, NodeID v, NodeID w, bool weighted) {
+    if (labels && std::max(v, w) < labels->index->num_nodes()) {
+        return labels->index->get_distance(v, w);
     }
     
-    // Fallback for unknown modes
+    std::lock_guard<std::recursive_mutex> lock(graph_mutex);
+    // Base mode sees undisrupted weights, all other modes the full disruption overlay
+    graph.activate_overlay(mode == Mode::BASE ? nullptr : &disruptionOverlay);
+    
+    // Labels from setIndex describe the undisrupted graph, so they answer base queries directly
+    if (mode == Mode::BASE && index != nullptr && weighted && std::max(v, w) < index->num_nodes()) {
+        return index->get_distance(v, w);
+    }
     return graph.get_distance(v, w, weighted);
 }
 
@@ -515,10 +673,7 @@ std::pair<distance_t, std::vector<NodeID>> Dynamic::get_path(NodeID source, Node
         return {std::numeric_limits<distance_t>::max(), {}};
     }
     
-    std::cout << "Finding path from " << source << " to " << target << " in mode " << static_cast<int>(currentMode) << std::endl;
-    
-    // Check graph basic info
-    std::cout << "Graph has " << graph.node_count() << " nodes and " << graph.edge_count() << " edges" << std::endl;
+    const Mode mode = currentMode;
     
     // Check if source and target are the same
     if (source == target) {
@@ -526,119 +681,53 @@ std::pair<distance_t, std::vector<NodeID>> Dynamic::get_path(NodeID source, Node
         return {0, {source}};
     }
     
+    return queryPath(queryLabels(mode, weighted), mode, source, target, weighted);
+}
+
+std::pair<distance_t, std::vector<NodeID>> Dynamic::queryPath(const std::shared_ptr<LabelSnapshot> &labels, Mode mode,
+                                                              NodeID source, NodeID target, bool weighted) {
+    distance_t distance = road_network::infinity;
+    std::vector<NodeID> path;
+    
     // ============================================================
     // HC2L-BASED ROUTING WITH DYNAMIC DISRUPTIONS
     // ============================================================
     
-    // Determine if we should use disrupted state
-    bool should_apply_disruptions = (currentMode == Mode::DISRUPTED || 
-                                   currentMode == Mode::IMMEDIATE_UPDATE || 
-                                   currentMode == Mode::LAZY_UPDATE);
-    
-    distance_t distance;
-    std::vector<NodeID> path;
+    if (labels) {
+        // Distance and path both come from the one snapshot, unpacked against the weights it was repaired for, so
+        // they agree even while a refresh swaps in newer labels
+        std::cout << "Unpacking path from labels matching disruption version " << labels->version << std::endl;
+        std::tie(distance, path) = graph.get_path_from_index(source, target, *labels->index, labels->weights.get());
+        if (!path.empty() || distance >= road_network::infinity) {
+            std::cout << "HC2L result: distance=" << distance << ", path_size=" << path.size() << std::endl;
+            return {distance, path};
+        }
+        std::cout << "Labels do not match their edge weights - falling back to Dijkstra" << std::endl;
+    }
     
-    if (should_apply_disruptions) {
-        std::cout << "Applying disruptions for mode: " << static_cast<int>(currentMode) << std::endl;
-        
-        // CRITICAL: For HC2L to work with disruptions, we need to:
-        // 1. Create a temporary modified graph with disruptions applied
-        // 2. Use HC2L labels for fast pruning, but validate paths against disrupted graph
-        // 3. Fall back to Dijkstra ONLY on affected regions if labels are stale
-        
-        // Check if labels need refresh based on mode
-        if (currentMode == Mode::IMMEDIATE_UPDATE) {
-            std::cout << "IMMEDIATE_UPDATE: Rebuilding labels with disruptions" << std::endl;
-            
-            // Apply disruptions to graph
-            for (const auto& edge : disruptedClosedEdges) {
-                graph.applyDisruption(edge.first, edge.second, 1.0, true);
-            }
-            for (const auto& [edge, slowdown] : disruptedSlowdownFactorByEdge) {
-                graph.applyDisruption(edge.first, edge.second, slowdown, false);
-            }
-            
-            // Rebuild HC2L index with disrupted graph
-            rebuildLabelsWithDisruptions();
-            
-            // Use HC2L index to get distance
-            distance = get_distance(source, target);
-            
-            // Get full path using HC2L-guided search on disrupted graph
-            if (distance < road_network::infinity) {
-                path = reconstructPathFromLabels(source, target);
-            }
-            
-        } else if (currentMode == Mode::LAZY_UPDATE) {
-            std::cout << "LAZY_UPDATE: Using stale labels with on-demand repair" << std::endl;
-            
-            // Mark affected labels as stale (don't rebuild yet)
-            markAffectedLabelsAsStale();
-            
-            // Try HC2L query first with stale labels
-            distance = get_distance(source, target);
-            
-            // Check if path goes through disrupted edges
-            bool path_affected = isPathAffectedByDisruptions(source, target);
-            
-            if (path_affected) {
-                std::cout << "Path affected by disruptions - performing lazy repair" << std::endl;
-                
-                // Lazy repair: Apply disruptions and recompute only for this query
-                Graph temp_graph = graph; // Copy for temporary modifications
-                
-                for (const auto& edge : disruptedClosedEdges) {
-                    temp_graph.applyDisruption(edge.first, edge.second, 1.0, true);
-                }
-                for (const auto& [edge, slowdown] : disruptedSlowdownFactorByEdge) {
-                    if (slowdown < 0.5) { // Critical slowdowns only
-                        temp_graph.applyDisruption(edge.first, edge.second, slowdown, false);
-                    }
-                }
-                
-                // Use HC2L for pruning, but validate on disrupted graph
-                auto result = temp_graph.get_path_dijkstra(source, target, weighted);
-                distance = result.first;
-                path = result.second;
-                
-            } else {
-                std::cout << "Path not affected - using existing HC2L labels" << std::endl;
-                // Path not affected, use HC2L labels directly
-                if (distance < road_network::infinity) {
-                    path = reconstructPathFromLabels(source, target);
-                }
-            }
-            
-        } else {
-            // Standard DISRUPTED mode
-            std::cout << "DISRUPTED mode: Applying all disruptions with HC2L validation" << std::endl;
-            
-            // Apply all disruptions
-            for (const auto& edge : disruptedClosedEdges) {
-                graph.applyDisruption(edge.first, edge.second, 1.0, true);
-            }
-            for (const auto& [edge, slowdown] : disruptedSlowdownFactorByEdge) {
-                graph.applyDisruption(edge.first, edge.second, slowdown, false);
-            }
-            
-            // Use HC2L with disrupted graph
-            distance = get_distance(source, target);
-            
-            if (distance < road_network::infinity) {
-                path = reconstructPathFromLabels(source, target);
-            }
+    std::lock_guard<std::recursive_mutex> lock(graph_mutex);
+    if (mode == Mode::BASE) {
+        std::cout << "Running in BASE mode - using pure HC2L labels" << std::endl;
+        graph.activate_overlay(nullptr);
+        if (index != nullptr && weighted) {
+            std::tie(distance, path) = graph.get_path_from_index(source, target, *index);
         }
-        
+    } else if (mode == Mode::LAZY_UPDATE && isPathAffectedByDisruptions(source, target)) {
+        std::cout << "Path affected by disruptions - performing lazy repair" << std::endl;
+        // Lazy repair: recompute only for this query, with closures and critical slowdowns only
+        graph.activate_overlay(&criticalDisruptionOverlay);
     } else {
-        std::cout << "Running in BASE mode - using pure HC2L labels" << std::endl;
-        
-        // BASE mode: Use HC2L index without any disruptions
-        distance = get_distance(source, target); // HC2L distance query
-        
-        if (distance < road_network::infinity) {
-            // Reconstruct path from HC2L labels
-            path = reconstructPathFromLabels(source, target);
+        std::cout << "Applying disruptions for mode: " << static_cast<int>(mode) << std::endl;
+        if (mode == Mode::IMMEDIATE_UPDATE) {
+            rebuildLabelsWithDisruptions();
         }
+        graph.activate_overlay(&disruptionOverlay);
+    }
+    if (path.empty()) {
+        std::tie(distance, path) = graph.get_path_dijkstra(source, target, weighted);
+    }
+    if (!weighted && !path.empty()) {
+        distance = graph.get_distance(source, target, false);
     }
     
     // ============================================================
@@ -667,21 +756,6 @@ std::pair<distance_t, std::vector<NodeID>> Dynamic::get_path(NodeID source, Node
 // HELPER FUNCTIONS FOR HC2L-BASED DYNAMIC ROUTING
 // ============================================================
 
-// Reconstruct path from HC2L labels
-std::vector<NodeID> Dynamic::reconstructPathFromLabels(NodeID source, NodeID target) {
-    // Use HC2L contraction hierarchy to reconstruct path
-    // This should traverse the labels to get actual road sequence
-    
-    std::vector<NodeID> path;
-    
-    // TODO: Implement actual HC2L path reconstruction
-    // For now, use the existing get_path_dijkstra as fallback
-    auto result = graph.get_path_dijkstra(source, target, true);
-    path = result.second;
-    
-    return path;
-}
-
 // Check if path is affected by disruptions
 bool Dynamic::isPathAffectedByDisruptions(NodeID source, NodeID target) {
     // Quick check: Does the potential path region overlap with disrupted edges?
@@ -701,29 +775,20 @@ bool Dynamic::isPathAffectedByDisruptions(NodeID source, NodeID target) {
     return false; // Conservative: assume not affected if not obvious
 }
 
-// Mark labels affected by disruptions as stale (for lazy mode)
-void Dynamic::markAffectedLabelsAsStale() {
-    // Mark labels of nodes near disrupted edges as needing refresh
-    std::cout << "Marking affected labels as stale for lazy update" << std::endl;
-    
-    // TODO: Implement sophisticated stale marking based on HC2L hierarchy
-    // For now, this is a placeholder
-}
-
 // Rebuild HC2L labels with current disruptions (for immediate mode)
 void Dynamic::rebuildLabelsWithDisruptions() {
-    std::cout << "Rebuilding HC2L labels with disruptions applied" << std::endl;
-    
-    // TODO: Implement full HC2L index rebuild
-    // This is expensive but necessary for IMMEDIATE_UPDATE mode
-    // Should recompute contraction hierarchy and labels
-    
-    // For now, this is a placeholder
-    std::cout << "Warning: Full label rebuild not yet implemented" << std::endl;
+    if (labelSnapshot.load() == nullptr) {
+        std::cout << "Warning: No repairable labels - call buildRepairableIndex first" << std::endl;
+        return;
+    }
+    // Queries keep using the previous labels until the background refresh swaps in repaired ones
+    std::cout << "Refreshing HC2L labels with disruptions applied" << std::endl;
+    triggerBackgroundLabelUpdate();
 }
 
 // NEW: Get actual number of nodes visited during distance calculation
 size_t Dynamic::get_visited_nodes_count(NodeID v, NodeID w, bool weighted) {
+    std::lock_guard<std::recursive_mutex> lock(graph_mutex);
     // Avoid infinite recursion by not calling get_distance again
     size_t total_nodes = graph.node_count();
     
@@ -751,6 +816,7 @@ size_t Dynamic::get_visited_nodes_count(NodeID v, NodeID w, bool weighted) {
 
 // NEW: Check if route uses disrupted edges
 bool Dynamic::route_uses_disruptions(const std::vector<NodeID>& path) const {
+    std::lock_guard<std::recursive_mutex> lock(graph_mutex);
     for (size_t i = 0; i < path.size() - 1; ++i) {
         EdgeID edge = makeEdgeId(path[i], path[i + 1]);
         
@@ -777,6 +843,16 @@ bool Dynamic::initializeCoordinateMapping(const std::string& nodes_csv_file, con
         return false;
     }
     
+    // Index the graph's road segments for snapping GPS positions between intersections
+    std::vector<Edge> edges;
+    graph.get_edges(edges);
+    std::vector<std::pair<NodeID, NodeID>> segments;
+    segments.reserve(edges.size());
+    for (const Edge& e : edges) {
+        segments.push_back({e.from, e.to});
+    }
+    std::cout << "Indexed " << coordinate_mapper.buildSegmentIndex(segments) << " road segments." << std::endl;
+    
     coordinate_mapping_initialized = true;
     std::cout << "Coordinate mapping system initialized successfully!" << std::endl;
     return true;
@@ -794,18 +870,37 @@ RouteInfo Dynamic::findRouteByGPS(double start_lat, double start_lng, double end
         return route_info;
     }
     
-    // Find nearest nodes to start and end coordinates
+    // One set of labels answers all distance and path queries of this route
+    const Mode mode = currentMode;
+    std::shared_ptr<LabelSnapshot> labels = queryLabels(mode, weighted);
+    
+    // Snap onto road segments when indexed, otherwise onto the nearest nodes
     double start_distance, end_distance;
-    NodeID start_node = findNearestAvailableNode(start_lat, start_lng, start_distance);
-    NodeID end_node = findNearestAvailableNode(end_lat, end_lng, end_distance);
+    NodeID start_node, end_node;
+    SegmentEndpoints endpoints;
+    const bool on_segments = coordinate_mapper.hasSegmentIndex();
+    if (on_segments) {
+        if (!findSegmentEndpoints(labels, mode, start_lat, start_lng, end_lat, end_lng, weighted, endpoints)) {
+            std::cerr << "Error: No path found between the road segments near the specified coordinates." << std::endl;
+            return route_info;
+        }
+        start_node = endpoints.start_node;
+        end_node = endpoints.end_node;
+        start_distance = endpoints.start_distance;
+        end_distance = endpoints.end_distance;
+    } else {
+        start_node = findNearestAvailableNode(start_lat, start_lng, start_distance);
+        end_node = findNearestAvailableNode(end_lat, end_lng, end_distance);
+    }
     
     if (start_node == 0 || end_node == 0) {
         std::cerr << "Error: Could not find valid non-disrupted nodes near the specified coordinates." << std::endl;
         return route_info;
     }
     
-    // In disrupted mode, check if the direct route between chosen nodes is heavily disrupted
-    if (currentMode == Mode::DISRUPTED && start_node != end_node) {
+    // In disrupted mode, check if the direct route between chosen nodes is heavily disrupted;
+    // segment endpoints already account for current distances
+    if (!on_segments && mode == Mode::DISRUPTED && start_node != end_node) {
         if (isRouteHeavilyDisrupted(start_node, end_node)) {
             std::cout << "Warning: Direct route between nodes " << start_node << " and " << end_node 
                       << " is heavily disrupted. Searching for alternative nodes..." << std::endl;
@@ -814,23 +909,18 @@ RouteInfo Dynamic::findRouteByGPS(double start_lat, double start_lng, double end
             double alt_start_distance = start_distance;
             NodeID alt_start_node = start_node;
             
-            const std::vector<NodeCoordinate>& all_nodes = coordinate_mapper.getAllNodes();
-            for (const auto& node_coord : all_nodes) {
-                if (node_coord.node_id == start_node) continue;
+            // Candidates within 50% more distance, max 100m away, closest first
+            auto start_candidates = coordinate_mapper.findNodesWithinRadius(
+                start_lat, start_lng, std::min(start_distance * 1.5, 100.0));
+            for (const auto& [candidate, candidate_distance] : start_candidates) {
+                if (candidate == start_node) continue;
                 
-                double candidate_distance = CoordinateMapper::calculateDistance(
-                    start_lat, start_lng, node_coord.latitude, node_coord.longitude);
-                
-                if (candidate_distance <= start_distance * 1.5 && // Within 50% more distance
-                    candidate_distance <= 100.0) { // Max 100m away
-                    
-                    if (!isRouteHeavilyDisrupted(node_coord.node_id, end_node)) {
-                        alt_start_node = node_coord.node_id;
-                        alt_start_distance = candidate_distance;
-                        std::cout << "Found alternative start node " << alt_start_node 
-                                  << " at distance " << candidate_distance << "m" << std::endl;
-                        break;
-                    }
+                if (!isRouteHeavilyDisrupted(candidate, end_node)) {
+                    alt_start_node = candidate;
+                    alt_start_distance = candidate_distance;
+                    std::cout << "Found alternative start node " << alt_start_node 
+                              << " at distance " << candidate_distance << "m" << std::endl;
+                    break;
                 }
             }
             
@@ -838,22 +928,17 @@ RouteInfo Dynamic::findRouteByGPS(double start_lat, double start_lng, double end
             double alt_end_distance = end_distance;
             NodeID alt_end_node = end_node;
             
-            for (const auto& node_coord : all_nodes) {
-                if (node_coord.node_id == end_node) continue;
-                
-                double candidate_distance = CoordinateMapper::calculateDistance(
-                    end_lat, end_lng, node_coord.latitude, node_coord.longitude);
+            auto end_candidates = coordinate_mapper.findNodesWithinRadius(
+                end_lat, end_lng, std::min(end_distance * 1.5, 100.0));
+            for (const auto& [candidate, candidate_distance] : end_candidates) {
+                if (candidate == end_node) continue;
                 
-                if (candidate_distance <= end_distance * 1.5 && // Within 50% more distance
-                    candidate_distance <= 100.0) { // Max 100m away
-                    
-                    if (!isRouteHeavilyDisrupted(alt_start_node, node_coord.node_id)) {
-                        alt_end_node = node_coord.node_id;
-                        alt_end_distance = candidate_distance;
-                        std::cout << "Found alternative end node " << alt_end_node 
-                                  << " at distance " << candidate_distance << "m" << std::endl;
-                        break;
-                    }
+                if (!isRouteHeavilyDisrupted(alt_start_node, candidate)) {
+                    alt_end_node = candidate;
+                    alt_end_distance = candidate_distance;
+                    std::cout << "Found alternative end node " << alt_end_node 
+                              << " at distance " << candidate_distance << "m" << std::endl;
+                    break;
                 }
             }
             
@@ -874,9 +959,15 @@ RouteInfo Dynamic::findRouteByGPS(double start_lat, double start_lng, double end
               << " (distance: " << end_distance << "m)" << std::endl;
     
     // Find the path using existing algorithm
-    auto path_result = get_path(start_node, end_node, weighted);
-    route_info.total_distance = path_result.first;
-    route_info.path = path_result.second;
+    if (on_segments && endpoints.direct) {
+        route_info.total_distance = endpoints.distance;
+        route_info.path = {start_node, end_node};
+    } else {
+        auto path_result = start_node == end_node ? std::make_pair(distance_t(0), std::vector<NodeID>{start_node})
+                                                  : queryPath(labels, mode, start_node, end_node, weighted);
+        route_info.total_distance = on_segments ? endpoints.distance : path_result.first;
+        route_info.path = path_result.second;
+    }
     
     if (route_info.path.empty()) {
         std::cerr << "Error: No path found between the specified coordinates." << std::endl;
@@ -986,6 +1077,7 @@ bool Dynamic::isEdgeDisrupted(NodeID u, NodeID v) const {
         return false;
     }
     
+    std::lock_guard<std::recursive_mutex> lock(graph_mutex);
     EdgeID edge = makeEdgeId(u, v);
     return disruptedClosedEdges.count(edge) > 0 || 
            disruptedSlowdownFactorByEdge.count(edge) > 0;
@@ -997,6 +1089,7 @@ bool Dynamic::isRouteHeavilyDisrupted(NodeID start, NodeID end) const {
         return false;
     }
     
+    std::lock_guard<std::recursive_mutex> lock(graph_mutex);
     // Check direct edge first
     EdgeID direct_edge = makeEdgeId(start, end);
     
@@ -1039,6 +1132,62 @@ bool Dynamic::isNodeAccessible(NodeID node) const {
     return graph.degree(node) > 0;
 }
 
+bool Dynamic::findSegmentEndpoints(const std::shared_ptr<LabelSnapshot> &labels, Mode mode, double start_lat, double start_lng,
+                                   double end_lat, double end_lng, bool weighted, SegmentEndpoints& endpoints) {
+    // Segment weights come from the weights the labels were repaired for, or from the graph with the mode's overlay
+    // applied; closed segments cannot be travelled, so positions snap onto the nearest open segment instead
+    std::unique_lock<std::recursive_mutex> lock(graph_mutex, std::defer_lock);
+    const WeightTable *weights = labels ? labels->weights.get() : nullptr;
+    if (weights == nullptr) {
+        lock.lock();
+        graph.activate_overlay(mode == Mode::BASE ? nullptr : &disruptionOverlay);
+    }
+    auto open = [&](NodeID a, NodeID b) { return graph.edge_weight(a, b, weights) < infinity; };
+    SegmentSnap from, to;
+    if (!coordinate_mapper.snapToSegment(start_lat, start_lng, from, open) || !coordinate_mapper.snapToSegment(end_lat, end_lng, to, open)) {
+        return false;
+    }
+    endpoints.start_distance = from.distance_m;
+    endpoints.end_distance = to.distance_m;
+    std::cout << "Snapped start onto segment " << from.source_id << "-" << from.target_id << " (" << from.distance_m << "m away), end onto segment "
+              << to.source_id << "-" << to.target_id << " (" << to.distance_m << "m away)" << std::endl;
+    
+    // Partial edge weights from the snapped positions to the segment endpoints
+    const double from_weight = weighted ? graph.edge_weight(from.source_id, from.target_id, weights) : 1.0;
+    const double to_weight = weighted ? graph.edge_weight(to.source_id, to.target_id, weights) : 1.0;
+    if (lock.owns_lock()) {
+        lock.unlock();
+    }
+    const std::pair<NodeID, double> exits[2] = { {from.source_id, from.fraction * from_weight}, {from.target_id, (1 - from.fraction) * from_weight} };
+    const std::pair<NodeID, double> entries[2] = { {to.source_id, to.fraction * to_weight}, {to.target_id, (1 - to.fraction) * to_weight} };
+    double best = infinity;
+    for (const auto& [exit_node, exit_offset] : exits) {
+        for (const auto& [entry_node, entry_offset] : entries) {
+            distance_t d = queryDistance(labels, mode, exit_node, entry_node, weighted);
+            if (d < infinity && exit_offset + d + entry_offset < best) {
+                best = exit_offset + d + entry_offset;
+                endpoints.start_node = exit_node;
+                endpoints.end_node = entry_node;
+            }
+        }
+    }
+    // Both positions on the same segment: travel along it directly
+    if (from.source_id == to.source_id && from.target_id == to.target_id) {
+        double along = std::fabs(from.fraction - to.fraction) * from_weight;
+        if (along <= best) {
+            best = along;
+            endpoints.direct = true;
+            endpoints.start_node = from.fraction <= to.fraction ? from.source_id : from.target_id;
+            endpoints.end_node = from.fraction <= to.fraction ? from.target_id : from.source_id;
+        }
+    }
+    if (best >= infinity) {
+        return false;
+    }
+    endpoints.distance = static_cast<distance_t>(std::llround(best));
+    return true;
+}
+
 NodeID Dynamic::findNearestAvailableNode(double lat, double lng, double& distance) {
     const double MAX_SEARCH_RADIUS = 1000.0; // meters
     const int MAX_CANDIDATES = 50; // Increased to find more alternatives
@@ -1064,30 +1213,13 @@ NodeID Dynamic::findNearestAvailableNode(double lat, double lng, double& distanc
         return nearest;
     }
     
-    // Search for alternative accessible nodes within radius
-    const std::vector<NodeCoordinate>& all_nodes = coordinate_mapper.getAllNodes();
-    std::vector<std::pair<NodeID, double>> candidates;
-    
-    // Find nodes within search radius
-    for (const auto& node_coord : all_nodes) {
-        if (node_coord.node_id == nearest) continue; // Skip the nearest one we already checked
-        
-        double candidate_distance = CoordinateMapper::calculateDistance(
-            lat, lng, node_coord.latitude, node_coord.longitude);
-        
-        if (candidate_distance <= MAX_SEARCH_RADIUS) {
-            candidates.push_back({node_coord.node_id, candidate_distance});
-        }
-    }
-    
-    // Sort candidates by distance
-    std::sort(candidates.begin(), candidates.end(), 
-        [](const auto& a, const auto& b) { return a.second < b.second; });
+    // Search for alternative accessible nodes within radius, closest first
+    std::vector<std::pair<NodeID, double>> candidates = coordinate_mapper.findKNearestNodes(lat, lng, MAX_CANDIDATES + 1);
     
-    // Check candidates for accessibility, up to MAX_CANDIDATES
-    for (size_t i = 0; i < std::min(candidates.size(), (size_t)MAX_CANDIDATES); ++i) {
-        NodeID candidate = candidates[i].first;
-        double candidate_distance = candidates[i].second;
+    // Check candidates for accessibility, skipping the nearest one we already checked
+    for (const auto& [candidate, candidate_distance] : candidates) {
+        if (candidate == nearest) continue;
+        if (candidate_distance > MAX_SEARCH_RADIUS) break;
         
         if (isNodeAccessible(candidate)) {
             distance = candidate_distance;
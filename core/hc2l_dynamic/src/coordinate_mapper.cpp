@@ -5,6 +5,7 @@
 #include <limits>
 #include <iostream>
 #include <algorithm>
+#include <queue>
 
 namespace hc2l_dynamic {
 
@@ -29,7 +30,34 @@ static std::vector<std::string> parseCSVLine(const std::string& line) {
     return fields;
 }
 
+bool CoordinateMapper::loadNodeSnapshot(const std::string& snapshot_file) {
+    road_network::NodeAttributes attributes;
+    try {
+        road_network::read_graph_snapshot(snapshot_file, nullptr, &attributes);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return false;
+    }
+    
+    node_coordinates.clear();
+    node_index_map.clear();
+    for (road_network::NodeID node_id = 1; node_id < attributes.latitudes.size(); node_id++) {
+        if (std::isnan(attributes.latitudes[node_id]) || std::isnan(attributes.longitudes[node_id])) continue;
+        node_index_map[node_id] = node_coordinates.size();
+        node_coordinates.push_back(NodeCoordinate(node_id, attributes.latitudes[node_id], attributes.longitudes[node_id]));
+    }
+    osm_ids = std::move(attributes.osm_ids);
+    node_grid.build(node_coordinates);
+    
+    std::cout << "Loaded " << node_coordinates.size() << " node coordinates from snapshot." << std::endl;
+    return !node_coordinates.empty();
+}
+
 bool CoordinateMapper::loadNodeCoordinates(const std::string& nodes_csv_file) {
+    if (road_network::is_graph_snapshot(nodes_csv_file)) {
+        return loadNodeSnapshot(nodes_csv_file);
+    }
+    
     std::ifstream file(nodes_csv_file);
     if (!file.is_open()) {
         std::cerr << "Error: Cannot open nodes file: " << nodes_csv_file << std::endl;
@@ -38,6 +66,7 @@ bool CoordinateMapper::loadNodeCoordinates(const std::string& nodes_csv_file) {
     
     node_coordinates.clear();
     node_index_map.clear();
+    osm_ids.clear();
     
     std::string header;
     std::getline(file, header); // Skip header: node_id,latitude,longitude
@@ -65,6 +94,7 @@ bool CoordinateMapper::loadNodeCoordinates(const std::string& nodes_csv_file) {
     }
     
     file.close();
+    node_grid.build(node_coordinates);
     std::cout << "Loaded " << node_coordinates.size() << " node coordinates." << std::endl;
     return !node_coordinates.empty();
 }
@@ -148,25 +178,348 @@ double CoordinateMapper::calculateDistance(double lat1, double lng1, double lat2
     return R * c;
 }
 
-road_network::NodeID CoordinateMapper::findNearestNode(double latitude, double longitude, double& distance_m) const {
-    if (node_coordinates.empty()) {
-        distance_m = std::numeric_limits<double>::max();
-        return 0;
+// Spatial grid helpers
+static const double EARTH_RADIUS_M = 6371000;
+static const double DEG_TO_RAD = M_PI / 180.0;
+
+// Squared chord length between unit vectors
+static double chord2(double x1, double y1, double z1, double x2, double y2, double z2) {
+    double dx = x1 - x2, dy = y1 - y2, dz = z1 - z2;
+    return dx * dx + dy * dy + dz * dz;
+}
+
+// Great-circle distance in meters for a squared chord length between unit vectors
+static double chord2ToMeters(double c2) {
+    return 2 * EARTH_RADIUS_M * std::asin(std::min(1.0, std::sqrt(c2) / 2));
+}
+
+static void toUnitVector(double latitude, double longitude, double& x, double& y, double& z) {
+    double lat = latitude * DEG_TO_RAD, lng = longitude * DEG_TO_RAD;
+    x = std::cos(lat) * std::cos(lng);
+    y = std::cos(lat) * std::sin(lng);
+    z = std::sin(lat);
+}
+
+// Cosine of the highest latitude a short path from the given latitude can reach
+static double latitudeScale(double latitude) {
+    return std::cos(std::min(89.0, std::fabs(latitude) + 1.0) * DEG_TO_RAD);
+}
+
+void GridLayout::init(double min_lat, double max_lat, double min_lng, double max_lng, size_t item_count) {
+    lng_scale = latitudeScale(std::max(std::fabs(min_lat), std::fabs(max_lat)));
+    double max_x, max_y;
+    project(min_lat, min_lng, min_x, min_y);
+    project(max_lat, max_lng, max_x, max_y);
+    
+    // About two items per cell
+    double area = std::max(max_x - min_x, 1.0) * std::max(max_y - min_y, 1.0);
+    cell_size = std::max(1.0, std::sqrt(area / std::max<size_t>(1, item_count / 2)));
+    columns = static_cast<size_t>((max_x - min_x) / cell_size) + 1;
+    rows = static_cast<size_t>((max_y - min_y) / cell_size) + 1;
+    cell_start.assign(columns * rows + 1, 0);
+}
+
+void GridLayout::project(double latitude, double longitude, double& x, double& y) const {
+    x = EARTH_RADIUS_M * longitude * DEG_TO_RAD * lng_scale;
+    y = EARTH_RADIUS_M * latitude * DEG_TO_RAD;
+}
+
+size_t GridLayout::column_of(double x) const {
+    double c = std::floor((x - min_x) / cell_size);
+    return c < 0 ? 0 : std::min(static_cast<size_t>(std::min(c, 1e18)), columns - 1);
+}
+
+size_t GridLayout::row_of(double y) const {
+    double r = std::floor((y - min_y) / cell_size);
+    return r < 0 ? 0 : std::min(static_cast<size_t>(std::min(r, 1e18)), rows - 1);
+}
+
+double GridLayout::ring_bound(double latitude, double x, double y, size_t column, size_t row, size_t r) const {
+    // Projected x distances assume the grid's latitudes; shrink them for queries further from the equator
+    double x_scale = std::min(1.0, latitudeScale(latitude) / lng_scale);
+    auto box_distance = [&](double x0, double x1, double y0, double y1) {
+        double dx = std::max({x0 - x, 0.0, x - x1}) * x_scale;
+        double dy = std::max({y0 - y, 0.0, y - y1});
+        return std::sqrt(dx * dx + dy * dy);
+    };
+    // Unvisited cells lie in up to four strips around the visited window
+    double max_x = min_x + columns * cell_size, max_y = min_y + rows * cell_size;
+    double bound = std::numeric_limits<double>::infinity();
+    if (column > r) bound = std::min(bound, box_distance(min_x, min_x + (column - r) * cell_size, min_y, max_y));
+    if (column + r + 1 < columns) bound = std::min(bound, box_distance(min_x + (column + r + 1) * cell_size, max_x, min_y, max_y));
+    if (row > r) bound = std::min(bound, box_distance(min_x, max_x, min_y, min_y + (row - r) * cell_size));
+    if (row + r + 1 < rows) bound = std::min(bound, box_distance(min_x, max_x, min_y + (row + r + 1) * cell_size, max_y));
+    return bound;
+}
+
+template<typename F>
+void GridLayout::visit_ring(size_t column, size_t row, size_t r, F&& visit_cell) const {
+    size_t c0 = column >= r ? column - r : 0, c1 = std::min(column + r, columns - 1);
+    size_t r0 = row >= r ? row - r : 0, r1 = std::min(row + r, rows - 1);
+    for (size_t w = r0; w <= r1; w++) {
+        if (w + r == row || w == row + r) {
+            for (size_t c = c0; c <= c1; c++) visit_cell(w * columns + c);
+        } else {
+            if (column >= r) visit_cell(w * columns + column - r);
+            if (r > 0 && column + r < columns) visit_cell(w * columns + column + r);
+        }
+    }
+}
+
+void SpatialGrid::build(const std::vector<NodeCoordinate>& nodes) {
+    points.clear();
+    cell_start.clear();
+    columns = rows = 0;
+    if (nodes.empty()) return;
+    
+    double min_lat = std::numeric_limits<double>::max(), max_lat = std::numeric_limits<double>::lowest();
+    double min_lng = min_lat, max_lng = max_lat;
+    for (const auto& coord : nodes) {
+        min_lat = std::min(min_lat, coord.latitude);
+        max_lat = std::max(max_lat, coord.latitude);
+        min_lng = std::min(min_lng, coord.longitude);
+        max_lng = std::max(max_lng, coord.longitude);
+    }
+    init(min_lat, max_lat, min_lng, max_lng, nodes.size());
+    
+    // Counting sort of nodes by cell
+    std::vector<uint32_t> cell_of(nodes.size());
+    for (size_t i = 0; i < nodes.size(); i++) {
+        double x, y;
+        project(nodes[i].latitude, nodes[i].longitude, x, y);
+        cell_of[i] = row_of(y) * columns + column_of(x);
+        cell_start[cell_of[i] + 1]++;
+    }
+    for (size_t c = 1; c < cell_start.size(); c++) {
+        cell_start[c] += cell_start[c - 1];
+    }
+    points.resize(nodes.size());
+    std::vector<uint32_t> next(cell_start.begin(), cell_start.end() - 1);
+    for (size_t i = 0; i < nodes.size(); i++) {
+        GridPoint& point = points[next[cell_of[i]]++];
+        toUnitVector(nodes[i].latitude, nodes[i].longitude, point.x, point.y, point.z);
+        point.node_id = nodes[i].node_id;
+    }
+}
+
+road_network::NodeID SpatialGrid::nearest(double latitude, double longitude, double& distance_m) const {
+    distance_m = std::numeric_limits<double>::max();
+    if (points.empty()) return 0;
+    
+    double x, y, qx, qy, qz;
+    project(latitude, longitude, x, y);
+    toUnitVector(latitude, longitude, qx, qy, qz);
+    size_t column = column_of(x), row = row_of(y);
+    
+    double best = std::numeric_limits<double>::infinity();
+    road_network::NodeID best_node = 0;
+    for (size_t r = 0; ; r++) {
+        visit_ring(column, row, r, [&](size_t cell) {
+            for (uint32_t i = cell_start[cell]; i < cell_start[cell + 1]; i++) {
+                double d = chord2(qx, qy, qz, points[i].x, points[i].y, points[i].z);
+                if (d < best) {
+                    best = d;
+                    best_node = points[i].node_id;
+                }
+            }
+        });
+        double bound = ring_bound(latitude, x, y, column, row, r);
+        if (bound == std::numeric_limits<double>::infinity() || (best_node != 0 && chord2ToMeters(best) <= bound)) break;
+    }
+    distance_m = chord2ToMeters(best);
+    return best_node;
+}
+
+std::vector<std::pair<road_network::NodeID, double>> SpatialGrid::k_nearest(double latitude, double longitude, size_t k) const {
+    std::vector<std::pair<road_network::NodeID, double>> result;
+    if (points.empty() || k == 0) return result;
+    
+    double x, y, qx, qy, qz;
+    project(latitude, longitude, x, y);
+    toUnitVector(latitude, longitude, qx, qy, qz);
+    size_t column = column_of(x), row = row_of(y);
+    
+    // Max-heap of the k closest nodes found so far
+    std::priority_queue<std::pair<double, road_network::NodeID>> closest;
+    for (size_t r = 0; ; r++) {
+        visit_ring(column, row, r, [&](size_t cell) {
+            for (uint32_t i = cell_start[cell]; i < cell_start[cell + 1]; i++) {
+                double d = chord2(qx, qy, qz, points[i].x, points[i].y, points[i].z);
+                if (closest.size() < k) {
+                    closest.push({d, points[i].node_id});
+                } else if (d < closest.top().first) {
+                    closest.pop();
+                    closest.push({d, points[i].node_id});
+                }
+            }
+        });
+        double bound = ring_bound(latitude, x, y, column, row, r);
+        if (bound == std::numeric_limits<double>::infinity() ||
+            (closest.size() == k && chord2ToMeters(closest.top().first) <= bound)) break;
+    }
+    
+    result.resize(closest.size());
+    for (size_t i = result.size(); i-- > 0; closest.pop()) {
+        result[i] = {closest.top().second, chord2ToMeters(closest.top().first)};
     }
+    return result;
+}
+
+std::vector<std::pair<road_network::NodeID, double>> SpatialGrid::within_radius(double latitude, double longitude, double radius_m) const {
+    std::vector<std::pair<road_network::NodeID, double>> result;
+    if (points.empty() || radius_m < 0) return result;
     
-    road_network::NodeID nearest_node = 0;
-    double min_distance = std::numeric_limits<double>::max();
+    double x, y, qx, qy, qz;
+    project(latitude, longitude, x, y);
+    toUnitVector(latitude, longitude, qx, qy, qz);
+    double x_radius = radius_m / std::min(1.0, latitudeScale(latitude) / lng_scale);
+    double max_chord = 2 * std::sin(std::min(M_PI / 2, radius_m / (2 * EARTH_RADIUS_M)));
+    double max_chord2 = max_chord * max_chord;
     
-    for (const auto& coord : node_coordinates) {
-        double dist = calculateDistance(latitude, longitude, coord.latitude, coord.longitude);
-        if (dist < min_distance) {
-            min_distance = dist;
-            nearest_node = coord.node_id;
+    size_t c0 = column_of(x - x_radius), c1 = column_of(x + x_radius);
+    size_t r0 = row_of(y - radius_m), r1 = row_of(y + radius_m);
+    std::vector<std::pair<double, road_network::NodeID>> found;
+    for (size_t w = r0; w <= r1; w++) {
+        for (uint32_t i = cell_start[w * columns + c0]; i < cell_start[w * columns + c1 + 1]; i++) {
+            const GridPoint& p = points[i];
+            double d = chord2(qx, qy, qz, p.x, p.y, p.z);
+            if (d <= max_chord2) found.push_back({d, p.node_id});
         }
     }
+    std::sort(found.begin(), found.end());
     
-    distance_m = min_distance;
-    return nearest_node;
+    result.reserve(found.size());
+    for (const auto& f : found) {
+        result.push_back({f.second, chord2ToMeters(f.first)});
+    }
+    return result;
+}
+
+void SegmentGrid::build(const std::vector<std::pair<NodeCoordinate, NodeCoordinate>>& input) {
+    segments.clear();
+    cell_segments.clear();
+    cell_start.clear();
+    columns = rows = 0;
+    if (input.empty()) return;
+    
+    double min_lat = std::numeric_limits<double>::max(), max_lat = std::numeric_limits<double>::lowest();
+    double min_lng = min_lat, max_lng = max_lat;
+    segments.reserve(input.size());
+    for (const auto& [source, target] : input) {
+        min_lat = std::min({min_lat, source.latitude, target.latitude});
+        max_lat = std::max({max_lat, source.latitude, target.latitude});
+        min_lng = std::min({min_lng, source.longitude, target.longitude});
+        max_lng = std::max({max_lng, source.longitude, target.longitude});
+        segments.push_back({source.latitude, source.longitude, target.latitude, target.longitude, source.node_id, target.node_id});
+    }
+    init(min_lat, max_lat, min_lng, max_lng, segments.size());
+    
+    // List each segment in all cells overlapped by its bounding box, counting first
+    auto for_each_cell = [&](const GridSegment& segment, auto&& visit_cell) {
+        double x0, y0, x1, y1;
+        project(segment.source_lat, segment.source_lng, x0, y0);
+        project(segment.target_lat, segment.target_lng, x1, y1);
+        size_t c0 = column_of(std::min(x0, x1)), c1 = column_of(std::max(x0, x1));
+        size_t r0 = row_of(std::min(y0, y1)), r1 = row_of(std::max(y0, y1));
+        for (size_t w = r0; w <= r1; w++) {
+            for (size_t c = c0; c <= c1; c++) visit_cell(w * columns + c);
+        }
+    };
+    for (const GridSegment& segment : segments) {
+        for_each_cell(segment, [&](size_t cell) { cell_start[cell + 1]++; });
+    }
+    for (size_t c = 1; c < cell_start.size(); c++) {
+        cell_start[c] += cell_start[c - 1];
+    }
+    cell_segments.resize(cell_start.back());
+    std::vector<uint32_t> next(cell_start.begin(), cell_start.end() - 1);
+    for (uint32_t i = 0; i < segments.size(); i++) {
+        for_each_cell(segments[i], [&](size_t cell) { cell_segments[next[cell]++] = i; });
+    }
+}
+
+bool SegmentGrid::nearest(double latitude, double longitude, SegmentSnap& snap,
+                          const std::function<bool(road_network::NodeID, road_network::NodeID)>& accept) const {
+    if (segments.empty()) return false;
+    
+    double x, y;
+    project(latitude, longitude, x, y);
+    size_t column = column_of(x), row = row_of(y);
+    // Segments are short, so distances are measured in the tangent plane at the query position
+    const double ky = EARTH_RADIUS_M * DEG_TO_RAD, kx = ky * std::cos(latitude * DEG_TO_RAD);
+    
+    double best = std::numeric_limits<double>::infinity(), best_fraction = 0;
+    size_t best_segment = segments.size();
+    for (size_t r = 0; ; r++) {
+        visit_ring(column, row, r, [&](size_t cell) {
+            for (uint32_t i = cell_start[cell]; i < cell_start[cell + 1]; i++) {
+                const GridSegment& segment = segments[cell_segments[i]];
+                if (accept && !accept(segment.source_id, segment.target_id)) continue;
+                double ax = (segment.source_lng - longitude) * kx, ay = (segment.source_lat - latitude) * ky;
+                double dx = (segment.target_lng - segment.source_lng) * kx, dy = (segment.target_lat - segment.source_lat) * ky;
+                double length2 = dx * dx + dy * dy;
+                double t = length2 > 0 ? std::clamp(-(ax * dx + ay * dy) / length2, 0.0, 1.0) : 0.0;
+                double px = ax + t * dx, py = ay + t * dy;
+                double d = std::sqrt(px * px + py * py);
+                if (d < best) {
+                    best = d;
+                    best_fraction = t;
+                    best_segment = cell_segments[i];
+                }
+            }
+        });
+        double bound = ring_bound(latitude, x, y, column, row, r);
+        if (bound == std::numeric_limits<double>::infinity() || (best_segment < segments.size() && best <= bound)) break;
+    }
+    if (best_segment == segments.size()) return false;
+    
+    const GridSegment& segment = segments[best_segment];
+    snap.source_id = segment.source_id;
+    snap.target_id = segment.target_id;
+    snap.fraction = best_fraction;
+    snap.distance_m = best;
+    snap.latitude = segment.source_lat + best_fraction * (segment.target_lat - segment.source_lat);
+    snap.longitude = segment.source_lng + best_fraction * (segment.target_lng - segment.source_lng);
+    return true;
+}
+
+road_network::NodeID CoordinateMapper::findNearestNode(double latitude, double longitude, double& distance_m) const {
+    return node_grid.nearest(latitude, longitude, distance_m);
+}
+
+std::vector<std::pair<road_network::NodeID, double>> CoordinateMapper::findKNearestNodes(double latitude, double longitude, size_t k) const {
+    return node_grid.k_nearest(latitude, longitude, k);
+}
+
+std::vector<std::pair<road_network::NodeID, double>> CoordinateMapper::findNodesWithinRadius(double latitude, double longitude, double radius_m) const {
+    return node_grid.within_radius(latitude, longitude, radius_m);
+}
+
+std::vector<road_network::NodeID> CoordinateMapper::findNearestNodes(const std::vector<std::pair<double, double>>& points, std::vector<double>& distances_m) const {
+    std::vector<road_network::NodeID> nodes(points.size());
+    distances_m.resize(points.size());
+    for (size_t i = 0; i < points.size(); i++) {
+        nodes[i] = node_grid.nearest(points[i].first, points[i].second, distances_m[i]);
+    }
+    return nodes;
+}
+
+size_t CoordinateMapper::buildSegmentIndex(const std::vector<std::pair<road_network::NodeID, road_network::NodeID>>& edges) {
+    std::vector<std::pair<NodeCoordinate, NodeCoordinate>> segments;
+    segments.reserve(edges.size());
+    for (const auto& [source, target] : edges) {
+        auto source_it = node_index_map.find(source);
+        auto target_it = node_index_map.find(target);
+        if (source_it == node_index_map.end() || target_it == node_index_map.end()) continue;
+        segments.push_back({node_coordinates[source_it->second], node_coordinates[target_it->second]});
+    }
+    segment_grid.build(segments);
+    return segment_grid.size();
+}
+
+bool CoordinateMapper::snapToSegment(double latitude, double longitude, SegmentSnap& snap,
+                                     const std::function<bool(road_network::NodeID, road_network::NodeID)>& accept) const {
+    return segment_grid.nearest(latitude, longitude, snap, accept);
 }
 
 bool CoordinateMapper::getNodeCoordinates(road_network::NodeID node_id, double& latitude, double& longitude) const {
@@ -181,6 +534,10 @@ bool CoordinateMapper::getNodeCoordinates(road_network::NodeID node_id, double&
     return true;
 }
 
+uint64_t CoordinateMapper::getOsmId(road_network::NodeID node_id) const {
+    return node_id < osm_ids.size() ? osm_ids[node_id] : 0;
+}
+
 std::string CoordinateMapper::getRoadName(road_network::NodeID source, road_network::NodeID target) const {
     auto it = segment_map.find({source, target});
     if (it != segment_map.end()) {
@@ -71,18 +71,18 @@ int main(int argc, char **argv) {
     cout << "Using disruption threshold τ = " << road_network::DISRUPTION_THRESHOLD_TAU << "\n";
 
     // Load graph
-    ifstream gfs(graphFile);
-    if (!gfs.is_open()) {
+    Graph g;
+    try {
+        read_graph(g, graphFile);
+    } catch (const exception&) {
         cerr << "Failed to open graph file: " << graphFile << endl;
         return 1;
     }
-
-    Graph g;
-    read_graph(g, gfs);
-    gfs.close();
     global_graph_ptr = &g;
 
     Dynamic gd(g);
+    // Labels on the base graph, repaired in place once disruptions are queried in lazy mode
+    gd.buildRepairableIndex();
     gd.loadDisruptions(disruptionsFile);
 
     // --- Get source and target nodes from command line or use defaults
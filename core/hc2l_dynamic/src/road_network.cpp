@@ -3,6 +3,7 @@
 
 #include <vector>
 #include <queue>
+#include <deque>
 #include <cassert>
 #include <barrier>
 #include <algorithm>
@@ -10,11 +11,24 @@
 #include <cmath>
 #include <bitset>
 #include <unordered_set>
+#include <unordered_map>
 #include <thread>
 #include <atomic>
 #include <cstring>
 #include <random>
+#include <functional>
+
+#if defined(__x86_64__) || defined(__i386__)
+    #include <immintrin.h>
+    #define MIN_PLUS_SIMD // vectorized label scans, dispatched at runtime
+#endif
 #include <mutex>
+#include <fstream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "lazy_update_tracker.h"
 
 namespace road_network {
@@ -40,6 +54,11 @@ namespace road_network {
 static const NodeID NO_NODE = 0; // null value equivalent for integers identifying nodes
 static const SubgraphID NO_SUBGRAPH = 0; // used to indicate that node does not belong to any active subgraph
 static const uint16_t MAX_CUT_LEVEL = 58; // maximum height of decomposition tree; 58 bits to store binary path, plus 6 bits to store path length = 64 bit integer
+static const size_t GRAPH_CHUNK_SIZE = 1 << 20; // minimum number of bytes per thread when parsing graph files
+static const size_t LABEL_LANES = 8; // number of cut vertices labelled per traversal during index construction
+static const pair<double,double> INERTIAL_DIRECTIONS[] = { {1, 0}, {0, 1}, {1, 1}, {1, -1} }; // projection directions for inertial-flow partitioning
+static const double INERTIAL_FRACTION = 0.25; // maximum fraction of nodes used as sources or sinks for inertial-flow partitioning
+static const uint8_t MAX_ROAD_CLASS = 7; // road class of motorways, see road_class_rank
 
 // profiling
 #ifndef NPROFILE
@@ -53,6 +72,7 @@ static const uint16_t MAX_CUT_LEVEL = 58; // maximum height of decomposition tre
 
 // progress of 0 resets counter
 static bool log_progress_on = false;
+static FlowEngine flow_engine = FlowEngine::dinitz;
 void log_progress(size_t p, ostream &os = cout)
 {
     static const size_t P_DIFF = 1000000L;
@@ -250,6 +270,103 @@ bool is_ancestor(uint64_t bv_ancestor, uint64_t bv_descendant)
 
 }
 
+//--------------------------- Min-plus kernels ----------------------
+
+// label data is followed by this many readable bytes, so vectorized scans can end on a full-width load
+static const size_t LABEL_TAIL_PADDING = 64;
+
+// computes min(a[i] + b[i]) for i < n; labels are at most infinity, so sums cannot overflow
+typedef distance_t (*MinPlusKernel)(const distance_t *a, const distance_t *b, size_t n);
+
+static distance_t min_plus_scalar(const distance_t *a, const distance_t *b, size_t n)
+{
+    distance_t min_dist = infinity;
+    for (size_t i = 0; i < n; i++)
+    {
+        distance_t dist = a[i] + b[i];
+        if (dist < min_dist)
+            min_dist = dist;
+    }
+    return min_dist;
+}
+
+#ifdef MIN_PLUS_SIMD
+// partial last vectors read into tail padding, with lanes beyond n masked to infinity
+__attribute__((target("sse4.1")))
+static distance_t min_plus_sse41(const distance_t *a, const distance_t *b, size_t n)
+{
+    const __m128i inf = _mm_set1_epi32(infinity);
+    __m128i acc = inf;
+    for (size_t i = 0; i < n; i += 4)
+    {
+        __m128i dist = _mm_add_epi32(_mm_loadu_si128((const __m128i*)(a + i)), _mm_loadu_si128((const __m128i*)(b + i)));
+        if (i + 4 > n)
+        {
+            __m128i valid = _mm_cmplt_epi32(_mm_setr_epi32(0, 1, 2, 3), _mm_set1_epi32(n - i));
+            dist = _mm_blendv_epi8(inf, dist, valid);
+        }
+        acc = _mm_min_epu32(acc, dist);
+    }
+    acc = _mm_min_epu32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+    acc = _mm_min_epu32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(acc);
+}
+
+__attribute__((target("avx2")))
+static distance_t min_plus_avx2(const distance_t *a, const distance_t *b, size_t n)
+{
+    const __m256i inf = _mm256_set1_epi32(infinity);
+    __m256i acc = inf;
+    for (size_t i = 0; i < n; i += 8)
+    {
+        __m256i dist = _mm256_add_epi32(_mm256_loadu_si256((const __m256i*)(a + i)), _mm256_loadu_si256((const __m256i*)(b + i)));
+        if (i + 8 > n)
+        {
+            __m256i valid = _mm256_cmpgt_epi32(_mm256_set1_epi32(n - i), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+            dist = _mm256_blendv_epi8(inf, dist, valid);
+        }
+        acc = _mm256_min_epu32(acc, dist);
+    }
+    __m128i acc4 = _mm_min_epu32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    acc4 = _mm_min_epu32(acc4, _mm_shuffle_epi32(acc4, _MM_SHUFFLE(1, 0, 3, 2)));
+    acc4 = _mm_min_epu32(acc4, _mm_shuffle_epi32(acc4, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(acc4);
+}
+
+// masked loads suppress faults, so no padding is needed here
+__attribute__((target("avx512f")))
+static distance_t min_plus_avx512(const distance_t *a, const distance_t *b, size_t n)
+{
+    __m512i acc = _mm512_set1_epi32(infinity);
+    for (size_t i = 0; i < n; i += 16)
+    {
+        __mmask16 valid = i + 16 > n ? (__mmask16)((1u << (n - i)) - 1) : (__mmask16)0xFFFF;
+        __m512i dist = _mm512_add_epi32(_mm512_maskz_loadu_epi32(valid, a + i), _mm512_maskz_loadu_epi32(valid, b + i));
+        acc = _mm512_mask_min_epu32(acc, valid, acc, dist);
+    }
+    alignas(64) distance_t lanes[16];
+    _mm512_store_si512(lanes, acc);
+    return *min_element(lanes, lanes + 16);
+}
+#endif
+
+static MinPlusKernel select_min_plus_kernel()
+{
+#ifdef MIN_PLUS_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        return min_plus_avx512;
+    if (__builtin_cpu_supports("avx2"))
+        return min_plus_avx2;
+    if (__builtin_cpu_supports("sse4.1"))
+        return min_plus_sse41;
+#endif
+    return min_plus_scalar;
+}
+
+// selected once at startup, based on CPU features
+static const MinPlusKernel min_plus = select_min_plus_kernel();
+
 //--------------------------- FlatCutIndex --------------------------
 
 // helper function for memory alignment
@@ -274,7 +391,7 @@ FlatCutIndex::FlatCutIndex(const CutIndex &ci)
     // distance_offset is redundant to speed up distance pointer calculation, label_count permits truncated labels to be stored
     size_t distance_offset = sizeof(uint64_t) + 2 * sizeof(uint16_t) + aligned<distance_t>(ci.dist_index.size() * sizeof(uint16_t));
     size_t data_size = distance_offset + ci.distances.size() * sizeof(distance_t);
-    data = (char*)calloc(data_size, 1);
+    data = (char*)calloc(data_size + LABEL_TAIL_PADDING, 1);
     // copy partition bitvector, distance_offset, label_count, dist_index and distances into data
     *partition_bitvector() = PBV::from(ci.partition, ci.cut_level);
     *_distance_offset() = distance_offset;
@@ -449,10 +566,11 @@ static void clear_and_shrink(vector<T> &v)
     v.shrink_to_fit();
 }
 
-ContractionIndex::ContractionIndex(vector<CutIndex> &ci, vector<Neighbor> &closest)
+ContractionIndex::ContractionIndex(vector<CutIndex> &ci, vector<Neighbor> &closest, bool hierarchy_labels) : hierarchy_labels(hierarchy_labels)
 {
     assert(ci.size() == closest.size());
     labels.resize(ci.size());
+    blocks.resize(ci.size());
     // handle core nodes
     for (NodeID node = 1; node < closest.size(); node++)
     {
@@ -460,6 +578,7 @@ ContractionIndex::ContractionIndex(vector<CutIndex> &ci, vector<Neighbor> &close
         {
             assert(closest[node].distance == 0);
             labels[node].cut_index = FlatCutIndex(ci[node]);
+            blocks[node].reset(labels[node].cut_index.data, free);
         }
         // conserve memory
         clear_and_shrink(ci[node].dist_index);
@@ -492,13 +611,15 @@ ContractionIndex::ContractionIndex(vector<CutIndex> &ci, vector<Neighbor> &close
     clear_and_shrink(closest);
 }
 
-ContractionIndex::ContractionIndex(std::vector<CutIndex> &ci)
+ContractionIndex::ContractionIndex(std::vector<CutIndex> &ci) : hierarchy_labels(false)
 {
     labels.resize(ci.size());
+    blocks.resize(ci.size());
     for (NodeID node = 1; node < ci.size(); node++)
         if (!ci[node].empty())
         {
             labels[node].cut_index = FlatCutIndex(ci[node]);
+            blocks[node].reset(labels[node].cut_index.data, free);
             // conserve memory
             clear_and_shrink(ci[node].dist_index);
             clear_and_shrink(ci[node].distances);
@@ -506,23 +627,108 @@ ContractionIndex::ContractionIndex(std::vector<CutIndex> &ci)
     clear_and_shrink(ci);
 }
 
+ContractionIndex::ContractionIndex(const ContractionIndex &other)
+    : labels(other.labels), blocks(other.blocks), contracted_nodes(other.contracted_nodes), hierarchy_labels(other.hierarchy_labels)
+{
+    // label data stays shared until written, see get_writable_cut_index
+}
+
 ContractionIndex::~ContractionIndex()
 {
-    for (NodeID node = 1; node < labels.size(); node++)
-        // not all labels own their cut index data
-        if (!labels[node].cut_index.empty() && labels[node].distance_offset == 0)
-            free(labels[node].cut_index.data);
+    // label data is freed along with the last index sharing it
 }
 
 distance_t ContractionIndex::get_distance(NodeID v, NodeID w) const {
-    distance_t dist = get_distance(labels[v].cut_index, labels[w].cut_index)
-                    + labels[v].distance_offset
-                    + labels[w].distance_offset;
+    ContractionLabel cv = labels[v], cw = labels[w];
+    assert(!cv.cut_index.empty() && !cw.cut_index.empty());
+    if (cv.cut_index == cw.cut_index)
+    {
+        // nodes lie in same tree of contracted nodes
+        if (v == w)
+            return 0;
+        if (cv.distance_offset == 0)
+            return cw.distance_offset;
+        if (cw.distance_offset == 0)
+            return cv.distance_offset;
+        // find lowest common ancestor
+        NodeID v_anc = v, w_anc = w;
+        ContractionLabel cv_anc = cv, cw_anc = cw;
+        while (v_anc != w_anc)
+        {
+            if (cv_anc.distance_offset < cw_anc.distance_offset)
+            {
+                w_anc = cw_anc.parent;
+                cw_anc = labels[w_anc];
+            }
+            else if (cv_anc.distance_offset > cw_anc.distance_offset)
+            {
+                v_anc = cv_anc.parent;
+                cv_anc = labels[v_anc];
+            }
+            else
+            {
+                v_anc = cv_anc.parent;
+                w_anc = cw_anc.parent;
+                cv_anc = labels[v_anc];
+                cw_anc = labels[w_anc];
+            }
+        }
+        return cv.distance_offset + cw.distance_offset - 2 * cv_anc.distance_offset;
+    }
 
     // Note: Disruption handling is now done in the Dynamic class wrapper
+    distance_t d = hierarchy_labels ? get_hierarchy_distance(cv.cut_index, cw.cut_index) : get_distance(cv.cut_index, cw.cut_index);
+    // offsets of contracted nodes become infinite when tree edges get closed
+    return min<uint64_t>(infinity, static_cast<uint64_t>(cv.distance_offset) + cw.distance_offset + d);
+}
 
+ContractionLabel ContractionIndex::get_contraction_label(NodeID v) const
+{
+    return labels[v];
+}
+
+FlatCutIndex ContractionIndex::get_cut_index(NodeID v) const
+{
+    return labels[v].cut_index;
+}
+
+FlatCutIndex ContractionIndex::get_writable_cut_index(NodeID v)
+{
+    NodeID owner = v;
+    while (labels[owner].distance_offset != 0)
+        owner = labels[owner].parent;
+    shared_ptr<char> &block = blocks[owner];
+    if (block.use_count() > 1)
+    {
+        if (!contracted_nodes)
+        {
+            auto members = make_shared<vector<vector<NodeID>>>(labels.size());
+            for (NodeID node = 1; node < labels.size(); node++)
+                if (labels[node].distance_offset != 0)
+                {
+                    NodeID root = labels[node].parent;
+                    while (labels[root].distance_offset != 0)
+                        root = labels[root].parent;
+                    (*members)[root].push_back(node);
+                }
+            contracted_nodes = std::move(members);
+        }
+        size_t data_size = labels[owner].cut_index.size();
+        char *data = (char*)malloc(data_size + LABEL_TAIL_PADDING);
+        memcpy(data, block.get(), data_size + LABEL_TAIL_PADDING);
+        block.reset(data, free);
+        labels[owner].cut_index.data = data;
+        for (NodeID node : (*contracted_nodes)[owner])
+            labels[node].cut_index.data = data;
+    }
+    return labels[owner].cut_index;
+}
 
-    return dist;
+void ContractionIndex::update_distance_offset(NodeID n, distance_t d)
+{
+    // owners are identified by zero offset
+    assert(d > 0);
+    labels[n].distance_offset = d;
 }
 
 
@@ -555,22 +761,12 @@ size_t ContractionIndex::common_ancestor_count(NodeID v, NodeID w) const
 
 distance_t ContractionIndex::get_cut_level_distance(FlatCutIndex a, FlatCutIndex b, size_t cut_level)
 {
-    distance_t min_dist = infinity;
     uint16_t a_offset = get_offset(a.dist_index(), cut_level);
     uint16_t b_offset = get_offset(b.dist_index(), cut_level);
     const distance_t* a_ptr = a.distances() + a_offset;
     const distance_t* b_ptr = b.distances() + b_offset;
-    const distance_t* a_end = a_ptr + min(a.dist_index()[cut_level] - a_offset, b.dist_index()[cut_level] - b_offset);
     // find min 2-hop distance within partition
-    while (a_ptr != a_end)
-    {
-        distance_t dist = *a_ptr + *b_ptr;
-        if (dist < min_dist)
-            min_dist = dist;
-        a_ptr++;
-        b_ptr++;
-    }
-    return min_dist;
+    return min_plus(a_ptr, b_ptr, min(a.dist_index()[cut_level] - a_offset, b.dist_index()[cut_level] - b_offset));
 }
 
 size_t ContractionIndex::get_cut_level_hoplinks(FlatCutIndex a, FlatCutIndex b, size_t cut_level)
@@ -589,17 +785,7 @@ distance_t ContractionIndex::get_distance(FlatCutIndex a, FlatCutIndex b)
         min_dist = min(min_dist, get_cut_level_distance(a, b, cl));
 #else
     // no pruning means we have a continuous block to check
-    const distance_t* a_ptr = a.distances();
-    const distance_t* b_ptr = b.distances();
-    const distance_t* a_end = a_ptr + min(a.dist_index()[cut_level], b.dist_index()[cut_level]);
-    while (a_ptr != a_end)
-    {
-        distance_t dist = *a_ptr + *b_ptr;
-        if (dist < min_dist)
-            min_dist = dist;
-        a_ptr++;
-        b_ptr++;
-    }
+    min_dist = min_plus(a.distances(), b.distances(), min(a.dist_index()[cut_level], b.dist_index()[cut_level]));
 #endif
     return min_dist;
 #else
@@ -607,6 +793,13 @@ distance_t ContractionIndex::get_distance(FlatCutIndex a, FlatCutIndex b)
 #endif
 }
 
+distance_t ContractionIndex::get_hierarchy_distance(FlatCutIndex a, FlatCutIndex b)
+{
+    // distances to all common ancestors form a contiguous block ending with the lowest common cut
+    size_t cut_level = PBV::lca_level(*a.partition_bitvector(), *b.partition_bitvector());
+    return min_plus(a.distances(), b.distances(), min(a.dist_index()[cut_level], b.dist_index()[cut_level]));
+}
+
 bool ContractionIndex::is_contracted(NodeID node) const
 {
     return labels[node].parent != NO_NODE;
@@ -794,12 +987,13 @@ void ContractionIndex::write_json(std::ostream& os) const
     reset_list_format();
 }
 
-ContractionIndex::ContractionIndex(istream& is)
+ContractionIndex::ContractionIndex(istream& is) : hierarchy_labels(false)
 {
     // read index data
     size_t node_count = 0;
     is.read((char*)&node_count, sizeof(size_t));
     labels.resize(node_count + 1);
+    blocks.resize(node_count + 1);
     for (NodeID node = 1; node < labels.size(); node++)
     {
         ContractionLabel &cl = labels[node];
@@ -808,7 +1002,8 @@ ContractionIndex::ContractionIndex(istream& is)
         {
             size_t data_size = 0;
             is.read((char*)&data_size, sizeof(size_t));
-            cl.cut_index.data = (char*)malloc(data_size);
+            cl.cut_index.data = (char*)malloc(data_size + LABEL_TAIL_PADDING);
+            blocks[node].reset(cl.cut_index.data, free);
             is.read(cl.cut_index.data, data_size);
         }
         else
@@ -828,6 +1023,229 @@ ContractionIndex::ContractionIndex(istream& is)
     }
 }
 
+//--------------------------- Push-relabel --------------------------
+
+// compact flow network over local vertex ids, with arcs stored in adjacency arrays
+// and each arc paired with its reverse residual arc
+class FlowNetwork
+{
+    struct Arc
+    {
+        uint32_t from, to;
+        int32_t capacity;
+    };
+    uint32_t vertex_count = 0;
+    vector<Arc> added; // arcs in order of add_arc calls, until finalize
+    vector<uint32_t> first_arc, head, rev, position, fill_pos;
+    vector<int32_t> residual;
+    // push-relabel state
+    vector<uint32_t> height, current;
+    vector<int64_t> excess;
+    vector<uint8_t> active;
+    deque<uint32_t> fifo;
+    vector<uint32_t> bfs_queue;
+
+    void global_relabel(uint32_t root);
+    void push(uint32_t v, uint32_t arc, int64_t amount);
+    void relabel(uint32_t v);
+    // discharges active vertices towards root until none are left that can reach it
+    void discharge_all(uint32_t root, uint32_t other);
+public:
+    static const int32_t UNBOUNDED = INT32_MAX / 2;
+
+    // clears network, keeping allocated memory for reuse
+    void reset(uint32_t vertex_count);
+    // adds arc together with reverse residual arc of capacity 0; returns id for querying flow
+    uint32_t add_arc(uint32_t from, uint32_t to, int32_t capacity);
+    // converts arcs into adjacency arrays; no arcs may be added afterwards
+    void finalize();
+    // computes maximum s-t flow using two-phase FIFO push-relabel with global relabeling; returns flow value
+    int64_t max_flow(uint32_t s, uint32_t t);
+    // flow along arc with given id
+    int32_t flow(uint32_t arc_id) const;
+    // marks vertices reachable from root in residual network, or from which root is reachable if backward
+    void residual_reachable(uint32_t root, bool backward, vector<uint8_t> &reached);
+};
+
+// number of relabel scans per vertex and arc between global relabels
+static const size_t GLOBAL_RELABEL_FREQUENCY = 6;
+
+void FlowNetwork::reset(uint32_t vertex_count)
+{
+    this->vertex_count = vertex_count;
+    added.clear();
+}
+
+uint32_t FlowNetwork::add_arc(uint32_t from, uint32_t to, int32_t capacity)
+{
+    assert(from < vertex_count && to < vertex_count && capacity > 0);
+    added.push_back({ from, to, capacity });
+    return added.size() - 1;
+}
+
+void FlowNetwork::finalize()
+{
+    // count sort arcs and their reverses by tail
+    first_arc.assign(vertex_count + 1, 0);
+    for (const Arc &a : added)
+    {
+        first_arc[a.from + 1]++;
+        first_arc[a.to + 1]++;
+    }
+    for (uint32_t v = 0; v < vertex_count; v++)
+        first_arc[v + 1] += first_arc[v];
+    const size_t arc_count = 2 * added.size();
+    head.resize(arc_count);
+    rev.resize(arc_count);
+    residual.resize(arc_count);
+    position.resize(added.size());
+    fill_pos.assign(first_arc.begin(), first_arc.end() - 1);
+    for (size_t i = 0; i < added.size(); i++)
+    {
+        const Arc &a = added[i];
+        uint32_t forward = fill_pos[a.from]++, backward = fill_pos[a.to]++;
+        head[forward] = a.to;
+        head[backward] = a.from;
+        rev[forward] = backward;
+        rev[backward] = forward;
+        residual[forward] = a.capacity;
+        residual[backward] = 0;
+        position[i] = forward;
+    }
+    added.clear();
+}
+
+void FlowNetwork::global_relabel(uint32_t root)
+{
+    // exact residual distances to root; vertices cut off from root get vertex_count, which makes them inactive
+    height.assign(vertex_count, vertex_count);
+    height[root] = 0;
+    bfs_queue.assign(1, root);
+    for (size_t i = 0; i < bfs_queue.size(); i++)
+    {
+        uint32_t w = bfs_queue[i];
+        for (uint32_t a = first_arc[w]; a < first_arc[w + 1]; a++)
+        {
+            uint32_t u = head[a];
+            if (height[u] == vertex_count && residual[rev[a]] > 0)
+            {
+                height[u] = height[w] + 1;
+                bfs_queue.push_back(u);
+            }
+        }
+    }
+    for (uint32_t v = 0; v < vertex_count; v++)
+        current[v] = first_arc[v];
+}
+
+void FlowNetwork::push(uint32_t v, uint32_t arc, int64_t amount)
+{
+    uint32_t w = head[arc];
+    residual[arc] -= amount;
+    residual[rev[arc]] += amount;
+    excess[v] -= amount;
+    excess[w] += amount;
+    if (!active[w])
+    {
+        active[w] = true;
+        fifo.push_back(w);
+    }
+}
+
+void FlowNetwork::relabel(uint32_t v)
+{
+    uint32_t min_height = vertex_count;
+    for (uint32_t a = first_arc[v]; a < first_arc[v + 1]; a++)
+        if (residual[a] > 0)
+            min_height = min(min_height, height[head[a]] + 1);
+    height[v] = min_height;
+    current[v] = first_arc[v];
+}
+
+void FlowNetwork::discharge_all(uint32_t root, uint32_t other)
+{
+    global_relabel(root);
+    height[other] = vertex_count;
+    const size_t relabel_budget = GLOBAL_RELABEL_FREQUENCY * vertex_count + head.size();
+    size_t relabel_work = 0;
+    while (!fifo.empty())
+    {
+        uint32_t v = fifo.front();
+        fifo.pop_front();
+        active[v] = false;
+        while (excess[v] > 0 && height[v] < vertex_count)
+        {
+            if (current[v] == first_arc[v + 1])
+            {
+                relabel(v);
+                relabel_work += first_arc[v + 1] - first_arc[v];
+                continue;
+            }
+            uint32_t a = current[v];
+            if (residual[a] > 0 && height[v] == height[head[a]] + 1)
+                push(v, a, min<int64_t>(excess[v], residual[a]));
+            else
+                current[v]++;
+        }
+        if (relabel_work > relabel_budget)
+        {
+            global_relabel(root);
+            height[other] = vertex_count;
+            relabel_work = 0;
+        }
+    }
+}
+
+int64_t FlowNetwork::max_flow(uint32_t s, uint32_t t)
+{
+    assert(added.empty());
+    excess.assign(vertex_count, 0);
+    current.resize(vertex_count);
+    active.assign(vertex_count, false);
+    fifo.clear();
+    // s and t never become active
+    active[s] = active[t] = true;
+    for (uint32_t a = first_arc[s]; a < first_arc[s + 1]; a++)
+        if (residual[a] > 0)
+            push(s, a, residual[a]);
+    // phase one finds a maximum preflow, moving excess towards t only
+    discharge_all(t, s);
+    // phase two returns remaining excess to s, turning the preflow into a flow
+    for (uint32_t v = 0; v < vertex_count; v++)
+        if (excess[v] > 0 && !active[v])
+        {
+            active[v] = true;
+            fifo.push_back(v);
+        }
+    discharge_all(s, t);
+    return excess[t];
+}
+
+int32_t FlowNetwork::flow(uint32_t arc_id) const
+{
+    return residual[rev[position[arc_id]]];
+}
+
+void FlowNetwork::residual_reachable(uint32_t root, bool backward, vector<uint8_t> &reached)
+{
+    reached.assign(vertex_count, false);
+    reached[root] = true;
+    bfs_queue.assign(1, root);
+    for (size_t i = 0; i < bfs_queue.size(); i++)
+    {
+        uint32_t v = bfs_queue[i];
+        for (uint32_t a = first_arc[v]; a < first_arc[v + 1]; a++)
+        {
+            uint32_t w = head[a];
+            if (!reached[w] && residual[backward ? rev[a] : a] > 0)
+            {
+                reached[w] = true;
+                bfs_queue.push_back(w);
+            }
+        }
+    }
+}
+
 //--------------------------- Graph ---------------------------------
 
 SubgraphID next_subgraph_id(bool reset)
@@ -895,6 +1313,17 @@ distance_t DiffData::min() const
     return std::min(dist_a, dist_b);
 }
 
+void WeightOverlay::clear()
+{
+    changes.clear();
+    version++;
+}
+
+bool WeightOverlay::empty() const
+{
+    return changes.empty();
+}
+
 DiffData::DiffData(NodeID node, distance_t dist_a, distance_t dist_b) : node(node), dist_a(dist_a), dist_b(dist_b)
 {
 }
@@ -917,12 +1346,38 @@ vector<vector<NodeID>> Graph::deg2paths;
 #endif
 NodeID Graph::s, Graph::t;
 vector<NodeID> Graph::node_order;
+// planar node coordinates for inertial-flow partitioning; only set during create_cut_index, NaN for nodes without coordinates
+static vector<double> partition_x, partition_y;
+// road class priors for cut vertices; only set during create_cut_index, 0 for nodes without road class
+static vector<uint8_t> node_road_class;
+const WeightOverlay *Graph::overlay = nullptr;
+uint64_t Graph::overlay_version = 0;
+vector<WeightOverlay::Change> Graph::overlay_base;
+// base weights of slots changed by the active overlay, keyed by node << 32 | slot
+static unordered_map<uint64_t, distance_t> overlay_base_weights;
+
+#ifdef MULTI_THREAD
+// pool running subgraph recursion and label searches during index construction; sized by create_cut_index
+static unique_ptr<util::TaskPool> construction_tasks;
+
+static util::TaskPool& construction_pool()
+{
+    if (!construction_tasks)
+        construction_tasks = make_unique<util::TaskPool>();
+    return *construction_tasks;
+}
+#endif
 
 void Graph::show_progress(bool state)
 {
     log_progress_on = state;
 }
 
+void Graph::set_flow_engine(FlowEngine engine)
+{
+    flow_engine = engine;
+}
+
 bool Graph::contains(NodeID node) const
 {
     return node_data[node].subgraph_id == subgraph_id;
@@ -982,6 +1437,55 @@ void Graph::add_edge(NodeID v, NodeID w, distance_t distance, bool add_reverse,
         add_edge(w, v, distance, false, merged);
 }
 
+void Graph::add_edges(const vector<Edge> &edges)
+{
+    // counting sort of both arc directions by tail, keeping input order within each adjacency list
+    vector<uint32_t> offsets(node_data.size() + 1, 0);
+    for (const Edge &e : edges)
+    {
+        assert(e.from < node_data.size() && e.to < node_data.size());
+        assert(e.base_weight > 0);
+        offsets[e.from + 1]++;
+        offsets[e.to + 1]++;
+    }
+    for (size_t i = 1; i < offsets.size(); i++)
+        offsets[i] += offsets[i - 1];
+    vector<Neighbor> arcs(offsets.back(), Neighbor(NO_NODE, 0));
+    vector<uint32_t> next(offsets.begin(), offsets.end() - 1);
+    for (const Edge &e : edges)
+    {
+        arcs[next[e.from]++] = Neighbor(e.to, static_cast<distance_t>(e.base_weight));
+        arcs[next[e.to]++] = Neighbor(e.from, static_cast<distance_t>(e.base_weight));
+    }
+    // merge parallel edges like add_edge with merge set does: first position, minimal distance
+    vector<NodeID> last_tail(node_data.size(), node_data.size());
+    vector<uint32_t> position(node_data.size());
+    for (NodeID v = 0; v < node_data.size(); v++)
+    {
+        vector<Neighbor> &neighbors = node_data[v].neighbors;
+        assert(neighbors.empty());
+        neighbors.reserve(offsets[v + 1] - offsets[v]);
+        for (uint32_t i = offsets[v]; i < offsets[v + 1]; i++)
+        {
+            Neighbor n = arcs[i];
+            if (last_tail[n.node] == v)
+                neighbors[position[n.node]].distance = min(neighbors[position[n.node]].distance, n.distance);
+            else
+            {
+                last_tail[n.node] = v;
+                position[n.node] = neighbors.size();
+                neighbors.push_back(n);
+            }
+        }
+    }
+}
+
+void Graph::set_neighbors(NodeID v, span<const Neighbor> neighbors)
+{
+    assert(v < node_data.size());
+    node_data[v].neighbors.assign(neighbors.begin(), neighbors.end());
+}
+
 void Graph::remove_edge(NodeID v, NodeID w)
 {
     std::erase_if(node_data[v].neighbors, [w](const Neighbor &n) { return n.node == w; });
@@ -1178,93 +1682,52 @@ void Graph::run_dijkstra(NodeID v)
     }
 }
 
-void Graph::run_dijkstra_with_parents(NodeID v)
+std::pair<distance_t, std::vector<NodeID>> Graph::get_path_dijkstra(NodeID v, NodeID w, bool weighted)
 {
-    CHECK_CONSISTENT;
-    assert(contains(v));
-    // init distances and parents
-    for (NodeID node : nodes)
-    {
-        node_data[node].distance = infinity;
-        node_data[node].parent = NO_NODE;
-    }
-    node_data[v].distance = 0;
-    node_data[v].parent = v; // source is its own parent
-    
-    // init queue
-    priority_queue<SearchNode> q;
-    q.push(SearchNode(0, v));
-    
-    // dijkstra with parent tracking
-    while (!q.empty())
+    // path search is always weighted, as BFS does not track parents
+    (void)weighted;
+    return get_shortest_path(v, w);
+}
+
+std::pair<distance_t, std::vector<NodeID>> Graph::get_path_from_index(NodeID v, NodeID w, const ContractionIndex &ci, const WeightTable *weights) const
+{
+    // weights tables describe the full graph, and may be read while other threads search subgraphs
+    assert(weights || (contains(v) && contains(w)));
+    if (max(v, w) >= ci.num_nodes())
+        return make_pair(infinity, vector<NodeID>());
+    const distance_t distance = ci.get_distance(v, w);
+    vector<NodeID> path;
+    if (distance >= infinity)
+        return make_pair(infinity, path);
+    // walk towards w, always moving to a neighbor whose edge weight plus index distance to w stays tight
+    path.push_back(v);
+    NodeID current = v;
+    distance_t remaining = distance;
+    while (current != w)
     {
-        SearchNode next = q.top();
-        q.pop();
-
-        for (Neighbor n : node_data[next.node].neighbors)
+        NodeID next = NO_NODE;
+        distance_t next_remaining = 0;
+        for (const Neighbor &n : weights ? (*weights)[current] : node_data[current].neighbors)
         {
-            // filter neighbors nodes not belonging to subgraph
-            if (!contains(n.node))
+            // closed edges carry infinite weight; zero-weight edges make no progress and could cycle
+            if (n.distance == 0 || n.distance > remaining || (!weights && !contains(n.node)) || n.node >= ci.num_nodes())
                 continue;
-            // update distance and parent, then enqueue
-            distance_t new_dist = next.distance + n.distance;
-            if (new_dist < node_data[n.node].distance)
+            distance_t n_remaining = n.node == w ? 0 : ci.get_distance(n.node, w);
+            if (n.distance + n_remaining == remaining)
             {
-                node_data[n.node].distance = new_dist;
-                node_data[n.node].parent = next.node; // track parent for path reconstruction
-                q.push(SearchNode(new_dist, n.node));
+                next = n.node;
+                next_remaining = n_remaining;
+                break;
             }
         }
+        // index does not match current edge weights
+        if (next == NO_NODE)
+            return make_pair(distance, vector<NodeID>());
+        path.push_back(next);
+        current = next;
+        remaining = next_remaining;
     }
-}
-
-std::vector<NodeID> Graph::reconstruct_path(NodeID source, NodeID target)
-{
-    std::vector<NodeID> path;
-    
-    // Check if target is reachable
-    if (node_data[target].distance == infinity)
-        return path; // empty path if unreachable
-    
-    // Reconstruct path by following parent pointers backward
-    NodeID current = target;
-    while (current != source)
-    {
-        path.push_back(current);
-        current = node_data[current].parent;
-        
-        // Safety check to avoid infinite loops
-        if (current == NO_NODE)
-        {
-            path.clear();
-            return path; // return empty path if something went wrong
-        }
-    }
-    path.push_back(source);
-    
-    // Reverse to get path from source to target
-    std::reverse(path.begin(), path.end());
-    return path;
-}
-
-std::pair<distance_t, std::vector<NodeID>> Graph::get_path_dijkstra(NodeID v, NodeID w, bool weighted)
-{
-    assert(contains(v) && contains(w));
-    
-    // Run Dijkstra with parent tracking
-    if (weighted)
-        run_dijkstra_with_parents(v);
-    else
-    {
-        // For unweighted case, we'll use the weighted version anyway since BFS doesn't track parents yet
-        // We could implement run_bfs_with_parents() later if needed for performance
-        run_dijkstra_with_parents(v);
-    }
-    
-    distance_t distance = node_data[w].distance;
-    std::vector<NodeID> path = reconstruct_path(v, w);
-    
-    return std::make_pair(distance, path);
+    return make_pair(distance, path);
 }
 
 void Graph::run_dijkstra_llsub(NodeID v)
@@ -1345,56 +1808,99 @@ void Graph::run_dijkstra_ll(NodeID v)
 }
 #endif
 
-#ifdef MULTI_THREAD_DISTANCES
-void Graph::run_dijkstra_par(const vector<NodeID> &vertices)
+// distances from up to LABEL_LANES sources, so that relaxing an edge for all of them is a single vector operation
+struct alignas(LABEL_LANES * sizeof(distance_t)) LaneDistances
+{
+    distance_t lane[LABEL_LANES];
+};
+
+// per-thread state of run_dijkstra_llsub_multi, indexed by node
+struct MultiSourceWorkspace
+{
+    vector<LaneDistances> distances;
+    vector<uint8_t> queued; // set while improvements of a node remain to be propagated
+};
+
+static thread_local MultiSourceWorkspace multi_source_workspace;
+
+void Graph::run_dijkstra_llsub_multi(const vector<NodeID> &cut, size_t first, vector<CutIndex> &ci)
 {
     CHECK_CONSISTENT;
-    vector<thread> threads;
-    auto dijkstra = [this](NodeID v, size_t distance_id) {
+    const size_t lanes = min(LABEL_LANES, cut.size() - first);
+    MultiSourceWorkspace &ws = multi_source_workspace;
+    if (ws.distances.size() < node_data.size())
+    {
+        ws.distances.resize(node_data.size());
+        ws.queued.resize(node_data.size(), false);
+    }
+    // pruning level of each lane; unused lanes get level 0, which excludes every node
+    distance_t pruning_level[LABEL_LANES] = {};
+    for (size_t l = 0; l < lanes; l++)
+        pruning_level[l] = node_data[cut[first + l]].landmark_level;
+    // init distances
+    LaneDistances unreached;
+    fill(unreached.lane, unreached.lane + LABEL_LANES, infinity);
+    for (NodeID node : nodes)
+        ws.distances[node] = unreached;
+    // init queue
+    priority_queue<SearchNode> q;
+    for (size_t l = 0; l < lanes; l++)
+    {
+        NodeID v = cut[first + l];
         assert(contains(v));
-        assert(distance_id < MULTI_THREAD_DISTANCES);
-        // init distances
-        for (NodeID node : nodes)
-            node_data[node].distances[distance_id] = infinity;
-        node_data[v].distances[distance_id] = 0;
-        // init queue
-        priority_queue<SearchNode> q;
+        ws.distances[v].lane[l] = 0;
+        ws.queued[v] = true;
         q.push(SearchNode(0, v));
-        // dijkstra
-        while (!q.empty())
-        {
-            SearchNode next = q.top();
-            q.pop();
+    }
+    // label-correcting search over all lanes, ordered by smallest improved distance; a node is
+    // rescanned if some lane improves after it was scanned, and stale queue entries are skipped
+    while (!q.empty())
+    {
+        NodeID next = q.top().node;
+        q.pop();
+        if (!ws.queued[next])
+            continue;
+        ws.queued[next] = false;
 
-            for (Neighbor n : node_data[next.node].neighbors)
+        const LaneDistances current = ws.distances[next];
+        for (Neighbor n : node_data[next].neighbors)
+        {
+            // filter neighbors nodes not belonging to subgraph
+            if (!contains(n.node))
+                continue;
+            // lanes may not enter nodes with landmark level at least their own
+            const distance_t n_level = node_data[n.node].landmark_level;
+            LaneDistances &n_dist = ws.distances[n.node];
+            distance_t min_improved = infinity;
+            for (size_t l = 0; l < LABEL_LANES; l++)
             {
-                // filter neighbors nodes not belonging to subgraph
-                if (!contains(n.node))
-                    continue;
-                // update distance and enque
-                distance_t new_dist = next.distance + n.distance;
-                if (new_dist < node_data[n.node].distances[distance_id])
-                {
-                    node_data[n.node].distances[distance_id] = new_dist;
-                    q.push(SearchNode(new_dist, n.node));
-                }
+                distance_t new_dist = n_level >= pruning_level[l] ? infinity : current.lane[l] + n.distance;
+                min_improved = new_dist < n_dist.lane[l] ? min(min_improved, new_dist) : min_improved;
+                n_dist.lane[l] = min(n_dist.lane[l], new_dist);
+            }
+            if (min_improved < infinity)
+            {
+                ws.queued[n.node] = true;
+                q.push(SearchNode(min_improved, n.node));
             }
         }
-    };
-    for (size_t i = 0; i < vertices.size(); i++)
-        threads.push_back(thread(dijkstra, vertices[i], i));
-    for (size_t i = 0; i < vertices.size(); i++)
-        threads[i].join();
+    }
+    // write into slots reserved for cut
+    for (NodeID node : nodes)
+    {
+        vector<distance_t> &distances = ci[node].distances;
+        copy(ws.distances[node].lane, ws.distances[node].lane + lanes, distances.end() - cut.size() + first);
+    }
+    log_progress(nodes.size() * lanes);
 }
 
-void Graph::run_dijkstra_llsub_par(const std::vector<NodeID> &vertices)
+#ifdef MULTI_THREAD_DISTANCES
+void Graph::run_dijkstra_par(const vector<NodeID> &vertices)
 {
     CHECK_CONSISTENT;
-    vector<thread> threads;
     auto dijkstra = [this](NodeID v, size_t distance_id) {
         assert(contains(v));
         assert(distance_id < MULTI_THREAD_DISTANCES);
-        const uint16_t pruning_level = node_data[v].landmark_level;
         // init distances
         for (NodeID node : nodes)
             node_data[node].distances[distance_id] = infinity;
@@ -1410,31 +1916,29 @@ void Graph::run_dijkstra_llsub_par(const std::vector<NodeID> &vertices)
 
             for (Neighbor n : node_data[next.node].neighbors)
             {
-                Node &n_data = node_data[n.node];
-                // filter neighbors nodes not belonging to subgraph or having higher landmark level
-                if (!contains(n.node) || n_data.landmark_level >= pruning_level)
+                // filter neighbors nodes not belonging to subgraph
+                if (!contains(n.node))
                     continue;
                 // update distance and enque
                 distance_t new_dist = next.distance + n.distance;
-                if (new_dist < n_data.distances[distance_id])
+                if (new_dist < node_data[n.node].distances[distance_id])
                 {
-                    n_data.distances[distance_id] = new_dist;
+                    node_data[n.node].distances[distance_id] = new_dist;
                     q.push(SearchNode(new_dist, n.node));
                 }
             }
         }
     };
+    util::TaskPool::TaskGroup group(construction_pool());
     for (size_t i = 0; i < vertices.size(); i++)
-        threads.push_back(thread(dijkstra, vertices[i], i));
-    for (size_t i = 0; i < vertices.size(); i++)
-        threads[i].join();
+        group.spawn([&dijkstra, &vertices, i] { dijkstra(vertices[i], i); });
+    group.wait();
 }
 
 #ifdef PRUNING
 void Graph::run_dijkstra_ll_par(const vector<NodeID> &vertices)
 {
     CHECK_CONSISTENT;
-    vector<thread> threads;
     auto dijkstra = [this](NodeID v, size_t distance_id) {
         assert(contains(v));
         assert(distance_id < MULTI_THREAD_DISTANCES);
@@ -1474,10 +1978,10 @@ void Graph::run_dijkstra_ll_par(const vector<NodeID> &vertices)
             }
         }
     };
+    util::TaskPool::TaskGroup group(construction_pool());
     for (size_t i = 0; i < vertices.size(); i++)
-        threads.push_back(thread(dijkstra, vertices[i], i));
-    for (size_t i = 0; i < vertices.size(); i++)
-        threads[i].join();
+        group.spawn([&dijkstra, &vertices, i] { dijkstra(vertices[i], i); });
+    group.wait();
 }
 #endif
 #endif
@@ -1811,6 +2315,110 @@ distance_t Graph::get_distance(NodeID v, NodeID w, bool weighted)
     return node_data[w].distance;
 }
 
+// per-thread state for shortest path searches, indexed by node; entries only count if stamped by the current search
+struct PathSearchWorkspace
+{
+    vector<distance_t> distance[2];
+    vector<NodeID> parent[2];
+    vector<uint32_t> stamp[2];
+    uint32_t current_stamp = 0;
+
+    void start(size_t node_count)
+    {
+        for (int side = 0; side < 2; side++)
+            if (stamp[side].size() < node_count)
+            {
+                distance[side].resize(node_count);
+                parent[side].resize(node_count);
+                stamp[side].resize(node_count, 0);
+            }
+        // after wrap-around, stale stamps could match again
+        if (++current_stamp == 0)
+        {
+            for (int side = 0; side < 2; side++)
+                fill(stamp[side].begin(), stamp[side].end(), 0);
+            current_stamp = 1;
+        }
+    }
+    bool reached(int side, NodeID node) const
+    {
+        return stamp[side][node] == current_stamp;
+    }
+    void reach(int side, NodeID node, distance_t dist, NodeID parent_node)
+    {
+        stamp[side][node] = current_stamp;
+        distance[side][node] = dist;
+        parent[side][node] = parent_node;
+    }
+};
+
+static thread_local PathSearchWorkspace path_workspace;
+
+pair<distance_t, vector<NodeID>> Graph::get_shortest_path(NodeID v, NodeID w, const function<bool(NodeID,NodeID)> &edge_filter) const
+{
+    assert(contains(v) && contains(w));
+    if (v == w)
+        return make_pair(0, vector<NodeID>(1, v));
+    PathSearchWorkspace &ws = path_workspace;
+    ws.start(node_data.size());
+    // side 0 searches forward from v, side 1 backward from w
+    typedef pair<distance_t,NodeID> QueueEntry;
+    priority_queue<QueueEntry, vector<QueueEntry>, greater<QueueEntry>> q[2];
+    const NodeID root[2] = { v, w };
+    for (int side = 0; side < 2; side++)
+    {
+        ws.reach(side, root[side], 0, NO_NODE);
+        q[side].push(QueueEntry(0, root[side]));
+    }
+    // shortest connection found so far, via edge from meet_forward to meet_backward
+    distance_t best = infinity;
+    NodeID meet_forward = NO_NODE, meet_backward = NO_NODE;
+    while (!q[0].empty() && !q[1].empty())
+    {
+        // frontiers have met once no shorter connection is possible
+        if (q[0].top().first + q[1].top().first >= best)
+            break;
+        const int side = q[0].top().first <= q[1].top().first ? 0 : 1;
+        const QueueEntry next = q[side].top();
+        q[side].pop();
+        // skip outdated queue entries
+        if (next.first > ws.distance[side][next.second])
+            continue;
+        for (const Neighbor &n : node_data[next.second].neighbors)
+        {
+            // filter closed edges and neighbors not belonging to subgraph
+            if (n.distance >= infinity || !contains(n.node))
+                continue;
+            if (edge_filter && !(side == 0 ? edge_filter(next.second, n.node) : edge_filter(n.node, next.second)))
+                continue;
+            const distance_t new_dist = next.first + n.distance;
+            if (new_dist >= best)
+                continue;
+            if (!ws.reached(side, n.node) || new_dist < ws.distance[side][n.node])
+            {
+                ws.reach(side, n.node, new_dist, next.second);
+                q[side].push(QueueEntry(new_dist, n.node));
+            }
+            if (ws.reached(1 - side, n.node) && new_dist + ws.distance[1 - side][n.node] < best)
+            {
+                best = new_dist + ws.distance[1 - side][n.node];
+                meet_forward = side == 0 ? next.second : n.node;
+                meet_backward = side == 0 ? n.node : next.second;
+            }
+        }
+    }
+    if (best >= infinity)
+        return make_pair(infinity, vector<NodeID>());
+    // join forward and backward search trees at meeting edge
+    vector<NodeID> path;
+    for (NodeID node = meet_forward; node != NO_NODE; node = ws.parent[0][node])
+        path.push_back(node);
+    reverse(path.begin(), path.end());
+    for (NodeID node = meet_backward; node != NO_NODE; node = ws.parent[1][node])
+        path.push_back(node);
+    return make_pair(best, path);
+}
+
 pair<NodeID,distance_t> Graph::get_furthest(NodeID v, bool weighted)
 {
     NodeID furthest = v;
@@ -1978,6 +2586,80 @@ bool Graph::get_rough_partition(Partition &p, double balance, bool disconnected)
     return false;
 }
 
+// sum of road classes over given nodes
+static size_t road_class_sum(const vector<NodeID> &nodes)
+{
+    size_t sum = 0;
+    if (!node_road_class.empty())
+        for (NodeID node : nodes)
+            sum += node_road_class[node];
+    return sum;
+}
+
+bool Graph::get_inertial_partition(Partition &p, double balance)
+{
+    DEBUG("get_inertial_partition on " << *this);
+    CHECK_CONSISTENT;
+    assert(p.left.empty() && p.cut.empty() && p.right.empty());
+    for (NodeID node : nodes)
+        if (node >= partition_x.size() || isnan(partition_x[node]) || isnan(partition_y[node]))
+            return false;
+    // get partition bounds as for rough partition, but keep enough nodes in between for flow to choose from
+    size_t max_left = min(nodes.size() / 2, static_cast<size_t>(ceil(nodes.size() * min(balance, INERTIAL_FRACTION))));
+    size_t min_right = nodes.size() - max_left;
+    // for each direction, use extreme nodes on either side as sources and sinks
+    vector<vector<NodeID>> candidates;
+    vector<pair<double,NodeID>> projection(nodes.size());
+    for (pair<double,double> direction : INERTIAL_DIRECTIONS)
+    {
+        for (size_t i = 0; i < nodes.size(); i++)
+        {
+            NodeID node = nodes[i];
+            projection[i] = make_pair(direction.first * partition_x[node] + direction.second * partition_y[node], node);
+        }
+        nth_element(projection.begin(), projection.begin() + max_left, projection.end());
+        nth_element(projection.begin() + max_left, projection.begin() + min_right, projection.end());
+        Partition rough;
+        for (size_t i = 0; i < projection.size(); i++)
+        {
+            if (i < max_left)
+                rough.left.push_back(projection[i].second);
+            else if (i < min_right)
+                rough.cut.push_back(projection[i].second);
+            else
+                rough.right.push_back(projection[i].second);
+        }
+        vector<vector<NodeID>> cuts;
+        rough_partition_to_cuts(cuts, rough);
+        for (vector<NodeID> &cut : cuts)
+            candidates.push_back(std::move(cut));
+    }
+    DEBUG("inertial cuts=" << candidates);
+    // tiny graphs may yield no cuts at all, leave those to the rough partition
+    if (candidates.empty())
+        return false;
+    // completing a partition requires a full traversal, so only do so for the smallest cuts,
+    // preferring those through arterial roads
+    size_t min_cut_size = candidates[0].size(), max_cut_class = 0;
+    for (const vector<NodeID> &cut : candidates)
+        min_cut_size = min(min_cut_size, cut.size());
+    for (const vector<NodeID> &cut : candidates)
+        if (cut.size() == min_cut_size)
+            max_cut_class = max(max_cut_class, road_class_sum(cut));
+    bool found = false;
+    for (vector<NodeID> &cut : candidates)
+        if (cut.size() == min_cut_size && road_class_sum(cut) == max_cut_class)
+        {
+            Partition p_alt;
+            p_alt.cut = std::move(cut);
+            complete_partition(p_alt);
+            if (!found || p.rating() < p_alt.rating())
+                p = p_alt;
+            found = true;
+        }
+    return found;
+}
+
 void Graph::min_vertex_cuts(vector<vector<NodeID>> &cuts)
 {
     DEBUG("min_vertex_cut over " << *this);
@@ -2156,6 +2838,76 @@ void Graph::min_vertex_cuts(vector<vector<NodeID>> &cuts)
     DEBUG("cuts=" << cuts);
 }
 
+void Graph::min_vertex_cuts_push_relabel(vector<vector<NodeID>> &cuts)
+{
+    DEBUG("min_vertex_cuts_push_relabel over " << *this);
+    CHECK_CONSISTENT;
+    assert(contains(s) && contains(t));
+    static const uint32_t NO_ARC = UINT32_MAX;
+    // local copy of flow graph: node i is split into incoming copy 2i and outgoing copy 2i+1, followed by s and t;
+    // local ids are kept in distance field, which Dinitz' algorithm uses for BFS
+    vector<NodeID> local_nodes;
+    for (NodeID node : nodes)
+        if (node != s && node != t)
+        {
+            node_data[node].distance = local_nodes.size();
+            local_nodes.push_back(node);
+        }
+    const uint32_t local_s = 2 * local_nodes.size(), local_t = local_s + 1;
+    // with road classes, cutting a node costs a large base minus its class: any smaller cut is still cheaper,
+    // but among cuts of equal size those through arterial roads win
+    const int32_t base_capacity = node_road_class.empty() ? 1 : MAX_ROAD_CLASS * local_nodes.size() + 1;
+    assert(base_capacity < FlowNetwork::UNBOUNDED);
+    static thread_local FlowNetwork network;
+    network.reset(local_t + 1);
+    vector<uint32_t> inner_arc(local_nodes.size()), s_arc(local_nodes.size(), NO_ARC), t_arc(local_nodes.size(), NO_ARC);
+    for (uint32_t i = 0; i < local_nodes.size(); i++)
+    {
+        const int32_t capacity = base_capacity - (node_road_class.empty() ? 0 : node_road_class[local_nodes[i]]);
+        inner_arc[i] = network.add_arc(2 * i, 2 * i + 1, capacity);
+        for (Neighbor n : node_data[local_nodes[i]].neighbors)
+        {
+            if (n.node == s)
+                s_arc[i] = network.add_arc(local_s, 2 * i, capacity);
+            else if (n.node == t)
+                t_arc[i] = network.add_arc(2 * i + 1, local_t, capacity);
+            else if (contains(n.node))
+                network.add_arc(2 * i + 1, 2 * node_data[n.node].distance, FlowNetwork::UNBOUNDED);
+        }
+    }
+    network.finalize();
+    network.max_flow(local_s, local_t);
+    // the min cuts closest to t and to s are the same for every max flow, so without road classes these match the cuts found by Dinitz' algorithm
+    assert(cuts.empty());
+    cuts.resize(1);
+    vector<uint8_t> reached;
+    network.residual_reachable(local_t, true, reached);
+    for (uint32_t i = 0; i < local_nodes.size(); i++)
+    {
+        if (network.flow(inner_arc[i]) == 0)
+            continue;
+        // cut inner edge, or edge to t if outgoing copy cannot reach t
+        if (reached[2 * i + 1] ? !reached[2 * i] : t_arc[i] != NO_ARC && network.flow(t_arc[i]) > 0)
+            cuts[0].push_back(local_nodes[i]);
+    }
+#ifdef MULTI_CUT
+    cuts.resize(2);
+    network.residual_reachable(local_s, false, reached);
+    for (uint32_t i = 0; i < local_nodes.size(); i++)
+    {
+        if (network.flow(inner_arc[i]) == 0)
+            continue;
+        // cut inner edge, or edge from s if incoming copy is unreachable from s
+        if (reached[2 * i] ? !reached[2 * i + 1] : s_arc[i] != NO_ARC && network.flow(s_arc[i]) > 0)
+            cuts[1].push_back(local_nodes[i]);
+    }
+    // eliminate potential duplicate
+    if (cuts[0] == cuts[1])
+        cuts.resize(1);
+#endif
+    DEBUG("cuts=" << cuts);
+}
+
 void Graph::get_connected_components(vector<vector<NodeID>> &components)
 {
     CHECK_CONSISTENT;
@@ -2236,8 +2988,11 @@ void Graph::rough_partition_to_cuts(vector<vector<NodeID>> &cuts, const Partitio
         center.add_edge(s, node, 1, true);
     for (NodeID node : t_neighbors)
         center.add_edge(t, node, 1, true);
-    // find minimum cut
-    center.min_vertex_cuts(cuts);
+    // find minimum cut; our implementation of Dinitz' algorithm is limited to unit capacities, so road classes require push-relabel
+    if (flow_engine == FlowEngine::push_relabel || !node_road_class.empty())
+        center.min_vertex_cuts_push_relabel(cuts);
+    else
+        center.min_vertex_cuts(cuts);
     // revert s-t addition
     for (NodeID node : t_neighbors)
     {
@@ -2295,6 +3050,12 @@ void Graph::create_partition(Partition &p, double balance)
         }
         return;
     }
+    // use node coordinates if available
+    if (!partition_x.empty() && get_inertial_partition(p, balance))
+    {
+        DEBUG("get_inertial_partition found partition=" << p);
+        return;
+    }
     // find initial rough partition
 #ifdef NO_SHORTCUTS
     bool is_fine = get_rough_partition(p, balance, true);
@@ -2464,8 +3225,15 @@ void Graph::sort_cut_for_pruning(vector<NodeID> &cut, [[maybe_unused]] vector<Cu
         }
     }
 #endif
-    // sort cut
-    sort(pruning_potential.begin(), pruning_potential.end());
+    // sort cut, putting arterial roads first among nodes of equal pruning potential
+    auto road_class = [](NodeID node) { return node_road_class.empty() ? 0 : node_road_class[node]; };
+    sort(pruning_potential.begin(), pruning_potential.end(), [&road_class](const pair<size_t,NodeID> &a, const pair<size_t,NodeID> &b) {
+        if (a.first != b.first)
+            return a.first < b.first;
+        if (road_class(a.second) != road_class(b.second))
+            return road_class(a.second) > road_class(b.second);
+        return a.second < b.second;
+    });
     for (size_t c = 0; c < cut.size(); c++)
         cut[c] = pruning_potential[c].second;
 }
@@ -2545,6 +3313,10 @@ void Graph::extend_cut_index(vector<CutIndex> &ci, double balance, uint8_t cut_l
     START_TIMER;
 #ifdef PRUNING
     sort_cut_for_pruning(p.cut, ci);
+#else
+    // put arterial roads first, giving them the highest landmark levels (with PRUNING, only among nodes of equal pruning potential)
+    if (!node_road_class.empty())
+        stable_sort(p.cut.begin(), p.cut.end(), [](NodeID a, NodeID b) { return node_road_class[a] > node_road_class[b]; });
 #endif
     for (size_t c = 0; c < p.cut.size(); c++)
         node_data[p.cut[c]].landmark_level = p.cut.size() - c;
@@ -2562,7 +3334,9 @@ void Graph::extend_cut_index(vector<CutIndex> &ci, double balance, uint8_t cut_l
         node_data[c].deg2path_ids.clear();
     }
 #endif
-#ifdef MULTI_THREAD_DISTANCES
+#ifdef PRUNING
+    // when tail-pruning, we store distances within subgraph containing all other cut nodes (easier to compute)
+    #ifdef MULTI_THREAD_DISTANCES
     if (nodes.size() > thread_threshold)
     {
         size_t next_offset;
@@ -2570,35 +3344,24 @@ void Graph::extend_cut_index(vector<CutIndex> &ci, double balance, uint8_t cut_l
         {
             next_offset = min(offset + MULTI_THREAD_DISTANCES, p.cut.size());
             const vector<NodeID> partial_cut(p.cut.begin() + offset, p.cut.begin() + next_offset);
-    #ifdef PRUNING
-            // when tail-pruning, we store distances within subgraph containing all other cut nodes (easier to compute)
             run_dijkstra_ll_par(partial_cut);
-    #else
-            // otherwise we store distances within subgraph excluding lower-index cut nodes (easier to update)
-            run_dijkstra_llsub_par(partial_cut);
-    #endif
             for (size_t distance_id = 0; distance_id < partial_cut.size(); distance_id++)
             {
                 for (NodeID node : nodes)
-    #ifdef PRUNING
                 {
                     distance_t dist_and_flag = node_data[node].distances[distance_id];
                     ci[node].distances.push_back(dist_and_flag);
                     if ((dist_and_flag & 1) == 0)
                         ci[node].pruning_2hop++;
                 }
-    #else
-                    ci[node].distances.push_back(node_data[node].distances[distance_id]);
-    #endif
                 log_progress(nodes.size());
             }
         }
     }
     else
-#endif
+    #endif
     for (NodeID c : p.cut)
     {
-#ifdef PRUNING
         run_dijkstra_ll(c);
         for (NodeID node : nodes)
         {
@@ -2607,13 +3370,26 @@ void Graph::extend_cut_index(vector<CutIndex> &ci, double balance, uint8_t cut_l
             if ((dist_and_flag & 1) == 0)
                 ci[node].pruning_2hop++;
         }
-#else
-        run_dijkstra_llsub(c);
-        for (NodeID node : nodes)
-            ci[node].distances.push_back(node_data[node].distance);
-#endif
         log_progress(nodes.size());
     }
+#else
+    // otherwise we store distances within subgraph excluding lower-index cut nodes (easier to update),
+    // with slots reserved up front so groups of cut vertices can be labelled concurrently
+    for (NodeID node : nodes)
+        ci[node].distances.resize(ci[node].distances.size() + p.cut.size());
+    #ifdef MULTI_THREAD
+    if (nodes.size() > thread_threshold)
+    {
+        util::TaskPool::TaskGroup group(construction_pool());
+        for (size_t first = 0; first < p.cut.size(); first += LABEL_LANES)
+            group.spawn([this, &p, &ci, first] { run_dijkstra_llsub_multi(p.cut, first, ci); });
+        group.wait();
+    }
+    else
+    #endif
+    for (size_t first = 0; first < p.cut.size(); first += LABEL_LANES)
+        run_dijkstra_llsub_multi(p.cut, first, ci);
+#endif
 
     // truncate distances stored for cut vertices
     for (size_t c_pos = 0; c_pos < p.cut.size(); c_pos++)
@@ -2655,9 +3431,11 @@ void Graph::extend_cut_index(vector<CutIndex> &ci, double balance, uint8_t cut_l
 #ifdef MULTI_THREAD
     if (nodes.size() > thread_threshold)
     {
-        std::thread t_left(extend_on_partition, std::ref(ci), balance, cut_level, std::cref(p.left), std::cref(p.cut));
+        // idle workers may steal the left side while this thread recurses on the right
+        util::TaskPool::TaskGroup group(construction_pool());
+        group.spawn([&ci, balance, cut_level, &p] { extend_on_partition(ci, balance, cut_level, p.left, p.cut); });
         extend_on_partition(ci, balance, cut_level, p.right, p.cut);
-        t_left.join();
+        group.wait();
     }
     else
 #endif
@@ -2667,8 +3445,16 @@ void Graph::extend_cut_index(vector<CutIndex> &ci, double balance, uint8_t cut_l
     }
 }
 
-size_t Graph::create_cut_index(std::vector<CutIndex> &ci, double balance)
+size_t Graph::create_cut_index(std::vector<CutIndex> &ci, double balance, size_t thread_count, const NodeAttributes *attributes)
 {
+#ifdef MULTI_THREAD
+    if (thread_count == 0)
+        thread_count = max(thread::hardware_concurrency(), 1u);
+    if (!construction_tasks || construction_tasks->size() != thread_count)
+        construction_tasks = make_unique<util::TaskPool>(thread_count);
+#else
+    (void)thread_count;
+#endif
 #ifndef NPROFILE
     t_partition = t_label = t_shortcut = 0;
 #endif
@@ -2696,8 +3482,39 @@ size_t Graph::create_cut_index(std::vector<CutIndex> &ci, double balance)
         ci[node].dist_index.reserve(32);
         ci[node].distances.reserve(label_reserve);
     }
+    // project coordinates onto plane, scaling longitudes by mean latitude
+    if (attributes && !attributes->latitudes.empty())
+    {
+        double latitude_sum = 0;
+        size_t latitude_count = 0;
+        for (double latitude : attributes->latitudes)
+            if (!isnan(latitude))
+            {
+                latitude_sum += latitude;
+                latitude_count++;
+            }
+        const double longitude_scale = cos(latitude_sum / max<size_t>(latitude_count, 1) * M_PI / 180);
+        partition_x.assign(node_data.size(), NAN);
+        partition_y.assign(node_data.size(), NAN);
+        for (NodeID node : nodes)
+            if (node < attributes->latitudes.size() && node < attributes->longitudes.size())
+            {
+                partition_x[node] = attributes->longitudes[node] * longitude_scale;
+                partition_y[node] = attributes->latitudes[node];
+            }
+    }
+    if (attributes && !attributes->road_classes.empty())
+    {
+        node_road_class.assign(node_data.size(), 0);
+        for (NodeID node : nodes)
+            if (node < attributes->road_classes.size())
+                node_road_class[node] = min(attributes->road_classes[node], MAX_ROAD_CLASS);
+    }
     extend_cut_index(ci, balance, 0);
     log_progress(0);
+    partition_x.clear();
+    partition_y.clear();
+    node_road_class.clear();
 #ifdef CONTRACT2D
     deg2paths.clear();
 #endif
@@ -2815,6 +3632,436 @@ void Graph::contract(vector<Neighbor> &closest)
     }
 }
 
+//--------------------------- ContractionHierarchy ------------------
+
+// rank of contracted nodes, which are not part of the hierarchy
+static const uint16_t NOT_IN_HIERARCHY = UINT16_MAX;
+
+ContractionHierarchy::ContractionHierarchy()
+{
+}
+
+ContractionHierarchy::ContractionHierarchy(istream &is)
+{
+    size_t count, node_count;
+    is.read((char*)&node_count, sizeof(size_t));
+    nodes.resize(node_count);
+    for (NodeID i = 1; i < node_count; i++)
+    {
+        is.read((char*)&nodes[i].dist_index, sizeof(uint16_t));
+        if (nodes[i].dist_index == NOT_IN_HIERARCHY)
+            continue;
+        is.read((char*)&count, sizeof(size_t));
+        nodes[i].up_neighbors.reserve(count);
+        for (size_t j = 0; j < count; j++)
+        {
+            Neighbor n(NO_NODE, 0);
+            is.read((char*)&n.node, sizeof(NodeID));
+            is.read((char*)&n.distance, sizeof(distance_t));
+            nodes[i].up_neighbors.push_back(n);
+        }
+        is.read((char*)&count, sizeof(size_t));
+        nodes[i].down_neighbors.resize(count);
+        is.read((char*)nodes[i].down_neighbors.data(), count * sizeof(NodeID));
+    }
+}
+
+void ContractionHierarchy::write(ostream &os)
+{
+    size_t count = nodes.size();
+    os.write((char*)&count, sizeof(size_t));
+    for (NodeID i = 1; i < nodes.size(); i++)
+    {
+        os.write((char*)&nodes[i].dist_index, sizeof(uint16_t));
+        if (nodes[i].dist_index == NOT_IN_HIERARCHY)
+            continue;
+        count = nodes[i].up_neighbors.size();
+        os.write((char*)&count, sizeof(size_t));
+        for (Neighbor n : nodes[i].up_neighbors)
+        {
+            os.write((char*)&n.node, sizeof(NodeID));
+            os.write((char*)&n.distance, sizeof(distance_t));
+        }
+        count = nodes[i].down_neighbors.size();
+        os.write((char*)&count, sizeof(size_t));
+        os.write((char*)nodes[i].down_neighbors.data(), count * sizeof(NodeID));
+    }
+}
+
+size_t ContractionHierarchy::size() const
+{
+    size_t total = 0;
+    for (NodeID i = 1; i < nodes.size(); i++)
+    {
+        if (nodes[i].dist_index == NOT_IN_HIERARCHY)
+            continue;
+        total += sizeof(uint64_t);
+        total += nodes[i].up_neighbors.size() * (sizeof(NodeID) + sizeof(distance_t));
+        total += nodes[i].down_neighbors.size() * sizeof(NodeID);
+    }
+    return total;
+}
+
+size_t ContractionHierarchy::edge_count() const
+{
+    size_t total = 0;
+    for (CHNode const& node : nodes)
+        total += node.up_neighbors.size();
+    return total;
+}
+
+void Graph::create_contraction_hierarchy(ContractionHierarchy &ch, vector<CutIndex> &ci) const
+{
+    // without contraction every node is its own root
+    vector<Neighbor> closest;
+    closest.reserve(ci.size());
+    for (NodeID node = 0; node < ci.size(); node++)
+        closest.push_back(Neighbor(node, 0));
+    create_contraction_hierarchy(ch, ci, closest);
+}
+
+void Graph::create_contraction_hierarchy(ContractionHierarchy &ch, vector<CutIndex> &ci, vector<Neighbor> &closest) const
+{
+    vector<NodeID> bottom_up_nodes;
+    bottom_up_nodes.reserve(nodes.size() + 1);
+    // distance index of own label determines edge direction; existing labels (distances within
+    // partition subgraphs) are discarded, as repairs rely on labels matching the hierarchy exactly
+    ch.nodes.resize(nodes.size() + 1);
+    for (NodeID node : nodes)
+    {
+        if (closest[node].node == node)
+        {
+            bottom_up_nodes.push_back(node);
+            ch.nodes[node].dist_index = ci[node].dist_index[ci[node].cut_level] - 1;
+            ci[node].distances.assign(ch.nodes[node].dist_index, infinity);
+        }
+        else
+            ch.nodes[node].dist_index = NOT_IN_HIERARCHY;
+    }
+
+    // initialize with upwards graph edges
+    for (NodeID node : bottom_up_nodes)
+        for (const Neighbor &n : node_data[node].neighbors)
+            if (closest[n.node].node == n.node && ch.nodes[n.node].dist_index < ch.nodes[node].dist_index)
+            {
+                ch.nodes[node].up_neighbors.push_back(Neighbor(n.node, n.distance));
+                distance_t &d = ci[node].distances[ch.nodes[n.node].dist_index];
+                d = min(d, n.distance);
+            }
+
+    // add shortcuts bottom-up
+    auto di_order = [&ch](NodeID a, NodeID b) -> bool
+    {
+        return ch.nodes[a].dist_index > ch.nodes[b].dist_index;
+    };
+    // by rank, then distance, so that only the shortest of parallel edges is kept
+    auto up_order = [&ch](Neighbor a, Neighbor b) -> bool
+    {
+        if (ch.nodes[a.node].dist_index != ch.nodes[b.node].dist_index)
+            return ch.nodes[a.node].dist_index > ch.nodes[b.node].dist_index;
+        return a.distance < b.distance;
+    };
+    auto same_node = [](Neighbor a, Neighbor b) { return a.node == b.node; };
+
+    sort(bottom_up_nodes.begin(), bottom_up_nodes.end(), di_order);
+    for (NodeID node : bottom_up_nodes)
+    {
+        vector<Neighbor> &up = ch.nodes[node].up_neighbors;
+        sort(up.begin(), up.end(), up_order);
+        up.erase(unique(up.begin(), up.end(), same_node), up.end());
+
+        for (size_t i = 0; i + 1 < up.size(); i++)
+            for (size_t j = i + 1; j < up.size(); j++)
+            {
+                distance_t weight = up[i].distance + up[j].distance;
+                distance_t &d = ci[up[i].node].distances[ch.nodes[up[j].node].dist_index];
+                if (weight < d)
+                {
+                    ch.nodes[up[i].node].up_neighbors.push_back(Neighbor(up[j].node, weight));
+                    d = weight;
+                }
+            }
+
+        // create downward neighbors from upward ones
+        for (Neighbor upn : up)
+            ch.nodes[upn.node].down_neighbors.push_back(node);
+    }
+
+    // compute DHL distances top-down
+    for (auto it = bottom_up_nodes.rbegin(); it != bottom_up_nodes.rend(); it++)
+    {
+        vector<distance_t> &distances = ci[*it].distances;
+        for (Neighbor n : ch.nodes[*it].up_neighbors)
+            for (size_t anc = 0; anc < ch.nodes[n.node].dist_index; anc++)
+                distances[anc] = min(distances[anc], n.distance + ci[n.node].distances[anc]);
+        distances.push_back(0);
+    }
+}
+
+struct DCHSearchNode
+{
+    uint16_t dist_index;
+    NodeID v;
+    NodeID w;
+    distance_t distance;
+    bool operator<(const DCHSearchNode &other) const { return dist_index < other.dist_index; }
+    DCHSearchNode(uint16_t dist_index, NodeID v, NodeID w, distance_t distance) : dist_index(dist_index), v(v), w(w), distance(distance) {}
+};
+
+struct ICHSearchNode
+{
+    NodeID v;
+    uint16_t w;
+    ICHSearchNode(NodeID v, uint16_t w) : v(v), w(w) {}
+};
+
+Neighbor& Graph::UpNeighbor(ContractionHierarchy &ch, NodeID v, NodeID w)
+{
+    for (Neighbor &n : ch.nodes[v].up_neighbors)
+        if (n.node == w)
+            return n;
+    // edge may be missing if it got dominated during construction
+    ch.nodes[v].up_neighbors.push_back(Neighbor(w, infinity));
+    return ch.nodes[v].up_neighbors.back();
+}
+
+distance_t Graph::edge_weight(NodeID v, NodeID w, const WeightTable *weights) const
+{
+    distance_t d = infinity;
+    for (const Neighbor &n : weights ? (*weights)[v] : node_data[v].neighbors)
+        if (n.node == w)
+            d = min(d, n.distance);
+    return d;
+}
+
+void Graph::get_weights(WeightTable &weights) const
+{
+    weights.resize(node_data.size());
+    for (NodeID node = 0; node < node_data.size(); node++)
+        weights[node] = node_data[node].neighbors;
+}
+
+void Graph::DecCH(ContractionHierarchy &ch, vector<pair<pair<distance_t, distance_t>, pair<NodeID, NodeID> > >& updates, vector<pair<distance_t, pair<NodeID, NodeID> > > &C)
+{
+    priority_queue<DCHSearchNode> q;
+    NodeID a, b;
+    for (pair<pair<distance_t, distance_t>, pair<NodeID, NodeID> > iter : updates)
+    {
+        a = iter.second.first, b = iter.second.second;
+        if (ch.nodes[a].dist_index < ch.nodes[b].dist_index)
+            swap(a, b);
+        Neighbor &x = UpNeighbor(ch, a, b);
+        if (x.distance > iter.first.second)
+        {
+            x.distance = iter.first.second;
+            C.push_back(make_pair(x.distance, make_pair(a, b)));
+            q.push(DCHSearchNode(ch.nodes[a].dist_index, a, b, x.distance));
+        }
+    }
+
+    while (!q.empty())
+    {
+        DCHSearchNode next = q.top(); q.pop();
+        for (Neighbor n : ch.nodes[next.v].up_neighbors)
+        {
+            if (n.node == next.w)
+                continue;
+            distance_t new_dist = next.distance + n.distance;
+            a = next.w, b = n.node;
+            if (ch.nodes[a].dist_index < ch.nodes[b].dist_index)
+                swap(a, b);
+            Neighbor &x = UpNeighbor(ch, a, b);
+            if (x.distance > new_dist)
+            {
+                x.distance = new_dist;
+                C.push_back(make_pair(x.distance, make_pair(a, b)));
+                q.push(DCHSearchNode(ch.nodes[a].dist_index, a, b, x.distance));
+            }
+        }
+    }
+}
+
+void Graph::IncCH(ContractionHierarchy &ch, vector<pair<pair<distance_t, distance_t>, pair<NodeID, NodeID> > >& updates, vector<pair<distance_t, pair<NodeID, NodeID> > > &C, const WeightTable *weights)
+{
+    priority_queue<DCHSearchNode> q;
+    NodeID a, b;
+    for (pair<pair<distance_t, distance_t>, pair<NodeID, NodeID> > iter : updates)
+    {
+        a = iter.second.first, b = iter.second.second;
+        if (ch.nodes[a].dist_index < ch.nodes[b].dist_index)
+            swap(a, b);
+        Neighbor &x = UpNeighbor(ch, a, b);
+        if (x.distance == iter.first.first)
+        {
+            C.push_back(make_pair(x.distance, make_pair(a, b)));
+            q.push(DCHSearchNode(ch.nodes[a].dist_index, a, b, x.distance));
+        }
+    }
+
+    while (!q.empty())
+    {
+        DCHSearchNode next = q.top(); q.pop();
+
+        // recompute shortcut distance from graph edge and lower triangles
+        distance_t new_dist = edge_weight(next.v, next.w, weights);
+        vector<NodeID> &v_down = ch.nodes[next.v].down_neighbors, &w_down = ch.nodes[next.w].down_neighbors;
+        sort(v_down.begin(), v_down.end());
+        sort(w_down.begin(), w_down.end());
+        size_t i = 0, j = 0;
+        while (i < v_down.size() && j < w_down.size())
+        {
+            a = v_down[i]; b = w_down[j];
+            if (a < b)
+                i++;
+            else if (b < a)
+                j++;
+            else
+            {
+                new_dist = min(new_dist, UpNeighbor(ch, a, next.v).distance + UpNeighbor(ch, a, next.w).distance);
+                i++; j++;
+            }
+        }
+
+        Neighbor &x = UpNeighbor(ch, next.v, next.w);
+        if (new_dist != x.distance)
+        {
+            // shortcuts that were tight via this one need to be recomputed as well
+            for (Neighbor &n : ch.nodes[next.v].up_neighbors)
+            {
+                if (n.node == next.w)
+                    continue;
+                distance_t old_dist = next.distance + n.distance;
+                a = next.w, b = n.node;
+                if (ch.nodes[a].dist_index < ch.nodes[b].dist_index)
+                    swap(a, b);
+                Neighbor &y = UpNeighbor(ch, a, b);
+                if (y.distance == old_dist)
+                {
+                    C.push_back(make_pair(y.distance, make_pair(a, b)));
+                    q.push(DCHSearchNode(ch.nodes[a].dist_index, a, b, y.distance));
+                }
+            }
+            x.distance = new_dist;
+        }
+    }
+}
+
+void Graph::DhlDec(ContractionHierarchy &ch, ContractionIndex &ci, vector<pair<pair<distance_t, distance_t>, pair<NodeID, NodeID> > >& updates)
+{
+    vector<pair<distance_t, pair<NodeID, NodeID> > > C;
+    DecCH(ch, updates, C);
+
+    // update distances involving ancestors
+    util::min_bucket_queue<ICHSearchNode> q;
+    for (pair<distance_t, pair<NodeID, NodeID> > iter : C)
+    {
+        if (iter.first < ci.get_cut_index(iter.second.first).distances()[ch.nodes[iter.second.second].dist_index])
+        {
+            FlatCutIndex a = ci.get_writable_cut_index(iter.second.first), b = ci.get_cut_index(iter.second.second);
+            for (size_t anc = 0; anc <= ch.nodes[iter.second.second].dist_index; anc++)
+                if (iter.first + b.distances()[anc] < a.distances()[anc])
+                {
+                    a.distances()[anc] = iter.first + b.distances()[anc];
+                    q.push(ICHSearchNode(iter.second.first, anc), ch.nodes[iter.second.first].dist_index);
+                }
+        }
+    }
+
+    // update distances involving descendants
+    while (!q.empty())
+    {
+        ICHSearchNode next = q.pop();
+        distance_t d = ci.get_cut_index(next.v).distances()[next.w];
+        for (NodeID node : ch.nodes[next.v].down_neighbors)
+        {
+            FlatCutIndex nn = ci.get_cut_index(node);
+            distance_t new_dist = nn.distances()[ch.nodes[next.v].dist_index] + d;
+            if (new_dist < nn.distances()[next.w])
+            {
+                ci.get_writable_cut_index(node).distances()[next.w] = new_dist;
+                q.push(ICHSearchNode(node, next.w), ch.nodes[node].dist_index);
+            }
+        }
+    }
+}
+
+void Graph::DhlInc(ContractionHierarchy &ch, ContractionIndex &ci, vector<pair<pair<distance_t, distance_t>, pair<NodeID, NodeID> > >& updates, const WeightTable *weights)
+{
+    vector<pair<distance_t, pair<NodeID, NodeID> > > C;
+    IncCH(ch, updates, C, weights);
+
+    // identify distances involving ancestors that may have used changed shortcuts
+    util::min_bucket_queue<ICHSearchNode> q;
+    for (pair<distance_t, pair<NodeID, NodeID> > iter : C)
+    {
+        FlatCutIndex a = ci.get_cut_index(iter.second.first);
+        if (iter.first == a.distances()[ch.nodes[iter.second.second].dist_index])
+        {
+            FlatCutIndex b = ci.get_cut_index(iter.second.second);
+            for (size_t anc = 0; anc <= ch.nodes[iter.second.second].dist_index; anc++)
+                if (iter.first + b.distances()[anc] == a.distances()[anc])
+                    q.push(ICHSearchNode(iter.second.first, anc), ch.nodes[iter.second.first].dist_index);
+        }
+    }
+
+    // recompute them top-down, identifying distances to descendants for update
+    while (!q.empty())
+    {
+        ICHSearchNode next = q.pop();
+        distance_t new_dist = infinity; // new distance from v to anc
+        for (Neighbor &n : ch.nodes[next.v].up_neighbors)
+            if (ch.nodes[n.node].dist_index >= next.w)
+                new_dist = min(new_dist, n.distance + ci.get_cut_index(n.node).distances()[next.w]);
+
+        // distance may not have changed after all
+        FlatCutIndex cv = ci.get_cut_index(next.v);
+        if (new_dist > cv.distances()[next.w])
+        {
+            for (NodeID node : ch.nodes[next.v].down_neighbors)
+            {
+                FlatCutIndex nn = ci.get_cut_index(node);
+                if (nn.distances()[ch.nodes[next.v].dist_index] + cv.distances()[next.w] == nn.distances()[next.w])
+                    q.push(ICHSearchNode(node, next.w), ch.nodes[node].dist_index);
+            }
+            ci.get_writable_cut_index(next.v).distances()[next.w] = new_dist;
+        }
+    }
+}
+
+void Graph::contract_seq(ContractionIndex &ci, vector<pair<distance_t, NodeID> >& contracted_updates, const WeightTable *weights)
+{
+    // process children in order of original distance, so that ancestors come first and their offsets are final;
+    // new offsets are always derived from the parent's current offset, as other updates may have shifted it
+    sort(contracted_updates.begin(), contracted_updates.end());
+    unordered_set<NodeID> visited;
+    // search from each update using DFS
+    vector<NodeID> stack;
+    for (auto& it : contracted_updates)
+    {
+        // skip subtrees already updated from an ancestor
+        if (!visited.insert(it.second).second)
+            continue;
+        stack.push_back(it.second);
+        while (!stack.empty())
+        {
+            NodeID node = stack.back(); stack.pop_back();
+            visited.insert(node);
+            NodeID parent = ci.get_contraction_label(node).parent;
+            distance_t parent_offset = ci.get_contraction_label(parent).distance_offset;
+            const vector<Neighbor> &neighbors = weights ? (*weights)[node] : node_data[node].neighbors;
+            for (Neighbor n : neighbors)
+                if (n.node == parent)
+                {
+                    ci.update_distance_offset(node, min(infinity, parent_offset + n.distance));
+                    break;
+                }
+            for (Neighbor n : neighbors)
+                if (ci.get_contraction_label(n.node).parent == node)
+                    stack.push_back(n.node);
+        }
+    }
+}
+
 //--------------------------- Graph debug ---------------------------
 
 bool Graph::is_consistent() const
@@ -2973,6 +4220,320 @@ void read_graph(Graph &g, istream &in)
     g.remove_isolated();
 }
 
+// parse unsigned decimal at p, skipping leading blanks; leaves p behind the last digit
+static uint32_t parse_uint(const char *&p, const char *end)
+{
+    while (p < end && (*p == ' ' || *p == '\t'))
+        p++;
+    uint32_t value = 0;
+    while (p < end && *p >= '0' && *p <= '9')
+        value = value * 10 + (*p++ - '0');
+    return value;
+}
+
+// parse DIMACS lines in [p, end), which must start at a line boundary; node_count is set by a problem line
+static void parse_dimacs_chunk(const char *p, const char *end, vector<Edge> &edges, size_t &node_count)
+{
+    while (p < end)
+    {
+        // like stream extraction, skip blank space before line identifier
+        while (p < end && isspace(static_cast<unsigned char>(*p)))
+            p++;
+        if (p == end)
+            break;
+        char line_id = *p++;
+        if (line_id == 'a')
+        {
+            NodeID v = parse_uint(p, end);
+            NodeID w = parse_uint(p, end);
+            distance_t d = parse_uint(p, end);
+            edges.push_back(Edge(v, w, d));
+        }
+        else if (line_id == 'p')
+        {
+            // skip problem type
+            while (p < end && *p != '\n' && !isdigit(static_cast<unsigned char>(*p)))
+                p++;
+            node_count = parse_uint(p, end);
+        }
+        p = static_cast<const char*>(memchr(p, '\n', end - p));
+        if (p == nullptr)
+            break;
+    }
+}
+
+//--------------------------- snapshot ------------------------------
+
+// binary graph snapshot layout, all sections aligned to SNAPSHOT_ALIGNMENT:
+// header, offsets[node_count + 2], arcs[arc_count], then latitudes, longitudes and osm_ids[node_count + 1] if flagged
+static const char SNAPSHOT_MAGIC[8] = { 'H', 'C', '2', 'L', 'G', 'R', 'P', 'H' };
+static const uint32_t SNAPSHOT_VERSION = 1;
+static const uint32_t SNAPSHOT_COORDINATES = 1;
+static const uint32_t SNAPSHOT_OSM_IDS = 2;
+static const uint64_t SNAPSHOT_ALIGNMENT = 64; // sections start on cache line boundaries
+
+static uint64_t align_offset(uint64_t offset)
+{
+    return (offset + SNAPSHOT_ALIGNMENT - 1) & ~(SNAPSHOT_ALIGNMENT - 1);
+}
+
+struct SnapshotHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint64_t node_count;
+    uint64_t arc_count;
+};
+
+// section offsets of snapshot with given header, plus total file size
+struct SnapshotLayout
+{
+    uint64_t offsets, arcs, latitudes, longitudes, osm_ids, size;
+    SnapshotLayout(const SnapshotHeader &header);
+};
+
+SnapshotLayout::SnapshotLayout(const SnapshotHeader &header)
+{
+    const uint64_t attribute_size = (header.node_count + 1) * 8;
+    offsets = align_offset(sizeof(SnapshotHeader));
+    arcs = align_offset(offsets + (header.node_count + 2) * sizeof(uint32_t));
+    latitudes = align_offset(arcs + header.arc_count * sizeof(Neighbor));
+    longitudes = latitudes + (header.flags & SNAPSHOT_COORDINATES ? attribute_size : 0);
+    osm_ids = longitudes + (header.flags & SNAPSHOT_COORDINATES ? attribute_size : 0);
+    size = osm_ids + (header.flags & SNAPSHOT_OSM_IDS ? attribute_size : 0);
+}
+
+// load snapshot from memory region holding the whole file
+static void load_snapshot(const char *data, size_t size, Graph *g, NodeAttributes *attributes, const string &filename)
+{
+    SnapshotHeader header;
+    if (size < sizeof(header))
+        throw runtime_error("truncated graph snapshot " + filename);
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0)
+        throw runtime_error("not a graph snapshot: " + filename);
+    if (header.version != SNAPSHOT_VERSION)
+        throw runtime_error("unsupported graph snapshot version " + to_string(header.version) + " in " + filename);
+    if (header.node_count >= UINT32_MAX || header.arc_count > UINT32_MAX)
+        throw runtime_error("corrupt graph snapshot " + filename);
+    SnapshotLayout layout(header);
+    if (layout.size != size)
+        throw runtime_error("corrupt graph snapshot " + filename);
+    const size_t n = header.node_count;
+    if (g)
+    {
+        const uint32_t *offsets = reinterpret_cast<const uint32_t*>(data + layout.offsets);
+        const Neighbor *arcs = reinterpret_cast<const Neighbor*>(data + layout.arcs);
+        if (offsets[0] != 0 || offsets[n + 1] != header.arc_count)
+            throw runtime_error("corrupt graph snapshot " + filename);
+        for (size_t v = 0; v <= n; v++)
+            if (offsets[v] > offsets[v + 1])
+                throw runtime_error("corrupt graph snapshot " + filename);
+        for (size_t i = 0; i < header.arc_count; i++)
+            if (arcs[i].node > n)
+                throw runtime_error("corrupt graph snapshot " + filename);
+        g->resize(n);
+        for (NodeID v = 0; v <= n; v++)
+            g->set_neighbors(v, span<const Neighbor>(arcs + offsets[v], arcs + offsets[v + 1]));
+        g->remove_isolated();
+    }
+    if (attributes)
+    {
+        const double *latitudes = reinterpret_cast<const double*>(data + layout.latitudes);
+        const double *longitudes = reinterpret_cast<const double*>(data + layout.longitudes);
+        const uint64_t *osm_ids = reinterpret_cast<const uint64_t*>(data + layout.osm_ids);
+        attributes->latitudes.clear();
+        attributes->longitudes.clear();
+        attributes->osm_ids.clear();
+        if (header.flags & SNAPSHOT_COORDINATES)
+        {
+            attributes->latitudes.assign(latitudes, latitudes + n + 1);
+            attributes->longitudes.assign(longitudes, longitudes + n + 1);
+        }
+        if (header.flags & SNAPSHOT_OSM_IDS)
+            attributes->osm_ids.assign(osm_ids, osm_ids + n + 1);
+    }
+}
+
+uint8_t road_class_rank(const string &highway)
+{
+    static const pair<const char*,uint8_t> ranks[] = {
+        { "motorway", 7 }, { "trunk", 6 }, { "primary", 5 }, { "secondary", 4 }, { "tertiary", 3 },
+        { "unclassified", 2 }, { "residential", 2 }, { "living_street", 1 }, { "service", 1 }
+    };
+    // tags may list several classes, and link roads share the class of the road they connect to
+    uint8_t rank = 0;
+    size_t begin = 0;
+    while (begin < highway.size())
+    {
+        size_t end = highway.find_first_not_of("abcdefghijklmnopqrstuvwxyz_", begin);
+        if (end == string::npos)
+            end = highway.size();
+        string tag = highway.substr(begin, end - begin);
+        if (tag.size() > 5 && tag.compare(tag.size() - 5, 5, "_link") == 0)
+            tag.resize(tag.size() - 5);
+        for (const pair<const char*,uint8_t> &r : ranks)
+            if (tag == r.first)
+                rank = max(rank, r.second);
+        begin = end + 1;
+    }
+    return rank;
+}
+
+// split CSV line into fields, keeping separators within double quotes
+static void split_csv_line(const string &line, vector<string> &fields)
+{
+    fields.assign(1, string());
+    bool quoted = false;
+    for (char c : line)
+    {
+        if (c == '"')
+            quoted = !quoted;
+        else if (c == ',' && !quoted)
+            fields.emplace_back();
+        else if (c != '\r')
+            fields.back().push_back(c);
+    }
+}
+
+size_t read_road_classes(const string &filename, NodeAttributes &attributes)
+{
+    ifstream in(filename);
+    if (!in)
+        throw runtime_error("cannot open " + filename);
+    string line;
+    vector<string> fields;
+    getline(in, line);
+    split_csv_line(line, fields);
+    const size_t source_column = find(fields.begin(), fields.end(), "source") - fields.begin();
+    const size_t target_column = find(fields.begin(), fields.end(), "target") - fields.begin();
+    const size_t highway_column = find(fields.begin(), fields.end(), "highway") - fields.begin();
+    if (max({ source_column, target_column, highway_column }) >= fields.size())
+        throw runtime_error("missing source, target or highway column in " + filename);
+    const size_t n = Graph::super_node_count();
+    attributes.road_classes.assign(n + 1, 0);
+    size_t rows = 0;
+    while (getline(in, line))
+    {
+        split_csv_line(line, fields);
+        if (max({ source_column, target_column, highway_column }) >= fields.size())
+            continue;
+        const uint8_t rank = road_class_rank(fields[highway_column]);
+        for (size_t column : { source_column, target_column })
+        {
+            NodeID node = stoul(fields[column]);
+            if (node > 0 && node <= n)
+                attributes.road_classes[node] = max(attributes.road_classes[node], rank);
+        }
+        rows++;
+    }
+    return rows;
+}
+
+bool is_graph_snapshot(const string &filename)
+{
+    ifstream in(filename, ios::binary);
+    char magic[sizeof(SNAPSHOT_MAGIC)];
+    return in.read(magic, sizeof(magic)) && memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic)) == 0;
+}
+
+void read_graph_snapshot(const string &filename, Graph *g, NodeAttributes *attributes)
+{
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw runtime_error("cannot open graph snapshot " + filename);
+    struct stat file_stat;
+    void *region = MAP_FAILED;
+    if (fstat(fd, &file_stat) == 0 && file_stat.st_size > 0)
+        region = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (region == MAP_FAILED)
+        throw runtime_error("cannot map graph snapshot " + filename);
+    try {
+        load_snapshot(static_cast<const char*>(region), file_stat.st_size, g, attributes, filename);
+    } catch (...) {
+        munmap(region, file_stat.st_size);
+        throw;
+    }
+    munmap(region, file_stat.st_size);
+}
+
+void read_graph(Graph &g, const string &filename)
+{
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw runtime_error("cannot open graph file " + filename);
+    struct stat file_stat;
+    void *region = MAP_FAILED;
+    if (fstat(fd, &file_stat) == 0 && S_ISREG(file_stat.st_mode) && file_stat.st_size > 0)
+        region = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    // pipes, empty files and failed mappings go through the stream parser
+    if (region == MAP_FAILED)
+    {
+        ifstream in(filename);
+        if (!in)
+            throw runtime_error("cannot read graph file " + filename);
+        read_graph(g, in);
+        return;
+    }
+    const size_t size = file_stat.st_size;
+    const char *begin = static_cast<const char*>(region), *end = begin + size;
+    madvise(region, size, MADV_SEQUENTIAL);
+    if (size >= sizeof(SNAPSHOT_MAGIC) && memcmp(begin, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) == 0)
+    {
+        try {
+            load_snapshot(begin, size, &g, nullptr, filename);
+        } catch (...) {
+            munmap(region, size);
+            throw;
+        }
+        munmap(region, size);
+        return;
+    }
+    // split at line boundaries into chunks of at least GRAPH_CHUNK_SIZE bytes, parsed in parallel
+    const size_t chunk_count = max<size_t>(1, min<size_t>(size / GRAPH_CHUNK_SIZE, thread::hardware_concurrency()));
+    vector<const char*> bounds(1, begin);
+    for (size_t i = 1; i < chunk_count; i++)
+    {
+        const char *bound = max(begin + size * i / chunk_count, bounds.back());
+        const char *line_end = static_cast<const char*>(memchr(bound, '\n', end - bound));
+        bounds.push_back(line_end ? line_end + 1 : end);
+    }
+    bounds.push_back(end);
+    vector<vector<Edge>> chunk_edges(chunk_count);
+    vector<size_t> node_counts(chunk_count, 0);
+    vector<thread> threads;
+    for (size_t i = 1; i < chunk_count; i++)
+        threads.push_back(thread(parse_dimacs_chunk, bounds[i], bounds[i + 1], ref(chunk_edges[i]), ref(node_counts[i])));
+    parse_dimacs_chunk(bounds[0], bounds[1], chunk_edges[0], node_counts[0]);
+    for (thread &t : threads)
+        t.join();
+    munmap(region, size);
+    // concatenate chunks in file order, so adjacency lists match those built by the stream parser
+    size_t node_count = 0, edge_count = 0;
+    for (size_t i = 0; i < chunk_count; i++)
+    {
+        if (node_count == 0)
+            node_count = node_counts[i];
+        edge_count += chunk_edges[i].size();
+    }
+    if (node_count == 0)
+        throw runtime_error("missing problem line in graph file " + filename);
+    vector<Edge> edges;
+    edges.reserve(edge_count);
+    for (vector<Edge> &chunk : chunk_edges)
+    {
+        edges.insert(edges.end(), chunk.begin(), chunk.end());
+        vector<Edge>().swap(chunk);
+    }
+    g.resize(node_count);
+    g.add_edges(edges);
+    g.remove_isolated();
+}
+
+
 //--------------------------- ostream -------------------------------
 
 // for easy distance printing
@@ -3076,23 +4637,59 @@ ostream& operator<<(ostream& os, const Graph &g)
     return os << "G(" << g.subgraph_id << "#" << g.nodes << " over " << g.node_data << ")";
 }
 
-void Graph::applyDisruption(NodeID u, NodeID v, double slowdown, bool closed) {
-    for (Neighbor &n : node_data[u].neighbors) {
-        if (n.node == v) {
-            if (closed) {
-                n.distance = infinity;
-            } else {
-                // apply slowdown relative to current nominal weight
-                double slowed = static_cast<double>(n.distance) * slowdown;
-                if (slowed >= static_cast<double>(infinity)) {
-                    n.distance = infinity;
-                } else {
-                    n.distance = static_cast<distance_t>(slowed);
-                }
+bool Graph::set_overlay_weight(WeightOverlay &o, NodeID v, NodeID w, const function<distance_t(distance_t)> &reweight) const
+{
+    // weight of slot before any overlay was applied
+    auto base_weight = [](NodeID node, uint32_t slot) {
+        auto it = overlay_base_weights.find(static_cast<uint64_t>(node) << 32 | slot);
+        return it != overlay_base_weights.end() ? it->second : node_data[node].neighbors[slot].distance;
+    };
+    bool found = false;
+    for (auto [from, to] : { pair(v, w), pair(w, v) })
+    {
+        const vector<Neighbor> &neighbors = node_data[from].neighbors;
+        for (uint32_t slot = 0; slot < neighbors.size(); slot++)
+            if (neighbors[slot].node == to)
+            {
+                o.changes.push_back({from, slot, reweight(base_weight(from, slot))});
+                found = true;
+                break;
             }
-            break;
-        }
     }
+    if (found)
+        o.version++;
+    return found;
+}
+
+void Graph::activate_overlay(const WeightOverlay *o)
+{
+    if (o == overlay && (o == nullptr || o->version == overlay_version))
+        return;
+    // revert in reverse order, so slots changed repeatedly end up with base weight
+    for (auto it = overlay_base.rbegin(); it != overlay_base.rend(); ++it)
+        node_data[it->node].neighbors[it->slot].distance = it->weight;
+    overlay_base.clear();
+    overlay_base_weights.clear();
+    overlay = o;
+    if (o == nullptr)
+        return;
+    overlay_version = o->version;
+    overlay_base.reserve(o->changes.size());
+    overlay_base_weights.reserve(o->changes.size());
+    for (const WeightOverlay::Change &c : o->changes)
+    {
+        assert(c.slot < node_data[c.node].neighbors.size());
+        distance_t &d = node_data[c.node].neighbors[c.slot].distance;
+        overlay_base.push_back({c.node, c.slot, d});
+        // slots may change repeatedly, keep the weight saved first
+        overlay_base_weights.emplace(static_cast<uint64_t>(c.node) << 32 | c.slot, d);
+        d = c.weight;
+    }
+}
+
+const WeightOverlay* Graph::active_overlay()
+{
+    return overlay;
 }
 
 // Note: Disruption path checking is now handled in the Dynamic class
@@ -27,6 +27,139 @@ Summary Summary::operator*(double x) const
     return { min * x, max * x, avg * x  };
 }
 
+// pool and deque index of the current thread if it is a TaskPool worker
+thread_local static const TaskPool *worker_pool = nullptr;
+thread_local static size_t worker_index = 0;
+
+TaskPool::TaskGroup::TaskGroup(TaskPool &pool) : pool(pool), pending(0)
+{
+}
+
+TaskPool::TaskGroup::~TaskGroup()
+{
+    wait();
+}
+
+void TaskPool::TaskGroup::spawn(function<void()> task)
+{
+    pending++;
+    pool.push(Task{ move(task), this });
+}
+
+void TaskPool::TaskGroup::wait()
+{
+    const size_t worker = pool.current_worker();
+    Task task;
+    while (pending > 0)
+    {
+        if (pool.next_task(worker, task))
+        {
+            pool.execute(task);
+            continue;
+        }
+        unique_lock<mutex> lock(pool.m_mutex);
+        pool.changed.wait(lock, [this] { return pending == 0 || pool.queued > 0; });
+    }
+}
+
+TaskPool::TaskPool(size_t thread_count) : queued(0), stopping(false)
+{
+    for (size_t i = 0; i < thread_count; i++)
+        queues.push_back(make_unique<TaskQueue>());
+    for (size_t i = 1; i < thread_count; i++)
+        workers.push_back(thread(&TaskPool::worker_loop, this, i));
+}
+
+TaskPool::~TaskPool()
+{
+    {
+        lock_guard<mutex> lock(m_mutex);
+        stopping = true;
+    }
+    changed.notify_all();
+    for (thread &t : workers)
+        t.join();
+}
+
+size_t TaskPool::size() const
+{
+    return queues.size();
+}
+
+size_t TaskPool::current_worker() const
+{
+    return worker_pool == this ? worker_index : 0;
+}
+
+void TaskPool::push(Task &&task)
+{
+    // count before queueing, so queued never drops below the number of tasks present
+    queued++;
+    {
+        TaskQueue &q = *queues[current_worker()];
+        lock_guard<mutex> lock(q.m_mutex);
+        q.tasks.push_back(move(task));
+    }
+    lock_guard<mutex> lock(m_mutex);
+    changed.notify_all();
+}
+
+bool TaskPool::next_task(size_t worker, Task &task)
+{
+    // own tasks from the back, stolen ones from the front
+    for (size_t i = 0; i < queues.size(); i++)
+    {
+        TaskQueue &q = *queues[(worker + i) % queues.size()];
+        lock_guard<mutex> lock(q.m_mutex);
+        if (q.tasks.empty())
+            continue;
+        if (i == 0)
+        {
+            task = move(q.tasks.back());
+            q.tasks.pop_back();
+        }
+        else
+        {
+            task = move(q.tasks.front());
+            q.tasks.pop_front();
+        }
+        queued--;
+        return true;
+    }
+    return false;
+}
+
+void TaskPool::execute(Task &task)
+{
+    task.run();
+    task.run = nullptr;
+    // group may be destroyed by its waiter as soon as pending drops to zero
+    if (task.group->pending.fetch_sub(1) == 1)
+    {
+        lock_guard<mutex> lock(m_mutex);
+        changed.notify_all();
+    }
+}
+
+void TaskPool::worker_loop(size_t worker)
+{
+    worker_pool = this;
+    worker_index = worker;
+    Task task;
+    while (true)
+    {
+        if (next_task(worker, task))
+        {
+            execute(task);
+            continue;
+        }
+        unique_lock<mutex> lock(m_mutex);
+        changed.wait(lock, [this] { return stopping || queued > 0; });
+        if (stopping)
+            return;
+    }
+}
+
 }
 
 namespace std {
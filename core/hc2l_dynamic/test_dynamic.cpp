@@ -0,0 +1,275 @@
+#include "Dynamic.h"
+#include "road_network.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <cstdio>
+#include <algorithm>
+#include <random>
+#include <cmath>
+
+using namespace hc2l_dynamic;
+using namespace road_network;
+
+static const std::string GRAPH_PATH = "test_dynamic_graph.gr";
+static const std::string NODES_PATH = "test_dynamic_nodes.csv";
+static const std::string SCENARIO_PATH = "test_dynamic_scenario.csv";
+
+// Ladder with rows 1-2-3 and 4-5-6, about 111m between neighboring nodes, all edges of weight 100
+static void writeLadder(Graph &g) {
+    auto lat = [](int node) { return node <= 3 ? 0.0 : -0.001; };
+    auto lng = [](int node) { return ((node - 1) % 3) * 0.001; };
+    std::ofstream graphFile(GRAPH_PATH), nodesFile(NODES_PATH), scenarioFile(SCENARIO_PATH);
+    graphFile << "p sp 6 7" << std::endl;
+    nodesFile << "node_id,latitude,longitude" << std::endl;
+    scenarioFile << "source_lat,source_lon,target_lat,target_lon,source,target,road_name,speed_kph,freeFlow_kph,jamFactor,isClosed,segmentLength" << std::endl;
+    for (int node = 1; node <= 6; node++)
+        nodesFile << node << "," << lat(node) << "," << lng(node) << std::endl;
+    for (auto [a, b] : std::vector<std::pair<int, int>>{ {1, 2}, {2, 3}, {4, 5}, {5, 6}, {1, 4}, {2, 5}, {3, 6} }) {
+        graphFile << "a " << a << " " << b << " 100" << std::endl;
+        scenarioFile << lat(a) << "," << lng(a) << "," << lat(b) << "," << lng(b) << "," << a << "," << b
+                     << ",Road " << a << "-" << b << ",30,30,1,False,111" << std::endl;
+    }
+    graphFile.close();
+    nodesFile.close();
+    scenarioFile.close();
+    read_graph(g, GRAPH_PATH);
+}
+
+static bool usesEdge(const std::vector<NodeID> &path, NodeID a, NodeID b) {
+    for (size_t i = 0; i + 1 < path.size(); i++)
+        if (std::min(path[i], path[i + 1]) == std::min(a, b) && std::max(path[i], path[i + 1]) == std::max(a, b))
+            return true;
+    return false;
+}
+
+// Checks that GPS positions near a closed segment snap onto open segments instead of travelling along it
+bool testSnapAvoidsClosedSegment() {
+    std::cout << "\n=== Testing Segment Snapping Around Closed Edge ===" << std::endl;
+    Graph g;
+    writeLadder(g);
+    Dynamic dynamic(g);
+    dynamic.buildRepairableIndex();
+    if (!dynamic.initializeCoordinateMapping(NODES_PATH, SCENARIO_PATH)) {
+        std::cout << "FAILED: could not initialize coordinate mapping" << std::endl;
+        return false;
+    }
+    dynamic.addUserDisruption(1, 2, "Road Closure", "Closed");
+
+    // both positions lie on segment 1-2; in base mode the route runs along it directly
+    bool passed = true;
+    for (Mode mode : { Mode::BASE, Mode::DISRUPTED, Mode::LAZY_UPDATE, Mode::IMMEDIATE_UPDATE }) {
+        dynamic.setMode(mode);
+        RouteInfo route = dynamic.findRouteByGPS(0.00001, 0.0003, 0.00001, 0.0007);
+        // detour 1-4-5-2 around the closure
+        bool ok = mode == Mode::BASE ? route.total_distance == 40
+                                     : !usesEdge(route.path, 1, 2) && route.total_distance >= 300 && route.total_distance < infinity;
+        std::cout << (ok ? "PASSED" : "FAILED") << ": mode " << static_cast<int>(mode) << " route " << route.total_distance
+                  << " over " << route.path.size() << " nodes" << std::endl;
+        passed = passed && ok;
+    }
+    return passed;
+}
+
+// Checks that base mode paths are unpacked from the unrepaired labels, also after disruptions were repaired in
+bool testBasePathFromLabels() {
+    std::cout << "\n=== Testing Base Mode Path Unpacking ===" << std::endl;
+    Graph g;
+    writeLadder(g);
+    Dynamic dynamic(g);
+    dynamic.buildRepairableIndex();
+    dynamic.addUserDisruption(2, 5, "Road Closure", "Closed");
+    dynamic.setMode(Mode::LAZY_UPDATE);
+    distance_t disrupted = dynamic.get_distance(5, 2, true);
+
+    dynamic.setMode(Mode::BASE);
+    std::ostringstream log;
+    std::streambuf *console = std::cout.rdbuf(log.rdbuf());
+    auto [distance, path] = dynamic.get_path(5, 2, true);
+    std::cout.rdbuf(console);
+    bool fromLabels = log.str().find("Unpacking path from labels") != std::string::npos;
+    // the closure detours 5-4-1-2, base mode still takes the closed edge
+    bool passed = fromLabels && distance == 100 && path == std::vector<NodeID>{5, 2} && disrupted == 300;
+    std::cout << (passed ? "PASSED" : "FAILED") << ": base path of length " << distance << " over " << path.size()
+              << " nodes" << (fromLabels ? " unpacked from labels" : " not unpacked from labels") << std::endl;
+    return passed;
+}
+
+// Checks that rebuilding overlays while one is applied slows edges relative to their base weights, not the slowed ones
+bool testSlowdownsStayRelativeToBaseWeight() {
+    std::cout << "\n=== Testing Repeated Slowdowns ===" << std::endl;
+    Graph g;
+    writeLadder(g);
+    Dynamic dynamic(g);
+    dynamic.buildRepairableIndex();
+    // each disruption switches to the mode it recommends, and rebuilds overlays while one is applied
+    dynamic.addUserDisruption(2, 5, "Congestion", "Medium");
+    dynamic.setMode(Mode::DISRUPTED);
+    distance_t first = dynamic.get_distance(2, 5, true);
+    dynamic.addUserDisruption(1, 2, "Congestion", "Medium");
+    dynamic.addUserDisruption(2, 5, "Congestion", "Medium");
+    dynamic.setMode(Mode::DISRUPTED);
+    distance_t repeated = dynamic.get_distance(2, 5, true), other = dynamic.get_distance(1, 2, true);
+    // 100 / 0.6, rounded up
+    bool passed = first == 167 && repeated == 167 && other == 167;
+    std::cout << (passed ? "PASSED" : "FAILED") << ": slowed distances " << first << ", " << repeated << " and " << other << std::endl;
+    return passed;
+}
+
+// Checks that copies of an index share label data until it is written, and that writes leave the original unchanged
+bool testCopiedIndexSharesUnchangedLabels() {
+    std::cout << "\n=== Testing Copy-on-Write Labels ===" << std::endl;
+    // path 1-2-3 closed into a cycle by 3-4-1, with node 5 hanging off node 2
+    Graph g(5);
+    for (auto [a, b] : std::vector<std::pair<NodeID, NodeID>>{ {1, 2}, {2, 3}, {3, 4}, {4, 1}, {2, 5} })
+        g.add_edge(a, b, 10, true);
+    std::vector<Neighbor> closest;
+    g.contract(closest);
+    std::vector<CutIndex> ci;
+    g.create_cut_index(ci, 0.5);
+    g.reset();
+    ContractionIndex original(ci, closest), copy(original);
+
+    bool shared = copy.get_cut_index(1).distances() == original.get_cut_index(1).distances();
+    distance_t before = original.get_cut_index(2).distances()[0];
+    FlatCutIndex written = copy.get_writable_cut_index(2);
+    written.distances()[0] = before + 1;
+    bool passed = shared && copy.is_contracted(5)
+        && original.get_cut_index(2).distances()[0] == before
+        && copy.get_cut_index(5).distances() == written.distances()
+        && copy.get_cut_index(1).distances() == original.get_cut_index(1).distances();
+    std::cout << (passed ? "PASSED" : "FAILED") << ": written labels copied, others still shared" << std::endl;
+    return passed;
+}
+
+// side x side grid with pseudo-random weights, seeded by side so repeated builds are identical
+static void makeWeightedGrid(Graph &g, NodeID side) {
+    g.resize(side * side);
+    std::mt19937 rng(side);
+    for (NodeID r = 0; r < side; r++)
+        for (NodeID c = 0; c < side; c++) {
+            NodeID v = r * side + c + 1;
+            if (c + 1 < side)
+                g.add_edge(v, v + 1, 50 + rng() % 100, true);
+            if (r + 1 < side)
+                g.add_edge(v, v + side, 50 + rng() % 100, true);
+        }
+}
+
+// builds labels single-threaded on a fresh grid from a fixed seed, so runs differ only in the given options
+static void buildGridLabels(NodeID side, FlowEngine engine, const NodeAttributes *attributes, std::vector<CutIndex> &ci) {
+    Graph g;
+    makeWeightedGrid(g, side);
+    Graph::set_flow_engine(engine);
+    srand(1);
+    g.create_cut_index(ci, 0.2, 1, attributes);
+    Graph::set_flow_engine(FlowEngine::dinitz);
+}
+
+// counts random pairs whose index distance differs from Dijkstra on the same grid
+static size_t gridDistanceMismatches(NodeID side, const ContractionIndex &index) {
+    Graph g;
+    makeWeightedGrid(g, side);
+    std::mt19937 pairs(7);
+    size_t mismatches = 0;
+    for (int i = 0; i < 200; i++) {
+        NodeID v = 1 + pairs() % (side * side), w = 1 + pairs() % (side * side);
+        if (index.get_distance(v, w) != g.get_distance(v, w, true))
+            mismatches++;
+    }
+    return mismatches;
+}
+
+// Checks that the push-relabel engine finds the same cuts as Dinitz, giving identical labels
+bool testPushRelabelMatchesDinitz() {
+    std::cout << "\n=== Testing Push-Relabel Flow Engine ===" << std::endl;
+    const NodeID side = 40;
+    std::vector<CutIndex> dinitzCI, pushRelabelCI;
+    buildGridLabels(side, FlowEngine::dinitz, nullptr, dinitzCI);
+    buildGridLabels(side, FlowEngine::push_relabel, nullptr, pushRelabelCI);
+    size_t differing = 0;
+    for (NodeID v = 1; v <= side * side; v++)
+        if (dinitzCI[v].partition != pushRelabelCI[v].partition || dinitzCI[v].dist_index != pushRelabelCI[v].dist_index
+            || dinitzCI[v].distances != pushRelabelCI[v].distances)
+            differing++;
+    bool passed = dinitzCI.size() == pushRelabelCI.size() && differing == 0;
+    std::cout << (passed ? "PASSED" : "FAILED") << ": " << differing << " nodes with differing labels" << std::endl;
+    return passed;
+}
+
+// Checks that inertial-flow partitions from grid coordinates give smaller cuts and exact distances
+bool testInertialFlowPartition() {
+    std::cout << "\n=== Testing Inertial Flow Partitioning ===" << std::endl;
+    const NodeID side = 60;
+    // grid laid out in 100m steps
+    NodeAttributes coordinates;
+    coordinates.latitudes.assign(side * side + 1, NAN);
+    coordinates.longitudes.assign(side * side + 1, NAN);
+    for (NodeID r = 0; r < side; r++)
+        for (NodeID c = 0; c < side; c++) {
+            coordinates.latitudes[r * side + c + 1] = 14.6 + r * 1e-3;
+            coordinates.longitudes[r * side + c + 1] = 121.0 + c * 1e-3;
+        }
+    std::vector<CutIndex> roughCI, inertialCI;
+    buildGridLabels(side, FlowEngine::dinitz, nullptr, roughCI);
+    buildGridLabels(side, FlowEngine::dinitz, &coordinates, inertialCI);
+    ContractionIndex roughIndex(roughCI), inertialIndex(inertialCI);
+    double roughCutSize = roughIndex.avg_cut_size(), inertialCutSize = inertialIndex.avg_cut_size();
+    size_t mismatches = gridDistanceMismatches(side, inertialIndex);
+    bool passed = inertialCutSize < roughCutSize && mismatches == 0;
+    std::cout << (passed ? "PASSED" : "FAILED") << ": avg cut size " << inertialCutSize << " (inertial flow) vs "
+              << roughCutSize << " (rough partition), " << mismatches << " mismatches" << std::endl;
+    return passed;
+}
+
+// Checks road class parsing and that cuts preferring arterial roads keep distances exact
+bool testRoadClassCuts() {
+    std::cout << "\n=== Testing Road Class Cut Priors ===" << std::endl;
+    bool ranks = road_class_rank("motorway") == 7 && road_class_rank("primary_link") == 5
+        && road_class_rank("['unclassified', 'tertiary']") == 3 && road_class_rank("busway") == 0;
+
+    const std::string path = "test_dynamic_road_classes.csv";
+    std::ofstream(path) << "source,target,length,name,highway\n"
+                        << "1,2,22.66,\"Avenue, North\",secondary\n"
+                        << "2,3,19.49,,\"['unclassified', 'residential']\"\n";
+    // road classes are sized for the global graph
+    Graph roads(3);
+    NodeAttributes parsed;
+    bool read = read_road_classes(path, parsed) == 2 && parsed.road_classes == std::vector<uint8_t>{ 0, 4, 4, 2 };
+    std::remove(path.c_str());
+
+    // every tenth row and column is a primary road
+    const NodeID side = 40;
+    NodeAttributes attributes;
+    attributes.road_classes.assign(side * side + 1, 2);
+    for (NodeID r = 0; r < side; r++)
+        for (NodeID c = 0; c < side; c++)
+            if (r % 10 == 5 || c % 10 == 5)
+                attributes.road_classes[r * side + c + 1] = 5;
+    std::vector<CutIndex> ci;
+    buildGridLabels(side, FlowEngine::dinitz, &attributes, ci);
+    size_t mismatches = gridDistanceMismatches(side, ContractionIndex(ci));
+    bool passed = ranks && read && mismatches == 0;
+    std::cout << (passed ? "PASSED" : "FAILED") << ": ranks " << (ranks ? "ok" : "wrong") << ", road classes "
+              << (read ? "read" : "misread") << ", " << mismatches << " mismatches with arterial cuts" << std::endl;
+    return passed;
+}
+
+int main() {
+    std::cout << "HC2L Dynamic Test Program" << std::endl;
+    std::cout << "=========================" << std::endl;
+
+    bool passed = testSnapAvoidsClosedSegment();
+    passed = testBasePathFromLabels() && passed;
+    passed = testSlowdownsStayRelativeToBaseWeight() && passed;
+    passed = testCopiedIndexSharesUnchangedLabels() && passed;
+    passed = testPushRelabelMatchesDinitz() && passed;
+    passed = testInertialFlowPartition() && passed;
+    passed = testRoadClassCuts() && passed;
+
+    std::remove(GRAPH_PATH.c_str());
+    std::remove(NODES_PATH.c_str());
+    std::remove(SCENARIO_PATH.c_str());
+    return passed ? 0 : 1;
+}
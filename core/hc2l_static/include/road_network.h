@@ -22,6 +22,8 @@
 #include <cstdint>
 #include <climits>
 #include <vector>
+#include <string>
+#include <span>
 #include <ostream>
 #include <cassert>
 
@@ -35,6 +37,7 @@ const distance_t infinity = UINT32_MAX >> 1;
 
 struct Neighbor;
 class Graph;
+struct NodeAttributes;
 
 //--------------------------- CutIndex ------------------------------
 
@@ -72,6 +75,8 @@ namespace PBV
     uint64_t lca(uint64_t bv1, uint64_t bv2);
     // check whether node is an ancestor of another, based on their bitvectors
     bool is_ancestor(uint64_t bv_ancestor, uint64_t bv_descendant);
+    // sort key placing bitvectors in depth-first order of the partition tree
+    uint64_t dfs_key(uint64_t bv);
 }
 
 class FlatCutIndex
@@ -158,6 +163,10 @@ public:
 
     // compute distance between v and w
     distance_t get_distance(NodeID v, NodeID w) const;
+    // compute distances for a batch of queries, using up to thread_count threads (0 = all cores)
+    void get_distances(std::span<const std::pair<NodeID,NodeID>> queries, std::span<distance_t> results, size_t thread_count = 0) const;
+    // compute row-major matrix of distances from each source to each target, using up to thread_count threads (0 = all cores)
+    std::vector<distance_t> distance_matrix(std::span<const NodeID> sources, std::span<const NodeID> targets, size_t thread_count = 0) const;
     // verify correctness of distance computed via index for a particular query
     bool check_query(std::pair<NodeID,NodeID> query, Graph &g) const;
 
@@ -272,6 +281,9 @@ struct DiffData
     friend std::ostream& operator<<(std::ostream& os, const DiffData &dd);
 };
 
+// max-flow algorithm used to find minimum vertex cuts during partitioning
+enum class FlowEngine { dinitz, push_relabel };
+
 /**
  * full graph information (edges and weights) is only stored once, as static data; graph instances describe induced subgraphs, storing only a list of nodes;
  * this approach speeds up creation of subgraphs, and saves memory, but complicates usage;
@@ -329,11 +341,12 @@ class Graph
     void run_dijkstra_llsub(NodeID v);
     // stores whether all shortest paths bypass other landmarks in lowest distance bit
     void run_dijkstra_ll(NodeID v);
+    // run dijkstra from a group of cut vertices starting at cut[first] in a single traversal, in subgraph excluding
+    // lower-level landmarks; distances go into the last cut.size() entries of each CutIndex, which must be reserved
+    void run_dijkstra_llsub_multi(const std::vector<NodeID> &cut, size_t first, std::vector<CutIndex> &ci);
 #ifdef MULTI_THREAD_DISTANCES
     // run dijkstra from multiple nodes in parallel
     void run_dijkstra_par(const std::vector<NodeID> &vertices);
-    // run dijkstra from multiple nodes in parallel, in subgraph excluding lower-level landmarks
-    void run_dijkstra_llsub_par(const std::vector<NodeID> &vertices);
     // stores whether all shortest paths bypass other landmarks in lowest distance bit
     void run_dijkstra_ll_par(const std::vector<NodeID> &vertices);
 #endif
@@ -358,6 +371,9 @@ class Graph
     void get_diff_data(std::vector<DiffData> &diff, NodeID a, NodeID b, bool weighted, bool pre_computed = false);
     // find one or more minimal s-t vertex cut sets
     void min_vertex_cuts(std::vector<std::vector<NodeID>> &cuts);
+    // same cuts as min_vertex_cuts, computed by push-relabel on a compact copy of the flow graph;
+    // during create_cut_index with road classes, picks the min cut through the most important roads
+    void min_vertex_cuts_push_relabel(std::vector<std::vector<NodeID>> &cuts);
     // find cut from given rough partition
     void rough_partition_to_cuts(std::vector<std::vector<NodeID>> &cuts, const Partition &p);
     // compute left/right partitions based on given cut
@@ -382,6 +398,8 @@ class Graph
 public:
     // turn progress tracking on/off
     static void show_progress(bool state);
+    // select max-flow algorithm used for partitioning
+    static void set_flow_engine(FlowEngine engine);
     // number of nodes in the top-level graph
     static size_t super_node_count();
 
@@ -392,6 +410,10 @@ public:
     void resize(size_t node_count);
     // insert edge from v to w into global graph, optionally merging with existing edge
     void add_edge(NodeID v, NodeID w, distance_t distance, bool add_reverse, bool merge = false);
+    // insert batch of undirected edges into global graph without edges, merging parallel edges
+    void add_edges(const std::vector<Edge> &edges);
+    // replace adjacency list of v in global graph; reverse arcs must be set separately
+    void set_neighbors(NodeID v, std::span<const Neighbor> neighbors);
     // remove edges between v and w from global graph
     void remove_edge(NodeID v, NodeID w);
     // remove isolated nodes from subgraph
@@ -415,10 +437,14 @@ public:
     void get_connected_components(std::vector<std::vector<NodeID>> &cc);
     // computed rough partition with wide separator, returned in p; returns if rough partition is already a partition
     bool get_rough_partition(Partition &p, double balance, bool disconnected);
+    // compute partition by projecting node coordinates onto several directions and separating extreme nodes (inertial flow);
+    // only available during create_cut_index with coordinates given, returns false if nodes lack coordinates
+    bool get_inertial_partition(Partition &p, double balance);
     // partition graph into balanced subgraphs using minimal cut
     void create_partition(Partition &p, double balance);
-    // decompose graph and construct cut index; returns number of shortcuts used
-    size_t create_cut_index(std::vector<CutIndex> &ci, double balance);
+    // decompose graph and construct cut index using up to thread_count threads (0 = all cores); returns number of shortcuts used;
+    // if node attributes are given, partitions are found by inertial flow where coordinates allow, and cuts prefer arterial roads
+    size_t create_cut_index(std::vector<CutIndex> &ci, double balance, size_t thread_count = 0, const NodeAttributes *attributes = nullptr);
     // returns edges that don't affect distances between nodes
     void get_redundant_edges(std::vector<Edge> &edges);
     // repeatedly remove nodes of degree 1, populating closest[removed] with next node on path to closest unremoved node
@@ -441,5 +467,27 @@ public:
 void print_graph(const Graph &g, std::ostream &os);
 // read graph in DIMACS format
 void read_graph(Graph &g, std::istream &in);
+// read graph in DIMACS format or binary snapshot from memory-mapped file, parsing DIMACS chunks of at least
+// chunk_size bytes on up to thread_count threads (0 for defaults); throws if file cannot be read
+void read_graph(Graph &g, const std::string &filename, size_t thread_count = 0, size_t chunk_size = 0);
+
+// per-node data, mostly stored in binary graph snapshots, indexed by node id (entry 0 unused); empty if not available
+struct NodeAttributes
+{
+    std::vector<double> latitudes, longitudes; // NaN for nodes without coordinates
+    std::vector<uint64_t> osm_ids; // 0 for nodes without OSM id
+    std::vector<uint8_t> road_classes; // highest road_class_rank of incident roads, 0 if unknown; not stored in snapshots
+};
+
+// rank of OpenStreetMap highway tag (or list of tags), from 7 for motorways down to 1 for service roads; 0 if unknown
+uint8_t road_class_rank(const std::string &highway);
+// read highest road_class_rank of incident edges from CSV with source, target and highway columns (e.g. quezon_city_edges.csv)
+// into attributes.road_classes, sized for the global graph; returns number of edges read, throws if file cannot be read
+size_t read_road_classes(const std::string &filename, NodeAttributes &attributes);
+
+// returns whether file is a binary graph snapshot (of any version)
+bool is_graph_snapshot(const std::string &filename);
+// read binary snapshot into g and attributes, either of which may be null; throws if file is invalid or of another version
+void read_graph_snapshot(const std::string &filename, Graph *g, NodeAttributes *attributes);
 
 } // road_network
\ No newline at end of file
@@ -6,8 +6,9 @@
 using namespace road_network;
 
 int main(int argc, char** argv) {
-    if (argc != 5 || std::string(argv[1]) != "--in" || std::string(argv[3]) != "--out") {
-        std::cerr << "Usage: hc2l_cli_build --in <input.gr> --out <output.index>\n";
+    if ((argc != 5 && !(argc == 7 && std::string(argv[5]) == "--road-classes"))
+        || std::string(argv[1]) != "--in" || std::string(argv[3]) != "--out") {
+        std::cerr << "Usage: hc2l_cli_build --in <input.gr> --out <output.index> [--road-classes <edges.csv>]\n";
         return 1;
     }
 
@@ -19,23 +20,33 @@ int main(int argc, char** argv) {
 
     // Load graph
     Graph g;
-    std::ifstream in(in_file);
-    if (!in) {
+    try {
+        read_graph(g, in_file);
+    } catch (const std::exception&) {
         std::cerr << "Error opening input file: " << in_file << "\n";
         return 1;
     }
 
-    read_graph(g, in);  // ✅ this is the correct function
-    in.close();
-
     std::cerr << "[INFO] Graph loaded: " << g.get_nodes().size() << " nodes\n";
 
+    // road classes from the highway column let cuts prefer arterial roads
+    NodeAttributes attributes;
+    if (argc == 7) {
+        try {
+            size_t rows = read_road_classes(argv[6], attributes);
+            std::cerr << "[INFO] Road classes read for " << rows << " edges\n";
+        } catch (const std::exception& e) {
+            std::cerr << "Error reading road classes: " << e.what() << "\n";
+            return 1;
+        }
+    }
+
 
 
     // Build cut index
     auto start = std::chrono::high_resolution_clock::now();
     std::vector<CutIndex> ci;
-    size_t num_shortcuts = g.create_cut_index(ci, 0.5);  // 0.5 = balance factor
+    size_t num_shortcuts = g.create_cut_index(ci, 0.5, 0, attributes.road_classes.empty() ? nullptr : &attributes);  // 0.5 = balance factor
     auto end = std::chrono::high_resolution_clock::now();
 
     std::cerr << "[INFO] Writing index to: " << out_file << "\n";
@@ -9,6 +9,11 @@
 const std::string QC_GRAPH_PATH = "../../test_data/qc_from_csv.gr";
 const std::string QC_SCENARIO_PATH = "../../test_data/qc_scenario_for_cpp_1.csv";
 
+// defined in test_road_network.cpp
+long long build_cut_index_with_engine(road_network::Graph &g, road_network::FlowEngine engine, double balance,
+                                      std::vector<road_network::CutIndex> &ci);
+void expect_same_labels(const std::vector<road_network::CutIndex> &a, const std::vector<road_network::CutIndex> &b);
+
 class QuezonCityStaticTest : public ::testing::Test {
 protected:
     void SetUp() override {
@@ -233,6 +238,27 @@ TEST_F(QuezonCityStaticTest, PerformanceBenchmark) {
     EXPECT_LT(static_cast<double>(query_time.count()) / queries.size(), 1000);  // < 1ms per query on average
 }
 
+TEST_F(QuezonCityStaticTest, FlowEngineBenchmark) {
+    ASSERT_NE(graph, nullptr);
+    
+    // Build the index once per max-flow engine, on fresh graphs with the same seed
+    auto build = [](road_network::FlowEngine engine, std::vector<road_network::CutIndex> &ci) {
+        road_network::Graph g;
+        std::ifstream file(QC_GRAPH_PATH);
+        road_network::read_graph(g, file);
+        return build_cut_index_with_engine(g, engine, 0.5, ci);
+    };
+    std::vector<road_network::CutIndex> dinitz_ci, push_relabel_ci;
+    auto dinitz_time = build(road_network::FlowEngine::dinitz, dinitz_ci);
+    auto push_relabel_time = build(road_network::FlowEngine::push_relabel, push_relabel_ci);
+    
+    std::cerr << "[FLOW] Index construction with Dinitz: " << dinitz_time << " ms\n";
+    std::cerr << "[FLOW] Index construction with push-relabel: " << push_relabel_time << " ms\n";
+    
+    // Both engines find the same min cuts, so labels must be identical
+    expect_same_labels(dinitz_ci, push_relabel_ci);
+}
+
 TEST_F(QuezonCityStaticTest, IndexSerialization) {
     ASSERT_NE(graph, nullptr);
     
@@ -2,9 +2,29 @@
 #include "../include/road_network.h"
 #include <fstream>
 #include <sstream>
+#include <cmath>
+#include <random>
+#include <chrono>
 
 const std::string TEST_DATA_PATH = "../test_data/sample_graph.txt";
 
+void make_weighted_grid(road_network::Graph &g, size_t side, size_t extra_nodes = 0);
+
+// side x side grid with pseudo-random edge weights, seeded by side so repeated builds are identical;
+// extra_nodes are added after the grid nodes for callers to connect
+void make_weighted_grid(road_network::Graph &g, size_t side, size_t extra_nodes) {
+    g.resize(side * side + extra_nodes);
+    std::mt19937 rng(side);
+    for (size_t row = 0; row < side; row++)
+        for (size_t col = 0; col < side; col++) {
+            road_network::NodeID node = row * side + col + 1;
+            if (col + 1 < side)
+                g.add_edge(node, node + 1, 50 + rng() % 100, true);
+            if (row + 1 < side)
+                g.add_edge(node, node + side, 50 + rng() % 100, true);
+        }
+}
+
 class RoadNetworkTest : public ::testing::Test {
 protected:
     void SetUp() override {
@@ -80,4 +100,304 @@ TEST_F(RoadNetworkTest, LoadGraphFromFile) {
         // Skip test if sample data doesn't exist
         GTEST_SKIP() << "Sample graph file not found: " << TEST_DATA_PATH;
     }
-}
\ No newline at end of file
+}
+
+// reads graph from DIMACS text with the stream parser and from a file with the mapped parser, expecting the same edges
+static void expect_readers_agree(const std::string &dimacs, const std::string &path, size_t thread_count, size_t chunk_size) {
+    std::ofstream(path) << dimacs;
+    std::vector<road_network::Edge> stream_edges, mapped_edges;
+    size_t stream_nodes;
+    {
+        road_network::Graph g;
+        std::istringstream in(dimacs);
+        road_network::read_graph(g, in);
+        g.get_edges(stream_edges);
+        stream_nodes = g.node_count();
+    }
+    road_network::Graph g;
+    road_network::read_graph(g, path, thread_count, chunk_size);
+    g.get_edges(mapped_edges);
+
+    EXPECT_EQ(g.node_count(), stream_nodes);
+    ASSERT_EQ(mapped_edges.size(), stream_edges.size());
+    size_t differing = 0;
+    for (size_t i = 0; i < mapped_edges.size(); i++)
+        if (mapped_edges[i].a != stream_edges[i].a || mapped_edges[i].b != stream_edges[i].b || mapped_edges[i].d != stream_edges[i].d)
+            differing++;
+    EXPECT_EQ(differing, 0u);
+}
+
+TEST(GraphReaderTest, MappedReaderMatchesStreamReader) {
+    // parallel edges in either direction, a comment and blank lines between arcs
+    const std::string dimacs = "c sample\np sp 5 6\na 1 2 7\na 2 1 4\n\na 2 3 5\nc mid\n  a 3 4 2\na 4 5 9\na 2 3 8\n";
+    const std::string path = testing::TempDir() + "mapped_reader.gr";
+    expect_readers_agree(dimacs, path, 0, 0);
+
+    road_network::Graph g;
+    road_network::read_graph(g, path);
+    std::vector<road_network::Edge> edges;
+    g.get_edges(edges);
+    EXPECT_EQ(edges.size(), 4u);
+    EXPECT_THROW(road_network::read_graph(g, testing::TempDir() + "missing.gr"), std::runtime_error);
+}
+
+TEST(GraphReaderTest, ChunkedReaderMatchesStreamReader) {
+    // grid file of a few hundred KB, split into 64 KB chunks so chunk bounds fall inside lines and comments
+    std::ostringstream dimacs;
+    const size_t side = 80;
+    std::mt19937 rng(3);
+    dimacs << "c chunked\np sp " << side * side << " " << 4 * side * (side - 1) << "\n";
+    for (size_t row = 0; row < side; row++)
+        for (size_t col = 0; col < side; col++) {
+            size_t node = row * side + col + 1;
+            if (col + 1 < side)
+                dimacs << "a " << node << " " << node + 1 << " " << 1 + rng() % 1000 << "\n"
+                       << "a " << node + 1 << " " << node << " " << 1 + rng() % 1000 << "\n";
+            if (row + 1 < side)
+                dimacs << "a " << node << " " << node + side << " " << 1 + rng() % 1000 << "\n"
+                       << "c row " << row << "\n"
+                       << "a " << node + side << " " << node << " " << 1 + rng() % 1000 << "\n";
+        }
+    ASSERT_GT(dimacs.str().size(), 4u * 65536);
+    const std::string path = testing::TempDir() + "chunked_reader.gr";
+    for (size_t thread_count : { 2, 3, 8 })
+        expect_readers_agree(dimacs.str(), path, thread_count, 65536);
+}
+
+long long build_cut_index_with_engine(road_network::Graph &g, road_network::FlowEngine engine, double balance,
+                                      std::vector<road_network::CutIndex> &ci);
+void expect_same_labels(const std::vector<road_network::CutIndex> &a, const std::vector<road_network::CutIndex> &b);
+
+// builds cut index single-threaded from a fixed seed with the given flow engine, so engines can be compared
+// on identical rough partitions; returns construction time in ms
+long long build_cut_index_with_engine(road_network::Graph &g, road_network::FlowEngine engine, double balance,
+                                      std::vector<road_network::CutIndex> &ci) {
+    road_network::Graph::set_flow_engine(engine);
+    srand(1);
+    auto start = std::chrono::high_resolution_clock::now();
+    g.create_cut_index(ci, balance, 1);
+    auto end = std::chrono::high_resolution_clock::now();
+    road_network::Graph::set_flow_engine(road_network::FlowEngine::dinitz);
+    return std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+}
+
+void expect_same_labels(const std::vector<road_network::CutIndex> &a, const std::vector<road_network::CutIndex> &b) {
+    ASSERT_EQ(a.size(), b.size());
+    size_t differing = 0;
+    for (size_t i = 0; i < a.size(); i++)
+        if (a[i].partition != b[i].partition || a[i].dist_index != b[i].dist_index || a[i].distances != b[i].distances)
+            differing++;
+    EXPECT_EQ(differing, 0u);
+}
+
+// builds cut index on a fresh grid with both flow engines, expecting identical labels; returns times in ms
+static std::pair<long long, long long> compare_engines_on_grid(size_t side) {
+    // graphs share static state, so only one exists at a time
+    auto build = [side](road_network::FlowEngine engine, std::vector<road_network::CutIndex> &ci) {
+        road_network::Graph g;
+        make_weighted_grid(g, side);
+        return build_cut_index_with_engine(g, engine, 0.2, ci);
+    };
+    std::vector<road_network::CutIndex> dinitz_ci, push_relabel_ci;
+    long long dinitz_time = build(road_network::FlowEngine::dinitz, dinitz_ci);
+    long long push_relabel_time = build(road_network::FlowEngine::push_relabel, push_relabel_ci);
+    expect_same_labels(dinitz_ci, push_relabel_ci);
+    return { dinitz_time, push_relabel_time };
+}
+
+TEST(FlowEngineTest, PushRelabelMatchesDinitzOnGrids) {
+    for (size_t side : { 50, 100 })
+        compare_engines_on_grid(side);
+}
+
+TEST(FlowEngineTest, GridBenchmark) {
+    // synthetic grid of about three times the QC node count, for comparing engines beyond the city graph
+    const size_t side = 200;
+    auto [dinitz_time, push_relabel_time] = compare_engines_on_grid(side);
+    std::cerr << "[FLOW] " << side << "x" << side << " grid - Dinitz: " << dinitz_time << " ms, push-relabel: "
+              << push_relabel_time << " ms\n";
+}
+
+TEST(InertialFlowTest, GridCoordinatesGiveSmallerCuts) {
+    const size_t side = 100;
+    // grid laid out in 100m steps
+    road_network::NodeAttributes coordinates;
+    coordinates.latitudes.assign(side * side + 1, NAN);
+    coordinates.longitudes.assign(side * side + 1, NAN);
+    for (size_t row = 0; row < side; row++)
+        for (size_t col = 0; col < side; col++) {
+            coordinates.latitudes[row * side + col + 1] = 14.6 + row * 1e-3;
+            coordinates.longitudes[row * side + col + 1] = 121.0 + col * 1e-3;
+        }
+    std::vector<road_network::CutIndex> rough_ci, inertial_ci;
+    {
+        road_network::Graph g;
+        make_weighted_grid(g, side);
+        srand(1);
+        g.create_cut_index(rough_ci, 0.2, 1);
+    }
+    road_network::Graph g;
+    make_weighted_grid(g, side);
+    g.create_cut_index(inertial_ci, 0.2, 1, &coordinates);
+    g.reset();
+    road_network::ContractionIndex rough_index(rough_ci), inertial_index(inertial_ci);
+    std::cerr << "[INERTIAL] " << side << "x" << side << " grid - avg cut size: " << rough_index.avg_cut_size()
+              << " (rough partition) vs " << inertial_index.avg_cut_size() << " (inertial flow)\n";
+    EXPECT_LT(inertial_index.avg_cut_size(), rough_index.avg_cut_size());
+
+    std::mt19937 pairs(7);
+    for (int i = 0; i < 200; i++) {
+        road_network::NodeID v = 1 + pairs() % (side * side), w = 1 + pairs() % (side * side);
+        EXPECT_EQ(inertial_index.get_distance(v, w), g.get_distance(v, w, true));
+    }
+}
+
+TEST(RoadClassTest, HighwayTagRanks) {
+    EXPECT_EQ(road_network::road_class_rank("motorway"), 7);
+    EXPECT_EQ(road_network::road_class_rank("primary_link"), 5);
+    EXPECT_EQ(road_network::road_class_rank("residential"), 2);
+    EXPECT_EQ(road_network::road_class_rank("['unclassified', 'tertiary']"), 3);
+    EXPECT_EQ(road_network::road_class_rank("busway"), 0);
+    EXPECT_EQ(road_network::road_class_rank(""), 0);
+}
+
+TEST(RoadClassTest, ReadsHighestClassOfIncidentEdges) {
+    const std::string path = testing::TempDir() + "road_classes.csv";
+    std::ofstream(path) << "source,target,length,name,highway\n"
+                        << "1,2,22.66,\"Avenue, North\",secondary\n"
+                        << "2,3,19.49,,\"['unclassified', 'residential']\"\n"
+                        << "3,9,10.0,Out of range,primary\n";
+    road_network::Graph g(4);
+    road_network::NodeAttributes attributes;
+    EXPECT_EQ(road_network::read_road_classes(path, attributes), 3u);
+    EXPECT_EQ(attributes.road_classes, (std::vector<uint8_t>{ 0, 4, 4, 5, 0 }));
+    EXPECT_THROW(road_network::read_road_classes(path + ".missing", attributes), std::runtime_error);
+}
+
+TEST(RoadClassTest, ArterialCutsKeepDistancesExact) {
+    const size_t side = 60;
+    road_network::Graph g;
+    make_weighted_grid(g, side);
+    road_network::NodeAttributes attributes;
+    attributes.road_classes.assign(side * side + 1, 2);
+    // every tenth row and column is a primary road
+    for (size_t row = 0; row < side; row++)
+        for (size_t col = 0; col < side; col++)
+            if (row % 10 == 5 || col % 10 == 5)
+                attributes.road_classes[row * side + col + 1] = 5;
+    std::vector<road_network::CutIndex> ci;
+    srand(1);
+    g.create_cut_index(ci, 0.2, 1, &attributes);
+    g.reset();
+#ifndef PRUNING
+    // top-level cut vertices store distances to themselves and all vertices before them in hub order,
+    // so where the cut crosses primary roads, those vertices should have the fewest labels
+    // (with PRUNING, hub order follows pruning potential and road classes only break ties)
+    size_t last_primary = 0, first_other = SIZE_MAX;
+    for (road_network::NodeID node = 1; node <= side * side; node++)
+        if (ci[node].cut_level == 0) {
+            if (attributes.road_classes[node] == 5)
+                last_primary = std::max(last_primary, ci[node].distances.size());
+            else
+                first_other = std::min(first_other, ci[node].distances.size());
+        }
+    EXPECT_GT(last_primary, 0u);
+    EXPECT_LT(last_primary, first_other);
+#endif
+    road_network::ContractionIndex index(ci);
+
+    std::mt19937 pairs(7);
+    for (int i = 0; i < 200; i++) {
+        road_network::NodeID v = 1 + pairs() % (side * side), w = 1 + pairs() % (side * side);
+        EXPECT_EQ(index.get_distance(v, w), g.get_distance(v, w, true));
+    }
+}
+
+// grid with pendant trees, whose nodes get contracted into the grid, and a triangle unreachable from the grid
+class BatchQueryTest : public ::testing::Test {
+protected:
+    static const size_t side = 20, tree_count = 10, tree_size = 4;
+    static const size_t grid_nodes = side * side, triangle = grid_nodes + tree_count * tree_size + 1;
+
+    void SetUp() override {
+        road_network::Graph g;
+        make_weighted_grid(g, side, tree_count * tree_size + 3);
+        for (size_t t = 0; t < tree_count; t++) {
+            // path of three nodes with a branch at its first node
+            road_network::NodeID root = 1 + t * 37 % grid_nodes, first = grid_nodes + t * tree_size + 1;
+            g.add_edge(root, first, 10 + t, true);
+            g.add_edge(first, first + 1, 20, true);
+            g.add_edge(first + 1, first + 2, 30, true);
+            g.add_edge(first, first + 3, 15, true);
+        }
+        g.add_edge(triangle, triangle + 1, 5, true);
+        g.add_edge(triangle + 1, triangle + 2, 7, true);
+        g.add_edge(triangle, triangle + 2, 9, true);
+        std::vector<road_network::Neighbor> closest;
+        g.contract(closest);
+        std::vector<road_network::CutIndex> ci;
+        srand(1);
+        g.create_cut_index(ci, 0.2, 1);
+        index = std::make_unique<road_network::ContractionIndex>(ci, closest);
+    }
+
+    // same-tree, contracted-to-grid and unreachable pairs, followed by random ones
+    std::vector<std::pair<road_network::NodeID, road_network::NodeID>> make_queries(size_t count) const {
+        const road_network::NodeID tree = grid_nodes + 1;
+        std::vector<std::pair<road_network::NodeID, road_network::NodeID>> queries = {
+            { tree + 2, tree + 3 }, { tree + 1, tree + 2 }, { tree + 3, tree }, { tree + 2, tree + 2 },
+            { tree + 2, tree + tree_size + 2 }, { tree + 2, 1 + grid_nodes / 2 }, { 1 + grid_nodes / 2, tree + 3 },
+            { tree + 2, triangle }, { triangle + 1, 1 }, { triangle, triangle + 2 }
+        };
+        std::mt19937 rng(3);
+        while (queries.size() < count)
+            queries.push_back({ 1 + rng() % (triangle + 2), 1 + rng() % (triangle + 2) });
+        return queries;
+    }
+
+    std::unique_ptr<road_network::ContractionIndex> index;
+};
+
+TEST_F(BatchQueryTest, GetDistancesMatchesSingleQueries) {
+    ASSERT_TRUE(index->is_contracted(grid_nodes + 3));
+    EXPECT_EQ(index->get_distance(1, triangle), road_network::infinity);
+    // more than one block of queries, and not a multiple of the block size
+    auto queries = make_queries((1 << 16) + 37);
+    for (size_t thread_count : { 1, 3, 0 }) {
+        std::vector<road_network::distance_t> results(queries.size(), 1);
+        index->get_distances(queries, results, thread_count);
+        size_t mismatches = 0;
+        for (size_t i = 0; i < queries.size(); i++)
+            if (results[i] != index->get_distance(queries[i].first, queries[i].second))
+                mismatches++;
+        EXPECT_EQ(mismatches, 0u) << "with " << thread_count << " threads";
+    }
+}
+
+TEST_F(BatchQueryTest, DistanceMatrixMatchesSingleQueries) {
+    // neither dimension is a multiple of the tile size
+    auto pairs = make_queries(100);
+    std::vector<road_network::NodeID> sources, targets;
+    for (size_t i = 0; i < pairs.size(); i++) {
+        if (i < 45)
+            sources.push_back(pairs[i].first);
+        targets.push_back(pairs[i].second);
+    }
+    for (size_t thread_count : { 1, 3 }) {
+        std::vector<road_network::distance_t> matrix = index->distance_matrix(sources, targets, thread_count);
+        ASSERT_EQ(matrix.size(), sources.size() * targets.size());
+        for (size_t i = 0; i < sources.size(); i++)
+            for (size_t j = 0; j < targets.size(); j++)
+                EXPECT_EQ(matrix[i * targets.size() + j], index->get_distance(sources[i], targets[j]))
+                    << "from " << sources[i] << " to " << targets[j];
+    }
+}
+
+TEST_F(BatchQueryTest, EmptyBatches) {
+    std::vector<std::pair<road_network::NodeID, road_network::NodeID>> no_queries;
+    std::vector<road_network::distance_t> no_results;
+    index->get_distances(no_queries, no_results);
+    std::vector<road_network::NodeID> nodes = { 1, grid_nodes + 2 }, no_nodes;
+    EXPECT_TRUE(index->distance_matrix(no_nodes, nodes).empty());
+    EXPECT_TRUE(index->distance_matrix(nodes, no_nodes).empty());
+}
@@ -2,6 +2,8 @@
 import subprocess
 import json
 import os
+import threading
+import itertools
 from typing import Dict, List, Tuple, Optional
 from road_name_mapper import RoadNameMapper
 
@@ -20,8 +22,67 @@ class DHLRouter:
         # Initialize road name mapper for turn-by-turn directions
         self.road_mapper = RoadNameMapper(self._find_edges_csv())
         
+        # Persistent routing server (keeps graph and index loaded between requests)
+        self.server_executable = os.path.join(os.path.dirname(self.cpp_executable), 'dhl_routing_server')
+        self.server_process = None
+        self.server_lock = threading.Lock()
+        self.request_ids = itertools.count(1)
+        
         print(f"✅ Using DHL routing executable: {self.cpp_executable}")
     
+    def _query_server(self, start_lat: float, start_lng: float,
+                      dest_lat: float, dest_lng: float, use_disruptions: bool) -> Optional[Dict]:
+        """Send one request to the persistent DHL routing server; returns None if it is unavailable"""
+        if not os.path.exists(self.server_executable):
+            return None
+        
+        with self.server_lock:
+            try:
+                if self.server_process is None or self.server_process.poll() is not None:
+                    print(f"Starting DHL routing server: {self.server_executable}")
+                    self.server_process = subprocess.Popen(
+                        [self.server_executable, '--threads', '1'],
+                        stdin=subprocess.PIPE,
+                        stdout=subprocess.PIPE,
+                        text=True,
+                        bufsize=1
+                    )
+                
+                request_id = next(self.request_ids)
+                request = {
+                    'id': request_id,
+                    'start_lat': start_lat, 'start_lng': start_lng,
+                    'dest_lat': dest_lat, 'dest_lng': dest_lng,
+                    'use_disruptions': use_disruptions
+                }
+                self.server_process.stdin.write(json.dumps(request) + '\n')
+                self.server_process.stdin.flush()
+                
+                # Requests are sent one at a time, but skip any stale responses just in case
+                for line in self.server_process.stdout:
+                    response = json.loads(line)
+                    if response.get('id') == request_id:
+                        return response
+                
+                # Server exited (e.g. failed to initialize)
+                self.server_process = None
+                return None
+                
+            except (OSError, ValueError) as e:
+                print(f"DHL routing server unavailable, falling back to JSON API: {e}")
+                if self.server_process is not None:
+                    self.server_process.kill()
+                self.server_process = None
+                return None
+    
+    def close(self):
+        """Stop the persistent DHL routing server, if running"""
+        with self.server_lock:
+            if self.server_process is not None and self.server_process.poll() is None:
+                self.server_process.stdin.close()
+                self.server_process.wait(timeout=5)
+            self.server_process = None
+    
     def _find_dhl_executable(self):
         """Find the DHL executable in possible locations"""
         current_dir = os.path.dirname(os.path.abspath(__file__))
@@ -79,6 +140,19 @@ class DHLRouter:
         Returns route data with polylines and metrics
         """
         try:
+            # Prefer the persistent server; index construction then happens only once
+            dhl_data = self._query_server(start_lat, start_lng, dest_lat, dest_lng, use_disruptions)
+            if dhl_data is not None:
+                if not dhl_data.get('success', False):
+                    return {
+                        'success': False,
+                        'error': dhl_data.get('error', 'Unknown DHL error')
+                    }
+                parsed_data = self._convert_dhl_to_route_format(dhl_data)
+                parsed_data['success'] = True
+                parsed_data['raw_dhl_output'] = dhl_data
+                return parsed_data
+            
             print(f"Executing DHL JSON API route computation...")
             
             # Use the refactored JSON API - much simpler now!